@@ -0,0 +1,180 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef _BATCHEDFIFO_H
+#define _BATCHEDFIFO_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// A simple thread-safe FIFO of fixed capacity, with batch operations.
+// Interface follows AliceO2::Common::Fifo (push/pop return 0 on success),
+// with the addition of multi-push/multi-pop: a whole batch of items is
+// inserted or retrieved with a single lock operation, instead of paying
+// synchronization per item. Used on the high-rate equipment -> aggregator
+// path, where per-block FIFO synchronization is measurable.
+
+// A notification object for event-driven wakeup of a consumer thread.
+// Several FIFOs may share one event: each push notifies it, and the consumer
+// waits on it instead of polling with fixed sleeps. To avoid missed wakeups,
+// the consumer shall take the event count before checking the FIFOs, and
+// give it back to wait(): it returns immediately if a notification happened
+// in between. An optional spin time allows to busy-wait a little before
+// blocking, for lowest wakeup latency on the highest-rate sources.
+class FifoEvent {
+public:
+  // notify waiting threads that something happened
+  void notify() {
+    eventCount.fetch_add(1, std::memory_order_release);
+    {
+      // lock taken (empty) to avoid race with predicate check in wait()
+      std::lock_guard<std::mutex> lock(eventMutex);
+    }
+    eventCondition.notify_all();
+  }
+
+  // get current event count, to be passed to wait()
+  uint64_t getCount() { return eventCount.load(std::memory_order_acquire); }
+
+  // wait for a notification newer than refCount, up to timeout (microseconds)
+  // busy-wait for spinTime (microseconds) before blocking, if set
+  void wait(uint64_t refCount, int timeout, int spinTime = 0) {
+    if (spinTime > 0) {
+      auto t0 = std::chrono::steady_clock::now();
+      while (eventCount.load(std::memory_order_acquire) == refCount) {
+        if (std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t0)
+                .count() >= spinTime) {
+          break;
+        }
+      }
+      if (eventCount.load(std::memory_order_acquire) != refCount) {
+        return;
+      }
+    }
+    std::unique_lock<std::mutex> lock(eventMutex);
+    eventCondition.wait_for(lock, std::chrono::microseconds(timeout), [&] {
+      return eventCount.load(std::memory_order_acquire) != refCount;
+    });
+  }
+
+private:
+  std::atomic<uint64_t> eventCount = {0}; // incremented on each notification
+  std::mutex eventMutex;                  // lock for condition variable
+  std::condition_variable eventCondition; // to wake up waiting threads
+};
+
+template <class T> class BatchedFifo {
+
+public:
+  BatchedFifo(int capacity) { maxItems = capacity; }
+  ~BatchedFifo() {}
+
+  // attach a notification event, shared with other FIFOs of same consumer
+  // each successful push then notifies it
+  void setEvent(FifoEvent *e) { event = e; }
+
+  // push one item
+  // returns 0 on success, -1 if FIFO full
+  int push(const T &item) {
+    {
+      std::unique_lock<std::mutex> lock(itemsMutex);
+      if (items.size() >= maxItems) {
+        return -1;
+      }
+      items.push_back(item);
+    }
+    if (event != nullptr) {
+      event->notify();
+    }
+    return 0;
+  }
+
+  // push a batch of items, with a single synchronization
+  // all items are inserted, or none (when not enough space)
+  // returns 0 on success, -1 if not enough space in FIFO
+  int push(const std::vector<T> &batch) {
+    {
+      std::unique_lock<std::mutex> lock(itemsMutex);
+      if (items.size() + batch.size() > maxItems) {
+        return -1;
+      }
+      for (const auto &item : batch) {
+        items.push_back(item);
+      }
+    }
+    if (event != nullptr) {
+      event->notify();
+    }
+    return 0;
+  }
+
+  // pop one item
+  // returns 0 on success, -1 if FIFO empty
+  int pop(T &item) {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    if (items.empty()) {
+      return -1;
+    }
+    item = items.front();
+    items.pop_front();
+    return 0;
+  }
+
+  // pop up to maxBatchSize items into given vector (cleared first), with a
+  // single synchronization
+  // returns the number of items retrieved (zero if FIFO empty)
+  int pop(std::vector<T> &batch, int maxBatchSize) {
+    batch.clear();
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    while ((!items.empty()) && ((int)batch.size() < maxBatchSize)) {
+      batch.push_back(items.front());
+      items.pop_front();
+    }
+    return batch.size();
+  }
+
+  bool isFull() {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    return (items.size() >= maxItems);
+  }
+
+  bool isEmpty() {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    return items.empty();
+  }
+
+  int getNumberOfUsedSlots() {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    return (int)items.size();
+  }
+
+  int getNumberOfFreeSlots() {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    return (int)(maxItems - items.size());
+  }
+
+  void clear() {
+    std::unique_lock<std::mutex> lock(itemsMutex);
+    items.clear();
+  }
+
+private:
+  std::deque<T> items;   // queued items
+  size_t maxItems;       // maximum number of items in FIFO
+  std::mutex itemsMutex; // lock for concurrent access to items
+  FifoEvent *event = nullptr; // notified on push, when set
+};
+
+#endif // #ifndef _BATCHEDFIFO_H
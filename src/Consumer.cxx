@@ -9,6 +9,35 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "MemoryPagesPool.h"
+#include "ReadoutUtils.h"
+
+Consumer::Consumer(ConfigFile &cfg, std::string cfgEntryPoint) {
+  // configuration parameter: | consumer-* | cpuSet | string | | If set, CPU
+  // affinity of the threads owned by this consumer. List of CPU ids, given as
+  // comma-separated values or ranges, e.g. "0-3,8". |
+  cfg.getOptionalValue<std::string>(cfgEntryPoint + ".cpuSet", cfgCpuSet);
+
+  // assign a unique id to this consumer, used to tag page trace events.
+  // atomic counter: consumers may be created concurrently at configure time
+  // (c.f. readout.configureThreads).
+  static std::atomic<int> nConsumers(0);
+  consumerId = ++nConsumers;
+}
+
+void Consumer::applyCpuSet() {
+  if (cfgCpuSet.length() == 0) {
+    return;
+  }
+  if (setThreadCpuSet(cfgCpuSet) == 0) {
+    theLog.log("Consumer %s: thread bound to CPUs %s", name.c_str(),
+               cfgCpuSet.c_str());
+  } else {
+    theLog.log(InfoLogger::Severity::Warning,
+               "Consumer %s: failed to set thread affinity to %s",
+               name.c_str(), cfgCpuSet.c_str());
+  }
+}
 
 int Consumer::pushData(DataSetReference &bc) {
   int success = 0;
@@ -16,6 +45,10 @@ int Consumer::pushData(DataSetReference &bc) {
   for (auto &b : *bc) {
     if (!pushData(b)) {
       success++;
+      totalBlocksIn++;
+      totalBytesIn += b->getData()->header.dataSize;
+      gPageEventTrace.record(b->getData()->data,
+                             PageEventTrace::stageConsumerPush, consumerId);
     } else {
       error++;
     }
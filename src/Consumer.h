@@ -17,13 +17,15 @@
 
 #include <memory>
 
+#include "ReadoutStats.h"
+
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
 extern InfoLogger theLog;
 
 class Consumer {
 public:
-  Consumer(ConfigFile &, std::string){};
+  Consumer(ConfigFile &cfg, std::string cfgEntryPoint);
   virtual ~Consumer(){};
   virtual int pushData(DataBlockContainerReference &b) = 0;
 
@@ -53,10 +55,37 @@ public:
                    // occuring in the consumer
   bool isErrorReported =
       false; // flag to keep track of error reports for this consumer
+
+  // cumulated input counters, updated when datasets are pushed to this
+  // consumer (used e.g. for the exported runtime statistics)
+  unsigned long long totalBlocksIn = 0; // blocks successfully pushed
+  unsigned long long totalBytesIn = 0;  // bytes successfully pushed
+
+  int consumerId = 0; // unique (incremental) id of this consumer, assigned at
+                      // construction time, e.g. to tag page trace events
+
+protected:
+  std::string cfgCpuSet = ""; // when set, CPU affinity of the threads owned
+                              // by this consumer (list of CPU ids, e.g.
+                              // "0-3,8")
+
+  ReadoutStatsBatch
+      statsBatch; // local accumulator for the gReadoutStats counter updated
+                  // by this consumer (e.g. bytesFairMQ, bytesRecorded), to
+                  // avoid bouncing the shared atomic per block. Subclasses
+                  // init() it with the relevant counter and add() on their
+                  // data path (one updating thread); flushed automatically
+                  // on count/time threshold and at destruction.
+
+  // set CPU affinity of calling thread to configured cpuSet, if any.
+  // to be called at begin of each thread owned by the consumer.
+  void applyCpuSet();
 };
 
 std::unique_ptr<Consumer> getUniqueConsumerStats(ConfigFile &cfg,
                                                  std::string cfgEntryPoint);
+std::unique_ptr<Consumer> getUniqueConsumerLatency(ConfigFile &cfg,
+                                                   std::string cfgEntryPoint);
 std::unique_ptr<Consumer> getUniqueConsumerFMQ(ConfigFile &cfg,
                                                std::string cfgEntryPoint);
 std::unique_ptr<Consumer>
@@ -9,6 +9,18 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "ReadoutUtils.h"
+
+#include <Common/Fifo.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 typedef struct {
   uint32_t w0;
@@ -31,21 +43,106 @@ typedef struct {
 
 class ConsumerDataChecker : public Consumer {
 public:
-  uint32_t checkValue;
-  unsigned long long errorCount;
-  unsigned long long checkedPages;
+  std::atomic<unsigned long long> errorCount;
+  std::atomic<unsigned long long> checkedPages;
+  unsigned long long skippedPages; // superpages not checked (workers busy)
+  uint32_t checkValue; // next expected counter value at input (the internal
+                       // data generator starts 0 and increases every 256-bit
+                       // word, continuously over pages)
+
+  // a superpage queued for verification, with the counter value expected at
+  // its first payload word
+  struct CheckRequest {
+    DataBlockContainerReference b;
+    uint32_t startValue;
+  };
+
+  // a verification worker, with its input queue
+  struct CheckThread {
+    std::unique_ptr<AliceO2::Common::Fifo<CheckRequest>> input;
+    std::unique_ptr<std::thread> th;
+  };
+  std::vector<std::unique_ptr<CheckThread>> pool;
+  std::atomic<int> shutdown;
+  int threadIndex = 0; // a running index for the next worker to use
+
+  int cfgNumberOfThreads;  // number of verification threads
+  int cfgFifoSize;         // input queue depth of each thread
+  int cfgIdleSleepTime;    // idle sleep time of the threads (microseconds)
 
   ConsumerDataChecker(ConfigFile &cfg, std::string cfgEntryPoint)
       : Consumer(cfg, cfgEntryPoint) {
-    checkValue =
-        0; // internal data generator starts 0 and increases every 256bits word
+    checkValue = 0;
     errorCount = 0;
     checkedPages = 0;
+    skippedPages = 0;
+    shutdown = 0;
+
+    // configuration parameter: | consumer-checker-* | numberOfThreads | int |
+    // 1 | Number of threads running the payload verification in parallel.
+    // Superpages are distributed round-robin between them, so that full-rate
+    // online checking does not block the data path. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".numberOfThreads",
+                              cfgNumberOfThreads, 1);
+    if (cfgNumberOfThreads < 1) {
+      cfgNumberOfThreads = 1;
+    }
+
+    // configuration parameter: | consumer-checker-* | threadInputFifoSize |
+    // int | 10 | Size of the input queue of each verification thread.
+    // Superpages arriving when all queues are full are counted and skipped. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".threadInputFifoSize",
+                              cfgFifoSize, 10);
+
+    // configuration parameter: | consumer-checker-* | threadIdleSleepTime |
+    // int | 1000 | Sleep time (microseconds) of inactive verification thread,
+    // before polling for next data. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".threadIdleSleepTime",
+                              cfgIdleSleepTime, 1000);
+
+    const char *simdMode = "scalar";
+#if defined(__AVX2__)
+    simdMode = "AVX2";
+#elif defined(__SSE2__)
+    simdMode = "SSE2";
+#endif
+    theLog.log("Data checker: %d thread(s), %s compare", cfgNumberOfThreads,
+               simdMode);
+
+    for (int i = 0; i < cfgNumberOfThreads; i++) {
+      auto ct = std::make_unique<CheckThread>();
+      ct->input = std::make_unique<AliceO2::Common::Fifo<CheckRequest>>(
+          cfgFifoSize);
+      CheckThread *ctPtr = ct.get();
+      std::function<void(void)> l = [this, ctPtr]() { this->loop(ctPtr); };
+      ct->th = std::make_unique<std::thread>(l);
+      pool.push_back(std::move(ct));
+    }
   }
+
   ~ConsumerDataChecker() {
+    // let workers empty their queues before stopping them
+    for (auto const &ct : pool) {
+      while (!ct->input->isEmpty()) {
+        usleep(1000);
+      }
+    }
+    shutdown = 1;
+    for (auto const &ct : pool) {
+      ct->th->join();
+    }
+    pool.clear();
     theLog.log("Checker detected %llu data errors on %llu DMA pages",
-               errorCount, checkedPages);
+               (unsigned long long)errorCount,
+               (unsigned long long)checkedPages);
+    if (skippedPages) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Checker skipped %llu superpages (verification threads "
+                 "busy)",
+                 skippedPages);
+    }
   }
+
   int pushData(DataBlockContainerReference &b) {
 
     void *ptr;
@@ -54,100 +151,142 @@ public:
     if (ptr == NULL) {
       return -1;
     }
-
     size = b->getData()->header.dataSize;
-    //    theLog.log("checking container %p data @ %p : %d bytes",(void
-    //    *)b.get(),ptr,(int)size);
+
+    // walk the page headers only (one cache line each) to compute the
+    // counter value expected at the beginning of next superpage: the heavy
+    // payload verification is done by the worker threads
+    uint32_t startValue = checkValue;
+    for (unsigned int i = 0; i < size; i += 8 * 1024) {
+      RocPageHeader *h = (RocPageHeader *)&(((char *)ptr)[i]);
+      unsigned int pagePayloadSize =
+          (h->payloadSize) * 256 / 8 -
+          sizeof(RocPageHeader); // convert to bytes the size given in number
+                                 // of 256-bits words
+      // counter increments once per 8 32-bit words
+      checkValue += pagePayloadSize / (8 * sizeof(unsigned int));
+    }
+
+    // feed the workers round-robin
+    CheckRequest req;
+    req.b = b;
+    req.startValue = startValue;
+    int i;
+    for (i = 0; i < cfgNumberOfThreads; i++) {
+      threadIndex++;
+      if (threadIndex == cfgNumberOfThreads) {
+        threadIndex = 0;
+      }
+      if (pool[threadIndex]->input->push(req) == 0) {
+        break;
+      }
+    }
+    if (i == cfgNumberOfThreads) {
+      // all queues full: keep up with the data, skip this superpage
+      skippedPages++;
+    }
+
+    return 0;
+  }
+
+private:
+  // verification thread loop
+  void loop(CheckThread *ct) {
+    applyCpuSet();
+    while (!shutdown) {
+      CheckRequest req;
+      if (ct->input->pop(req)) {
+        usleep(cfgIdleSleepTime);
+        continue;
+      }
+      checkSuperpage(req);
+      req.b = nullptr;
+    }
+  }
+
+  // check one superpage against the expected incrementing pattern
+  void checkSuperpage(CheckRequest &req) {
+    void *ptr = req.b->getData()->data;
+    size_t size = req.b->getData()->header.dataSize;
+    uint32_t value = req.startValue;
 
     unsigned int pageId = 0;
     for (unsigned int i = 0; i < size; pageId++) {
       checkedPages++;
       RocPageHeader *h = (RocPageHeader *)&(((char *)ptr)[i]);
-
-      /*      printf("page %u @ %p\n",pageId,(void *)h);
-            for (unsigned int w=0;w<sizeof(RocPageHeader)/sizeof(unsigned
-         int);w++) { printf("%08X  ",(((unsigned int *)h)[w])); if (w%8==7)
-         printf("\n");
-            }
-            printf("\n");
-      */
       void *pagePayloadPtr = &((char *)h)[sizeof(RocPageHeader)];
       unsigned int pagePayloadSize =
           (h->payloadSize) * 256 / 8 -
-          sizeof(RocPageHeader); // convert to bytes the size given in number of
-                                 // 256-bits words
-
-      /*
-            printf("payload size = %u\n",pagePayloadSize);
-            for (unsigned int w=0;w<pagePayloadSize/sizeof(unsigned int);w++) {
-              printf("%08X  ",(((unsigned int *)pagePayloadPtr)[w]));
-              if (w%8==7) printf("\n");
-            }
-            printf("\n");
-
-            for (unsigned int w=0;w<16;w++) {
-              printf("%08X  ",(((unsigned int *)pagePayloadPtr)[w]));
-              if (w%8==7) printf("\n");
-            }
-      */
-
-      // check counter increasing
-      /*
-      for (unsigned int w=0;w<pagePayloadSize/sizeof(unsigned int);w++) {
-        if (((unsigned int *)pagePayloadPtr)[w]!=checkValue) {
-          errorCount++;
-          if ((errorCount<100)||(errorCount%1000==0)) {
-            theLog.log("Error #%llu : Superpage %p Page %d : 32-bit word %d
-      mismatch : %X != %X\n",errorCount,ptr,i,w,((unsigned int
-      *)pagePayloadPtr)[w],checkValue);
-          }
-
-        }
-        if ((w%8)==7) {checkValue++;}
-      }
-      */
-
-      for (unsigned int w = 0; w < pagePayloadSize / sizeof(unsigned int);
-           w += 8) {
-        if ((((unsigned int *)pagePayloadPtr)[w] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 1] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 2] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 3] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 4] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 5] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 6] != checkValue) ||
-            (((unsigned int *)pagePayloadPtr)[w + 7] != checkValue)) {
-          errorCount++;
-          if ((errorCount < 100) || (errorCount % 1000 == 0)) {
-            theLog.log("Error #%llu : Superpage %p Page %d (size %d) : 32-bit "
-                       "word %d mismatch : %X != %X\n",
-                       errorCount, ptr, pageId, pagePayloadSize, w,
-                       ((unsigned int *)pagePayloadPtr)[w], checkValue);
-          }
-        }
-        checkValue++;
-      }
+          sizeof(RocPageHeader); // convert to bytes the size given in number
+                                 // of 256-bits words
 
-      // printf("page %d (size %d) checked\n",pageId,pagePayloadSize);
+      // payload is a 32-bit counter value repeated over each 256-bit word
+      unsigned int nGroups = pagePayloadSize / (8 * sizeof(unsigned int));
+      checkPayload((uint32_t *)pagePayloadPtr, nGroups, value, ptr, pageId,
+                   pagePayloadSize);
 
       i += 8 * 1024;
     }
-    // printf("superpage %p checked\n",ptr);
-
-    /*    if (size>sizeof(RocPageHeader)) {
-          RocPageHeader *h=(RocPageHeader *)&ptr;
-          printWord(&h->words[0]);
-          printWord(&h->words[1]);
-          printWord(&h->words[2]);	// trick! this is to print beginning of
-    payload...
-    //      uint8_t *payload=((uint8_t *)ptr)+sizeof(RocPageHeader);
-        }
-      */
+  }
 
-    return 0;
+  // compare nGroups groups of 8 32-bit words against the expected value
+  // (incremented once per group), reporting mismatches
+  void checkPayload(uint32_t *p, unsigned int nGroups, uint32_t &value,
+                    void *superpage, unsigned int pageId,
+                    unsigned int pagePayloadSize) {
+    unsigned int g = 0;
+#if defined(__AVX2__)
+    __m256i vExpected = _mm256_set1_epi32((int)value);
+    const __m256i vOne = _mm256_set1_epi32(1);
+    for (; g < nGroups; g++) {
+      __m256i vData = _mm256_loadu_si256((__m256i const *)&p[g * 8]);
+      __m256i vCmp = _mm256_cmpeq_epi32(vData, vExpected);
+      if (_mm256_movemask_epi8(vCmp) != -1) {
+        reportError(superpage, pageId, pagePayloadSize, g * 8, p[g * 8],
+                    value);
+      }
+      vExpected = _mm256_add_epi32(vExpected, vOne);
+      value++;
+    }
+#elif defined(__SSE2__)
+    __m128i vExpected = _mm_set1_epi32((int)value);
+    const __m128i vOne = _mm_set1_epi32(1);
+    for (; g < nGroups; g++) {
+      __m128i vData0 = _mm_loadu_si128((__m128i const *)&p[g * 8]);
+      __m128i vData1 = _mm_loadu_si128((__m128i const *)&p[g * 8 + 4]);
+      __m128i vCmp =
+          _mm_and_si128(_mm_cmpeq_epi32(vData0, vExpected),
+                        _mm_cmpeq_epi32(vData1, vExpected));
+      if (_mm_movemask_epi8(vCmp) != 0xFFFF) {
+        reportError(superpage, pageId, pagePayloadSize, g * 8, p[g * 8],
+                    value);
+      }
+      vExpected = _mm_add_epi32(vExpected, vOne);
+      value++;
+    }
+#else
+    for (; g < nGroups; g++) {
+      unsigned int w = g * 8;
+      if ((p[w] != value) || (p[w + 1] != value) || (p[w + 2] != value) ||
+          (p[w + 3] != value) || (p[w + 4] != value) || (p[w + 5] != value) ||
+          (p[w + 6] != value) || (p[w + 7] != value)) {
+        reportError(superpage, pageId, pagePayloadSize, w, p[w], value);
+      }
+      value++;
+    }
+#endif
   }
 
-private:
+  void reportError(void *superpage, unsigned int pageId,
+                   unsigned int pagePayloadSize, unsigned int w,
+                   uint32_t found, uint32_t expected) {
+    unsigned long long n = ++errorCount;
+    if ((n < 100) || (n % 1000 == 0)) {
+      theLog.log("Error #%llu : Superpage %p Page %d (size %d) : 32-bit "
+                 "word %d mismatch : %X != %X\n",
+                 n, superpage, pageId, pagePayloadSize, w, found, expected);
+    }
+  }
 };
 
 std::unique_ptr<Consumer>
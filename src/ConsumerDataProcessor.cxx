@@ -9,128 +9,16 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "ProcessThread.h"
+#include "ReadoutUtils.h"
 
 #include <dlfcn.h>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 #include <Common/Fifo.h>
 
-const bool debug = false;
-
-// declaration of function type to process data
-// input: input block
-// output: output block (can be the same as input block
-// preliminary interface - will likely be replaced by a class
-int processBlock(DataBlockContainerReference &input,
-                 DataBlockContainerReference &output);
-using PtrProcessFunction = decltype(&processBlock);
-
-// A class to implement a processsing thread
-class processThread {
-
-public:
-  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
-      inputFifo; // fifo for input data. This should be filled externally to
-                 // provide data blocks.
-  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
-      outputFifo; // fifo for output data. This should be emptied externally, to
-                  // dispose of processed data blocks.
-
-  // constructor
-  // parameters:
-  // - f: process function, called for each block coming in inputFifo. Result is
-  // put in outputFifo.
-  // - id: a number to identify this processing thread
-  // - fifoSize: size of input and output FIFOs for incoming/output data blocks
-  // - idleSleepTime: idle sleep time (in microseconds), when input fifo empty
-  // or output fifo full, before retrying.
-  //
-  // The constructor initialize the member variables and create the processing
-  // thread.
-  processThread(PtrProcessFunction f, int id, unsigned int fifoSize = 10,
-                unsigned int idleSleepTime = 100) {
-    shutdown = 0;
-    fProcess = f;
-    cfgIdleSleepTime = idleSleepTime;
-    threadId = id;
-    inputFifo =
-        std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
-            fifoSize);
-    outputFifo =
-        std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
-            fifoSize);
-    std::function<void(void)> l = std::bind(&processThread::loop, this);
-    th = std::make_unique<std::thread>(l);
-  }
-
-  // stop the thread
-  void stop() {
-    if (th == nullptr) {
-      return;
-    }
-    if (debug) {
-      printf("thread %d stopping\n", threadId);
-    }
-    shutdown = 1;
-    th->join();
-    if (debug) {
-      printf("thread %d stopped\n", threadId);
-    }
-    th = nullptr;
-  }
-
-  // destructor
-  ~processThread() {
-    stop(); // stop thread
-  }
-
-  // the loop which runs in a separate thread and calls fProcess() for each
-  // block in input fifo, until stop() is called
-  void loop() {
-    // printf("starting thread %d input=%p
-    // output=%p\n",threadId,inputFifo.get(),outputFifo.get());
-    // printf("processing thread %d starting\n",threadId);
-    // printf("outputfifo=%p\n",outputFifo.get());
-    // if (outputFifo==nullptr) return;
-    for (; !shutdown;) {
-      bool isActive = 0;
-      // printf("thread %d loop\n",threadId);
-      // wait there is a slot in output fifo before processing a new block, so
-      // that we are sure we can push the result
-      if (!outputFifo->isFull()) {
-        DataBlockContainerReference bc = nullptr;
-        inputFifo->pop(bc);
-        if (bc != nullptr) {
-          isActive = 1;
-          DataBlockContainerReference result = nullptr;
-          // if (debug) {printf("thread %d : got %p\n",threadId,bc.get());}
-          int err = fProcess(bc, result);
-          if (err) {
-            printf("processBlock() failed: error %d\n", err);
-          }
-          if (result) {
-            outputFifo->push(result);
-          }
-        }
-      }
-      if (!isActive) {
-        // printf("thread %d sleeping\n",threadId);
-        usleep(cfgIdleSleepTime);
-      }
-    }
-    // printf("processing thread %d completed\n",threadId);
-  }
-
-private:
-  std::atomic<int> shutdown; // flag set to 1 to request thread termination
-  std::unique_ptr<std::thread> th;   // the thread
-  unsigned int cfgIdleSleepTime = 0; // idle sleep time (in microseconds), when
-                                     // fifos empty or full, before retrying
-  PtrProcessFunction fProcess = nullptr; // the process function to be used
-  int threadId = 0;                      // id of the thread
-};
-
 // A consumer class allowing to call a function from a dynamically loaded
 // library for each datablock
 class ConsumerDataProcessor : public Consumer {
@@ -166,6 +54,13 @@ private:
 
   int cfgEnsurePageOrder = 0; // if set, will track incoming pages ID and make
                               // sure it goes out in same order
+
+  int cfgSharedInputEnabled = 0; // if set, threads take their input from a
+                                 // single shared queue instead of per-thread
+                                 // queues filled round-robin
+  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
+      sharedInputFifo;            // the shared input queue, when enabled
+  std::mutex sharedInputMutex;    // protects access to sharedInputFifo
   std::unique_ptr<AliceO2::Common::Fifo<DataBlockId>>
       idFifo; // fifo to keep track of order of IDs coming in
 
@@ -223,10 +118,30 @@ public:
     // 1 | Number of threads running the processBlock() function in parallel. |
     cfg.getOptionalValue<int>(cfgEntryPoint + ".numberOfThreads",
                               numberOfThreads, 1);
-    theLog.log("Using %d thread(s) for processing", numberOfThreads);
+
+    // configuration parameter: | consumer-processor-* | sharedInputEnabled |
+    // int | 0 | If set, the processing threads take their input from a single
+    // shared queue instead of per-thread queues filled round-robin: threads
+    // pull work as they become free, so a block with a long processing time
+    // does not delay the blocks queued behind it on the same thread. Useful
+    // when per-block processing cost varies a lot (e.g. compression of
+    // payloads with mixed entropy). Output ordering guarantees (see
+    // ensurePageOrder) are not affected. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".sharedInputEnabled",
+                              cfgSharedInputEnabled, 0);
+    if (cfgSharedInputEnabled) {
+      sharedInputFifo = std::make_unique<
+          AliceO2::Common::Fifo<DataBlockContainerReference>>(
+          (int)(numberOfThreads * cfgFifoSize));
+    }
+
+    theLog.log("Using %d thread(s) for processing (%s input)", numberOfThreads,
+               cfgSharedInputEnabled ? "shared" : "per-thread");
     for (int i = 0; i < numberOfThreads; i++) {
       threadPool.push_back(std::make_unique<processThread>(
-          processBlock, i + 1, cfgFifoSize, cfgIdleSleepTime));
+          processBlock, i + 1, cfgFifoSize, cfgIdleSleepTime, cfgCpuSet,
+          sharedInputFifo.get(),
+          cfgSharedInputEnabled ? &sharedInputMutex : nullptr));
     }
 
     // create a FIFO to keep track of incoming page IDs
@@ -311,23 +226,39 @@ public:
       }
     }
 
-    // find a free thread to process it, or drop it
-    int i;
-    for (i = 0; i < numberOfThreads; i++) {
-      threadIndex++;
-      if (threadIndex == numberOfThreads) {
-        threadIndex = 0;
+    // tag data page with a unique id, before it is visible to the threads
+    DataBlockId newId = currentId++;
+
+    // use the general-purpose id in header to store it
+    b->getData()->header.id = newId;
+
+    bool accepted = 0;
+    if (cfgSharedInputEnabled) {
+      // queue it in the shared input, threads pull work as they become free
+      std::unique_lock<std::mutex> lock(sharedInputMutex);
+      if (sharedInputFifo->push(b) == 0) {
+        accepted = 1;
       }
-      //      if (threadPool[threadIndex]->inputFifo->isFull()) {continue;
-      //      if (debug) {printf("pushing %p to thread
-      //      %d\n",b.get(),threadIndex+1);}
-      if (threadPool[threadIndex]->inputFifo->push(b) == 0) {
-        break;
+    } else {
+      // find a free thread to process it, or drop it
+      int i;
+      for (i = 0; i < numberOfThreads; i++) {
+        threadIndex++;
+        if (threadIndex == numberOfThreads) {
+          threadIndex = 0;
+        }
+        //      if (threadPool[threadIndex]->inputFifo->isFull()) {continue;
+        //      if (debug) {printf("pushing %p to thread
+        //      %d\n",b.get(),threadIndex+1);}
+        if (threadPool[threadIndex]->inputFifo->push(b) == 0) {
+          accepted = 1;
+          break;
+        }
       }
     }
 
     // update stats
-    if (i == numberOfThreads) {
+    if (!accepted) {
       // printf("all threads full\n");
       dropBlocks++;
       dropBytes += size;
@@ -337,12 +268,6 @@ public:
       processedBlocks++;
     }
 
-    // tag data page with a unique id
-    DataBlockId newId = currentId++;
-
-    // use the general-purpose id in header to store it
-    b->getData()->header.id = newId;
-
     if (cfgEnsurePageOrder) {
       if (idFifo->push(newId) != 0) {
         theLog.log(InfoLogger::Severity::Warning, "Page ordering FIFO full");
@@ -363,6 +288,8 @@ public:
   // collector thread loop: handle the output of processing threads
   void loopOutput(void) {
 
+    applyCpuSet();
+
     bool isActive = 0;
 
     // lambda function that pushes forward next available bage
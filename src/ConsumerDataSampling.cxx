@@ -9,13 +9,16 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "ReadoutUtils.h"
 
 #ifdef WITH_FAIRMQ
 
+#include <Common/Timer.h>
 #include <fairmq/FairMQDevice.h>
 #include <fairmq/FairMQMessage.h>
 #include <fairmq/FairMQParts.h>
 #include <fairmq/FairMQTransportFactory.h>
+#include <stdlib.h>
 #include <thread>
 
 class ConsumerDataSampling : public Consumer {
@@ -55,6 +58,23 @@ private:
 
   std::shared_ptr<FairMQTransportFactory> transportFactory;
 
+  // sampling policy: hard per-second publishing budget, spent uniformly over
+  // the incoming blocks (whatever link/timeframe they belong to) instead of
+  // on the first blocks of each second
+  double cfgMaxBlocksPerSecond = 0;          // max blocks published per second
+  unsigned long long cfgMaxBytesPerSecond = 0; // max bytes published per second
+  AliceO2::Common::Timer samplingWindowTimer;  // 1-second policy window
+  unsigned long long windowBlocksIn = 0;  // blocks received in current window
+  double acceptProbability = 1.0; // current probability to select a block
+  unsigned long long windowBlocksOut = 0; // blocks published in current window
+  unsigned long long windowBytesOut = 0;  // bytes published in current window
+
+  // statistics
+  unsigned long long statsBlocksIn = 0;     // total blocks received
+  unsigned long long statsBlocksOut = 0;    // total blocks published
+  unsigned long long statsBytesOut = 0;     // total bytes published
+  unsigned long long statsBlocksSkipped = 0; // blocks skipped by policy
+
 public:
   ConsumerDataSampling(ConfigFile &cfg, std::string cfgEntryPoint)
       : Consumer(cfg, cfgEntryPoint), channels(1) {
@@ -63,6 +83,28 @@ public:
     // ipc:///tmp/readout-pipe-1 | Address of the data sampling. |
     cfg.getOptionalValue<std::string>(cfgEntryPoint + ".address", address,
                                       "ipc:///tmp/readout-pipe-1");
+
+    // configuration parameter: | consumer-data-sampling-* | maxBlocksPerSecond
+    // | double | 0 | Maximum number of blocks published per second. Blocks
+    // above this budget are selected out uniformly (not just the first ones
+    // of each second). If zero (default), no limit. |
+    cfg.getOptionalValue<double>(cfgEntryPoint + ".maxBlocksPerSecond",
+                                 cfgMaxBlocksPerSecond);
+
+    // configuration parameter: | consumer-data-sampling-* | maxBytesPerSecond
+    // | bytes | 0 | Maximum number of bytes published per second. If zero
+    // (default), no limit. |
+    std::string sMaxBytes;
+    if (cfg.getOptionalValue<std::string>(cfgEntryPoint + ".maxBytesPerSecond",
+                                          sMaxBytes) == 0) {
+      cfgMaxBytesPerSecond =
+          ReadoutUtils::getNumberOfBytesFromString(sMaxBytes.c_str());
+    }
+    if ((cfgMaxBlocksPerSecond > 0) || (cfgMaxBytesPerSecond > 0)) {
+      theLog.log("Data sampling rate limit: %.2lf blocks/s %llu bytes/s",
+                 cfgMaxBlocksPerSecond, cfgMaxBytesPerSecond);
+      samplingWindowTimer.reset(1000000);
+    }
     channels[0].UpdateName("data-out");
     channels[0].UpdateType("pub"); // pub or push?
     channels[0].UpdateMethod("bind");
@@ -118,13 +160,73 @@ public:
     if (deviceThread.joinable()) {
       deviceThread.join();
     }
+
+    if ((cfgMaxBlocksPerSecond > 0) || (cfgMaxBytesPerSecond > 0)) {
+      theLog.log("Data sampling: %llu blocks in, %llu published (%llu bytes), "
+                 "%llu skipped by sampling policy",
+                 statsBlocksIn, statsBlocksOut, statsBytesOut,
+                 statsBlocksSkipped);
+    }
   }
   int pushData(DataBlockContainerReference &b) {
 
-    // we create a copy of the reference, in a newly allocated object, so that
-    // reference is kept alive until this new object is destroyed in the
-    // cleanupCallback
-    DataBlockContainerReference *ptr = new DataBlockContainerReference(b);
+    size_t size = b->getData()->header.dataSize;
+    statsBlocksIn++;
+
+    // apply sampling policy, if configured
+    if ((cfgMaxBlocksPerSecond > 0) || (cfgMaxBytesPerSecond > 0)) {
+      if (samplingWindowTimer.isTimeout()) {
+        // use the input rate observed over the completed window to set the
+        // probability to select a block in the next one, so that the
+        // publishing budget is spent uniformly over the incoming blocks
+        // (whatever link/timeframe they belong to) instead of on the first
+        // ones of each second
+        acceptProbability = 1.0;
+        if ((cfgMaxBlocksPerSecond > 0) && (windowBlocksIn > 0)) {
+          double p = cfgMaxBlocksPerSecond / windowBlocksIn;
+          if (p < acceptProbability) {
+            acceptProbability = p;
+          }
+        }
+        if ((cfgMaxBytesPerSecond > 0) && (windowBytesOut > 0) &&
+            (windowBlocksIn > 0)) {
+          // average published block size over last window gives the block
+          // budget equivalent to the bytes limit
+          double avgBlockSize = windowBytesOut * 1.0 / windowBlocksOut;
+          double p = (cfgMaxBytesPerSecond / avgBlockSize) / windowBlocksIn;
+          if (p < acceptProbability) {
+            acceptProbability = p;
+          }
+        }
+        windowBlocksIn = 0;
+        windowBlocksOut = 0;
+        windowBytesOut = 0;
+        samplingWindowTimer.increment();
+      }
+      windowBlocksIn++;
+
+      // uniform selection
+      if (acceptProbability < 1.0) {
+        if (rand() > acceptProbability * RAND_MAX) {
+          statsBlocksSkipped++;
+          return 0;
+        }
+      }
+
+      // hard ceiling, whatever the selection said
+      if ((cfgMaxBlocksPerSecond > 0) &&
+          (windowBlocksOut + 1 > cfgMaxBlocksPerSecond)) {
+        statsBlocksSkipped++;
+        return 0;
+      }
+      if ((cfgMaxBytesPerSecond > 0) &&
+          (windowBytesOut + size > cfgMaxBytesPerSecond)) {
+        statsBlocksSkipped++;
+        return 0;
+      }
+      windowBlocksOut++;
+      windowBytesOut += size;
+    }
 
     if (sender.GetCurrentState() != fair::mq::State::Running) {
       LOG(ERROR) << "ConsumerDataSampling: Trying to send data when the device "
@@ -132,6 +234,12 @@ public:
       return -1;
     }
 
+    // we create a copy of the reference, in a newly allocated object, so that
+    // reference is kept alive until this new object is destroyed in the
+    // cleanupCallback. The published messages point to the existing data
+    // page: no payload copy is made by this consumer.
+    DataBlockContainerReference *ptr = new DataBlockContainerReference(b);
+
     std::unique_ptr<FairMQMessage> msgHeader(transportFactory->CreateMessage(
         (void *)&(b->getData()->header),
         (size_t)(b->getData()->header.headerSize), cleanupCallback,
@@ -146,11 +254,17 @@ public:
 
     sender.fChannels.at("data-out").at(0).Send(message);
 
+    statsBlocksOut++;
+    statsBytesOut += size;
+
     return 0;
   }
 
 private:
-  void runDevice() { sender.RunStateMachine(); }
+  void runDevice() {
+    applyCpuSet();
+    sender.RunStateMachine();
+  }
 };
 
 std::unique_ptr<Consumer>
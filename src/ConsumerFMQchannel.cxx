@@ -9,12 +9,20 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "CounterStats.h"
 #include "MemoryBank.h"
 #include "MemoryBankManager.h"
 #include "MemoryPagesPool.h"
 #include "ReadoutStats.h"
 #include "ReadoutUtils.h"
 
+#include <atomic>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
 #ifdef WITH_FAIRMQ
 
 #include <fairmq/FairMQDevice.h>
@@ -23,6 +31,7 @@
 #include <fairmq/tools/Unique.h>
 
 #include "RAWDataHeader.h"
+#include "RdhUtils.h"
 #include "SubTimeframe.h"
 
 class ConsumerFMQchannel : public Consumer {
@@ -33,6 +42,10 @@ private:
   bool disableSending = 0;
   bool enableRawFormat = false;
   bool enableStfSuperpage = false; // optimized stf transport: minimize STF packets
+  bool enableStfIndex = false; // batched stf transport: one part per data page,
+                               // HBF boundaries in an index table in header
+  bool enableStfV2 = false; // v2 stf transport: one part per data page, each
+                            // part described in a table in header
 
   std::shared_ptr<MemoryBank>
       memBank; // a dedicated memory bank allocated by FMQ mechanism
@@ -42,6 +55,132 @@ private:
   int memoryPoolPageSize;
   int memoryPoolNumberOfPages;
 
+  std::vector<RdhPacketDescriptor>
+      rdhPacketIndex; // per-page RDH index filled by scanRdhBlock(), vector
+                      // reused across pages to avoid re-allocation
+
+  // optional integrity stage (c.f. checksumEnabled): a CRC32C of each data
+  // page payload is computed by a small pool of worker threads before the
+  // messages are sent. The checksum is stamped in the reserved page header
+  // area (c.f. PageChecksumHeader, needs equipment.pageChecksumEnabled for
+  // the space) and, with enableRawFormat=4, published in the part descriptor
+  // table of the STF header so that receivers can verify the payload
+  // (c.f. receiverFMQ checkChecksum).
+  int checksumEnabled = 0;
+  int checksumThreads = 2;
+  std::vector<std::unique_ptr<std::thread>> checksumPool;
+  std::atomic<int> checksumShutdown = {0};
+  // current batch of pages to checksum, published to the pool by pushData().
+  // the vectors are stable while checksumBatchSize is non-zero.
+  std::vector<DataBlock *> checksumBatch;
+  std::vector<uint32_t> checksumValues;     // resulting CRC per page
+  std::atomic<int> checksumNext = {0};      // next page of batch to process
+  std::atomic<int> checksumDone = {0};      // number of pages completed
+  std::atomic<int> checksumBatchSize = {0}; // when non-zero, batch in progress
+  std::atomic<int> checksumActive = {0};    // number of threads in a batch
+  CounterStats checksumStats; // bytes checksummed (count = number of pages)
+
+  // take and checksum pages of the current batch, if any.
+  // returns the number of pages processed by this call.
+  // may be called concurrently: pages are distributed with an atomic index.
+  int checksumWork() {
+    int nPages = checksumBatchSize.load();
+    if (nPages == 0) {
+      return 0;
+    }
+    int n = 0;
+    checksumActive++;
+    // re-check after registering, to not use a batch already completed
+    if (checksumBatchSize.load() == nPages) {
+      for (;;) {
+        int i = checksumNext++;
+        if (i >= nPages) {
+          break;
+        }
+        DataBlock *b = checksumBatch[i];
+        uint32_t crc = ReadoutUtils::crc32c(b->data, b->header.dataSize);
+        checksumValues[i] = crc;
+        // stamp in the reserved page header area, when the page has one
+        PageChecksumHeader *ck =
+            getPageChecksumArea((char *)b + sizeof(DataBlock), b->data);
+        if (ck != nullptr) {
+          ck->crc32c = crc;
+          ck->magic = PageChecksumMagic;
+        }
+        checksumStats.increment(b->header.dataSize);
+        checksumDone++;
+        n++;
+      }
+    }
+    checksumActive--;
+    return n;
+  }
+
+  // loop of the checksum worker threads
+  void checksumLoop() {
+    while (!checksumShutdown.load()) {
+      if (checksumWork() == 0) {
+        usleep(100);
+      }
+    }
+  }
+
+  // compute the CRC32C of each page of the dataset, with the help of the
+  // worker pool. on return, checksumValues holds one CRC per page, in dataset
+  // order, and the pages with a reserved checksum area are stamped.
+  void checksumDataSet(DataSetReference &bc) {
+    int nPages = (int)bc->size();
+    if (nPages == 0) {
+      return;
+    }
+    checksumBatch.clear();
+    for (auto &br : *bc) {
+      checksumBatch.push_back(br->getData());
+    }
+    checksumValues.assign(nPages, 0);
+    checksumNext.store(0);
+    checksumDone.store(0);
+    checksumBatchSize.store(nPages);
+    // this thread participates too
+    checksumWork();
+    // active wait for completion: remaining pages are being processed by the
+    // workers and complete within microseconds
+    while (checksumDone.load() < nPages) {
+    }
+    checksumBatchSize.store(0);
+    // wait until no worker references the batch vectors anymore, so that the
+    // next call can safely modify them
+    while (checksumActive.load() != 0) {
+    }
+  }
+
+  // zero-copy check: count data pages outside the FMQ unmanaged region.
+  // such pages are copied by the transport, which is silent but expensive:
+  // this typically means an equipment not configured with the memory bank
+  // created by this consumer (c.f. memoryBankName)
+  unsigned long long nPagesOutOfRegion = 0;
+
+  // check that a data page given to the transport lies in the FMQ unmanaged
+  // region, and warn (once) otherwise
+  void checkMemoryRegion(void *ptr, size_t size) {
+    if (memoryBuffer == nullptr) {
+      return;
+    }
+    char *regionBase = (char *)memoryBuffer->GetData();
+    char *regionEnd = regionBase + memoryBuffer->GetSize();
+    if (((char *)ptr >= regionBase) && ((char *)ptr + size <= regionEnd)) {
+      return;
+    }
+    nPagesOutOfRegion++;
+    if (nPagesOutOfRegion == 1) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Data page @ %p (%lu bytes) outside FMQ unmanaged region: "
+                 "transport will copy it. Check that equipments use the "
+                 "memory bank of this consumer (memoryBankName)",
+                 ptr, (unsigned long)size);
+    }
+  }
+
 public:
   std::vector<FairMQMessagePtr>
       messagesToSend;          // collect HBF messages of each update
@@ -50,6 +189,9 @@ public:
   ConsumerFMQchannel(ConfigFile &cfg, std::string cfgEntryPoint)
       : Consumer(cfg, cfgEntryPoint) {
 
+    // batched updates of the global byte counter (c.f. Consumer::statsBatch)
+    statsBatch.init(&gReadoutStats.bytesFairMQ);
+
     // configuration parameter: | consumer-FairMQchannel-* | disableSending |
     // int | 0 | If set, no data is output to FMQ channel. Used for performance
     // test to create FMQ shared memory segment without pushing the data. |
@@ -62,9 +204,16 @@ public:
     }
 
     // configuration parameter: | consumer-FairMQchannel-* | enableRawFormat |
-    // int | 0 | If 0, data is pushed 1 STF header + 1 part per HBF. 
+    // int | 0 | If 0, data is pushed 1 STF header + 1 part per HBF.
     // If 1, data is pushed in raw format without STF headers, 1 FMQ message
-    // per data page. If 2, format is 1 STF header + 1 part per data page.|
+    // per data page. If 2, format is 1 STF header + 1 part per data page.
+    // If 3, format is 1 STF header (with an index table of HBF offsets, see
+    // struct SubTimeframeIndexed) + 1 part per data page: HBF boundaries are
+    // conveyed without the per-HBF message overhead.
+    // If 4, format is 1 v2 STF header (with a table describing each part:
+    // offset, size, linkId, first orbit - see struct SubTimeframeV2) + 1 part
+    // per data page: receivers can route or discard parts from the header
+    // only, without reading payload memory.|
     int cfgEnableRawFormat = 0;
     cfg.getOptionalValue<int>(cfgEntryPoint + ".enableRawFormat",
                               cfgEnableRawFormat);
@@ -75,6 +224,14 @@ public:
       theLog.log("FMQ message output in raw format - mode 2 : 1 message = "
       "1 header + 1 part per data page");
       enableStfSuperpage = true;
+    } else if (cfgEnableRawFormat==3) {
+      theLog.log("FMQ message output in batched format - mode 3 : 1 message = "
+      "1 header + HBF index table + 1 part per data page");
+      enableStfIndex = true;
+    } else if (cfgEnableRawFormat==4) {
+      theLog.log("FMQ message output in v2 format - mode 4 : 1 message = "
+      "1 header + part descriptor table + 1 part per data page");
+      enableStfV2 = true;
     }
 
     // configuration parameter: | consumer-FairMQchannel-* | sessionName |
@@ -159,6 +316,33 @@ public:
                                       cfgUnmanagedMemorySize);
     long long mMemorySize = ReadoutUtils::getNumberOfBytesFromString(
         cfgUnmanagedMemorySize.c_str());
+
+    // configuration parameter: | consumer-FairMQchannel-* |
+    // unmanagedMemoryHugePages | int | 0 | If set, the kernel is advised
+    // (madvise MADV_HUGEPAGE) to back the FMQ unmanaged memory region with
+    // transparent huge pages, reducing TLB pressure and page fault count. |
+    int cfgUnmanagedMemoryHugePages = 0;
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".unmanagedMemoryHugePages",
+                              cfgUnmanagedMemoryHugePages);
+
+    // configuration parameter: | consumer-FairMQchannel-* |
+    // unmanagedMemoryPrefault | int | 0 | If set, the FMQ unmanaged memory
+    // region is prefaulted (zeroed) at configure time by this number of
+    // parallel threads, so that first-touch page faults do not occur during
+    // the first seconds of data taking. |
+    int cfgUnmanagedMemoryPrefault = 0;
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".unmanagedMemoryPrefault",
+                              cfgUnmanagedMemoryPrefault);
+
+    // configuration parameter: | consumer-FairMQchannel-* |
+    // unmanagedMemoryLock | int | 0 | If set, the FMQ unmanaged memory region
+    // is locked in RAM (mlock) at configure time, so its pages can not be
+    // swapped or reclaimed during the run. May need a suitable
+    // RLIMIT_MEMLOCK. |
+    int cfgUnmanagedMemoryLock = 0;
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".unmanagedMemoryLock",
+                              cfgUnmanagedMemoryLock);
+
     if (mMemorySize > 0) {
       memoryBuffer = sendingChannel->Transport()->CreateUnmanagedRegion(
           mMemorySize,
@@ -177,6 +361,43 @@ public:
       memBank = std::make_shared<MemoryBank>(
           memoryBuffer->GetData(), memoryBuffer->GetSize(), nullptr,
           "FMQ unmanaged memory buffer from " + cfgEntryPoint);
+
+      // ask for transparent huge pages before the region is faulted
+      if (cfgUnmanagedMemoryHugePages) {
+        if (madvise(memoryBuffer->GetData(), memoryBuffer->GetSize(),
+                    MADV_HUGEPAGE) == 0) {
+          theLog.log("FMQ unmanaged memory region: huge pages advised");
+        } else {
+          theLog.log(InfoLogger::Severity::Warning,
+                     "FMQ unmanaged memory region: madvise(MADV_HUGEPAGE) "
+                     "failed: %s",
+                     strerror(errno));
+        }
+      }
+
+      // prefault the region now, so that first-touch page faults do not
+      // occur during the first seconds of data taking
+      if (cfgUnmanagedMemoryPrefault > 0) {
+        theLog.log("FMQ unmanaged memory region: prefaulting with %d "
+                   "thread(s)",
+                   cfgUnmanagedMemoryPrefault);
+        AliceO2::Common::Timer prefaultTimer;
+        prefaultTimer.reset();
+        memBank->clear(cfgUnmanagedMemoryPrefault);
+        theLog.log("FMQ unmanaged memory region: prefaulted in %.2lfs",
+                   prefaultTimer.getTime());
+      }
+
+      // lock the region in RAM
+      if (cfgUnmanagedMemoryLock) {
+        if (mlock(memoryBuffer->GetData(), memoryBuffer->GetSize()) == 0) {
+          theLog.log("FMQ unmanaged memory region: locked in RAM");
+        } else {
+          theLog.log(InfoLogger::Severity::Warning,
+                     "FMQ unmanaged memory region: mlock() failed: %s",
+                     strerror(errno));
+        }
+      }
       if (memoryBankName.length() == 0) {
         memoryBankName = cfgEntryPoint; // if no bank name defined, create one
                                         // with the name of the consumer
@@ -209,6 +430,41 @@ public:
     theLog.log("Using memory pool %d pages x %d bytes", memoryPoolNumberOfPages,
                memoryPoolPageSize);
 
+    // configuration parameter: | consumer-FairMQchannel-* | checksumEnabled |
+    // int | 0 | If set, a CRC32C checksum of the payload of each data page is
+    // computed (by a pool of worker threads, c.f. checksumThreads) before the
+    // data is sent. The checksum is stamped in the reserved header area of
+    // the page (see PageChecksumHeader in ReadoutUtils.h, needs
+    // equipment.pageChecksumEnabled for the space to be reserved) and, with
+    // enableRawFormat=4, stored in the part descriptor table of the STF
+    // header, so that receivers can verify data integrity (c.f. receiverFMQ
+    // checkChecksum). |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".checksumEnabled",
+                              checksumEnabled);
+
+    // configuration parameter: | consumer-FairMQchannel-* | checksumThreads |
+    // int | 2 | Number of worker threads computing the page checksums (c.f.
+    // checksumEnabled). The consumer thread takes part in the computation as
+    // well. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".checksumThreads",
+                              checksumThreads);
+
+    if (checksumEnabled) {
+      if (checksumThreads < 0) {
+        checksumThreads = 0;
+      }
+      checksumStats.enableThreadSafe();
+      for (int i = 0; i < checksumThreads; i++) {
+        checksumPool.push_back(std::make_unique<std::thread>(
+            &ConsumerFMQchannel::checksumLoop, this));
+      }
+      theLog.log("Page checksum (CRC32C) enabled: %d worker threads, %s "
+                 "implementation",
+                 checksumThreads,
+                 ReadoutUtils::crc32cHardware ? "hardware (SSE4.2)"
+                                              : "software");
+    }
+
     sendingChannel->Bind(cfgChannelAddress);
 
     if (!sendingChannel->Validate()) {
@@ -217,6 +473,25 @@ public:
   }
 
   ~ConsumerFMQchannel() {
+    // stop the checksum workers
+    checksumShutdown = 1;
+    for (auto &t : checksumPool) {
+      t->join();
+    }
+    checksumPool.clear();
+    if (checksumEnabled) {
+      theLog.log("Page checksums computed: %llu pages, %s",
+                 (unsigned long long)checksumStats.getCount(),
+                 ReadoutUtils::NumberOfBytesToString(
+                     (double)checksumStats.get(), "B")
+                     .c_str());
+    }
+    if (nPagesOutOfRegion) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "%llu data pages were outside the FMQ unmanaged region and "
+                 "copied by the transport",
+                 nPagesOutOfRegion);
+    }
     // release in reverse order
     mp = nullptr;
     memoryBuffer = nullptr; // warning: data range may still be referenced in
@@ -236,6 +511,11 @@ public:
       return 0;
     }
 
+    // compute (and stamp) the payload checksum of each page before sending
+    if (checksumEnabled) {
+      checksumDataSet(bc);
+    }
+
     // debug mode to send in simple raw format: 1 FMQ message per data page
     if (enableRawFormat) {
       // we just ship one FMQmessage per incoming data page
@@ -246,11 +526,12 @@ public:
         void *hint = (void *)blockRef;
         void *blobPtr = b->data;
         size_t blobSize = (size_t)b->header.dataSize;
+        checkMemoryRegion(blobPtr, blobSize);
         std::unique_ptr<FairMQMessage> msgBody(transportFactory->CreateMessage(
             memoryBuffer, blobPtr, blobSize, hint));
         // printf("send %p = %d bytes hint=%p\n",blobPtr,(int)blobSize,hint);
         sendingChannel->Send(msgBody);
-        gReadoutStats.bytesFairMQ += blobSize;
+        statsBatch.add(blobSize);
       }
       return 0;
     }
@@ -290,11 +571,233 @@ public:
         void *hint = (void *)blockRef;
         void *blobPtr = b->data;
         size_t blobSize = (size_t)b->header.dataSize;
+        checkMemoryRegion(blobPtr, blobSize);
         msgs.emplace_back(std::move(
 	sendingChannel->NewMessage(memoryBuffer, blobPtr, blobSize, hint)));
       }
       sendingChannel->Send(msgs);
-      
+
+      return 0;
+    }
+
+
+    // batched format
+    // one header with an index table of HBF offsets + one FMQ message part
+    // per incoming data page: the receiver gets HBF boundaries without
+    // per-HBF message handling overhead
+    if (enableStfIndex) {
+
+      if (memoryPoolPageSize < (int)sizeof(SubTimeframeIndexed)) {
+        return -1;
+      }
+      DataBlockContainerReference headerBlock = nullptr;
+      try {
+        headerBlock = mp->getNewDataBlockContainer();
+      } catch (...) {
+      }
+      if (headerBlock == nullptr) {
+        return -1;
+      }
+      auto blockRef = new DataBlockContainerReference(headerBlock);
+      SubTimeframeIndexed *stfHeader =
+          (SubTimeframeIndexed *)headerBlock->getData()->data;
+      stfHeader->stf.timeframeId = 0;
+      stfHeader->stf.numberOfHBF = 0;
+      stfHeader->stf.linkId = undefinedLinkId;
+      stfHeader->numberOfOffsets = 0;
+
+      // index table, appended to fixed header, space permitting
+      uint32_t *offsetTable =
+          (uint32_t *)((char *)stfHeader + sizeof(SubTimeframeIndexed));
+      uint32_t maxOffsets =
+          (memoryPoolPageSize - sizeof(SubTimeframeIndexed)) / sizeof(uint32_t);
+
+      // iterate the pages to fill the HBF index table
+      unsigned int lastHBid = -1;
+      int isFirst = true;
+      uint64_t payloadOffset = 0; // running offset in concatenated payload
+      for (auto &br : *bc) {
+        DataBlock *b = br->getData();
+        if (isFirst) {
+          stfHeader->stf.timeframeId = b->header.timeframeId;
+          stfHeader->stf.linkId = b->header.linkId;
+          isFirst = false;
+        } else {
+          if (stfHeader->stf.timeframeId != b->header.timeframeId) {
+            theLog.log(InfoLogger::Severity::Warning,"mismatch tfId");
+          }
+          if (stfHeader->stf.linkId != b->header.linkId) {
+            theLog.log(InfoLogger::Severity::Warning,"mismatch linkId");
+          }
+        }
+
+        // when the equipment stored a packet index in the page header space
+        // (c.f. equipment.pageLinkIndexEnabled), reuse it. Otherwise, single
+        // scan-and-validate pass over the page (see scanRdhBlock()).
+        // HBF boundaries are then derived from the compact index.
+        rdhPacketIndex.clear();
+        const PageLinkIndexHeader *pageIndex = getPageLinkIndex(b, b->data);
+        if (pageIndex != nullptr) {
+          const PageLinkIndexEntry *e = getPageLinkIndexEntries(pageIndex);
+          for (uint16_t i = 0; i < pageIndex->nEntries; i++, e++) {
+            rdhPacketIndex.push_back(
+                {e->offset, e->size, e->hbOrbit, e->linkId, e->stopBit});
+          }
+        } else {
+          std::string errorDescription;
+          if (scanRdhBlock(b->data, b->header.dataSize, rdhPacketIndex,
+                           errorDescription) < 0) {
+            theLog.log(InfoLogger::Severity::Warning,
+                       "TF%d invalid RDH in page, HBF index may be incomplete: "
+                       "%s",
+                       (int)stfHeader->stf.timeframeId,
+                       errorDescription.c_str());
+          }
+        }
+        for (auto &p : rdhPacketIndex) {
+          if (p.hbOrbit != lastHBid) {
+            stfHeader->stf.numberOfHBF++;
+            if (stfHeader->numberOfOffsets < maxOffsets) {
+              offsetTable[stfHeader->numberOfOffsets++] =
+                  (uint32_t)(payloadOffset + p.offset);
+            } else if (stfHeader->numberOfOffsets == maxOffsets) {
+              // table truncated: receiver can detect it from
+              // numberOfOffsets < numberOfHBF
+              theLog.log(InfoLogger::Severity::Warning,
+                         "TF%d HBF index table full (%d entries), truncated",
+                         (int)stfHeader->stf.timeframeId, (int)maxOffsets);
+            }
+            lastHBid = p.hbOrbit;
+          }
+        }
+        payloadOffset += b->header.dataSize;
+      }
+
+      size_t headerSize = sizeof(SubTimeframeIndexed) +
+                          stfHeader->numberOfOffsets * sizeof(uint32_t);
+
+      std::vector<FairMQMessagePtr> msgs;
+      msgs.reserve(bc->size()+1);
+
+      // header
+      msgs.emplace_back(std::move(
+        sendingChannel->NewMessage(memoryBuffer, (void *)stfHeader,
+                                   headerSize, (void *)(blockRef))));
+      // one msg part per data page
+      for (auto &br : *bc) {
+        DataBlock *b = br->getData();
+        DataBlockContainerReference *blockRef =
+            new DataBlockContainerReference(br);
+        void *hint = (void *)blockRef;
+        void *blobPtr = b->data;
+        size_t blobSize = (size_t)b->header.dataSize;
+        checkMemoryRegion(blobPtr, blobSize);
+        msgs.emplace_back(std::move(
+          sendingChannel->NewMessage(memoryBuffer, blobPtr, blobSize, hint)));
+      }
+      if (sendingChannel->Send(msgs) >= 0) {
+        statsBatch.add(payloadOffset + headerSize);
+      } else {
+        LOG(ERROR) << "Sending failed!";
+      }
+
+      return 0;
+    }
+
+
+    // v2 format
+    // one header with a table describing each following part (offset, size,
+    // linkId, first orbit) + one FMQ message part per incoming data page:
+    // receivers can route or discard parts from the header only, without
+    // reading payload memory
+    if (enableStfV2) {
+
+      size_t headerSizeNeeded =
+          sizeof(SubTimeframeV2) +
+          bc->size() * sizeof(SubTimeframePartDescriptor);
+      if ((size_t)memoryPoolPageSize < headerSizeNeeded) {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "page size too small for STF v2 header %d < %lu",
+                   memoryPoolPageSize, (unsigned long)headerSizeNeeded);
+        return -1;
+      }
+      DataBlockContainerReference headerBlock = nullptr;
+      try {
+        headerBlock = mp->getNewDataBlockContainer();
+      } catch (...) {
+      }
+      if (headerBlock == nullptr) {
+        return -1;
+      }
+      auto blockRef = new DataBlockContainerReference(headerBlock);
+      SubTimeframeV2 *stfHeader =
+          (SubTimeframeV2 *)headerBlock->getData()->data;
+      stfHeader->version = 2;
+      stfHeader->timeframeId = 0;
+      stfHeader->numberOfParts = 0;
+      SubTimeframePartDescriptor *partTable =
+          (SubTimeframePartDescriptor *)((char *)stfHeader +
+                                         sizeof(SubTimeframeV2));
+
+      // fill the part descriptor table
+      // only the first RDH of each page is read (for the orbit), the bulk of
+      // the payload is not touched
+      int isFirst = true;
+      uint64_t payloadOffset = 0; // running offset in concatenated payload
+      for (auto &br : *bc) {
+        DataBlock *b = br->getData();
+        if (isFirst) {
+          stfHeader->timeframeId = b->header.timeframeId;
+          isFirst = false;
+        } else if (stfHeader->timeframeId != b->header.timeframeId) {
+          theLog.log(InfoLogger::Severity::Warning,"mismatch tfId");
+        }
+        SubTimeframePartDescriptor *d = &partTable[stfHeader->numberOfParts];
+        d->offset = (uint32_t)payloadOffset;
+        d->size = (uint32_t)b->header.dataSize;
+        d->linkId = (uint32_t)b->header.linkId;
+        d->firstOrbit = 0;
+        d->crc32c =
+            checksumEnabled ? checksumValues[stfHeader->numberOfParts] : 0;
+        d->pad = 0;
+        if (b->header.dataSize >= sizeof(o2::Header::RAWDataHeader)) {
+          o2::Header::RAWDataHeader *rdh =
+              (o2::Header::RAWDataHeader *)b->data;
+          d->firstOrbit = rdh->heartbeatOrbit;
+        }
+        stfHeader->numberOfParts++;
+        payloadOffset += b->header.dataSize;
+      }
+
+      size_t headerSize = sizeof(SubTimeframeV2) +
+                          stfHeader->numberOfParts *
+                              sizeof(SubTimeframePartDescriptor);
+
+      std::vector<FairMQMessagePtr> msgs;
+      msgs.reserve(bc->size()+1);
+
+      // header
+      msgs.emplace_back(std::move(
+        sendingChannel->NewMessage(memoryBuffer, (void *)stfHeader,
+                                   headerSize, (void *)(blockRef))));
+      // one msg part per data page
+      for (auto &br : *bc) {
+        DataBlock *b = br->getData();
+        DataBlockContainerReference *blockRef =
+            new DataBlockContainerReference(br);
+        void *hint = (void *)blockRef;
+        void *blobPtr = b->data;
+        size_t blobSize = (size_t)b->header.dataSize;
+        checkMemoryRegion(blobPtr, blobSize);
+        msgs.emplace_back(std::move(
+          sendingChannel->NewMessage(memoryBuffer, blobPtr, blobSize, hint)));
+      }
+      if (sendingChannel->Send(msgs) >= 0) {
+        statsBatch.add(payloadOffset + headerSize);
+      } else {
+        LOG(ERROR) << "Sending failed!";
+      }
+
       return 0;
     }
 
@@ -438,6 +941,7 @@ public:
         // typeid(pendingFrames[0].blockRef).name() << std::endl;
 
         // create and queue a fmq message
+        checkMemoryRegion((void *)(&(b->data[ix])), (size_t)(l));
         messagesToSend.emplace_back(std::move(sendingChannel->NewMessage(
             memoryBuffer, (void *)(&(b->data[ix])), (size_t)(l), hint)));
         messagesToSendSize += l;
@@ -547,7 +1051,7 @@ public:
       // send all the messages
       if (sendingChannel->Send(messagesToSend) >= 0) {
 	messagesToSend.clear();
-	gReadoutStats.bytesFairMQ += messagesToSendSize;
+	statsBatch.add(messagesToSendSize);
 	messagesToSendSize = 0;
       } else {
 	LOG(ERROR) << "Sending failed!";
@@ -9,32 +9,101 @@
 // or submit itself to any jurisdiction.
 
 #include "Consumer.h"
+#include "CounterStats.h"
+#include "MemoryPagesPool.h"
+#include "ProcessThread.h"
 #include "RdhUtils.h"
 #include "ReadoutStats.h"
 #include "ReadoutUtils.h"
+#include <Common/Timer.h>
+#include <atomic>
 #include <errno.h>
+#include <fcntl.h>
 #include <iomanip>
+#include <lz4.h>
+#include <thread>
+#include <unistd.h>
+
+// in-flight budget shared by all the files of one recorder.
+// In async mode, each queued write keeps a reference to its data page until
+// the write has completed: on a slow disk the queues retain more and more
+// pages and can starve the equipment memory pool. This structure bounds that
+// retention (bytes and pages), with a configurable policy when the budget is
+// exceeded.
+struct RecorderInFlightBudget {
+  unsigned long long bytesMax = 0; // maximum bytes retained (0 = no limit)
+  int pagesMax = 0;                // maximum pages retained (0 = no limit)
+  int dropEnabled = 0; // over budget: 1 = drop pages (accounted), 0 = wait
+  std::atomic<unsigned long long> bytes = {0}; // bytes currently retained
+  std::atomic<int> pages = {0};                // pages currently retained
+  unsigned long long bytesDropped = 0; // bytes dropped over budget
+  unsigned long long pagesDropped = 0; // pages dropped over budget
+  CounterStats retentionTime; // time (microseconds) from write queueing to
+                              // completion, i.e. how long a page is retained
+  bool isOverBudget() {
+    if ((bytesMax) && (bytes.load() >= bytesMax)) {
+      return true;
+    }
+    if ((pagesMax) && (pages.load() >= pagesMax)) {
+      return true;
+    }
+    return false;
+  }
+};
 
 // a struct to store info related to one file
 class FileHandle {
 public:
   FileHandle(std::string &_path, InfoLogger *_theLog = nullptr,
-             unsigned long long _maxFileSize = 0, int _maxPages = 0) {
+             unsigned long long _maxFileSize = 0, int _maxPages = 0,
+             int _asyncWrite = 0, int _directIO = 0,
+             RecorderInFlightBudget *_budget = nullptr) {
     theLog = _theLog;
     path = _path;
+    budget = _budget;
     counterBytesTotal = 0;
+    // batched updates of the global byte counter: one FileHandle is written
+    // by a single thread (consumer thread, or writer thread in async mode)
+    statsBatch.init(&gReadoutStats.bytesRecorded);
     maxFileSize = _maxFileSize;
     maxPages = _maxPages;
+    asyncWrite = _asyncWrite;
+    directIO = _directIO;
     if (theLog != nullptr) {
       theLog->log("Opening file for writing: %s", path.c_str());
     }
-    fp = fopen(path.c_str(), "wb");
-    if (fp == NULL) {
-      if (theLog != nullptr) {
-        theLog->log(InfoLogger::Severity::Error, "Failed to create file: %s",
-                    strerror(errno));
+    if (asyncWrite) {
+      // async engine: unbuffered file descriptor (bypassing the page cache
+      // with O_DIRECT if requested), writes queued to a dedicated writer
+      // thread servicing them out of band
+      int flags = O_WRONLY | O_CREAT | O_TRUNC;
+      if (directIO) {
+        flags |= O_DIRECT;
+      }
+      fd = open(path.c_str(), flags, 0644);
+      if (fd < 0) {
+        if (theLog != nullptr) {
+          theLog->log(InfoLogger::Severity::Error, "Failed to create file: %s",
+                      strerror(errno));
+        }
+        return;
+      }
+      writeQueue = std::make_unique<AliceO2::Common::Fifo<WriteRequest>>(
+          writeQueueSize);
+      writeShutdown = 0;
+      ioError = 0;
+      writeOffset = 0;
+      writeThread =
+          std::make_unique<std::thread>(&FileHandle::writeLoop, this);
+    } else {
+      fp = fopen(path.c_str(), "wb");
+      if (fp == NULL) {
+        if (theLog != nullptr) {
+          theLog->log(InfoLogger::Severity::Error, "Failed to create file: %s",
+                      strerror(errno));
+        }
+        return;
       }
-      return;
     }
     isOk = true;
   }
@@ -42,6 +111,24 @@ public:
   ~FileHandle() { close(); }
 
   void close() {
+    if (writeThread != nullptr) {
+      // writer thread completes pending writes before exiting
+      writeShutdown = 1;
+      writeThread->join();
+      writeThread = nullptr;
+    }
+    // no more writes from here: push pending delta to global counter
+    statsBatch.flush();
+    if (fd >= 0) {
+      if (theLog != nullptr) {
+        theLog->log("Closing file %s : %llu bytes (~%s)", path.c_str(),
+                    counterBytesTotal,
+                    ReadoutUtils::NumberOfBytesToString(counterBytesTotal, "B")
+                        .c_str());
+      }
+      ::close(fd);
+      fd = -1;
+    }
     if (fp != NULL) {
       if (theLog != nullptr) {
         theLog->log("Closing file %s : %llu bytes (~%s)", path.c_str(),
@@ -62,8 +149,12 @@ public:
   // exceed max file size, to avoid starting writing anything if the next write
   // would reach limit return one of the status code below
   enum Status { Success = 0, Error = -1, FileLimitsReached = 1 };
+  // in async mode, a reference to the data block may be given: it is kept
+  // until the write has completed, so that page memory stays valid (the data
+  // is not copied)
   FileHandle::Status write(void *ptr, size_t size, bool isPage = false,
-                           size_t remainingBlockSize = 0) {
+                           size_t remainingBlockSize = 0,
+                           DataBlockContainerReference lock = nullptr) {
     lastWriteBytes = 0; // reset last bytes written
     if (isFull) {
       // report only first occurence of FileLimitsReached
@@ -89,14 +180,48 @@ public:
       close();
       return Status::FileLimitsReached;
     }
-    if (fp == NULL) {
-      return Status::Error;
-    }
-    if (fwrite(ptr, size, 1, fp) != 1) {
-      return Status::Error;
+    if (asyncWrite) {
+      if ((fd < 0) || (ioError)) {
+        return Status::Error;
+      }
+      // queue the write, completed out of band by the writer thread
+      // block when queue full: page references held there, this is the
+      // natural backpressure on the memory pool
+      WriteRequest r;
+      r.ptr = ptr;
+      r.size = size;
+      r.lock = lock;
+      r.isPage = isPage;
+      if (budget != nullptr) {
+        // account before queueing: the writer thread decrements on completion
+        r.timeQueued = PageEventTrace::getTimestamp();
+        budget->bytes += size;
+        if (isPage) {
+          budget->pages++;
+        }
+      }
+      while (writeQueue->push(r)) {
+        if (ioError) {
+          if (budget != nullptr) {
+            budget->bytes -= size;
+            if (isPage) {
+              budget->pages--;
+            }
+          }
+          return Status::Error;
+        }
+        usleep(100);
+      }
+    } else {
+      if (fp == NULL) {
+        return Status::Error;
+      }
+      if (fwrite(ptr, size, 1, fp) != 1) {
+        return Status::Error;
+      }
+      statsBatch.add(size);
     }
     counterBytesTotal += size;
-    gReadoutStats.bytesRecorded += size;
     if (isPage) {
       counterPages++;
     }
@@ -108,7 +233,90 @@ public:
 
   bool isFileOk() { return isOk; }
 
+  // get number of bytes written (or queued for write) so far
+  unsigned long long getBytes() { return counterBytesTotal; }
+
 private:
+  // a write queued to the writer thread
+  struct WriteRequest {
+    void *ptr = nullptr; // data to write
+    size_t size = 0;     // number of bytes
+    DataBlockContainerReference lock; // reference released on completion
+    bool isPage = false;    // set for the first write of each data page
+    uint64_t timeQueued = 0; // time the write was queued (in-flight budget)
+  };
+
+  // writer thread loop: complete queued writes, in order
+  void writeLoop() {
+    for (;;) {
+      WriteRequest r;
+      if (writeQueue->pop(r)) {
+        if (writeShutdown) {
+          break;
+        }
+        usleep(100);
+        continue;
+      }
+      if (!ioError) {
+        if (doWrite(r.ptr, r.size)) {
+          ioError = 1;
+          if (theLog != nullptr) {
+            theLog->log(InfoLogger::Severity::Error,
+                        "File write error (%s) : %s", path.c_str(),
+                        strerror(errno));
+          }
+        } else {
+          statsBatch.add(r.size);
+        }
+      }
+      if (budget != nullptr) {
+        budget->retentionTime.set(
+            (PageEventTrace::getTimestamp() - r.timeQueued) / 1000);
+        budget->bytes -= r.size;
+        if (r.isPage) {
+          budget->pages--;
+        }
+      }
+      r.lock = nullptr; // release page
+    }
+  }
+
+  // write a buffer to file descriptor, handling partial writes
+  // O_DIRECT needs aligned buffer address, size and file offset: for the
+  // occasional unaligned piece (e.g. last part of a page), the flag is
+  // dropped, and restored only once the file offset is realigned by a
+  // following write
+  // returns 0 on success, -1 on error
+  int doWrite(void *ptr, size_t size) {
+    const size_t directIOAlignment = 512;
+    bool isAligned = ((((uintptr_t)ptr) % directIOAlignment) == 0) &&
+                     ((size % directIOAlignment) == 0) &&
+                     ((writeOffset % directIOAlignment) == 0);
+    if ((directIO) && (!isAligned)) {
+      fcntl(fd, F_SETFL, O_WRONLY);
+    }
+    int err = 0;
+    char *p = (char *)ptr;
+    size_t left = size;
+    while (left > 0) {
+      ssize_t n = ::write(fd, p, left);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        err = -1;
+        break;
+      }
+      p += n;
+      left -= n;
+    }
+    writeOffset += size - left;
+    if ((directIO) && (!isAligned) &&
+        ((writeOffset % directIOAlignment) == 0)) {
+      fcntl(fd, F_SETFL, O_WRONLY | O_DIRECT);
+    }
+    return err;
+  }
   std::string path =
       ""; // path to the file (final, after variables substitution)
   unsigned long long counterBytesTotal = 0; // number of bytes written to file
@@ -122,6 +330,23 @@ private:
   bool isOk = false;            // flag set when file ready for writing
   size_t lastWriteBytes = 0;    // number of bytes last written with success
 
+  // async write engine
+  int asyncWrite = 0; // when set, writes queued to dedicated writer thread
+  int directIO = 0;   // when set, file opened with O_DIRECT
+  int fd = -1;        // file descriptor (async mode)
+  size_t writeOffset =
+      0; // current file offset: O_DIRECT is kept dropped while unaligned
+  const int writeQueueSize = 1024; // depth of write queue
+  std::unique_ptr<AliceO2::Common::Fifo<WriteRequest>>
+      writeQueue; // writes pending completion
+  std::unique_ptr<std::thread> writeThread; // thread completing the writes
+  std::atomic<int> writeShutdown = {0}; // to stop writer thread (after drain)
+  std::atomic<int> ioError = {0};       // set on first write error
+  RecorderInFlightBudget *budget =
+      nullptr; // shared accounting of pages retained by the queues (optional)
+  ReadoutStatsBatch statsBatch; // local accumulator for the global
+                                // bytesRecorded counter, flushed on close()
+
 public:
   int fileId = 0; // a placeholder for an incremental counter to identify
                   // current file Id (when file splitting enabled)
@@ -148,6 +373,98 @@ bool operator<(const DataSourceId &a, const DataSourceId &b) {
          ((a.equipmentId == b.equipmentId) && (a.linkId < b.linkId));
 }
 
+// compress a data page in-place into a standalone LZ4 frame, one frame per
+// page, same format as ProcessorLZ4Compress (and as parsed by readRaw with
+// filetype=lz4)
+static int lz4CompressPage(DataBlockContainerReference &input,
+                           DataBlockContainerReference &output) {
+
+  output = nullptr;
+
+  void *ptrIn = input->getData()->data; // data input
+  if (ptrIn == NULL) {
+    return -1;
+  }
+  size_t sizeIn = input->getData()->header.dataSize; // input size (bytes)
+
+  // LZ4 frame, simplest format with no options:
+  // Magic number (4b) FLG (1b) BD (1b) HC (1b) BlockCompressedSize (4b) Data
+  // (xxx) EndMark (4b)
+  // see https://github.com/lz4/lz4/blob/master/doc/lz4_Frame_format.md
+  const char header[] = {
+      0x04, 0x22, 0x4D, 0x18, // Magic Number
+      0x60, // FLG b01100000 = 0x60 -> Version=01 (bits 6-7), Block Independence
+            // flag=1 (bit 5)
+      0x70, // BD  b01110000 = 0x70 -> Block Maximum Size=111 (bits 4-5-6) 7 ->
+            // 4MB
+      0x73, // HC header checksum (xxh32()>>8) & 0xFF (do not include Magic
+            // Number!)
+  };
+  uint32_t blockSize =
+      0; // size of compressed block, 4 bytes little endian after header
+  const char trailer[] = {
+      0x00, 0x00, 0x00, 0x00 // EndMark
+  };
+  const int lz4FrameFormatBytes =
+      sizeof(header) + sizeof(blockSize) +
+      sizeof(trailer); // number of bytes needed for LZ4 frame formatting
+
+  // compress to temporary buffer, reused from one page to the next to avoid
+  // a malloc/free per page (one buffer per compression thread, grown as
+  // needed)
+  struct CompressBuffer {
+    char *ptr = nullptr;
+    int size = 0;
+    ~CompressBuffer() {
+      if (ptr != nullptr) {
+        free(ptr);
+      }
+    }
+  };
+  static thread_local CompressBuffer compressBuffer;
+  int outBufferSize = LZ4_compressBound(sizeIn);
+  if (outBufferSize > compressBuffer.size) {
+    char *newPtr = (char *)realloc(compressBuffer.ptr, outBufferSize);
+    if (newPtr == nullptr) {
+      return -1;
+    }
+    compressBuffer.ptr = newPtr;
+    compressBuffer.size = outBufferSize;
+  }
+  char *ptrOut = compressBuffer.ptr;
+  int err = -1;
+  size_t sizeOut = LZ4_compress_default((char *)ptrIn, ptrOut, sizeIn,
+                                        outBufferSize);
+  if (sizeOut > 0) {
+    // check formatted result fits in page buffer
+    int64_t sizeAvailable = (char *)input->getData() +
+                            input->getDataBufferSize() - (char *)ptrIn;
+    int64_t sizeNeeded = sizeOut + lz4FrameFormatBytes;
+    if (sizeNeeded <= sizeAvailable) {
+      // update lz4 block size
+      blockSize = (uint32_t)sizeOut;
+      blockSize &= 0x7FFFFFFF; // highest bit zero when frame is LZ4 compressed
+
+      // build formatted output back in page buffer
+      char *ptrFormatted = (char *)ptrIn;
+      int ptrSize = 0;
+      auto push = [&](const void *source, size_t size) {
+        memcpy(&ptrFormatted[ptrSize], source, size);
+        ptrSize += size;
+      };
+      push(header, sizeof(header));
+      push(&blockSize, sizeof(blockSize));
+      push(ptrOut, sizeOut);
+      push(trailer, sizeof(trailer));
+
+      output = input;
+      output->getData()->header.dataSize = ptrSize;
+      err = 0;
+    }
+  }
+  return err;
+}
+
 class ConsumerFileRecorder : public Consumer {
 public:
   ConsumerFileRecorder(ConfigFile &cfg, std::string cfgEntryPoint)
@@ -231,9 +548,94 @@ public:
     //  still get full data pages with empty packets. This setting is meant to
     //  reduce the amount of data recorded for continuous detectors in triggered
     //  mode.|
+    // configuration parameter: | consumer-fileRecorder-* | asyncWriteEnabled |
+    // int | 0 | Enable (1) or disable (0) the asynchronous write engine: each
+    // file gets an unbuffered file descriptor and a dedicated writer thread,
+    // writes are queued directly from the data pages (no copy) and completed
+    // out of band. The page references are released only when their write has
+    // completed. Keeps the recorder off the consumer data path. |
+    cfg.getOptionalValue(cfgEntryPoint + ".asyncWriteEnabled", asyncWriteEnabled,
+                         0);
+    // configuration parameter: | consumer-fileRecorder-* | directIOEnabled |
+    // int | 0 | With asyncWriteEnabled, open files with O_DIRECT: writes
+    // bypass the page cache, avoiding the double copy and writeback stalls at
+    // high recording rates. Unaligned pieces fall back to buffered writes. |
+    cfg.getOptionalValue(cfgEntryPoint + ".directIOEnabled", directIOEnabled,
+                         0);
+    if ((directIOEnabled) && (!asyncWriteEnabled)) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Option directIOEnabled implies asyncWriteEnabled, enabling "
+                 "asynchronous writes");
+      asyncWriteEnabled = 1;
+    }
+    if (asyncWriteEnabled) {
+      theLog.log("Asynchronous write engine enabled (directIO=%d)",
+                 directIOEnabled);
+    }
+
+    // configuration parameter: | consumer-fileRecorder-* | inFlightBytesMax |
+    // bytes | 0 | With asyncWriteEnabled, maximum number of bytes retained in
+    // the write queues. Queued pages are referenced until their write has
+    // completed, so on a slow disk the queues can retain enough pages to
+    // starve the equipment memory pool. If zero (default), no limit set. See
+    // inFlightPolicy for the behavior when the budget is exceeded. |
+    std::string sInFlightBytesMax;
+    if (cfg.getOptionalValue<std::string>(cfgEntryPoint + ".inFlightBytesMax",
+                                          sInFlightBytesMax) == 0) {
+      inFlightBudget.bytesMax =
+          ReadoutUtils::getNumberOfBytesFromString(sInFlightBytesMax.c_str());
+    }
+    // configuration parameter: | consumer-fileRecorder-* | inFlightPagesMax |
+    // int | 0 | With asyncWriteEnabled, maximum number of data pages retained
+    // in the write queues. If zero (default), no limit set. See
+    // inFlightPolicy. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".inFlightPagesMax",
+                              inFlightBudget.pagesMax, 0);
+    // configuration parameter: | consumer-fileRecorder-* | inFlightPolicy |
+    // string | wait | Policy when the in-flight budget (inFlightBytesMax,
+    // inFlightPagesMax) is exceeded: "wait" blocks the data stream until the
+    // disk catches up (backpressure propagates upstream and may stall
+    // readout), "drop" discards further pages, accounted and reported on
+    // exit, so that a slow disk degrades recording instead of stalling
+    // readout. |
+    std::string cfgInFlightPolicy = "wait";
+    cfg.getOptionalValue<std::string>(cfgEntryPoint + ".inFlightPolicy",
+                                      cfgInFlightPolicy);
+    if ((inFlightBudget.bytesMax) || (inFlightBudget.pagesMax)) {
+      if (!asyncWriteEnabled) {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "In-flight budget has no effect without asyncWriteEnabled "
+                   "(pages are not retained), ignored");
+        inFlightBudget.bytesMax = 0;
+        inFlightBudget.pagesMax = 0;
+      } else {
+        if (cfgInFlightPolicy == "drop") {
+          inFlightBudget.dropEnabled = 1;
+        } else if (cfgInFlightPolicy != "wait") {
+          theLog.log(InfoLogger::Severity::Error,
+                     "Wrong value for parameter inFlightPolicy: %s",
+                     cfgInFlightPolicy.c_str());
+          throw __LINE__;
+        }
+        // retention time updated by the writer thread of each file
+        inFlightBudget.retentionTime.enableThreadSafe();
+        theLog.log("In-flight budget: max %llu bytes / %d pages, policy = %s",
+                   inFlightBudget.bytesMax, inFlightBudget.pagesMax,
+                   cfgInFlightPolicy.c_str());
+      }
+    }
+
     cfg.getOptionalValue(cfgEntryPoint + ".dropEmptyHBFrames",
                          dropEmptyHBFrames, 0);
     if (dropEmptyHBFrames) {
+      if (asyncWriteEnabled) {
+        // packet copies kept for page boundaries would be freed before
+        // completion of their queued write
+        theLog.log(InfoLogger::Severity::Error,
+                   "Incompatible options dropEmptyHBFrames and "
+                   "asyncWriteEnabled");
+        throw __LINE__;
+      }
       if (recordWithDataBlockHeader) {
         theLog.log(InfoLogger::Severity::Error,
                    "Incompatible options dropEmptyHBFrames and "
@@ -245,22 +647,164 @@ public:
           "option dropEmptyHBFrames is enabled");
     }
 
+    // configuration parameter: | consumer-fileRecorder-* | stripePaths |
+    // string | | Comma-separated list of recording file paths, enabling
+    // striped multi-volume recording: timeframes are distributed between the
+    // files (tfId modulo number of paths), each with its own writer thread,
+    // to aggregate the bandwidth of several filesystems. Whole timeframes are
+    // kept per file, so each file can still be parsed independently. Paths
+    // accept the same variables as fileName, except %i and %l. Implies
+    // asyncWriteEnabled. |
+    std::string cfgStripePaths = "";
+    cfg.getOptionalValue<std::string>(cfgEntryPoint + ".stripePaths",
+                                      cfgStripePaths);
+    if (cfgStripePaths.length()) {
+      std::stringstream ss(cfgStripePaths);
+      std::string p;
+      while (std::getline(ss, p, ',')) {
+        if (p.length()) {
+          stripePathList.push_back(p);
+        }
+      }
+      nStripes = stripePathList.size();
+      if (!asyncWriteEnabled) {
+        theLog.log("Option stripePaths implies asyncWriteEnabled, enabling "
+                   "asynchronous writes");
+        asyncWriteEnabled = 1;
+      }
+      if (dropEmptyHBFrames) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Incompatible options dropEmptyHBFrames and stripePaths");
+        throw __LINE__;
+      }
+      theLog.log("Striped recording on %d volumes", nStripes);
+    }
+
+    // configuration parameter: | consumer-fileRecorder-* | lz4Enabled | int |
+    // 0 | If set, data pages are LZ4-compressed on the fly before being
+    // written to file, each page stored as a standalone LZ4 frame (same format
+    // as consumer-processor with ProcessorLZ4Compress library). The resulting
+    // file can be decoded with readRaw.exe filetype=lz4, or with the standard
+    // lz4 command-line tool. Compression is done in-place in the data pages:
+    // this consumer should then be the last one using them. |
+    cfg.getOptionalValue(cfgEntryPoint + ".lz4Enabled", lz4Enabled, 0);
+    if (lz4Enabled) {
+      if (recordWithDataBlockHeader) {
+        // readRaw parses either concatenated LZ4 frames or datablock headers,
+        // not a mix of both
+        theLog.log(InfoLogger::Severity::Error,
+                   "Incompatible options lz4Enabled and dataBlockHeaderEnabled");
+        throw __LINE__;
+      }
+      if (dropEmptyHBFrames) {
+        // page content is scanned packet by packet after compression would
+        // have destroyed it
+        theLog.log(InfoLogger::Severity::Error,
+                   "Incompatible options lz4Enabled and dropEmptyHBFrames");
+        throw __LINE__;
+      }
+      // configuration parameter: | consumer-fileRecorder-* |
+      // compressionThreads | int | 2 | With lz4Enabled, number of threads
+      // compressing the data pages in parallel. Pages are written to file in
+      // their input order, whichever thread compressed them. |
+      cfg.getOptionalValue<int>(cfgEntryPoint + ".compressionThreads",
+                                compressionThreads, 2);
+      if (compressionThreads < 1) {
+        compressionThreads = 1;
+      }
+      theLog.log("LZ4 compression of recorded data enabled - using %d "
+                 "thread(s)",
+                 compressionThreads);
+    }
+
     // check status
-    if (createFile() == 0) {
+    if (nStripes) {
+      stripeFiles.resize(nStripes);
+      stripeBytes.resize(nStripes, 0);
+      int nErrors = 0;
+      for (int v = 0; v < nStripes; v++) {
+        if (createStripeFile(v)) {
+          nErrors++;
+        }
+      }
+      if (nErrors == 0) {
+        recordingEnabled = true;
+        theLog.log("Recording enabled");
+      } else {
+        theLog.log(InfoLogger::Severity::Warning, "Recording disabled");
+        isError++;
+      }
+    } else if (createFile() == 0) {
       recordingEnabled = true;
       theLog.log("Recording enabled");
     } else {
       theLog.log(InfoLogger::Severity::Warning, "Recording disabled");
       isError++;
     }
+
+    // create the compression pool and the collector thread writing the
+    // compressed pages back in input order
+    if ((lz4Enabled) && (recordingEnabled)) {
+      for (int i = 0; i < compressionThreads; i++) {
+        compressionPool.push_back(std::make_unique<processThread>(
+            lz4CompressPage, i + 1, compressionFifoSize, compressionSleepTime,
+            cfgCpuSet));
+      }
+      lz4IdFifo = std::make_unique<AliceO2::Common::Fifo<DataBlockId>>(
+          (int)(compressionThreads * compressionFifoSize * 2));
+      collectorShutdown = 0;
+      std::function<void(void)> l =
+          std::bind(&ConsumerFileRecorder::loopCollect, this);
+      collectorThread = std::make_unique<std::thread>(l);
+    }
   }
 
   ~ConsumerFileRecorder() {
+    // flush and stop the compression pool before closing files
+    if (collectorThread != nullptr) {
+      // wait until all queued pages have been compressed and written
+      AliceO2::Common::Timer drainTimeout;
+      drainTimeout.reset(compressionDrainTimeout);
+      while (!lz4IdFifo->isEmpty()) {
+        if (drainTimeout.isTimeout()) {
+          theLog.log(InfoLogger::Severity::Warning,
+                     "Timeout waiting for compression threads to flush, some "
+                     "pages not recorded");
+          break;
+        }
+        usleep(1000);
+      }
+      for (auto const &th : compressionPool) {
+        th->stop();
+      }
+      collectorShutdown = 1;
+      collectorThread->join();
+      collectorThread = nullptr;
+      compressionPool.clear();
+      lz4IdFifo = nullptr;
+      if (lz4BytesIn) {
+        theLog.log("LZ4 compression: %llu bytes in %llu bytes out ratio %.4lf",
+                   lz4BytesIn, lz4BytesOut, lz4BytesOut * 1.0 / lz4BytesIn);
+      }
+    }
+
     if (defaultFile != nullptr) {
       defaultFile->close();
       defaultFile = nullptr;
     }
 
+    for (int v = 0; v < nStripes; v++) {
+      if (stripeFiles[v] != nullptr) {
+        stripeBytes[v] += stripeFiles[v]->getBytes();
+        stripeFiles[v]->close();
+        stripeFiles[v] = nullptr;
+      }
+      theLog.log("Volume %d (%s) : %llu bytes recorded (~%s)", v,
+                 stripePathList[v].c_str(), stripeBytes[v],
+                 ReadoutUtils::NumberOfBytesToString(stripeBytes[v], "B")
+                     .c_str());
+    }
+
     for (auto &kv : filePerSourceMap) {
       kv.second->close();
       kv.second = nullptr;
@@ -271,29 +815,40 @@ public:
       theLog.log("Packets recorded=%lld discarded(empty)=%lld", packetsRecorded,
                  emptyPacketsDropped);
     }
-  }
 
-  // create handle to recording file based on configuration
-  // optional params:
-  // equipmentID: use given equipment Id
-  // delayIfSourceId: when set, file is not created immediately
-  // getNewFp: if not null, function will copy handle to created file in the
-  // given variable
-  int createFile(std::shared_ptr<FileHandle> *getNewHandle = nullptr,
-                 const DataSourceId &sourceId = undefinedDataSourceId,
-                 bool delayIfSourceId = true, int fileId = 1) {
+    // report on the in-flight budget (files closed above: writer threads
+    // have completed, counters are final)
+    if ((inFlightBudget.bytesMax) || (inFlightBudget.pagesMax)) {
+      if (inFlightBudget.pagesDropped) {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "In-flight budget exceeded: %llu pages (%llu bytes) not "
+                   "recorded",
+                   inFlightBudget.pagesDropped, inFlightBudget.bytesDropped);
+      }
+      if (inFlightBudget.retentionTime.getCount()) {
+        theLog.log("Page retention time in write queues (microseconds): "
+                   "avg=%.1lf min=%llu max=%llu",
+                   inFlightBudget.retentionTime.getAverage(),
+                   (unsigned long long)inFlightBudget.retentionTime.getMinimum(),
+                   (unsigned long long)inFlightBudget.retentionTime.getMaximum());
+      }
+    }
+  }
 
-    // create the file name according to specified path
-    // parse the string, and subst variables:
-    // ${XXX} -> get variable XXX from environment
-    // %t -> unix timestamp (seconds since epoch)
-    // %T -> formatted date/time
-    // %i -> equipment ID of each data chunk (used to write data from different
-    // equipments to different output files). %l -> link ID of each data chunk
-    // (used to write data from different links to different output files). %f
-    // -> file number (incremental), when file splitting enabled (empty
-    // otherwise)
-    std::string newFileName;
+  // create a file name from given path template
+  // parse the string, and subst variables:
+  // ${XXX} -> get variable XXX from environment
+  // %t -> unix timestamp (seconds since epoch)
+  // %T -> formatted date/time
+  // %i -> equipment ID of each data chunk (used to write data from different
+  // equipments to different output files). %l -> link ID of each data chunk
+  // (used to write data from different links to different output files). %f
+  // -> file number (incremental), when file splitting enabled (empty
+  // otherwise)
+  // result stored in newFileName, returns 0 on success, -1 on parse error
+  int buildFileName(const std::string &pathTemplate, int fileId,
+                    const DataSourceId &sourceId, std::string &newFileName) {
+    newFileName.clear();
 
     // string for file incremental ID
     char sFileId[4] = "";
@@ -302,17 +857,17 @@ public:
     }
 
     int parseError = 0;
-    for (std::string::iterator it = fileName.begin(); it != fileName.end();
-         ++it) {
+    for (std::string::const_iterator it = pathTemplate.begin();
+         it != pathTemplate.end(); ++it) {
       // subst environment variable
       if (*it == '$') {
         ++it;
         int varNameComplete = 0;
-        if (it != fileName.end()) {
+        if (it != pathTemplate.end()) {
           if (*it == '{') {
             std::string varName;
 
-            for (++it; it != fileName.end(); ++it) {
+            for (++it; it != pathTemplate.end(); ++it) {
               if (*it == '}') {
                 varNameComplete = 1;
                 break;
@@ -335,7 +890,7 @@ public:
       } else if (*it == '%') {
         // escape characters
         ++it;
-        if (it != fileName.end()) {
+        if (it != pathTemplate.end()) {
           if (*it == 't') {
             newFileName += std::to_string(std::time(nullptr));
           } else if (*it == 'T') {
@@ -387,6 +942,24 @@ public:
     // ensure file ends with file ID, if not written somewhere else already
     newFileName += sFileId;
 
+    return 0;
+  }
+
+  // create handle to recording file based on configuration
+  // optional params:
+  // equipmentID: use given equipment Id
+  // delayIfSourceId: when set, file is not created immediately
+  // getNewFp: if not null, function will copy handle to created file in the
+  // given variable
+  int createFile(std::shared_ptr<FileHandle> *getNewHandle = nullptr,
+                 const DataSourceId &sourceId = undefinedDataSourceId,
+                 bool delayIfSourceId = true, int fileId = 1) {
+
+    std::string newFileName;
+    if (buildFileName(fileName, fileId, sourceId, newFileName)) {
+      return -1;
+    }
+
     if ((fileId > filesMax) && (filesMax >= 1)) {
       theLog.log(InfoLogger::Severity::Info,
                  "Maximum number of files reached for this stream");
@@ -403,7 +976,8 @@ public:
 
     // create file handle
     std::shared_ptr<FileHandle> newHandle = std::make_shared<FileHandle>(
-        newFileName, &theLog, maxFileSize, maxFilePages);
+        newFileName, &theLog, maxFileSize, maxFilePages, asyncWriteEnabled,
+        directIOEnabled, &inFlightBudget);
     if (newHandle == nullptr) {
       return -1;
     }
@@ -429,6 +1003,47 @@ public:
     return 0;
   }
 
+  // create (or rotate) the recording file of given stripe volume
+  // returns 0 on success, -1 on error
+  int createStripeFile(int volume, int fileId = 1) {
+
+    std::string newFileName;
+    if (buildFileName(stripePathList[volume], fileId, undefinedDataSourceId,
+                      newFileName)) {
+      return -1;
+    }
+    if (perSourceRecordingFile) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Per-source variables (%%i, %%l) not compatible with "
+                 "stripePaths");
+      return -1;
+    }
+
+    if ((fileId > filesMax) && (filesMax >= 1)) {
+      theLog.log(InfoLogger::Severity::Info,
+                 "Maximum number of files reached for this volume");
+      return -1;
+    }
+
+    std::shared_ptr<FileHandle> newHandle = std::make_shared<FileHandle>(
+        newFileName, &theLog, maxFileSize, maxFilePages, asyncWriteEnabled,
+        directIOEnabled, &inFlightBudget);
+    if (newHandle == nullptr) {
+      return -1;
+    }
+    if (!newHandle->isFileOk()) {
+      return -1;
+    }
+    newHandle->fileId = fileId;
+
+    // account bytes of previous file of this volume, if rotating
+    if (stripeFiles[volume] != nullptr) {
+      stripeBytes[volume] += stripeFiles[volume]->getBytes();
+    }
+    stripeFiles[volume] = newHandle;
+    return 0;
+  }
+
   int pushData(DataBlockContainerReference &b) {
 
     // do nothing if recording disabled
@@ -436,13 +1051,122 @@ public:
       return 0;
     }
 
+    // direct write path
+    if (!lz4Enabled) {
+      return recordBlock(b);
+    }
+
+    // compressed path: pages go through the compression pool, the collector
+    // thread writes them back in input order
+
+    // tag page with an incremental id, used to restore input order on output
+    // (use the general-purpose id in header to store it)
+    DataBlockId newId = lz4CurrentId++;
+    b->getData()->header.id = newId;
+    lz4BytesIn += b->getData()->header.dataSize;
+
+    // recording should not lose data: block when the pool is busy, this is
+    // the natural backpressure on the data stream
+    while (lz4IdFifo->push(newId)) {
+      usleep(1000);
+    }
+    for (int i = 0;; i++) {
+      // round-robin distribution of input pages to the compression threads
+      compressionThreadIndex++;
+      if (compressionThreadIndex == compressionThreads) {
+        compressionThreadIndex = 0;
+      }
+      if (compressionPool[compressionThreadIndex]->inputFifo->push(b) == 0) {
+        break;
+      }
+      if ((i % compressionThreads) == (compressionThreads - 1)) {
+        // all threads busy, wait a bit
+        usleep(1000);
+      }
+    }
+
+    return 0;
+  }
+
+  // collector thread loop: write output of compression threads to file, in
+  // the same order as pages came in
+  void loopCollect(void) {
+
+    applyCpuSet();
+
+    int threadIx = 0; // index of current thread being checked
+
+    for (; !collectorShutdown;) {
+      bool isActive = 0;
+
+      // we want a specific page number
+      DataBlockId nextId = 0;
+      if (lz4IdFifo->front(nextId) == 0) {
+        DataBlockContainerReference bc = nullptr;
+        for (int i = 0; i < compressionThreads; i++) {
+          int ix =
+              (i + threadIx) % compressionThreads; // we start from stored index
+          if (compressionPool[ix]->outputFifo->front(bc) == 0) {
+            if (bc->getData()->header.id == nextId) {
+              // we found it !
+              lz4IdFifo->pop(nextId);
+              compressionPool[ix]->outputFifo->pop(bc);
+              lz4BytesOut += bc->getData()->header.dataSize;
+              recordBlock(bc);
+              // we increment start index, as it is more likely to have the
+              // next page
+              threadIx++;
+              isActive = 1;
+              break;
+            }
+          }
+        }
+      }
+
+      // wait a bit if inactive
+      if (!isActive) {
+        usleep(1000);
+      }
+    }
+  }
+
+  // record one data block to file
+  // this is the pushData() back-end, called directly or (with lz4Enabled)
+  // from the collector thread after compression
+  int recordBlock(DataBlockContainerReference &b) {
+
+    // enforce the in-flight budget before retaining one more page
+    if ((inFlightBudget.bytesMax) || (inFlightBudget.pagesMax)) {
+      if (inFlightBudget.dropEnabled) {
+        if (inFlightBudget.isOverBudget()) {
+          // whole pages are dropped, so the file stays parseable
+          inFlightBudget.pagesDropped++;
+          inFlightBudget.bytesDropped += b->getData()->header.dataSize;
+          return 0;
+        }
+      } else {
+        while (inFlightBudget.isOverBudget()) {
+          usleep(100);
+        }
+      }
+    }
+
     // the file handle to be used for this block
     // by default, the main file
     std::shared_ptr<FileHandle> fpUsed;
 
+    // striping: whole timeframes distributed between the volumes
+    int stripeVolume = -1;
+    if (nStripes) {
+      stripeVolume = (int)(b->getData()->header.timeframeId % nStripes);
+      fpUsed = stripeFiles[stripeVolume];
+    }
+
     // does it depend on equipmentId ?
     DataSourceId sourceId = undefinedDataSourceId;
-    if (perSourceRecordingFile) {
+    if (nStripes) {
+      // file already selected above
+    } else if (perSourceRecordingFile) {
       // select appropriate file for recording
       if (useSourceEquipmentId) {
         sourceId.equipmentId = b->getData()->header.equipmentId;
@@ -479,8 +1203,9 @@ public:
         }
 
         // try to write
+        // the block reference is kept until write completion (async mode)
         FileHandle::Status status =
-            fpUsed->write(ptr, size, countPage, remainingBlockSize);
+            fpUsed->write(ptr, size, countPage, remainingBlockSize, b);
 
         // check if need to move to next file
         if (status == FileHandle::Status::FileLimitsReached) {
@@ -489,7 +1214,13 @@ public:
             int fileId = fpUsed->fileId;
             fileId++;
             if ((filesMax < 1) || (fileId <= filesMax)) {
-              createFile(&fpUsed, sourceId, false, fileId);
+              if (nStripes) {
+                if (createStripeFile(stripeVolume, fileId) == 0) {
+                  fpUsed = stripeFiles[stripeVolume];
+                }
+              } else {
+                createFile(&fpUsed, sourceId, false, fileId);
+              }
             }
           }
         }
@@ -674,6 +1405,43 @@ private:
   int filesMax = 0;     // maximum number of files to write (for each stream)
   int dropEmptyHBFrames =
       0; // if set, some empty packets are discarded (see logic in code)
+  int asyncWriteEnabled = 0; // if set, writes queued to a writer thread and
+                             // completed out of band
+  int directIOEnabled = 0;   // if set, files opened with O_DIRECT
+  RecorderInFlightBudget
+      inFlightBudget; // bounded retention of pages by the write queues,
+                      // shared by all the files of this recorder
+
+  // inline LZ4 compression of recorded data
+  int lz4Enabled = 0; // if set, data pages are compressed before writing
+  int compressionThreads = 0; // number of compression threads
+  const unsigned int compressionFifoSize =
+      10; // fifo size of the compression threads (input and output)
+  const unsigned int compressionSleepTime =
+      1000; // sleep time (microseconds) of inactive compression thread
+  const int compressionDrainTimeout =
+      5000000; // timeout (microseconds) to flush compression pool on exit
+  std::vector<std::unique_ptr<processThread>>
+      compressionPool;            // the pool of compression threads
+  int compressionThreadIndex = 0; // a running index for the next thread in
+                                  // pool to use
+  std::unique_ptr<AliceO2::Common::Fifo<DataBlockId>>
+      lz4IdFifo; // fifo to keep track of order of page IDs coming in
+  DataBlockId lz4CurrentId = 1; // a counter to tag pages being compressed
+  std::unique_ptr<std::thread>
+      collectorThread; // the thread writing compressed pages, in order
+  std::atomic<int> collectorShutdown = {
+      0}; // flag set to 1 to stop collector thread
+  unsigned long long lz4BytesIn = 0;  // bytes pushed to compression
+  unsigned long long lz4BytesOut = 0; // bytes written after compression
+
+  // striped multi-volume recording
+  int nStripes = 0; // number of stripe volumes (0 = striping disabled)
+  std::vector<std::string> stripePathList; // path template of each volume
+  std::vector<std::shared_ptr<FileHandle>>
+      stripeFiles; // current file of each volume
+  std::vector<unsigned long long>
+      stripeBytes; // bytes recorded per volume (closed files)
 
   class Packet {
   public:
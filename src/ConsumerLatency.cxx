@@ -0,0 +1,260 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+// Passthrough consumer measuring pipeline latency distributions. Each block
+// is timestamped on arrival against the creation time stamped by the
+// equipment in the page header space (c.f. equipment.pageTimestampEnabled),
+// and histograms of the equipment to consumer latency, of the slice size and
+// of the inter-timeframe arrival jitter are maintained. Percentiles (not
+// just averages) are reported, on console at stop and optionally through the
+// same monitoring path as consumer stats. Data is not touched: only header
+// fields and the page header space are read.
+
+#include "Consumer.h"
+#include "CounterStats.h"
+#include "MemoryPagesPool.h"
+#include "ReadoutUtils.h"
+
+#include <Common/Timer.h>
+
+#include <functional>
+#include <thread>
+
+#include <Monitoring/MonitoringFactory.h>
+using namespace o2::monitoring;
+
+class ConsumerLatency : public Consumer {
+private:
+  CounterStats latencyStats; // equipment to consumer latency of each block,
+                             // in microseconds
+  CounterStats sliceSizeStats; // number of blocks per dataset received
+  CounterStats tfJitterStats;  // time between arrival of first block of
+                               // consecutive timeframes, in microseconds
+
+  uint64_t counterBlocks;            // number of blocks received
+  uint64_t counterBlocksNoTimestamp; // blocks received without a (valid)
+                                     // creation timestamp
+  uint64_t lastTfId;   // id of last timeframe seen
+  uint64_t lastTfTime; // arrival time of first block of last timeframe (ns)
+
+  int monitoringEnabled;
+  double monitoringUpdatePeriod;
+  std::unique_ptr<Monitoring> monitoringCollector;
+
+  AliceO2::Common::Timer monitoringUpdateTimer;
+  bool isRunning = false;
+
+  // reset all counters for a fresh start
+  void reset() {
+    latencyStats.reset();
+    sliceSizeStats.reset();
+    tfJitterStats.reset();
+    counterBlocks = 0;
+    counterBlocksNoTimestamp = 0;
+    lastTfId = undefinedTimeframeId;
+    lastTfTime = 0;
+    monitoringUpdateTimer.reset(monitoringUpdatePeriod * 1000000);
+  }
+
+  // get a percentile (p in [0,1]) of a counter from its histogram.
+  // returns -1 when no value was recorded.
+  double getPercentile(CounterStats &c, double p) {
+    std::vector<double> x;
+    std::vector<CounterValue> count;
+    c.getHisto(x, count);
+    CounterValue total = 0;
+    for (auto v : count) {
+      total += v;
+    }
+    if (total == 0) {
+      return -1;
+    }
+    CounterValue threshold = (CounterValue)(total * p);
+    CounterValue sum = 0;
+    for (unsigned int i = 0; i < count.size(); i++) {
+      sum += count[i];
+      if (sum >= threshold) {
+        return x[i];
+      }
+    }
+    return x.back();
+  }
+
+  void sendMetricNoException(Metric &&metric) {
+    try {
+      monitoringCollector->send(std::forward<Metric &&>(metric));
+    } catch (...) {
+      theLog.log("monitoringCollector->send(%s) failed",
+                 metric.getName().c_str());
+    }
+  }
+
+  void publishStats() {
+    if (!monitoringEnabled) {
+      return;
+    }
+    sendMetricNoException(
+        {getPercentile(latencyStats, 0.50), "readout.latencyUs.p50"});
+    sendMetricNoException(
+        {getPercentile(latencyStats, 0.99), "readout.latencyUs.p99"});
+    sendMetricNoException(
+        {getPercentile(latencyStats, 0.999), "readout.latencyUs.p999"});
+    sendMetricNoException(
+        {getPercentile(sliceSizeStats, 0.50), "readout.sliceBlocks.p50"});
+    sendMetricNoException(
+        {getPercentile(sliceSizeStats, 0.99), "readout.sliceBlocks.p99"});
+    sendMetricNoException(
+        {getPercentile(tfJitterStats, 0.50), "readout.tfJitterUs.p50"});
+    sendMetricNoException(
+        {getPercentile(tfJitterStats, 0.99), "readout.tfJitterUs.p99"});
+  }
+
+  // print percentiles of one counter on console
+  void logPercentiles(const char *title, CounterStats &c, const char *unit) {
+    if (c.getCount() == 0) {
+      theLog.log("Latency stats: %s: no value recorded", title);
+      return;
+    }
+    theLog.log("Latency stats: %s (%s): p50=%.0lf p99=%.0lf p999=%.0lf "
+               "avg=%.1lf min=%llu max=%llu count=%llu",
+               title, unit, getPercentile(c, 0.50), getPercentile(c, 0.99),
+               getPercentile(c, 0.999), c.getAverage(),
+               (unsigned long long)c.getMinimum(),
+               (unsigned long long)c.getMaximum(),
+               (unsigned long long)c.getCount());
+  }
+
+  // thread publishing data regularly, until flag shutdown is set
+  std::unique_ptr<std::thread> periodicUpdateThread;
+  bool periodicUpdateThreadShutdown;
+  void periodicUpdate() {
+    applyCpuSet();
+    periodicUpdateThreadShutdown = 0;
+    for (; !periodicUpdateThreadShutdown;) {
+      if ((!isRunning) || (!monitoringEnabled)) {
+        usleep(100000);
+        continue;
+      }
+      double timeUntilTimeout = monitoringUpdateTimer.getRemainingTime();
+      if (timeUntilTimeout <= 0) {
+        publishStats();
+        monitoringUpdateTimer.increment();
+      } else {
+        if (timeUntilTimeout > 1) {
+          timeUntilTimeout = 1.0;
+        }
+        usleep((int)(timeUntilTimeout * 1000000));
+      }
+    }
+  }
+
+public:
+  ConsumerLatency(ConfigFile &cfg, std::string cfgEntryPoint)
+      : Consumer(cfg, cfgEntryPoint) {
+
+    // configuration parameter: | consumer-latency-* | monitoringEnabled | int
+    // | 0 | Enable (1) or disable (0) publishing of the latency percentiles
+    // to O2 monitoring. |
+    cfg.getOptionalValue(cfgEntryPoint + ".monitoringEnabled",
+                         monitoringEnabled, 0);
+    // configuration parameter: | consumer-latency-* | monitoringUpdatePeriod
+    // | double | 10 | Period of monitoring updates, in seconds. |
+    cfg.getOptionalValue(cfgEntryPoint + ".monitoringUpdatePeriod",
+                         monitoringUpdatePeriod, 10.0);
+    if (monitoringEnabled) {
+      // configuration parameter: | consumer-latency-* | monitoringURI |
+      // string | | URI to connect O2 monitoring service. c.f. o2::monitoring.
+      // |
+      const std::string configURI =
+          cfg.getValue<std::string>(cfgEntryPoint + ".monitoringURI");
+      theLog.log("Monitoring enabled - period %.2fs - using %s",
+                 monitoringUpdatePeriod, configURI.c_str());
+      monitoringCollector = MonitoringFactory::Get(configURI.c_str());
+    }
+
+    // logarithmic histograms, to get meaningful high percentiles over a wide
+    // dynamic range with a fixed number of bins
+    latencyStats.enableHistogram(128, 1, 60000000); // 1 us to 60 s
+    sliceSizeStats.enableHistogram(64, 1, 1000000); // 1 to 1M blocks
+    tfJitterStats.enableHistogram(128, 1, 60000000); // 1 us to 60 s
+
+    reset();
+
+    // start thread for periodic updates
+    std::function<void(void)> l =
+        std::bind(&ConsumerLatency::periodicUpdate, this);
+    periodicUpdateThread = std::make_unique<std::thread>(l);
+  }
+
+  ~ConsumerLatency() {
+    periodicUpdateThreadShutdown = 1;
+    periodicUpdateThread->join();
+  }
+
+  int pushData(DataBlockContainerReference &b) {
+    counterBlocks++;
+    DataBlock *db = b->getData();
+    const PageTimestampHeader *ts =
+        getPageTimestamp((char *)db + sizeof(DataBlock), db->data);
+    if (ts != nullptr) {
+      uint64_t now = PageEventTrace::getTimestamp();
+      if (now > ts->timeCreated) {
+        // set(), not increment(): only set() feeds the histogram
+        latencyStats.set((now - ts->timeCreated) / 1000);
+      }
+    } else {
+      counterBlocksNoTimestamp++;
+    }
+    return 0;
+  }
+
+  int pushData(DataSetReference &bc) {
+    sliceSizeStats.set(bc->size());
+    if (bc->size()) {
+      uint64_t tfId = (*bc)[0]->getData()->header.timeframeId;
+      if ((tfId != undefinedTimeframeId) && (tfId != lastTfId)) {
+        uint64_t now = PageEventTrace::getTimestamp();
+        if (lastTfTime) {
+          tfJitterStats.set((now - lastTfTime) / 1000);
+        }
+        lastTfTime = now;
+        lastTfId = tfId;
+      }
+    }
+    // per-block accounting done by base class iteration
+    return Consumer::pushData(bc);
+  }
+
+  int start() {
+    reset();
+    isRunning = true;
+    return 0;
+  };
+
+  int stop() {
+    isRunning = false;
+    publishStats();
+    logPercentiles("equipment to consumer latency", latencyStats, "us");
+    logPercentiles("slice size", sliceSizeStats, "blocks");
+    logPercentiles("inter-timeframe jitter", tfJitterStats, "us");
+    if (counterBlocksNoTimestamp) {
+      theLog.log("Latency stats: %llu / %llu blocks without creation "
+                 "timestamp (check equipment.pageTimestampEnabled)",
+                 (unsigned long long)counterBlocksNoTimestamp,
+                 (unsigned long long)counterBlocks);
+    }
+    return 0;
+  };
+};
+
+std::unique_ptr<Consumer> getUniqueConsumerLatency(ConfigFile &cfg,
+                                                   std::string cfgEntryPoint) {
+  return std::make_unique<ConsumerLatency>(cfg, cfgEntryPoint);
+}
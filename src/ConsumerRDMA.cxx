@@ -29,6 +29,7 @@
 
 #include <atomic>
 #include <thread>
+#include <vector>
 
 struct pdata {
   uint64_t buf_va;            // base address of server memory buffer
@@ -45,24 +46,41 @@ const unsigned int nloop = 10;
 #define RESOLVE_TIMEOUT_MS 1000
 #define MAX_WR 256
 
+// number of receive buffers posted per QP for credit messages
+#define CREDIT_RECV_WR 16
+
 class ConsumerRDMA : public Consumer {
 public:
-  struct rdma_event_channel *cm_channel = nullptr;
-  struct rdma_cm_id *cm_id = nullptr;
+  // context of one connection to the remote server
+  // each QP has its own CQ and remote page ring, pages are striped between
+  // them round-robin
+  struct QpContext {
+    struct rdma_event_channel *cm_channel = nullptr;
+    struct rdma_cm_id *cm_id = nullptr;
+    struct ibv_comp_channel *comp_chan = nullptr;
+    struct ibv_cq *cq = nullptr;
+    struct pdata server_pdata;
+    std::atomic<int>
+        nAvailable; // maximum number of WR that can be issued concurrently
+    std::atomic<long long>
+        nCredits; // remote pages we are allowed to overwrite (credit-based
+                  // flow control, when enabled)
+    uint64_t nPagesSent = 0;   // number of pages sent on this QP
+    uint64_t creditBuf[CREDIT_RECV_WR]; // landing buffers for credit messages
+    struct ibv_mr *creditBufMr = nullptr; // MR covering creditBuf
+  };
+
   struct ibv_pd *pd = nullptr;
-  struct ibv_comp_channel *comp_chan = nullptr;
-  struct ibv_cq *cq = nullptr;
   struct ibv_mr *mr = nullptr;
-  struct pdata server_pdata;
+  std::vector<std::unique_ptr<QpContext>> qps;
   bool CQshutdownRequest = false;
-  std::atomic<int>
-      nAvailable; // maximum number of WR that can be issued concurrently
 
-  int nPagesSent = 0; // number of pages sent
-                      //  int cfgMaxPages=0; // max number of pages to send
-  //  int cfgRemotePageSize=1024*1024; // size of remote data page
-  //  int cfgRemotePageNumber=1; // number of remote pages // TODO: get this on
-  //  connect init
+  int cfgNumberOfQp = 1;       // number of queue pairs to stripe data on
+  int cfgPollingEnabled = 0;   // if set, CQs polled directly (no events)
+  int cfgCreditFlowEnabled = 0; // if set, sends gated by credits from receiver
+
+  uint64_t nPagesSent = 0; // total number of pages sent
+  bool maxPagesReported = false; // flag to log quota reached once
 
   ConsumerRDMA(ConfigFile &cfg, std::string cfgEntryPoint)
       : Consumer(cfg, cfgEntryPoint) {
@@ -77,9 +95,35 @@ public:
     std::string cfgHost = "localhost"; // remote server address
     cfg.getOptionalValue<std::string>(cfgEntryPoint + ".host", cfgHost);
 
-    //    cfg.getOptionalValue<int>(cfgEntryPoint + ".maxPages", cfgMaxPages);
-    //    cfg.getOptionalValue<int>(cfgEntryPoint + ".remotePageSize",
-    //    cfgRemotePageSize);
+    // configuration parameter: | consumer-rdma-* | numberOfQp | int | 1 |
+    // Number of queue pairs (each with its own completion queue and
+    // connection to the server). Page transfers are striped between them
+    // round-robin, to reach line rate when a single QP saturates and to
+    // avoid head-of-line blocking when one stalls. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".numberOfQp", cfgNumberOfQp);
+    if (cfgNumberOfQp < 1) {
+      cfgNumberOfQp = 1;
+    }
+
+    // configuration parameter: | consumer-rdma-* | pollingEnabled | int | 0 |
+    // If set, work completions are collected by polling the completion
+    // queues directly instead of waiting for completion channel events.
+    // Lower latency, at the price of CPU usage. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".pollingEnabled",
+                              cfgPollingEnabled);
+
+    // configuration parameter: | consumer-rdma-* | creditFlowEnabled | int |
+    // 0 | If set, page sends are gated by credits advertised by the receiver
+    // (one 64-bit credit count per RDMA receive message), so that remote
+    // buffers are not overrun when the remote consumer stalls. Initial
+    // credit is the remote ring size. Needs a receiver supporting credit
+    // messages. |
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".creditFlowEnabled",
+                              cfgCreditFlowEnabled);
+
+    theLog.log("Using %d QP(s), completion mode = %s, credit flow = %d",
+               cfgNumberOfQp, cfgPollingEnabled ? "polling" : "event",
+               cfgCreditFlowEnabled);
 
     theLog.log("Looking for RDMA device...");
 
@@ -100,27 +144,7 @@ public:
       throw __LINE__;
     }
 
-    // setup connection manager (CM)
-    cm_channel = rdma_create_event_channel();
-    if (cm_channel == nullptr) {
-      throw __LINE__;
-    }
-    if (rdma_create_id(cm_channel, &cm_id, NULL, RDMA_PS_TCP)) {
-      throw __LINE__;
-    }
-
-    theLog.log("Connecting to %s : %s", cfgHost.c_str(), cfgPort.c_str());
-
-    /*
-        if(cfgMaxPages) {
-          theLog.log("Will send %d pages",cfgMaxPages);
-        }
-        if(cfgRemotePageSize) {
-          theLog.log("Remote page size:",cfgRemotePageSize);
-        }
-    */
-
-    // resolve server address
+    // resolve server address (list reused for each connection)
     struct addrinfo *addr_res;
     struct addrinfo addr_hints;
     memset(&addr_hints, 0, sizeof(addr_hints));
@@ -130,278 +154,286 @@ public:
         0) {
       throw __LINE__;
     }
-    bool addr_found = false;
-    for (struct addrinfo *t = addr_res; t != nullptr; t = t->ai_next) {
-      if (rdma_resolve_addr(cm_id, NULL, t->ai_addr, RESOLVE_TIMEOUT_MS) == 0) {
-        addr_found = true;
-        break;
-      }
-    }
-    if (addr_res != nullptr) {
-      freeaddrinfo(addr_res);
-    }
-    if (!addr_found) {
-      throw __LINE__;
-    }
 
-    struct rdma_cm_event *event = nullptr;
-    if (rdma_get_cm_event(cm_channel, &event)) {
-      throw __LINE__;
-    }
-    // theLog.log("event:%s",rdma_event_str(event->event));
-    if (event->event != RDMA_CM_EVENT_ADDR_RESOLVED) {
-      throw __LINE__;
-    }
-    rdma_ack_cm_event(event);
-
-    if (rdma_resolve_route(cm_id, RESOLVE_TIMEOUT_MS)) {
-      throw __LINE__;
-    }
-    if (rdma_get_cm_event(cm_channel, &event)) {
-      throw __LINE__;
-    }
-    if (event->event != RDMA_CM_EVENT_ROUTE_RESOLVED) {
-      throw __LINE__;
-    }
-    rdma_ack_cm_event(event);
+    theLog.log("Connecting to %s : %s", cfgHost.c_str(), cfgPort.c_str());
 
-    // the struct ibv_context is available in cm_id->verbs
-    struct ibv_port_attr port_attr;
-    int port_num = 1;
-    if (ibv_query_port(cm_id->verbs, port_num, &port_attr)) {
-      throw __LINE__;
-    }
-    if (port_attr.state != IBV_PORT_ACTIVE) {
-      theLog.log("port state NOT ACTIVE = %d ", port_attr.state);
-    }
+    for (int qpIx = 0; qpIx < cfgNumberOfQp; qpIx++) {
+      auto q = std::make_unique<QpContext>();
 
-    int c_active_width[] = {1, 1, 2, 4, 4, 8, 12};
-    float c_active_speed[] = {1, 2.5,  2,  5.0,  4,  10.0,
-                              8, 10.0, 16, 14.0, 32, 25.0};
-    int c_mtu[] = {IBV_MTU_256,  256,  IBV_MTU_512,  512, IBV_MTU_1024, 1024,
-                   IBV_MTU_2048, 2048, IBV_MTU_4096, 4096};
+      // setup connection manager (CM)
+      q->cm_channel = rdma_create_event_channel();
+      if (q->cm_channel == nullptr) {
+        throw __LINE__;
+      }
+      if (rdma_create_id(q->cm_channel, &q->cm_id, NULL, RDMA_PS_TCP)) {
+        throw __LINE__;
+      }
 
-    for (unsigned int i = 0; i < sizeof(c_mtu) / sizeof(int); i += 2) {
-      if (port_attr.active_mtu == c_mtu[i]) {
-        theLog.log("active_mtu = %d", c_mtu[i + 1]);
-        break;
+      bool addr_found = false;
+      for (struct addrinfo *t = addr_res; t != nullptr; t = t->ai_next) {
+        if (rdma_resolve_addr(q->cm_id, NULL, t->ai_addr, RESOLVE_TIMEOUT_MS) ==
+            0) {
+          addr_found = true;
+          break;
+        }
+      }
+      if (!addr_found) {
+        throw __LINE__;
       }
-    }
 
-    theLog.log("RDMA max msg =%d", port_attr.max_msg_sz);
+      struct rdma_cm_event *event = nullptr;
+      if (rdma_get_cm_event(q->cm_channel, &event)) {
+        throw __LINE__;
+      }
+      // theLog.log("event:%s",rdma_event_str(event->event));
+      if (event->event != RDMA_CM_EVENT_ADDR_RESOLVED) {
+        throw __LINE__;
+      }
+      rdma_ack_cm_event(event);
 
-    for (unsigned int i = 0; i < sizeof(c_active_width) / sizeof(int); i += 2) {
-      if (port_attr.active_width == c_active_width[i]) {
-        theLog.log("active_width = %dx", c_active_width[i + 1]);
-        break;
+      if (rdma_resolve_route(q->cm_id, RESOLVE_TIMEOUT_MS)) {
+        throw __LINE__;
       }
-    }
-    for (unsigned int i = 0; i < sizeof(c_active_speed) / sizeof(float);
-         i += 2) {
-      if (port_attr.active_speed == c_active_speed[i]) {
-        theLog.log("active_speed = %.1f Gbps", c_active_speed[i + 1]);
-        break;
+      if (rdma_get_cm_event(q->cm_channel, &event)) {
+        throw __LINE__;
       }
-    }
+      if (event->event != RDMA_CM_EVENT_ROUTE_RESOLVED) {
+        throw __LINE__;
+      }
+      rdma_ack_cm_event(event);
 
-    // create protection domain (PD)
-    pd = ibv_alloc_pd(cm_id->verbs);
-    if (pd == nullptr) {
-      throw __LINE__;
-    }
+      if (qpIx == 0) {
+        // device-level setup, once (all QPs are on the same device)
 
-    // create completion event channel
-    comp_chan = ibv_create_comp_channel(cm_id->verbs);
-    if (comp_chan == nullptr) {
-      throw __LINE__;
-    }
+        // the struct ibv_context is available in cm_id->verbs
+        struct ibv_port_attr port_attr;
+        int port_num = 1;
+        if (ibv_query_port(q->cm_id->verbs, port_num, &port_attr)) {
+          throw __LINE__;
+        }
+        if (port_attr.state != IBV_PORT_ACTIVE) {
+          theLog.log("port state NOT ACTIVE = %d ", port_attr.state);
+        }
 
-    // set completion channel non-blocking
-    int flags = fcntl(comp_chan->fd, F_GETFL);
-    if (fcntl(comp_chan->fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-      throw __LINE__;
-    }
-    flags = fcntl(comp_chan->fd, F_GETFL);
-    printf("flags: O_NONBLOCK = %d\n", (flags & O_NONBLOCK) ? 1 : 0);
+        int c_active_width[] = {1, 1, 2, 4, 4, 8, 12};
+        float c_active_speed[] = {1, 2.5,  2,  5.0,  4,  10.0,
+                                  8, 10.0, 16, 14.0, 32, 25.0};
+        int c_mtu[] = {IBV_MTU_256,  256,  IBV_MTU_512,  512,
+                       IBV_MTU_1024, 1024, IBV_MTU_2048, 2048,
+                       IBV_MTU_4096, 4096};
+
+        for (unsigned int i = 0; i < sizeof(c_mtu) / sizeof(int); i += 2) {
+          if (port_attr.active_mtu == c_mtu[i]) {
+            theLog.log("active_mtu = %d", c_mtu[i + 1]);
+            break;
+          }
+        }
 
-    printf("created comp_chan @ %d\n", comp_chan->fd);
+        theLog.log("RDMA max msg =%d", port_attr.max_msg_sz);
 
-    // create completion queue (CQ)
-    cq = ibv_create_cq(cm_id->verbs, MAX_WR, NULL, comp_chan, 0);
-    if (cq == nullptr) {
-      throw __LINE__;
-    }
+        for (unsigned int i = 0; i < sizeof(c_active_width) / sizeof(int);
+             i += 2) {
+          if (port_attr.active_width == c_active_width[i]) {
+            theLog.log("active_width = %dx", c_active_width[i + 1]);
+            break;
+          }
+        }
+        for (unsigned int i = 0; i < sizeof(c_active_speed) / sizeof(float);
+             i += 2) {
+          if (port_attr.active_speed == c_active_speed[i]) {
+            theLog.log("active_speed = %.1f Gbps", c_active_speed[i + 1]);
+            break;
+          }
+        }
 
-    // request completion notification on CQ
-    if (ibv_req_notify_cq(cq, 0)) {
-      throw __LINE__;
-    }
+        // create protection domain (PD)
+        pd = ibv_alloc_pd(q->cm_id->verbs);
+        if (pd == nullptr) {
+          throw __LINE__;
+        }
 
-    // register memory region
+        // register memory region
 
-    // registering all memory banks
-    std::vector<MemoryBankManager::memoryRange> memoryRegions;
-    theMemoryBankManager.getMemoryRegions(memoryRegions);
+        // registering all memory banks
+        std::vector<MemoryBankManager::memoryRange> memoryRegions;
+        theMemoryBankManager.getMemoryRegions(memoryRegions);
 
-    // check if memory regions contiguous
-    char *p0 = nullptr;
-    char *p1 = nullptr;
-    bool isContiguous = true;
-    for (auto const &r : memoryRegions) {
-      char *pr = (char *)r.offset;
-      if (p0 == nullptr) {
-        p0 = pr;
-      } else {
-        if (pr != p1) {
-          isContiguous = false;
-          break;
+        // check if memory regions contiguous
+        char *p0 = nullptr;
+        char *p1 = nullptr;
+        bool isContiguous = true;
+        for (auto const &r : memoryRegions) {
+          char *pr = (char *)r.offset;
+          if (p0 == nullptr) {
+            p0 = pr;
+          } else {
+            if (pr != p1) {
+              isContiguous = false;
+              break;
+            }
+          }
+          p1 = &pr[r.size];
+        }
+        if (isContiguous) {
+          size_t sz = p1 - p0;
+          theLog.log(
+              "Banks contiguous, registering them in one go: %p - %p (size %lu)",
+              p0, p1 - 1, sz);
+          mr = ibv_reg_mr(pd, p0, sz, IBV_ACCESS_LOCAL_WRITE);
+          if (mr == nullptr) {
+            throw __LINE__;
+          }
+        } else {
+          theLog.log("Banks not contiguous, configuration not supported");
+          throw __LINE__;
         }
       }
-      p1 = &pr[r.size];
-    }
-    if (isContiguous) {
-      size_t sz = p1 - p0;
-      theLog.log(
-          "Banks contiguous, registering them in one go: %p - %p (size %lu)",
-          p0, p1 - 1, sz);
-      mr = ibv_reg_mr(pd, p0, sz, IBV_ACCESS_LOCAL_WRITE);
-      if (mr == nullptr) {
+
+      if (!cfgPollingEnabled) {
+        // create completion event channel
+        q->comp_chan = ibv_create_comp_channel(q->cm_id->verbs);
+        if (q->comp_chan == nullptr) {
+          throw __LINE__;
+        }
+
+        // set completion channel non-blocking
+        int flags = fcntl(q->comp_chan->fd, F_GETFL);
+        if (fcntl(q->comp_chan->fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+          throw __LINE__;
+        }
+      }
+
+      // create completion queue (CQ)
+      q->cq = ibv_create_cq(q->cm_id->verbs, MAX_WR + CREDIT_RECV_WR, NULL,
+                            q->comp_chan, 0);
+      if (q->cq == nullptr) {
         throw __LINE__;
       }
-    } else {
-      theLog.log("Banks not contiguous, configuration not supported");
-      throw __LINE__;
-    }
 
-    // create queue pair (QP)
-    struct ibv_qp_init_attr qp_attr;
-    memset(&qp_attr, 0, sizeof(qp_attr));
-    qp_attr.cap.max_send_wr = MAX_WR;
-    qp_attr.cap.max_send_sge = 1;
-    qp_attr.cap.max_recv_wr = 1;
-    qp_attr.cap.max_recv_sge = 1;
-    qp_attr.send_cq = cq;
-    qp_attr.recv_cq = cq;
-    qp_attr.qp_type = IBV_QPT_RC;
-    if (rdma_create_qp(cm_id, pd, &qp_attr)) {
-      throw __LINE__;
-    }
+      if (!cfgPollingEnabled) {
+        // request completion notification on CQ
+        if (ibv_req_notify_cq(q->cq, 0)) {
+          throw __LINE__;
+        }
+      }
 
-    // connect to server
-    struct rdma_conn_param conn_param;
-    memset(&conn_param, 0, sizeof(conn_param));
-    conn_param.initiator_depth = 1;
-    conn_param.retry_count = 7;
+      // create queue pair (QP)
+      struct ibv_qp_init_attr qp_attr;
+      memset(&qp_attr, 0, sizeof(qp_attr));
+      qp_attr.cap.max_send_wr = MAX_WR;
+      qp_attr.cap.max_send_sge = 1;
+      qp_attr.cap.max_recv_wr = cfgCreditFlowEnabled ? CREDIT_RECV_WR : 1;
+      qp_attr.cap.max_recv_sge = 1;
+      qp_attr.send_cq = q->cq;
+      qp_attr.recv_cq = q->cq;
+      qp_attr.qp_type = IBV_QPT_RC;
+      if (rdma_create_qp(q->cm_id, pd, &qp_attr)) {
+        throw __LINE__;
+      }
 
-    if (rdma_connect(cm_id, &conn_param)) {
-      throw __LINE__;
-    }
-    if (rdma_get_cm_event(cm_channel, &event)) {
-      throw __LINE__;
-    }
-    printf("event:%s\n", rdma_event_str(event->event));
-    if (event->event != RDMA_CM_EVENT_ESTABLISHED) {
-      throw __LINE__;
-    }
-    // store data given by server
-    // it contains the access parameters to the remote memory
-
-    memcpy(&server_pdata, event->param.conn.private_data, sizeof(server_pdata));
-    rdma_ack_cm_event(event);
-    printf("remote buf @ %p\n", (void *)server_pdata.buf_va);
-
-    theLog.log("Remote buffer : %lu bytes total, %lu pages x %lu bytes",
-               server_pdata.buf_pageSize * server_pdata.buf_numberOfPages,
-               server_pdata.buf_numberOfPages, server_pdata.buf_pageSize);
-
-    nAvailable = MAX_WR;
-    /*
-    // start a thread for completion queue
-    std::thread tCQ([&]() {
-      while(!CQshutdownRequest) {
-
-        printf("waiting CQ @ %d\n",comp_chan->fd);
-
-        // poll the channel
-        struct pollfd cq_pollfd;
-        cq_pollfd.fd = comp_chan->fd;
-        cq_pollfd.events  = POLLIN;
-        cq_pollfd.revents = 0;
-        int err=0;
-        int ms_timeout = 1000;
-        for(;err==0;) {
-          printf("."); fflush(stdout);
-          err = poll(&cq_pollfd, 1, ms_timeout);
-          if (CQshutdownRequest) break;
+      if (cfgCreditFlowEnabled) {
+        // register landing buffers and post receives for credit messages
+        if (postCreditRecvs(*q, true)) {
+          throw __LINE__;
         }
-        if (err==0) {continue;} // timeout
-        if (err<0) {break;}
+      }
 
-        printf("reading CQ\n");
-        continue;
-        // wait for next event in CQ
-        struct ibv_cq *evt_cq=nullptr;
-        void *cq_context=nullptr;
-        if (ibv_get_cq_event(comp_chan,&evt_cq, &cq_context)) {throw __LINE__;}
-
-        // acknowledge the event (ONE event)
-        ibv_ack_cq_events(evt_cq, 1);
-
-        // request next event
-        if (ibv_req_notify_cq(cq, 0)) {throw __LINE__;}
-
-        //printf("emptying CQ\n");
-
-        // empty CQ
-        struct ibv_wc wc;
-        for (;;) {
-          int err=ibv_poll_cq(cq, 1, &wc);
-          if (err<0) {throw __LINE__;}
-          if (err==0) {break;}
-          if (wc.status != IBV_WC_SUCCESS) {
-            //printf("Completion with status 0x%x was found\n",wc.status);
-          } else {
-            //printf("WR success\n");
-            nAvailable++;
-          }
-        }
+      // connect to server
+      struct rdma_conn_param conn_param;
+      memset(&conn_param, 0, sizeof(conn_param));
+      conn_param.initiator_depth = 1;
+      conn_param.retry_count = 7;
 
+      if (rdma_connect(q->cm_id, &conn_param)) {
+        throw __LINE__;
       }
+      if (rdma_get_cm_event(q->cm_channel, &event)) {
+        throw __LINE__;
+      }
+      if (event->event != RDMA_CM_EVENT_ESTABLISHED) {
+        throw __LINE__;
+      }
+      // store data given by server
+      // it contains the access parameters to the remote memory
 
-    });
-    */
-  }
-
-  ~ConsumerRDMA() {}
+      memcpy(&q->server_pdata, event->param.conn.private_data,
+             sizeof(q->server_pdata));
+      rdma_ack_cm_event(event);
 
-  int pushData(DataBlockContainerReference &b) {
-    //	nBytesSent+=b->getData()->header.dataSize;
+      theLog.log(
+          "QP[%d] remote buffer : %lu bytes total, %lu pages x %lu bytes",
+          qpIx, q->server_pdata.buf_pageSize * q->server_pdata.buf_numberOfPages,
+          q->server_pdata.buf_numberOfPages, q->server_pdata.buf_pageSize);
 
-  startCQHandle:
+      q->nAvailable = MAX_WR;
+      // initial credit: the remote ring size
+      q->nCredits = (long long)q->server_pdata.buf_numberOfPages;
 
-    // first, handle pending completion events
+      qps.push_back(std::move(q));
+    }
 
-    // wait for next event in CQ
-    // printf("check for CQ event in queue\n");
-    struct ibv_cq *evt_cq = nullptr;
-    void *cq_context = nullptr;
-    if (ibv_get_cq_event(comp_chan, &evt_cq, &cq_context)) {
-      goto endCQHandle;
+    if (addr_res != nullptr) {
+      freeaddrinfo(addr_res);
     }
-    // printf("got CQ event\n");
+  }
 
-    // acknowledge the event (ONE event)
-    ibv_ack_cq_events(evt_cq, 1);
+  ~ConsumerRDMA() {}
 
-    // request next event
-    if (ibv_req_notify_cq(cq, 0)) {
-      throw __LINE__;
+  // register (first call) and post the receive buffers of given QP, used for
+  // incoming credit messages. returns 0 on success
+  int postCreditRecvs(QpContext &q, bool postAll, int ix = 0) {
+    if (q.creditBufMr == nullptr) {
+      q.creditBufMr = ibv_reg_mr(pd, q.creditBuf, sizeof(q.creditBuf),
+                                 IBV_ACCESS_LOCAL_WRITE);
+      if (q.creditBufMr == nullptr) {
+        return -1;
+      }
+    }
+    int i0 = postAll ? 0 : ix;
+    int i1 = postAll ? CREDIT_RECV_WR : ix + 1;
+    for (int i = i0; i < i1; i++) {
+      struct ibv_sge sge;
+      memset(&sge, 0, sizeof(sge));
+      sge.addr = (uintptr_t)&q.creditBuf[i];
+      sge.length = sizeof(q.creditBuf[i]);
+      sge.lkey = q.creditBufMr->lkey;
+      struct ibv_recv_wr wr;
+      memset(&wr, 0, sizeof(wr));
+      wr.wr_id = i + 1; // wr_id of recv WR = buffer index + 1
+      wr.sg_list = &sge;
+      wr.num_sge = 1;
+      struct ibv_recv_wr *bad_wr;
+      if (ibv_post_recv(q.cm_id->qp, &wr, &bad_wr)) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  // collect pending work completions of given QP: release send slots, and
+  // account credits received from the remote side
+  void pollCompletions(QpContext &q) {
+
+    if (!cfgPollingEnabled) {
+      // event mode: check the completion channel first
+      struct ibv_cq *evt_cq = nullptr;
+      void *cq_context = nullptr;
+      if (ibv_get_cq_event(q.comp_chan, &evt_cq, &cq_context)) {
+        // no pending event
+        return;
+      }
+      // acknowledge the event (ONE event)
+      ibv_ack_cq_events(evt_cq, 1);
+      // request next event
+      if (ibv_req_notify_cq(q.cq, 0)) {
+        throw __LINE__;
+      }
     }
 
     // empty CQ
     struct ibv_wc wc;
     for (;;) {
-      int err = ibv_poll_cq(cq, 1, &wc);
+      int err = ibv_poll_cq(q.cq, 1, &wc);
       if (err < 0) {
         throw __LINE__;
       }
@@ -410,19 +442,37 @@ public:
       }
       if (wc.status != IBV_WC_SUCCESS) {
         // printf("Completion with status 0x%x was found\n",wc.status);
+        continue;
+      }
+      if (wc.opcode == IBV_WC_RECV) {
+        // credit message from receiver
+        int bufIx = (int)wc.wr_id - 1;
+        if ((bufIx >= 0) && (bufIx < CREDIT_RECV_WR)) {
+          q.nCredits += (long long)q.creditBuf[bufIx];
+          // repost the receive buffer
+          if (postCreditRecvs(q, false, bufIx)) {
+            throw __LINE__;
+          }
+        }
       } else {
-        // printf("WR success\n");
-        nAvailable++;
+        // send (RDMA write) completed
+        q.nAvailable++;
       }
     }
+  }
 
-  endCQHandle:
-    // printf("end of CQ event handler\n");
+  int pushData(DataBlockContainerReference &b) {
+
+    // stripe pages round-robin between the QPs
+    QpContext &q = *qps[nPagesSent % qps.size()];
 
-    if (nPagesSent >= server_pdata.maxPages) {
-      if (nPagesSent == server_pdata.maxPages) {
+    // handle pending completion events
+    pollCompletions(q);
+
+    if (nPagesSent >= q.server_pdata.maxPages * qps.size()) {
+      if (!maxPagesReported) {
         theLog.log("Max number of pages sent");
-        nPagesSent++;
+        maxPagesReported = true;
       }
       // we have reached quota
       return 0;
@@ -431,14 +481,18 @@ public:
     int32_t *ptr = (int32_t *)b->getData()->data;
     size_t size = b->getData()->header.dataSize;
 
-    if (!nAvailable.load()) {
-      // printf("."); fflush(stdout);
+    // flow control: wait for a free send slot, and (when enabled) for credit
+    // from the receiver
+    while ((!q.nAvailable.load()) ||
+           ((cfgCreditFlowEnabled) && (q.nCredits.load() <= 0))) {
       usleep(1000);
-      goto startCQHandle;
+      pollCompletions(q);
     }
-    //      printf("%d available\n",nAvailable.load());
 
-    nAvailable--;
+    q.nAvailable--;
+    if (cfgCreditFlowEnabled) {
+      q.nCredits--;
+    }
 
     // scatter-gather element (SGE)
     struct ibv_sge sg_list;
@@ -456,28 +510,24 @@ public:
     wr.num_sge = 1;
     wr.opcode = IBV_WR_RDMA_WRITE;
     wr.wr.rdma.remote_addr =
-        server_pdata.buf_va + (nPagesSent % server_pdata.buf_numberOfPages) *
-                                  server_pdata.buf_pageSize;
+        q.server_pdata.buf_va +
+        (q.nPagesSent % q.server_pdata.buf_numberOfPages) *
+            q.server_pdata.buf_pageSize;
 
     ptr[0] = size; // first word is the size of message transmitted
-    // printf("Write remote @ page[%d]=%p\n",nPagesSent %
-    // server_pdata.buf_numberOfPages,(void *)(wr.wr.rdma.remote_addr));
-    /*      printf("Write remote @ %p\n",(void *)(wr.wr.rdma.remote_addr));
-          printf("Local data @ %p : %08X %08X\n",(void *)ptr,ptr[0],ptr[1]);
-      */
-    if (size > server_pdata.buf_pageSize) {
+    if (size > q.server_pdata.buf_pageSize) {
       printf("error data bigger than remote page size\n");
     }
-    wr.wr.rdma.rkey = server_pdata.buf_rkey;
+    wr.wr.rdma.rkey = q.server_pdata.buf_rkey;
     wr.send_flags =
         IBV_SEND_SIGNALED; // if not there, nothing happens in completion queue
     struct ibv_send_wr *bad_wr;
-    // printf("sending %d\n",buf[i*CHUNK_SIZE]);
 
-    if (ibv_post_send(cm_id->qp, &wr, &bad_wr)) {
+    if (ibv_post_send(q.cm_id->qp, &wr, &bad_wr)) {
       throw __LINE__;
     }
 
+    q.nPagesSent++;
     nPagesSent++;
 
     return 0;
@@ -171,6 +171,7 @@ private:
       periodicUpdateThread;          // the thread running periodic updates
   bool periodicUpdateThreadShutdown; // flag to stop periodicUpdateThread
   void periodicUpdate() {
+    applyCpuSet();
     periodicUpdateThreadShutdown = 0;
 
     // periodic update
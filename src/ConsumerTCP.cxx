@@ -41,12 +41,31 @@ public:
     int cfgNcx = 1; // number of parallel connections (using ports from port to
                     // port+ncx-1
     cfg.getOptionalValue<int>(cfgEntryPoint + ".ncx", cfgNcx);
-    theLog.log("TCP client connecting to %s:%d-%d", cfgHost.c_str(), cfgPort,
-               cfgPort + cfgNcx - 1);
+
+    // configuration parameter: | consumer-tcp-* | zeroCopyEnabled | int | 0 |
+    // If set, data pages are sent with MSG_ZEROCOPY: the kernel does not copy
+    // payload to socket buffers, page references being kept until
+    // transmission completion is reported on the socket error queue. Worth it
+    // for large pages (>~10kB), needs Linux >= 4.14. |
+    int cfgZeroCopyEnabled = 0;
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".zeroCopyEnabled",
+                              cfgZeroCopyEnabled);
+
+    // configuration parameter: | consumer-tcp-* | batchSize | int | 1 |
+    // Maximum number of queued data pages grouped in a single sendmsg() call
+    // (scatter-gather), reducing per-page syscall overhead. |
+    int cfgBatchSize = 1;
+    cfg.getOptionalValue<int>(cfgEntryPoint + ".batchSize", cfgBatchSize);
+
+    theLog.log("TCP client connecting to %s:%d-%d (zeroCopy=%d batchSize=%d)",
+               cfgHost.c_str(), cfgPort, cfgPort + cfgNcx - 1,
+               cfgZeroCopyEnabled, cfgBatchSize);
 
     for (int i = 0; i < cfgNcx; i++) {
       int p = cfgPort + i;
-      tx.push_back(std::make_unique<SocketTx>("Readout", cfgHost.c_str(), p));
+      tx.push_back(std::make_unique<SocketTx>("Readout", cfgHost.c_str(), p,
+                                              cfgZeroCopyEnabled,
+                                              cfgBatchSize));
     }
   }
   ~ConsumerTCP() {
@@ -11,6 +11,28 @@
 #include "CounterStats.h"
 #include <math.h>
 
+namespace {
+// a process-wide running index giving each thread a different preferred
+// shard, to spread concurrent updates over the cells
+std::atomic<unsigned int> nextThreadIndex{0};
+thread_local unsigned int threadIndex =
+    nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+
+// relaxed compare-and-swap update of an atomic minimum / maximum
+inline void atomicMin(std::atomic<CounterValue> &m, CounterValue v) {
+  CounterValue prev = m.load(std::memory_order_relaxed);
+  while ((v < prev) &&
+         (!m.compare_exchange_weak(prev, v, std::memory_order_relaxed))) {
+  }
+}
+inline void atomicMax(std::atomic<CounterValue> &m, CounterValue v) {
+  CounterValue prev = m.load(std::memory_order_relaxed);
+  while ((v > prev) &&
+         (!m.compare_exchange_weak(prev, v, std::memory_order_relaxed))) {
+  }
+}
+} // namespace
+
 CounterStats::CounterStats() { reset(); }
 CounterStats::~CounterStats() {}
 
@@ -22,9 +44,52 @@ void CounterStats::reset() {
   max = 0;
   histoNbin = 0;
   histoCounts.clear();
+  histoEdges.clear();
+  atomicHistoCounts = nullptr;
+  if (shards != nullptr) {
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      shards[i].value.store(0, std::memory_order_relaxed);
+      shards[i].sum.store(0, std::memory_order_relaxed);
+      shards[i].nValues.store(0, std::memory_order_relaxed);
+      shards[i].min.store(UINT64_MAX, std::memory_order_relaxed);
+      shards[i].max.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void CounterStats::enableThreadSafe(unsigned int n) {
+  if (n < 1) {
+    n = 1;
+  }
+  numberOfShards = n;
+  shards = std::make_unique<Shard[]>(n);
+  if (histoNbin) {
+    atomicHistoCounts =
+        std::make_unique<std::atomic<CounterValue>[]>(histoNbin);
+    for (unsigned int i = 0; i < histoNbin; i++) {
+      atomicHistoCounts[i].store(histoCounts[i], std::memory_order_relaxed);
+    }
+  }
+}
+
+CounterStats::Shard &CounterStats::getShard() {
+  return shards[threadIndex % numberOfShards];
 }
 
 void CounterStats::set(CounterValue newValue) {
+  if (shards != nullptr) {
+    Shard &s = getShard();
+    s.value.store(newValue, std::memory_order_relaxed);
+    s.sum.fetch_add(newValue, std::memory_order_relaxed);
+    atomicMin(s.min, newValue);
+    atomicMax(s.max, newValue);
+    s.nValues.fetch_add(1, std::memory_order_relaxed);
+    if (histoNbin) {
+      atomicHistoCounts[getHistoBin(newValue)].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+    return;
+  }
   value = newValue;
   sum += newValue;
   if (value < min) {
@@ -35,25 +100,20 @@ void CounterStats::set(CounterValue newValue) {
   }
   nValues++;
   if (histoNbin) {
-    if (newValue <= histoVmin) {
-      histoCounts[0]++;
-    } else if (newValue >= histoVmax) {
-      histoCounts[histoNbin - 1]++;
-    } else {
-      int n = 0;
-      if (histoLogScale) {
-        n = (int)floor(histoNbin - 1 - (log(newValue * histoK1) * histoK2));
-      } else {
-        n = (int)floor(1 + (newValue - histoVmin) * histoK1);
-      }
-      if ((n >= 0) && (n < (int)histoNbin)) {
-        histoCounts[n]++;
-      }
-    }
+    histoCounts[getHistoBin(newValue)]++;
   }
 }
 
 void CounterStats::increment(CounterValue increment) {
+  if (shards != nullptr) {
+    Shard &s = getShard();
+    s.value.fetch_add(increment, std::memory_order_relaxed);
+    s.sum.fetch_add(increment, std::memory_order_relaxed);
+    atomicMin(s.min, increment);
+    atomicMax(s.max, increment);
+    s.nValues.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
   value += increment;
   sum += increment;
   if (increment < min) {
@@ -65,19 +125,53 @@ void CounterStats::increment(CounterValue increment) {
   nValues++;
 }
 
-CounterValue CounterStats::get() { return value; }
+CounterValue CounterStats::get() {
+  if (shards != nullptr) {
+    CounterValue v = 0;
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      v += shards[i].value.load(std::memory_order_relaxed);
+    }
+    return v;
+  }
+  return value;
+}
 
-CounterValue CounterStats::getTotal() { return sum; }
+CounterValue CounterStats::getTotal() {
+  if (shards != nullptr) {
+    CounterValue v = 0;
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      v += shards[i].sum.load(std::memory_order_relaxed);
+    }
+    return v;
+  }
+  return sum;
+}
 
 double CounterStats::getAverage() {
-  if (nValues) {
-    return sum * 1.0 / nValues;
+  CounterValue n = getCount();
+  if (n) {
+    return getTotal() * 1.0 / n;
   } else {
     return 0;
   }
 }
 
 CounterValue CounterStats::getMinimum() {
+  if (shards != nullptr) {
+    CounterValue v = UINT64_MAX;
+    CounterValue n = 0;
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      CounterValue m = shards[i].min.load(std::memory_order_relaxed);
+      if (m < v) {
+        v = m;
+      }
+      n += shards[i].nValues.load(std::memory_order_relaxed);
+    }
+    if (n) {
+      return v;
+    }
+    return 0;
+  }
   if (nValues) {
     return min;
   }
@@ -85,17 +179,83 @@ CounterValue CounterStats::getMinimum() {
 }
 
 CounterValue CounterStats::getMaximum() {
+  if (shards != nullptr) {
+    CounterValue v = 0;
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      CounterValue m = shards[i].max.load(std::memory_order_relaxed);
+      if (m > v) {
+        v = m;
+      }
+    }
+    return v;
+  }
   if (nValues) {
     return max;
   }
   return 0;
 }
 
-CounterValue CounterStats::getCount() { return nValues; }
+CounterValue CounterStats::getCount() {
+  if (shards != nullptr) {
+    CounterValue v = 0;
+    for (unsigned int i = 0; i < numberOfShards; i++) {
+      v += shards[i].nValues.load(std::memory_order_relaxed);
+    }
+    return v;
+  }
+  return nValues;
+}
+
+// direct bucket lookup formula, float math. Used at init time only, to
+// calibrate the integer edge table used in the hot path.
+unsigned int CounterStats::getHistoBinDirect(CounterValue newValue) {
+  if (newValue <= histoVmin) {
+    return 0;
+  }
+  if (newValue >= histoVmax) {
+    return histoNbin - 1;
+  }
+  int n = 0;
+  if (histoLogScale) {
+    n = (int)floor(histoNbin - 1 - (log(newValue * histoK1) * histoK2));
+  } else {
+    n = (int)floor(1 + (newValue - histoVmin) * histoK1);
+  }
+  if (n < 0) {
+    n = 0;
+  }
+  if (n >= (int)histoNbin) {
+    n = histoNbin - 1;
+  }
+  return (unsigned int)n;
+}
+
+// bucket lookup from the precomputed edge table: binary search over
+// integers, no float math
+unsigned int CounterStats::getHistoBin(CounterValue newValue) {
+  if (newValue <= histoVmin) {
+    return 0;
+  }
+  if (newValue >= histoVmax) {
+    return histoNbin - 1;
+  }
+  unsigned int lo = 0;
+  unsigned int hi = histoNbin - 1;
+  while (lo < hi) {
+    unsigned int mid = (lo + hi + 1) / 2;
+    if (histoEdges[mid] <= newValue) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
 
 void CounterStats::enableHistogram(unsigned int nbin, CounterValue vmin,
                                    CounterValue vmax, int logScale) {
   histoCounts.clear();
+  histoEdges.clear();
   histoVmin = vmin;
   histoVmax = vmax;
   histoNbin = nbin;
@@ -118,6 +278,40 @@ void CounterStats::enableHistogram(unsigned int nbin, CounterValue vmin,
     }
   }
   histoCounts.resize(nbin, 0);
+
+  // precompute the lowest value falling in each bucket, and align the edges
+  // on the direct formula so both lookups give the same bucket
+  histoEdges.resize(nbin);
+  histoEdges[0] = 0;
+  for (unsigned int n = 1; n < nbin; n++) {
+    double e;
+    if (histoLogScale) {
+      e = vmax * pow(histoStep, (double)(nbin - 1 - n));
+    } else {
+      e = vmin + (n - 1) * histoStep;
+    }
+    CounterValue edge = (CounterValue)ceil(e);
+    if (edge < vmin) {
+      edge = vmin;
+    }
+    if (edge > vmax) {
+      edge = vmax;
+    }
+    while ((edge > vmin) && (getHistoBinDirect(edge - 1) >= n)) {
+      edge--;
+    }
+    while ((edge < vmax) && (getHistoBinDirect(edge) < n)) {
+      edge++;
+    }
+    histoEdges[n] = edge;
+  }
+
+  if (shards != nullptr) {
+    atomicHistoCounts = std::make_unique<std::atomic<CounterValue>[]>(nbin);
+    for (unsigned int i = 0; i < nbin; i++) {
+      atomicHistoCounts[i].store(0, std::memory_order_relaxed);
+    }
+  }
 }
 
 void CounterStats::getHisto(std::vector<double> &x,
@@ -137,7 +331,11 @@ void CounterStats::getHisto(std::vector<double> &x,
           x[i] = histoVmin + (i - 1) * histoStep;
         }
       }
-      count[i] = histoCounts[i];
+      if (atomicHistoCounts != nullptr) {
+        count[i] = atomicHistoCounts[i].load(std::memory_order_relaxed);
+      } else {
+        count[i] = histoCounts[i];
+      }
     }
   } else {
     x.clear();
@@ -11,6 +11,8 @@
 #ifndef _COUNTERSTATS_H
 #define _COUNTERSTATS_H
 
+#include <atomic>
+#include <memory>
 #include <stdint.h>
 #include <vector>
 
@@ -38,6 +40,13 @@ public:
                        int logScale = 1);
   void getHisto(std::vector<double> &x, std::vector<CounterValue> &count);
 
+  // allow concurrent set()/increment() from several threads: statistics are
+  // kept in per-thread relaxed-atomic cells (padded to separate cache lines)
+  // and merged on read. To be called before the counter is used. In this
+  // mode, get() returns the merged sum of the per-shard values, which is the
+  // expected result for increment()-style counters.
+  void enableThreadSafe(unsigned int numberOfShards = 4);
+
 private:
   CounterValue value; // last value set
 
@@ -57,6 +66,30 @@ private:
   double histoK1;
   double histoK2;
   int histoLogScale; // if set, using logarithmic scale on X
+
+  std::vector<CounterValue>
+      histoEdges; // lowest value falling in each bucket, precomputed at
+                  // enableHistogram() time so that the per-sample bucket
+                  // lookup is an integer binary search (no float math)
+  unsigned int getHistoBin(CounterValue v); // bucket lookup, from edge table
+  unsigned int
+  getHistoBinDirect(CounterValue v); // bucket lookup, from direct formula
+                                     // (float math, used at init only to
+                                     // calibrate the edge table)
+
+  // thread-safe mode: per-thread cells, merged on read
+  struct alignas(64) Shard {
+    std::atomic<CounterValue> value{0};
+    std::atomic<CounterValue> sum{0};
+    std::atomic<CounterValue> nValues{0};
+    std::atomic<CounterValue> min{UINT64_MAX};
+    std::atomic<CounterValue> max{0};
+  };
+  std::unique_ptr<Shard[]> shards; // the cells, when mode enabled
+  unsigned int numberOfShards = 0; // number of cells
+  std::unique_ptr<std::atomic<CounterValue>[]>
+      atomicHistoCounts;          // histogram counts, in thread-safe mode
+  Shard &getShard();              // cell to be used by calling thread
 };
 
 #endif // #ifndef _COUNTERSTATS_H
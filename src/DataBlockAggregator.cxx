@@ -9,6 +9,9 @@
 // or submit itself to any jurisdiction.
 
 #include "DataBlockAggregator.h"
+#include "ReadoutUtils.h"
+
+#include <unistd.h>
 
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
@@ -27,7 +30,7 @@ DataBlockAggregator::~DataBlockAggregator() {
 }
 
 int DataBlockAggregator::addInput(
-    std::shared_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>> input) {
+    std::shared_ptr<BatchedFifo<DataBlockContainerReference>> input) {
   // inputs.push_back(input);
   inputs.push_back(input);
   slicers.push_back(DataBlockSlicer());
@@ -40,10 +43,41 @@ Thread::CallbackResult DataBlockAggregator::threadCallback(void *arg) {
     return Thread::CallbackResult::Error;
   }
 
+  // on first iteration, apply configured CPU affinity to aggregate thread
+  if (!dPtr->cpuSetApplied) {
+    dPtr->cpuSetApplied = true;
+    if (dPtr->cfgCpuSet.length()) {
+      if (setThreadCpuSet(dPtr->cfgCpuSet) == 0) {
+        theLog.log("Aggregator thread bound to CPUs %s",
+                   dPtr->cfgCpuSet.c_str());
+      } else {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "Failed to set aggregator thread affinity to %s",
+                   dPtr->cfgCpuSet.c_str());
+      }
+    }
+  }
+
   if (dPtr->output->isFull()) {
     return Thread::CallbackResult::Idle;
   }
 
+  if (dPtr->cfgWakeupEnabled) {
+    // event-driven mode: when idle, wait for a push notification instead of
+    // returning Idle (which would add a fixed sleep in the Thread loop).
+    // event count taken before checking the FIFOs, to avoid missed wakeups.
+    // in sharded mode the aggregate thread is fed by the workers.
+    FifoEvent &e =
+        (dPtr->cfgThreads > 0) ? dPtr->mergeEvent : dPtr->inputEvent;
+    uint64_t refCount = e.getCount();
+    Thread::CallbackResult result = dPtr->executeCallback();
+    if (result == Thread::CallbackResult::Idle) {
+      e.wait(refCount, 1000, dPtr->cfgWakeupSpinTime);
+      return Thread::CallbackResult::Ok;
+    }
+    return result;
+  }
+
   return dPtr->executeCallback();
 }
 
@@ -53,16 +87,74 @@ void DataBlockAggregator::start() {
   }
   doFlush = 0;
   timeNow.reset();
+
+  // event-driven mode: get notified on pushes to the input FIFOs
+  if (cfgWakeupEnabled) {
+    for (auto &in : inputs) {
+      in->setEvent(&inputEvent);
+    }
+    theLog.log("Aggregator: event-driven wakeups enabled (spin time = %d us)",
+               cfgWakeupSpinTime);
+  }
+
+  // allocate ring of pending subtimeframes
+  if (enableStfBuilding) {
+    if (stfBuffer.size() == 0) {
+      stfBuffer.resize(stfWindowSize);
+    }
+    stfPendingCount = 0;
+    stfOldestTfId = 0;
+  }
+
+  // in sharded mode, start slicer workers: inputs are partitioned between
+  // workers (input i handled by worker i modulo cfgThreads), each input gets
+  // a FIFO of completed slices drained by the aggregate (merge) thread
+  if (cfgThreads > (int)inputs.size()) {
+    cfgThreads = inputs.size();
+  }
+  if (cfgThreads > 0) {
+    const int workerFifoSize = 1024;
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+      workerOut.push_back(
+          std::make_unique<AliceO2::Common::Fifo<DataSetReference>>(
+              workerFifoSize));
+    }
+    workerShutdown = 0;
+    for (int i = 0; i < cfgThreads; i++) {
+      workerThreads.push_back(
+          std::thread(&DataBlockAggregator::workerLoop, this, i));
+    }
+    theLog.log("Aggregator: %d slicer worker threads for %d inputs",
+               cfgThreads, (int)inputs.size());
+  }
+
   aggregateThread->start();
 }
 
 void DataBlockAggregator::stop(int waitStop) {
   doFlush = 0;
+  // stop slicer workers first, so that merge thread may drain them
+  if (workerThreads.size()) {
+    workerShutdown = 1;
+    for (auto &t : workerThreads) {
+      t.join();
+    }
+    workerThreads.clear();
+  }
   aggregateThread->stop();
   if (waitStop) {
     aggregateThread->join();
   }
-  theLog.log("Aggregator processed %llu blocks", totalBlocksIn);
+  // discard slices left in worker FIFOs
+  for (auto &w : workerOut) {
+    DataSetReference bc = nullptr;
+    while (!w->pop(bc)) {
+      bc->clear();
+    }
+  }
+  workerOut.clear();
+  theLog.log("Aggregator processed %llu blocks",
+             (unsigned long long)totalBlocksIn);
   for (unsigned int i = 0; i < inputs.size(); i++) {
 
     //    printf("aggregator input %d: in=%llu
@@ -81,6 +173,13 @@ void DataBlockAggregator::stop(int waitStop) {
     bc->clear();
   }
   output->clear();
+
+  // discard pending subtimeframes
+  for (auto &stf : stfBuffer) {
+    stf.tfId = 0;
+    stf.sstf.clear();
+  }
+  stfPendingCount = 0;
 }
 
 Thread::CallbackResult DataBlockAggregator::executeCallback() {
@@ -96,6 +195,44 @@ Thread::CallbackResult DataBlockAggregator::executeCallback() {
   // get time once per iteration
   double now = timeNow.getTime();
 
+  // sharded mode: slicers run in worker threads, here we only merge their
+  // completed slices to the output FIFO
+  if (cfgThreads > 0) {
+    for (unsigned int ix = 0; ix < nInputs; ix++) {
+      int i = (ix + nextIndex) % nInputs;
+      for (;;) {
+        if (output->isFull()) {
+          return Thread::CallbackResult::Idle;
+        }
+        DataSetReference bcv = nullptr;
+        if (workerOut[i]->pop(bcv)) {
+          break;
+        }
+        emitSlice(bcv, now);
+        nSlicesOut++;
+        nextIndex = i + 1;
+      }
+    }
+    checkStfTimeout(now);
+    if (nSlicesOut == 0) {
+      if ((doFlush) && (stfPendingCount == 0)) {
+        // flushing is complete once inputs and workers are drained
+        bool pending = false;
+        for (unsigned int i = 0; i < nInputs; i++) {
+          if ((!inputs[i]->isEmpty()) || (!workerOut[i]->isEmpty())) {
+            pending = true;
+            break;
+          }
+        }
+        if (!pending) {
+          doFlush = 0;
+        }
+      }
+      return Thread::CallbackResult::Idle;
+    }
+    return Thread::CallbackResult::Ok;
+  }
+
   for (unsigned int ix = 0; ix < nInputs; ix++) {
     int i = (ix + nextIndex) % nInputs;
 
@@ -104,34 +241,32 @@ Thread::CallbackResult DataBlockAggregator::executeCallback() {
       if (output->isFull()) {
         return Thread::CallbackResult::Idle;
       }
-      if (inputs[i]->isEmpty()) {
+      int nFreeOut = output->getNumberOfFreeSlots();
+      if (inputs[i]->pop(batchIn, nFreeOut) == 0) {
         continue;
       }
-      DataBlockContainerReference b = nullptr;
-      inputs[i]->pop(b);
-      nBlocksIn++;
-      totalBlocksIn++;
-      DataSetReference bcv = nullptr;
-      try {
-        bcv = std::make_shared<DataSet>();
-      } catch (...) {
-        return Thread::CallbackResult::Error;
+      for (auto &b : batchIn) {
+        nBlocksIn++;
+        totalBlocksIn++;
+        DataSetReference bcv = nullptr;
+        try {
+          bcv = std::make_shared<DataSet>();
+        } catch (...) {
+          return Thread::CallbackResult::Error;
+        }
+        bcv->push_back(b);
+        output->push(bcv);
+        nSlicesOut++;
       }
-      bcv->push_back(b);
-      output->push(bcv);
-      nSlicesOut++;
       continue;
     }
 
     const int maxLoop = 1024;
 
     // populate slices
-    for (int j = 0; j < maxLoop; j++) {
-      if (inputs[i]->isEmpty()) {
-        break;
-      }
-      DataBlockContainerReference b = nullptr;
-      inputs[i]->pop(b);
+    // retrieve a batch of blocks from input with a single synchronization
+    inputs[i]->pop(batchIn, maxLoop);
+    for (auto &b : batchIn) {
       nBlocksIn++;
       totalBlocksIn++;
       // printf("Got block %d from dev %d eq %d link %d tf
@@ -163,67 +298,19 @@ Thread::CallbackResult DataBlockAggregator::executeCallback() {
         break;
       }
 
-      if (enableStfBuilding) {     
-        // buffer timeframes
-	DataBlock *db = bcv->at(0)->getData();
-	uint64_t tfId=db->header.timeframeId;
-	uint64_t sourceId=(((uint64_t)db->header.equipmentId) << 32) | ((uint64_t)db->header.linkId);
-	if (tfId<=lastTimeframeId) {
-		theLog.log(InfoLogger::Severity::Warning, "Discarding late data for TF %lu (source = 0x%lX)",tfId,sourceId);
-	} else {
-	  tStf &stf=stfBuffer[tfId];
-	  stf.tfId=tfId;
-	  stf.sstf.push_back({sourceId, bcv, now});
-	  stf.updateTime=now;
-	  //theLog.log(InfoLogger::Severity::Info, "aggregate - added tf %lu : source %lX",tfId,sourceId);
-	}     
-      } else {
-        // push directly out completed slices
-        output->push(bcv);
-      }
+      emitSlice(bcv, now);
 
-      nSlicesOut++;      
+      nSlicesOut++;
       nextIndex = i + 1;
       // printf("Pushed STF : %d chunks\n",(int)bcv->size());
     }
   }
 
   // in TF buffering mode, are there some complete timeframes?
-  if (enableStfBuilding) {
-    int nDataSetPushed=0;
-    int nStfPushed=0;
-    auto it=stfBuffer.begin();
-    while (it!=stfBuffer.end()) {
-      double age=now-it->second.updateTime;      
-      if (age>=cfgStfTimeout) {
-        //printf("pushing age %.3f tf %d -> %d sources\n",age,it->second.tfId,it->second.sstf.size());
-	double tmin=it->second.updateTime;
-	double tmax=it->second.updateTime;	
-	for (auto const &ss: it->second.sstf) {
-	  output->push(ss.data);
-          nDataSetPushed++;
-	  if (ss.updateTime<tmin) {tmin=ss.updateTime;}
-	  if (ss.updateTime<tmax) {tmax=ss.updateTime;}	  
-	}
-	if (it->second.tfId == 1) {
-	    nSources=it->second.sstf.size(); // keep track of number of sources in first TF
-	}
-	nStfPushed++;
-	lastTimeframeId = it->second.tfId;
-	/*
-	if (lastTimeframeId % 10 == 1) {
-	  theLog.log(InfoLogger::Severity::Info,"LastTimeframeId=%lu deltaT=%f",lastTimeframeId,tmax-tmin);
-	}
-	*/
-	it=stfBuffer.erase(it);
-      } else {
-        break;
-      }
-    }
-  }
+  checkStfTimeout(now);
 
   if ((nBlocksIn == 0) && (nSlicesOut == 0)) {
-    if ((doFlush)&&(stfBuffer.size()==0)) {
+    if ((doFlush)&&(stfPendingCount==0)) {
       doFlush = 0; // flushing is complete if we are now idle
     }
     return Thread::CallbackResult::Idle;
@@ -232,6 +319,184 @@ Thread::CallbackResult DataBlockAggregator::executeCallback() {
   return Thread::CallbackResult::Ok;
 }
 
+void DataBlockAggregator::emitSlice(DataSetReference bcv, double now) {
+  if (enableStfBuilding) {
+    // buffer timeframes
+    DataBlock *db = bcv->at(0)->getData();
+    uint64_t tfId = db->header.timeframeId;
+    uint64_t sourceId = (((uint64_t)db->header.equipmentId) << 32) |
+                        ((uint64_t)db->header.linkId);
+    if (tfId <= lastTimeframeId) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Discarding late data for TF %lu (source = 0x%lX)", tfId,
+                 sourceId);
+    } else {
+      // make room if this TF is beyond the current window of pending slots
+      if ((stfPendingCount) && (tfId >= stfOldestTfId + stfWindowSize)) {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "STF buffer window full, flushing TF %lu before timeout",
+                   stfOldestTfId);
+        while ((stfPendingCount) && (tfId >= stfOldestTfId + stfWindowSize)) {
+          flushOldestStf();
+        }
+      }
+      tStf &stf = stfBuffer[tfId % stfWindowSize];
+      if (stf.tfId == 0) {
+        // new pending timeframe, take the slot
+        stf.tfId = tfId;
+        if ((stfPendingCount == 0) || (tfId < stfOldestTfId)) {
+          stfOldestTfId = tfId;
+        }
+        stfPendingCount++;
+      }
+      stf.sstf.push_back({sourceId, bcv, now});
+      stf.updateTime = now;
+      // theLog.log(InfoLogger::Severity::Info, "aggregate - added tf %lu :
+      // source %lX",tfId,sourceId);
+    }
+  } else {
+    // push directly out completed slices
+    output->push(bcv);
+  }
+}
+
+void DataBlockAggregator::checkStfTimeout(double now) {
+  if (!enableStfBuilding) {
+    return;
+  }
+  while (stfPendingCount) {
+    // locate oldest pending slot (skip TF ids for which no data was received)
+    while (stfBuffer[stfOldestTfId % stfWindowSize].tfId == 0) {
+      stfOldestTfId++;
+    }
+    double age = now - stfBuffer[stfOldestTfId % stfWindowSize].updateTime;
+    if (age >= cfgStfTimeout) {
+      flushOldestStf();
+    } else {
+      break;
+    }
+  }
+}
+
+int DataBlockAggregator::flushOldestStf() {
+  while (stfPendingCount) {
+    tStf &stf = stfBuffer[stfOldestTfId % stfWindowSize];
+    if (stf.tfId == 0) {
+      // no data was received for this TF id
+      stfOldestTfId++;
+      continue;
+    }
+    // printf("pushing tf %d -> %d sources\n",stf.tfId,stf.sstf.size());
+    for (auto const &ss : stf.sstf) {
+      output->push(ss.data);
+    }
+    if (stf.tfId == 1) {
+      nSources = stf.sstf.size(); // keep track of number of sources in first TF
+    }
+    lastTimeframeId = stf.tfId;
+    // free the slot, keeping vector capacity for reuse
+    stf.tfId = 0;
+    stf.sstf.clear();
+    stfPendingCount--;
+    stfOldestTfId++;
+    return 1;
+  }
+  return 0;
+}
+
+void DataBlockAggregator::workerLoop(int workerId) {
+  // workers share the CPU set of the aggregator thread, if any
+  if (cfgCpuSet.length()) {
+    setThreadCpuSet(cfgCpuSet);
+  }
+
+  std::vector<DataBlockContainerReference> batch;
+  const int maxLoop = 1024;
+  unsigned int nInputs = inputs.size();
+
+  while (!workerShutdown.load()) {
+    bool isActive = false;
+    int nSlicesOut = 0;
+    uint64_t eventRef = inputEvent.getCount();
+    double now = timeNow.getTime();
+
+    for (unsigned int i = workerId; i < nInputs; i += cfgThreads) {
+
+      if (disableSlicing) {
+        // no slicing... pass through
+        int nFreeOut = workerOut[i]->getNumberOfFreeSlots();
+        if (nFreeOut == 0) {
+          continue;
+        }
+        if (inputs[i]->pop(batch, nFreeOut) == 0) {
+          continue;
+        }
+        for (auto &b : batch) {
+          totalBlocksIn++;
+          DataSetReference bcv = nullptr;
+          try {
+            bcv = std::make_shared<DataSet>();
+          } catch (...) {
+            continue;
+          }
+          bcv->push_back(b);
+          workerOut[i]->push(bcv);
+          nSlicesOut++;
+        }
+        isActive = true;
+        continue;
+      }
+
+      // populate slices
+      // retrieve a batch of blocks from input with a single synchronization
+      inputs[i]->pop(batch, maxLoop);
+      if (batch.size()) {
+        isActive = true;
+      }
+      for (auto &b : batch) {
+        totalBlocksIn++;
+        slicers[i].appendBlock(b, now);
+      }
+
+      // close incomplete slices on timeout
+      if (cfgSliceTimeout) {
+        slicers[i].completeSliceOnTimeout(now - cfgSliceTimeout);
+      }
+
+      // move completed slices towards merge thread
+      for (;;) {
+        if (workerOut[i]->isFull()) {
+          break;
+        }
+        bool includeIncomplete = 0;
+        if ((doFlush) && (inputs[i]->isEmpty())) {
+          includeIncomplete = 1;
+        }
+        DataSetReference bcv = slicers[i].getSlice(includeIncomplete);
+        if (bcv == nullptr) {
+          break;
+        }
+        workerOut[i]->push(bcv);
+        nSlicesOut++;
+        isActive = true;
+      }
+    }
+
+    // wake up merge thread, once per iteration
+    if ((cfgWakeupEnabled) && (nSlicesOut)) {
+      mergeEvent.notify();
+    }
+
+    if (!isActive) {
+      if (cfgWakeupEnabled) {
+        inputEvent.wait(eventRef, 1000, cfgWakeupSpinTime);
+      } else {
+        usleep(1000);
+      }
+    }
+  }
+}
+
 DataBlockSlicer::DataBlockSlicer() {}
 
 DataBlockSlicer::~DataBlockSlicer() {}
@@ -239,21 +504,45 @@ DataBlockSlicer::~DataBlockSlicer() {}
 int DataBlockSlicer::appendBlock(DataBlockContainerReference const &block,
                                  double timestamp) {
   uint64_t tfId = block->getData()->header.timeframeId;
-  DataSourceId sourceId;
-  sourceId.linkId = block->getData()->header.linkId;
-  sourceId.equipmentId = block->getData()->header.equipmentId;
-
-  if (sourceId.linkId != undefinedLinkId) {
-    if (sourceId.linkId >= maxLinks) {
-      theLog.log(InfoLogger::Severity::Error, "wrong link id %d > %d",
-                 sourceId.linkId, maxLinks - 1);
+  uint8_t linkId = block->getData()->header.linkId;
+  uint16_t equipmentId = block->getData()->header.equipmentId;
+
+  // direct array lookup by link id
+  unsigned int linkIndex;
+  if (linkId != undefinedLinkId) {
+    if (linkId >= maxLinks) {
+      theLog.log(InfoLogger::Severity::Error, "wrong link id %d > %d", linkId,
+                 maxLinks - 1);
       return -1;
     }
+    linkIndex = linkId;
+  } else {
+    linkIndex = maxLinks; // last entry used for undefined link id
   }
 
-  // theLog.log("slicer %p append block eq %d link %d for tf %d",
-  //   this,(int)sourceId.equipmentId,(int)sourceId.linkId,(int)tfId);
-  PartialSlice &s = partialSlices[sourceId];
+  // theLog.log("slicer %p append block link %d for tf %d",
+  //   this,(int)linkId,(int)tfId);
+
+  // find the slice of this equipmentId in the per-link entries: usually a
+  // single one, but the same link id may come from several sources
+  std::vector<PartialSlice> &linkSlices = partialSlices[linkIndex];
+  PartialSlice *sp = nullptr;
+  for (auto &ps : linkSlices) {
+    if (ps.equipmentId == equipmentId) {
+      sp = &ps;
+      break;
+    }
+  }
+  if (sp == nullptr) {
+    try {
+      linkSlices.push_back(PartialSlice());
+    } catch (...) {
+      return -1;
+    }
+    sp = &linkSlices.back();
+    sp->equipmentId = equipmentId;
+  }
+  PartialSlice &s = *sp;
 
   if (s.currentDataSet != nullptr) {
     // theLog.log("slice size = %d
@@ -275,6 +564,7 @@ int DataBlockSlicer::appendBlock(DataBlockContainerReference const &block,
     } catch (...) {
       return -1;
     }
+    activeLinks |= ((uint64_t)1 << linkIndex);
   }
   s.currentDataSet->push_back(block);
   s.tfId = tfId;
@@ -290,10 +580,25 @@ DataSetReference DataBlockSlicer::getSlice(bool includeIncomplete) {
   DataSetReference bcv = nullptr;
   if (slices.empty()) {
     if (includeIncomplete) {
-      for (auto &s : partialSlices) {
-        bcv = s.second.currentDataSet;
+      for (unsigned int i = 0; activeLinks >> i; i++) {
+        if (!((activeLinks >> i) & 1)) {
+          continue;
+        }
+        bool anyActive = false;
+        for (auto &ps : partialSlices[i]) {
+          if (ps.currentDataSet != nullptr) {
+            if (bcv == nullptr) {
+              bcv = ps.currentDataSet;
+              ps.currentDataSet = nullptr;
+            } else {
+              anyActive = true;
+            }
+          }
+        }
+        if (!anyActive) {
+          activeLinks &= ~((uint64_t)1 << i);
+        }
         if (bcv != nullptr) {
-          s.second.currentDataSet = nullptr;
           break;
         }
       }
@@ -309,15 +614,27 @@ DataSetReference DataBlockSlicer::getSlice(bool includeIncomplete) {
 
 int DataBlockSlicer::completeSliceOnTimeout(double timestamp) {
   int nFlushed = 0;
-  for (auto &s : partialSlices) {
-    // check if current data set needs to be flushed
-    if (s.second.currentDataSet != nullptr) {
-      if (s.second.lastUpdateTime <= timestamp) {
-        slices.push(s.second.currentDataSet);
-        s.second.currentDataSet = nullptr;
-        nFlushed++;
+  // scan only links with a slice in construction
+  for (unsigned int i = 0; activeLinks >> i; i++) {
+    if (!((activeLinks >> i) & 1)) {
+      continue;
+    }
+    bool anyActive = false;
+    for (auto &ps : partialSlices[i]) {
+      // check if current data set needs to be flushed
+      if (ps.currentDataSet != nullptr) {
+        if (ps.lastUpdateTime <= timestamp) {
+          slices.push(ps.currentDataSet);
+          ps.currentDataSet = nullptr;
+          nFlushed++;
+        } else {
+          anyActive = true;
+        }
       }
     }
+    if (!anyActive) {
+      activeLinks &= ~((uint64_t)1 << i);
+    }
   }
   return nFlushed;
 }
@@ -17,11 +17,15 @@
 #include <Common/DataBlockContainer.h>
 #include <Common/DataSet.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <queue>
+#include <thread>
 #include <vector>
 
+#include "BatchedFifo.h"
+
 using namespace AliceO2::Common;
 
 /*
@@ -58,33 +62,25 @@ public:
   int slicerId = -1;
 
 private:
-  // data source id used to group data
-  struct DataSourceId {
-    uint16_t equipmentId = undefinedEquipmentId;
-    uint8_t linkId = undefinedLinkId;
-  };
-
   struct PartialSlice {
-    uint64_t tfId;                   // timeframeId of this slice
+    uint16_t equipmentId =
+        undefinedEquipmentId;        // equipmentId of this slice
+    uint64_t tfId = 0;               // timeframeId of this slice
     double lastUpdateTime = 0;       // timestamp of last block pushed
     DataSetReference currentDataSet; // currently associated data
   };
 
-  struct CompareDataSourceId {
-    inline bool operator()(const DataSourceId &id1, const DataSourceId &id2) const {
-      if (id1.equipmentId != id2.equipmentId) {
-        return id1.equipmentId < id2.equipmentId;
-      } else {
-        return id1.linkId < id2.linkId;
-      }
-    }
-  };
-
-  using PartialSliceMap =
-      std::map<DataSourceId, PartialSlice, CompareDataSourceId>;
-
-  const unsigned int maxLinks = 32; // maximum number of links
-  PartialSliceMap partialSlices;    // slices being built (one per link)
+  // slices being built are indexed directly by link id, each entry holding
+  // the slices of that link, one per equipmentId. There is usually a single
+  // one, but a given input may carry the same link id from several sources
+  // (e.g. file replays setting equipmentId per chunk from the RDH CRU id),
+  // which must not be merged in the same slice. The last entry is used for
+  // blocks with undefined link id. A bitmap of links with a slice in
+  // construction avoids scanning idle entries.
+  static const unsigned int maxLinks = 32; // maximum number of links
+  std::vector<PartialSlice>
+      partialSlices[maxLinks + 1]; // slices being built (per link)
+  uint64_t activeLinks = 0; // bitmap, bit N set when link N has a slice
 
   std::queue<DataSetReference>
       slices; // data sets which have been built and are complete
@@ -96,9 +92,8 @@ public:
                       std::string name = "Aggregator");
   ~DataBlockAggregator();
 
-  int addInput(
-      std::shared_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
-          input); // add a FIFO to be used as input
+  int addInput(std::shared_ptr<BatchedFifo<DataBlockContainerReference>>
+                   input); // add a FIFO to be used as input
 
   void start(); // starts processing thread
   void stop(int waitStopped =
@@ -111,6 +106,21 @@ public:
       0; // when set, slices not updated after timeout (seconds)
          // are considered completed and are flushed
 
+  std::string cfgCpuSet = ""; // when set, CPU affinity of the aggregator
+                              // thread (list of CPU ids, e.g. "0-3,8")
+
+  int cfgThreads = 0; // when set, number of slicer worker threads: inputs are
+                      // partitioned between workers running the slicers in
+                      // parallel, the aggregator thread only merges completed
+                      // slices to the output FIFO. 0 = single-threaded.
+
+  int cfgWakeupEnabled = 0; // when set, aggregator threads are notified when
+                            // data is pushed to their input FIFOs, instead of
+                            // polling with fixed sleeps
+  int cfgWakeupSpinTime = 0; // with cfgWakeupEnabled, time (microseconds) to
+                             // busy-wait before blocking, for lowest wakeup
+                             // latency on the highest-rate links
+
   static Thread::CallbackResult threadCallback(void *arg);
 
   Thread::CallbackResult executeCallback();
@@ -123,12 +133,16 @@ public:
   int nSources = 0; // accounted number of sources, on first timeframe
 
 private:
-  std::vector<
-      std::shared_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>>
+  std::vector<std::shared_ptr<BatchedFifo<DataBlockContainerReference>>>
       inputs;
   AliceO2::Common::Fifo<DataSetReference> *output; // todo: unique_ptr
 
+  std::vector<DataBlockContainerReference>
+      batchIn; // blocks retrieved from an input with a single multi-pop
+               // operation (vector reused across iterations)
+
   std::unique_ptr<Thread> aggregateThread;
+  bool cpuSetApplied = false; // flag set once aggregate thread affinity set
   AliceO2::Common::Timer incompletePendingTimer;
   AliceO2::Common::Timer timeNow; // a time counter, used to timestamp slices
 
@@ -138,7 +152,24 @@ private:
   int nextIndex = 0; // index of input channel to start with at next iteration
                      // to fill output fifo. not starting always from zero to
                      // avoid favorizing low-index channels.
-  unsigned long long totalBlocksIn = 0; // number of blocks received from inputs
+  std::atomic<unsigned long long> totalBlocksIn = {
+      0}; // number of blocks received from inputs
+
+  // sharded mode (cfgThreads > 0): worker threads run the slicers, one FIFO
+  // of completed slices per input towards the merge (aggregator) thread
+  std::vector<std::thread> workerThreads;
+  std::atomic<int> workerShutdown = {0}; // flag to stop worker threads
+  std::vector<std::unique_ptr<AliceO2::Common::Fifo<DataSetReference>>>
+      workerOut; // completed slices, per input
+  void workerLoop(int workerId); // thread loop of one slicer worker
+
+  FifoEvent inputEvent; // notified when data pushed to an input FIFO
+  FifoEvent mergeEvent; // notified when a worker pushed a completed slice
+
+  // emit one completed slice: buffer it (STF building mode) or push it out
+  void emitSlice(DataSetReference bcv, double now);
+  // push out buffered subtimeframes reaching cfgStfTimeout, in TF order
+  void checkStfTimeout(double now);
   
   // container for sub-subtimeframe (i.e. all data pages of 1 timeframe for a given single source)
   struct tSstf {
@@ -154,8 +185,19 @@ private:
     double updateTime;
   };
   
-  typedef std::map<uint64_t, tStf> tStfMap;
-  tStfMap stfBuffer; // buffer to hold pending subtimeframes
+  // pending subtimeframes are kept in a flat ring of slots indexed by
+  // tfId modulo window size: TF ids are dense and monotonically increasing,
+  // so each pending TF maps to its own slot. A slot with tfId 0 is free.
+  // This avoids per-timeframe map node allocation and rebalancing on the
+  // data path. Freed slots keep the capacity of their sstf vector.
+  static const unsigned int stfWindowSize = 1024; // number of pending TF slots
+  std::vector<tStf> stfBuffer;      // ring of pending subtimeframes
+  unsigned int stfPendingCount = 0; // number of slots in use
+  uint64_t stfOldestTfId = 0;       // lowest possibly-pending timeframe id
   uint64_t lastTimeframeId = 0; // counter for last timeframe id sent out
-  
+
+  // push out the oldest pending subtimeframe (regardless of timeout)
+  // returns 1 when one was pushed, 0 when none pending
+  int flushOldestStf();
+
 };
@@ -16,6 +16,7 @@
 #include <ReadoutCard/Exception.h>
 #include <ReadoutCard/MemoryMappedFile.h>
 #include <algorithm>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -48,8 +49,38 @@ size_t MemoryBank::getSize() { return size; }
 
 std::string MemoryBank::getDescription() { return description; }
 
-void MemoryBank::clear() {
-  std::memset(baseAddress, 0, size);
+int MemoryBank::getNumaNode() { return numaNode; }
+
+void MemoryBank::setNumaNode(int v_numaNode) { numaNode = v_numaNode; }
+
+void MemoryBank::clear(int numberOfThreads) {
+  if (numberOfThreads <= 1) {
+    std::memset(baseAddress, 0, size);
+    return;
+  }
+  // split the range in equal chunks, each initialized by a separate thread.
+  // chunks are aligned on 2MB boundaries so that each (huge)page is touched
+  // by a single thread.
+  const size_t chunkAlign = 2 * 1024 * 1024;
+  size_t chunkSize = size / numberOfThreads;
+  chunkSize -= chunkSize % chunkAlign;
+  if (chunkSize == 0) {
+    chunkSize = chunkAlign;
+  }
+  std::vector<std::thread> initThreads;
+  for (size_t offset = 0; offset < size; offset += chunkSize) {
+    size_t thisChunkSize = chunkSize;
+    if (offset + thisChunkSize > size) {
+      thisChunkSize = size - offset;
+    }
+    void *thisChunkAddress = &((char *)baseAddress)[offset];
+    initThreads.push_back(std::thread([thisChunkAddress, thisChunkSize]() {
+      std::memset(thisChunkAddress, 0, thisChunkSize);
+    }));
+  }
+  for (auto &t : initThreads) {
+    t.join();
+  }
   return;
 }
 
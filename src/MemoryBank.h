@@ -35,12 +35,22 @@ public:
   std::size_t getSize();  // get the total size (bytes) of this memory bank
   std::string getDescription(); // get the description of this memory bank;
 
-  void clear(); // write zeroes into the whole memory range
+  int getNumaNode(); // get NUMA node where bank is allocated (-1: unspecified)
+  void setNumaNode(int numaNode); // tag bank with NUMA node where allocated
+
+  void clear(int numberOfThreads =
+                 1); // write zeroes into the whole memory range. This also
+                     // pre-faults the pages. When numberOfThreads bigger than
+                     // one, the range is split and initialized in parallel
+                     // (faulting/zeroing a big bank sequentially can take tens
+                     // of seconds at start of run).
 
 protected:
   void *baseAddress;       // base address (virtual) of buffer
   std::size_t size;        // size of buffer, in bytes
   std::string description; // description of the memory bank (type/sypport, etc)
+  int numaNode = -1;       // NUMA node where memory allocated, if enforced at
+                           // creation time. -1 means unspecified.
   ReleaseCallback
       releaseCallback; // an optional user-callback to be called in destructor,
                        // when overloaded constructor has been used
@@ -39,7 +39,9 @@ int MemoryBankManager::addBank(std::shared_ptr<MemoryBank> bankPtr,
 std::shared_ptr<MemoryPagesPool>
 MemoryBankManager::getPagedPool(size_t pageSize, size_t pageNumber,
                                 std::string bankName, size_t firstPageOffset,
-                                size_t blockAlign) {
+                                size_t blockAlign, int numaNode,
+                                size_t extraCapacity,
+                                size_t headerReservedSpace) {
 
   void *baseAddress =
       nullptr;          // base address of bank from which the block is taken
@@ -70,7 +72,26 @@ MemoryBankManager::getPagedPool(size_t pageSize, size_t pageNumber,
         }
       }
     } else {
-      if (banks.size()) {
+      // no bank name specified
+      // if a NUMA node preference given, look for a bank allocated there
+      if (numaNode >= 0) {
+        for (ix = 0; ix < banks.size(); ix++) {
+          if (banks[ix].bank->getNumaNode() == numaNode) {
+            bankFound = true;
+            theLog.log(InfoLogger::Severity::Info,
+                       "Bank name not specified, using first one on NUMA node "
+                       "%d (%s)",
+                       numaNode, banks[ix].name.c_str());
+            break;
+          }
+        }
+        if (!bankFound) {
+          theLog.log(InfoLogger::Severity::Warning,
+                     "No memory bank found on NUMA node %d, using first one",
+                     numaNode);
+        }
+      }
+      if ((!bankFound) && (banks.size())) {
         ix = 0;
         bankFound = true;
         theLog.log(InfoLogger::Severity::Info,
@@ -129,9 +150,91 @@ MemoryBankManager::getPagedPool(size_t pageSize, size_t pageNumber,
   // end of locked block
 
   // create pool of pages from new block
-  return std::make_shared<MemoryPagesPool>(pageSize, pageNumber,
-                                           &(((char *)baseAddress)[offset]),
-                                           blockSize, nullptr, firstPageOffset);
+  return std::make_shared<MemoryPagesPool>(
+      pageSize, pageNumber, &(((char *)baseAddress)[offset]), blockSize,
+      nullptr, firstPageOffset, extraCapacity, headerReservedSpace);
+}
+
+void *MemoryBankManager::getPageRange(size_t pageSize, size_t numberOfPages,
+                                      std::string bankName) {
+
+  size_t rangeSize = pageSize * numberOfPages;
+  if (rangeSize == 0) {
+    return nullptr;
+  }
+
+  // disable concurrent execution of this function
+  std::unique_lock<std::mutex> lock(bankMutex);
+
+  // reuse a previously released range of same size, if any
+  for (auto it = freePageRanges.begin(); it != freePageRanges.end(); ++it) {
+    if (it->size == rangeSize) {
+      void *rangeAddress = it->baseAddress;
+      freePageRanges.erase(it);
+      return rangeAddress;
+    }
+  }
+
+  // otherwise, carve a new range from the free space of the bank
+  unsigned int ix = 0;
+  bool bankFound = false;
+  if (bankName.size() > 0) {
+    for (ix = 0; ix < banks.size(); ix++) {
+      if (banks[ix].name == bankName) {
+        bankFound = true;
+        break;
+      }
+    }
+  } else {
+    if (banks.size()) {
+      ix = 0;
+      bankFound = true;
+    }
+  }
+  if (!bankFound) {
+    return nullptr;
+  }
+
+  void *baseAddress = banks[ix].bank->getBaseAddress();
+  size_t offset = 0;
+  for (auto it = banks[ix].rangesInUse.begin();
+       it != banks[ix].rangesInUse.end(); ++it) {
+    size_t maxOffset = it->offset + it->size;
+    if (maxOffset > offset) {
+      offset = maxOffset;
+    }
+  }
+
+  // align beginning of range on page size
+  size_t bytesExcess = (((size_t)baseAddress) + offset) % pageSize;
+  if (bytesExcess) {
+    offset += pageSize - bytesExcess;
+  }
+
+  // check not exceeding bank size
+  if (offset + rangeSize > banks[ix].bank->getSize()) {
+    return nullptr;
+  }
+
+  // keep track of this new range
+  banks[ix].rangesInUse.push_back({offset, rangeSize});
+
+  return &(((char *)baseAddress)[offset]);
+}
+
+int MemoryBankManager::releasePageRange(void *baseAddress, size_t pageSize,
+                                        size_t numberOfPages) {
+  size_t rangeSize = pageSize * numberOfPages;
+  if ((baseAddress == nullptr) || (rangeSize == 0)) {
+    return -1;
+  }
+  std::unique_lock<std::mutex> lock(bankMutex);
+  try {
+    freePageRanges.push_back({baseAddress, rangeSize});
+  } catch (...) {
+    return -1;
+  }
+  return 0;
 }
 
 // a global MemoryBankManager instance
@@ -157,4 +260,5 @@ void MemoryBankManager::reset() {
                (useCount == 1) ? "" : "warning - still in use elsewhere !");
   }
   banks.clear();
+  freePageRanges.clear();
 }
@@ -48,9 +48,32 @@ public:
   // implementation, once a region from a bank has been used, it can not be
   // reused after the corresponding pool of pages has been release
   //    ... don't want to deal with fragmentation etc
+  // - numaNode: when bankName not specified, preferably use a bank allocated
+  // on this NUMA node (-1: no preference). This keeps pool pages local to e.g.
+  // the PCIe device doing DMA on them.
+  // - extraCapacity: number of extra pages the pool may receive at runtime
+  // (elastic mode, see getPageRange()). Only sizes the pool internal queue.
+  // - headerReservedSpace: number of bytes kept at the beginning of each
+  // page, before the payload (c.f. MemoryPagesPool constructor).
   std::shared_ptr<MemoryPagesPool>
   getPagedPool(size_t pageSize, size_t pageNumber, std::string bankName = "",
-               size_t firstPageOffset = 0, size_t blockAlign = 0);
+               size_t firstPageOffset = 0, size_t blockAlign = 0,
+               int numaNode = -1, size_t extraCapacity = 0,
+               size_t headerReservedSpace = sizeof(DataBlock));
+
+  // borrow a range of contiguous pages from the free space of a bank, for use
+  // by an elastic pool (c.f. MemoryPagesPool::setElasticReserve()). Ranges
+  // previously released with releasePageRange() are reused first, so total
+  // bank memory follows the actual per-pool load instead of a static split.
+  // returns base address of range, or nullptr if no space available.
+  void *getPageRange(size_t pageSize, size_t numberOfPages,
+                     std::string bankName = "");
+
+  // give back a range of pages previously obtained with getPageRange().
+  // the range is kept in a reserve for reuse by pools with same page size.
+  // returns 0 on success, -1 on error.
+  int releasePageRange(void *baseAddress, size_t pageSize,
+                       size_t numberOfPages);
 
   // a struct to define a memory range
   struct memoryRange {
@@ -78,6 +101,15 @@ private:
   std::vector<bankDescriptor> banks; // list of registered memory banks
   std::mutex
       bankMutex; // instance mutex to handle concurrent access to public methods
+
+  // a struct to describe a free range of pages available for elastic pools
+  struct freePageRange {
+    void *baseAddress; // base address of range
+    size_t size;       // size of range, in bytes
+  };
+  std::vector<freePageRange>
+      freePageRanges; // ranges released with releasePageRange(), available
+                      // for reuse by getPageRange()
 };
 
 // a global MemoryBankManager instance
@@ -10,19 +10,153 @@
 
 #include "MemoryPagesPool.h"
 #include <assert.h>
+#include <stdio.h>
+#include <time.h>
 
-int MemoryPagesPoolStatsEnabled = 0; // flag to control memory stats
+// global page lifecycle trace, shared by all pools and consumers
+PageEventTrace gPageEventTrace;
+
+void PageEventTrace::init(size_t numberOfEvents) {
+  // round ring size up to next power of two, for cheap index wrapping
+  size_t n = 1;
+  while (n < numberOfEvents) {
+    n *= 2;
+  }
+  // value-initialization: all entries zeroed, empty slots identified by
+  // timestamp == 0 when dumping a ring which did not wrap yet
+  events = std::make_unique<Event[]>(n);
+  indexMask = n - 1;
+  writeIndex.store(0, std::memory_order_relaxed);
+}
+
+void PageEventTrace::dump() {
+  if (events == nullptr) {
+    return;
+  }
+  const char *stageNames[] = {"?", "getPage", "getDataBlock", "releasePage",
+                              "consumerPush"};
+  size_t last = writeIndex.load(std::memory_order_relaxed);
+  size_t size = indexMask + 1;
+  size_t first = (last > size) ? (last - size) : 0;
+  printf("page lifecycle trace: %llu events recorded, dumping last %llu\n",
+         (unsigned long long)last, (unsigned long long)(last - first));
+  uint64_t t0 = 0;
+  for (size_t i = first; i < last; i++) {
+    Event &e = events[i & indexMask];
+    if (e.timestamp == 0) {
+      continue;
+    }
+    if (t0 == 0) {
+      // times printed relative to first event dumped
+      t0 = e.timestamp;
+    }
+    const char *stageName =
+        (e.stage >= 1) && (e.stage <= 4) ? stageNames[e.stage] : stageNames[0];
+    printf("%.9lf\t%p\t%s\t%u\n", (e.timestamp - t0) / 1000000000.0, e.page,
+           stageName, (unsigned int)e.sourceId);
+  }
+}
+
+uint64_t PageEventTrace::getTimestamp() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int MemoryPagesPoolStatsEnabled =
+    0; // flag to control memory stats. 1 = account all pages, N>1 = account
+       // only one page out of N (sampling, to keep hot path light)
+int MemoryPagesPoolLockFreeEnabled =
+    0; // flag to enable lock-free (multiple producers / multiple consumers)
+       // mode for the queue of available pages
+
+MemoryPagesPool::LockFreePageQueue::LockFreePageQueue(size_t capacity) {
+  // round capacity up to next power of two, for cheap index wrapping
+  size_t n = 1;
+  while (n < capacity) {
+    n *= 2;
+  }
+  cells.resize(n);
+  indexMask = n - 1;
+  for (size_t i = 0; i < n; i++) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+    cells[i].page = nullptr;
+  }
+  pushIndex.store(0, std::memory_order_relaxed);
+  popIndex.store(0, std::memory_order_relaxed);
+}
+
+MemoryPagesPool::LockFreePageQueue::~LockFreePageQueue() {}
+
+int MemoryPagesPool::LockFreePageQueue::push(void *page) {
+  size_t ix = pushIndex.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell *c = &cells[ix & indexMask];
+    size_t seq = c->sequence.load(std::memory_order_acquire);
+    if (seq == ix) {
+      // cell free, try to claim it
+      if (pushIndex.compare_exchange_weak(ix, ix + 1,
+                                          std::memory_order_relaxed)) {
+        c->page = page;
+        c->sequence.store(ix + 1, std::memory_order_release);
+        return 0;
+      }
+      // claimed by another thread, ix reloaded by compare_exchange
+    } else if (seq < ix) {
+      // queue full
+      return -1;
+    } else {
+      // another thread moved on, retry with fresh index
+      ix = pushIndex.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+int MemoryPagesPool::LockFreePageQueue::pop(void *&page) {
+  page = nullptr;
+  size_t ix = popIndex.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell *c = &cells[ix & indexMask];
+    size_t seq = c->sequence.load(std::memory_order_acquire);
+    if (seq == ix + 1) {
+      // cell filled, try to claim it
+      if (popIndex.compare_exchange_weak(ix, ix + 1,
+                                         std::memory_order_relaxed)) {
+        page = c->page;
+        c->page = nullptr;
+        c->sequence.store(ix + indexMask + 1, std::memory_order_release);
+        return 0;
+      }
+    } else if (seq <= ix) {
+      // queue empty
+      return -1;
+    } else {
+      ix = popIndex.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+size_t MemoryPagesPool::LockFreePageQueue::getNumberOfUsedSlots() {
+  size_t nPush = pushIndex.load(std::memory_order_relaxed);
+  size_t nPop = popIndex.load(std::memory_order_relaxed);
+  if (nPush <= nPop) {
+    return 0;
+  }
+  return nPush - nPop;
+}
 
 MemoryPagesPool::MemoryPagesPool(size_t vPageSize, size_t vNumberOfPages,
                                  void *vBaseAddress, size_t vBaseSize,
                                  ReleaseCallback vCallback,
-                                 size_t firstPageOffset) {
+                                 size_t firstPageOffset, size_t extraCapacity,
+                                 size_t vHeaderReservedSpace) {
   // initialize members from parameters
   pageSize = vPageSize;
   numberOfPages = vNumberOfPages;
   baseBlockAddress = vBaseAddress;
   baseBlockSize = vBaseSize;
   releaseBaseBlockCallback = vCallback;
+  headerReservedSpace = vHeaderReservedSpace;
 
   // check page / header sizes
   assert(headerReservedSpace >= sizeof(DataBlock));
@@ -46,26 +180,40 @@ MemoryPagesPool::MemoryPagesPool(size_t vPageSize, size_t vNumberOfPages,
     numberOfPages = (baseBlockSize - firstPageOffset) / pageSize;
   }
 
-  // create a fifo and store list of pages available
-  pagesAvailable =
-      std::make_unique<AliceO2::Common::Fifo<void *>>(numberOfPages);
+  // create a queue and store list of pages available
+  // lock-free mode (multiple threads may get/release pages concurrently)
+  // is selected by global flag
+  // queue sized with extra capacity headroom for elastic mode
+  if (MemoryPagesPoolLockFreeEnabled) {
+    pagesAvailableLockFree =
+        std::make_unique<LockFreePageQueue>(numberOfPages + extraCapacity);
+  } else {
+    pagesAvailable = std::make_unique<AliceO2::Common::Fifo<void *>>(
+        numberOfPages + extraCapacity);
+  }
   void *ptr = nullptr;
   int id = 0;
+  if (MemoryPagesPoolStatsEnabled) {
+    pageDescriptors.resize(numberOfPages);
+  }
   for (size_t i = 0; i < numberOfPages; i++) {
     ptr = &((char *)baseBlockAddress)[firstPageOffset + i * pageSize];
-    pagesAvailable->push(ptr);
+    if (pagesAvailableLockFree != nullptr) {
+      pagesAvailableLockFree->push(ptr);
+    } else {
+      pagesAvailable->push(ptr);
+    }
     if (i == 0) {
       firstPageAddress = ptr;
     }
     if (MemoryPagesPoolStatsEnabled) {
-      DataPageDescriptor d;
+      DataPageDescriptor &d = pageDescriptors[i];
       d.id = id;
       d.ptr = ptr;
       d.timeGetPage = 0.0;
       d.timeGetDataBlock = 0.0;
       d.timeReleasePage = 0.0;
       d.nTimeUsed = 0;
-      pagesMap[ptr] = d;
     }
     id++;
   }
@@ -137,15 +285,23 @@ MemoryPagesPool::~MemoryPagesPool() {
     }
 
     int nNeverUsed = 0;
-    for (auto &p : pagesMap) {
-      // printf("page id %d used %d\n",p.second.id,p.second.nTimeUsed);
-      if (p.second.nTimeUsed <= 10) {
+    for (auto &p : pageDescriptors) {
+      // printf("page id %d used %d\n",p.id,p.nTimeUsed);
+      if (p.nTimeUsed <= 10) {
         nNeverUsed++;
       }
     }
     printf("Pages never used: %d\n", nNeverUsed);
   }
 
+  // give back borrowed ranges, if any
+  if (returnRangeCallback != nullptr) {
+    for (auto &r : borrowedRanges) {
+      returnRangeCallback(r.address, pageSize, r.numberOfPages);
+    }
+  }
+  borrowedRanges.clear();
+
   // if defined, use provided callback to release base block
   if ((releaseBaseBlockCallback != nullptr) && (baseBlockAddress != nullptr)) {
     releaseBaseBlockCallback(baseBlockAddress);
@@ -153,28 +309,46 @@ MemoryPagesPool::~MemoryPagesPool() {
 }
 
 void *MemoryPagesPool::getPage() {
-  // get a page from fifo, if available
+  // get a page from queue, if available
   void *ptr = nullptr;
-  pagesAvailable->pop(ptr);
+  if (pagesAvailableLockFree != nullptr) {
+    pagesAvailableLockFree->pop(ptr);
+  } else {
+    pagesAvailable->pop(ptr);
+  }
 
-  // stats
-  if (MemoryPagesPoolStatsEnabled) {
-    if (ptr != nullptr) {
-      auto search = pagesMap.find(ptr);
-      if (search != pagesMap.end()) {
-        search->second.timeGetPage = clock.getTime();
-        if (search->second.timeReleasePage > 0) {
-          t3.set((uint64_t)(
-              (search->second.timeGetPage - search->second.timeReleasePage) *
-              1000000));
+  // elastic mode: when pool runs low, borrow a range from the shared reserve
+  if (elasticEnabled) {
+    if (getNumberOfPagesAvailable() < elasticLowWatermark) {
+      tryBorrowRange();
+      if (ptr == nullptr) {
+        // retry with freshly borrowed pages, if any
+        if (pagesAvailableLockFree != nullptr) {
+          pagesAvailableLockFree->pop(ptr);
+        } else {
+          pagesAvailable->pop(ptr);
         }
-        search->second.timeGetDataBlock = 0;
-        search->second.timeReleasePage = 0;
-        search->second.nTimeUsed++;
       }
     }
   }
 
+  // stats
+  DataPageDescriptor *d = getPageStatsDescriptor(ptr);
+  if (d != nullptr) {
+    d->timeGetPage = clock.getTime();
+    if (d->timeReleasePage > 0) {
+      t3.set((uint64_t)((d->timeGetPage - d->timeReleasePage) * 1000000));
+    }
+    d->timeGetDataBlock = 0;
+    d->timeReleasePage = 0;
+    d->nTimeUsed++;
+  }
+
+  // trace
+  if (ptr != nullptr) {
+    gPageEventTrace.record(ptr, PageEventTrace::stageGetPage);
+  }
+
   return ptr;
 }
 
@@ -185,25 +359,36 @@ void MemoryPagesPool::releasePage(void *address) {
   }
 
   // stats
-  if (MemoryPagesPoolStatsEnabled) {
-    auto search = pagesMap.find(address);
-    if (search != pagesMap.end()) {
-      search->second.timeReleasePage = clock.getTime();
-      if (search->second.timeGetDataBlock > 0) {
-        t2.set((uint64_t)(
-            (search->second.timeReleasePage - search->second.timeGetDataBlock) *
-            1000000));
-      }
-      if (search->second.timeGetPage > 0) {
-        t4.set((uint64_t)(
-            (search->second.timeReleasePage - search->second.timeGetPage) *
-            1000000));
-      }
+  DataPageDescriptor *d = getPageStatsDescriptor(address);
+  if (d != nullptr) {
+    d->timeReleasePage = clock.getTime();
+    if (d->timeGetDataBlock > 0) {
+      t2.set(
+          (uint64_t)((d->timeReleasePage - d->timeGetDataBlock) * 1000000));
+    }
+    if (d->timeGetPage > 0) {
+      t4.set((uint64_t)((d->timeReleasePage - d->timeGetPage) * 1000000));
     }
   }
 
+  // trace
+  gPageEventTrace.record(address, PageEventTrace::stageReleasePage);
+
   // put back page in list of available pages
-  pagesAvailable->push(address);
+  if (pagesAvailableLockFree != nullptr) {
+    pagesAvailableLockFree->push(address);
+  } else {
+    pagesAvailable->push(address);
+  }
+
+  // elastic mode: when many pages free, try to give back a borrowed range
+  if (elasticEnabled) {
+    if ((getNumberOfPagesAvailable() > elasticHighWatermark) &&
+        (borrowedRanges.size()) && (elasticReturnTimer.isTimeout())) {
+      tryReturnRange();
+      elasticReturnTimer.increment();
+    }
+  }
 }
 
 size_t MemoryPagesPool::getPageSize() { return pageSize; }
@@ -211,6 +396,9 @@ size_t MemoryPagesPool::getPageSize() { return pageSize; }
 size_t MemoryPagesPool::getTotalNumberOfPages() { return numberOfPages; }
 
 size_t MemoryPagesPool::getNumberOfPagesAvailable() {
+  if (pagesAvailableLockFree != nullptr) {
+    return pagesAvailableLockFree->getNumberOfUsedSlots();
+  }
   return pagesAvailable->getNumberOfUsedSlots();
 }
 
@@ -234,18 +422,17 @@ MemoryPagesPool::getNewDataBlockContainer(void *newPage) {
   }
 
   // stats
-  if (MemoryPagesPoolStatsEnabled) {
-    auto search = pagesMap.find(newPage);
-    if (search != pagesMap.end()) {
-      search->second.timeGetDataBlock = clock.getTime();
-      if (search->second.timeGetPage > 0) {
-        t1.set((uint64_t)(
-            (search->second.timeGetDataBlock - search->second.timeGetPage) *
-            1000000));
-      }
+  DataPageDescriptor *d = getPageStatsDescriptor(newPage);
+  if (d != nullptr) {
+    d->timeGetDataBlock = clock.getTime();
+    if (d->timeGetPage > 0) {
+      t1.set((uint64_t)((d->timeGetDataBlock - d->timeGetPage) * 1000000));
     }
   }
 
+  // trace
+  gPageEventTrace.record(newPage, PageEventTrace::stageGetDataBlock);
+
   // fill header at beginning of page
   // assuming payload is contiguous after header
   DataBlock *b = (DataBlock *)newPage;
@@ -277,17 +464,187 @@ MemoryPagesPool::getNewDataBlockContainer(void *newPage) {
   return bc;
 }
 
+int MemoryPagesPool::getPageIndex(void *pagePtr) {
+  // pages are contiguous from firstPageAddress, the index is computed by
+  // pointer arithmetic, no need for a container lookup
+  if ((pagePtr < firstPageAddress) || (pagePtr > lastPageAddress)) {
+    return -1;
+  }
+  size_t offset = (char *)pagePtr - (char *)firstPageAddress;
+  if ((offset % pageSize) != 0) {
+    return -1;
+  }
+  return (int)(offset / pageSize);
+}
+
+MemoryPagesPool::DataPageDescriptor *
+MemoryPagesPool::getPageStatsDescriptor(void *pagePtr) {
+  if ((!MemoryPagesPoolStatsEnabled) || (pagePtr == nullptr)) {
+    return nullptr;
+  }
+  int ix = getPageIndex(pagePtr);
+  if (ix < 0) {
+    return nullptr;
+  }
+  // when sampling configured (flag value N>1), account only one page out of N
+  if ((MemoryPagesPoolStatsEnabled > 1) &&
+      (ix % MemoryPagesPoolStatsEnabled)) {
+    return nullptr;
+  }
+  return &pageDescriptors[ix];
+}
+
 bool MemoryPagesPool::isPageValid(void *pagePtr) {
-  if (pagePtr < firstPageAddress) {
-    return false;
+  if (getPageIndex(pagePtr) >= 0) {
+    return true;
+  }
+  if (elasticEnabled) {
+    return isPageInBorrowedRanges(pagePtr);
+  }
+  return false;
+}
+
+int MemoryPagesPool::getPageTimingPercentiles(double &p50, double &p90,
+                                              double &p99) {
+  p50 = 0;
+  p90 = 0;
+  p99 = 0;
+  if (!MemoryPagesPoolStatsEnabled) {
+    return -1;
   }
-  if (pagePtr > lastPageAddress) {
-    return false;
+  // approximate percentiles from the getpage->releasepage histogram
+  std::vector<double> tx;
+  std::vector<CounterValue> tv;
+  t4.getHisto(tx, tv);
+  CounterValue total = 0;
+  for (auto v : tv) {
+    total += v;
   }
-  if ((((char *)pagePtr - (char *)firstPageAddress) % pageSize) != 0) {
-    return false;
+  if (total == 0) {
+    return -1;
+  }
+  auto percentile = [&](double p) {
+    CounterValue threshold = (CounterValue)(total * p);
+    CounterValue sum = 0;
+    for (unsigned int i = 0; i < tv.size(); i++) {
+      sum += tv[i];
+      if (sum >= threshold) {
+        return tx[i];
+      }
+    }
+    return tx[tx.size() - 1];
+  };
+  p50 = percentile(0.50);
+  p90 = percentile(0.90);
+  p99 = percentile(0.99);
+  return 0;
+}
+
+void MemoryPagesPool::setElasticReserve(BorrowRangeCallback vBorrowCallback,
+                                        ReturnRangeCallback vReturnCallback,
+                                        size_t rangeNumberOfPages,
+                                        size_t lowWatermark,
+                                        size_t highWatermark,
+                                        size_t maxExtraPages) {
+  borrowRangeCallback = vBorrowCallback;
+  returnRangeCallback = vReturnCallback;
+  elasticRangePages = rangeNumberOfPages;
+  elasticLowWatermark = lowWatermark;
+  elasticHighWatermark = highWatermark;
+  elasticMaxExtraPages = maxExtraPages;
+  elasticReturnTimer.reset(1000000); // max 1 range returned per second
+  elasticEnabled = true;
+}
+
+bool MemoryPagesPool::isPageInBorrowedRanges(void *pagePtr) {
+  std::unique_lock<std::mutex> lock(elasticMutex);
+  for (auto &r : borrowedRanges) {
+    if ((pagePtr >= r.address) &&
+        (pagePtr < &((char *)r.address)[r.numberOfPages * pageSize])) {
+      if ((((char *)pagePtr - (char *)r.address) % pageSize) == 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void MemoryPagesPool::tryBorrowRange() {
+  std::unique_lock<std::mutex> lock(elasticMutex);
+  if (borrowRangeCallback == nullptr) {
+    return;
+  }
+  // check not exceeding maximum number of borrowed pages
+  size_t nBorrowed = 0;
+  for (auto &r : borrowedRanges) {
+    nBorrowed += r.numberOfPages;
+  }
+  if (nBorrowed + elasticRangePages > elasticMaxExtraPages) {
+    return;
+  }
+  void *rangeAddress = borrowRangeCallback(pageSize, elasticRangePages);
+  if (rangeAddress == nullptr) {
+    return;
+  }
+  borrowedRanges.push_back({rangeAddress, elasticRangePages});
+  // make the new pages available
+  for (size_t i = 0; i < elasticRangePages; i++) {
+    void *ptr = &((char *)rangeAddress)[i * pageSize];
+    if (pagesAvailableLockFree != nullptr) {
+      pagesAvailableLockFree->push(ptr);
+    } else {
+      pagesAvailable->push(ptr);
+    }
+  }
+}
+
+void MemoryPagesPool::tryReturnRange() {
+  std::unique_lock<std::mutex> lock(elasticMutex);
+  if ((returnRangeCallback == nullptr) || (borrowedRanges.size() == 0)) {
+    return;
+  }
+  // try to collect from the queue all free pages of the last borrowed range.
+  // pages not belonging to it are pushed back. if the full range is free, it
+  // is given back to the reserve, otherwise collected pages are pushed back.
+  BorrowedRange &r = borrowedRanges.back();
+  char *rangeBegin = (char *)r.address;
+  char *rangeEnd = &rangeBegin[r.numberOfPages * pageSize];
+  std::vector<void *> collected;
+  size_t nToScan = getNumberOfPagesAvailable();
+  for (size_t i = 0; i < nToScan; i++) {
+    void *ptr = nullptr;
+    if (pagesAvailableLockFree != nullptr) {
+      pagesAvailableLockFree->pop(ptr);
+    } else {
+      pagesAvailable->pop(ptr);
+    }
+    if (ptr == nullptr) {
+      break;
+    }
+    if ((ptr >= rangeBegin) && (ptr < rangeEnd)) {
+      collected.push_back(ptr);
+    } else {
+      if (pagesAvailableLockFree != nullptr) {
+        pagesAvailableLockFree->push(ptr);
+      } else {
+        pagesAvailable->push(ptr);
+      }
+    }
+  }
+  if (collected.size() == r.numberOfPages) {
+    // full range is free, give it back
+    returnRangeCallback(r.address, pageSize, r.numberOfPages);
+    borrowedRanges.pop_back();
+  } else {
+    // some pages of the range still in use, push back the collected ones
+    for (auto ptr : collected) {
+      if (pagesAvailableLockFree != nullptr) {
+        pagesAvailableLockFree->push(ptr);
+      } else {
+        pagesAvailable->push(ptr);
+      }
+    }
   }
-  return true;
 }
 
 size_t MemoryPagesPool::getDataBlockMaxSize() {
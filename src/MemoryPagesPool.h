@@ -15,14 +15,81 @@
 #include <Common/DataBlockContainer.h>
 #include <Common/Fifo.h>
 #include <Common/Timer.h>
+#include <atomic>
 #include <functional>
-#include <map>
 #include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// Lightweight tracing of data page lifecycle events. Each event is recorded
+// in a fixed-size shared ring with a single relaxed atomic increment and a
+// plain store, overwriting the oldest events, so it is cheap enough to stay
+// enabled in production. The ring content can be dumped on demand (signal) or
+// on stop, to chase latency outliers of individual pages that the aggregate
+// timing statistics (t1..t4 counters below) can not explain.
+// Recording is disabled (single pointer test) until init() is called.
+class PageEventTrace {
+public:
+  // stages of the page lifecycle being traced
+  enum Stage : uint32_t {
+    stageGetPage = 1,      // page taken from pool (getPage())
+    stageGetDataBlock = 2, // page wrapped in a block (getNewDataBlockContainer())
+    stageReleasePage = 3,  // page put back in pool (releasePage())
+    stageConsumerPush = 4  // page pushed to a consumer (sourceId = consumer id)
+  };
+
+  // one recorded event
+  struct Event {
+    uint64_t timestamp; // time of event, from getTimestamp()
+    void *page;         // address of the data page concerned
+    uint32_t stage;     // one of the Stage values
+    uint32_t sourceId;  // optional id of event source (e.g. consumer id)
+  };
+
+  // allocate the ring and enable recording.
+  // numberOfEvents is rounded up to the next power of two.
+  void init(size_t numberOfEvents);
+
+  // record one event. May be called concurrently from any thread.
+  // no-op (single test) when tracing not enabled.
+  void record(void *page, uint32_t stage, uint32_t sourceId = 0) {
+    if (events == nullptr) {
+      return;
+    }
+    size_t ix = writeIndex.fetch_add(1, std::memory_order_relaxed) & indexMask;
+    Event &e = events[ix];
+    e.timestamp = getTimestamp();
+    e.page = page;
+    e.stage = stage;
+    e.sourceId = sourceId;
+  }
+
+  // print ring content to stdout, oldest event first.
+  // writers are not stopped, entries being overwritten may be inconsistent:
+  // acceptable for a debugging facility, keeps the data path untouched.
+  void dump();
+
+  // current time in nanoseconds (monotonic clock)
+  static uint64_t getTimestamp();
+
+private:
+  std::unique_ptr<Event[]> events; // the ring of events. nullptr = disabled.
+  size_t indexMask = 0;            // ring size - 1, for index wrapping
+  std::atomic<size_t> writeIndex{0}; // next slot to write (always incremented,
+                                     // wrapped with indexMask on access)
+};
+
+// global instance, shared by all memory pools and consumers
+extern PageEventTrace gPageEventTrace;
 
 // This class creates a pool of data pages from a memory block
-// Optimized for 1-1 consumers (1 thread to get the page, 1 thread to release
-// them) No check is done on validity of address of data pages pushed back in
-// queue Base address should be kept while object is in use
+// Default mode is optimized for 1-1 consumers (1 thread to get the page, 1
+// thread to release them). An optional lock-free mode allows several threads
+// to get/release pages concurrently without external locks (see
+// MemoryPagesPoolLockFreeEnabled global flag). No check is done on validity of
+// address of data pages pushed back in queue Base address should be kept while
+// object is in use
 
 class MemoryPagesPool {
 
@@ -44,16 +111,25 @@ public:
   // control alignment. All pages are created contiguous from this point.
   //   If non-zero, this may reduce number of pages created compared to request
   //   (as to fit in base size)
+  // - extraCapacity is the number of extra pages the pool may later receive
+  // at runtime (elastic mode, see setElasticReserve()). It only sizes the
+  // internal queue, no memory is reserved here.
+  // - headerReservedSpace is the number of bytes kept at the beginning of
+  // each page, before the payload. Must be at least sizeof(DataBlock) (the
+  // default); a larger value leaves room for extra metadata (e.g. the
+  // per-link packet index, c.f. equipment.pageLinkIndexEnabled).
   MemoryPagesPool(size_t pageSize, size_t numberOfPages, void *baseAddress,
                   size_t baseSize = 0, ReleaseCallback callback = nullptr,
-                  size_t firstPageOffset = 0);
+                  size_t firstPageOffset = 0, size_t extraCapacity = 0,
+                  size_t headerReservedSpace = sizeof(DataBlock));
 
   // destructor
   ~MemoryPagesPool();
 
   // methods to get and release page
   // the two functions can be called concurrently without locking
-  // (but a lock is needed if calling the same function concurrently)
+  // (but, in default mode, a lock is needed if calling the same function
+  // concurrently - in lock-free mode any number of threads may call both)
   void *
   getPage(); // get a new page from the pool (if available, nullptr if none)
   void releasePage(void *address); // insert back page to the pool after use, to
@@ -82,14 +158,76 @@ public:
 
   bool isPageValid(void *page); // check to see if a page address is valid
 
+  // get percentiles of the page lifecycle time (getPage to releasePage, in
+  // microseconds), from the timing statistics histogram. Returns 0 on
+  // success, -1 when statistics are not available (needs
+  // MemoryPagesPoolStatsEnabled).
+  int getPageTimingPercentiles(double &p50, double &p90, double &p99);
+
+  // elastic mode: the pool may borrow ranges of pages from a shared reserve
+  // at runtime (and return them later), so that total memory follows actual
+  // load instead of the static per-pool split.
+  // prototype of function to borrow a range of pages (returns base address of
+  // range, or nullptr if none available) and to return it after use.
+  using BorrowRangeCallback = std::function<void *(size_t, size_t)>;
+  using ReturnRangeCallback = std::function<void(void *, size_t, size_t)>;
+
+  // enable elastic mode. parameters:
+  // - borrowCallback / returnCallback: functions to get/release a range of
+  // pages from the shared reserve (typically bound to MemoryBankManager).
+  // - rangeNumberOfPages: number of pages per borrowed range.
+  // - lowWatermark: when number of pages available goes below this value, the
+  // pool tries to borrow a new range.
+  // - highWatermark: when number of pages available exceeds this value, the
+  // pool tries to return a borrowed range.
+  // - maxExtraPages: maximum number of pages borrowed at any time. Should not
+  // exceed the extraCapacity given at construction time.
+  // Needs the lock-free page queue (MemoryPagesPoolLockFreeEnabled): ranges
+  // are borrowed from the getPage() side and collected from the releasePage()
+  // side, which breaks the 1 producer + 1 consumer contract of the default
+  // queue.
+  void setElasticReserve(BorrowRangeCallback borrowCallback,
+                         ReturnRangeCallback returnCallback,
+                         size_t rangeNumberOfPages, size_t lowWatermark,
+                         size_t highWatermark, size_t maxExtraPages);
+
 private:
+  // A bounded lock-free MPMC queue of pages, based on a ring of cells each
+  // tagged with a sequence counter (Vyukov-style). Used instead of the
+  // (1 producer + 1 consumer) Fifo when lock-free mode is enabled, so that
+  // e.g. several consumers may release pages from their own threads while the
+  // equipment thread allocates, without serializing on an external lock.
+  class LockFreePageQueue {
+  public:
+    LockFreePageQueue(size_t capacity); // capacity rounded up to power of two
+    ~LockFreePageQueue();
+    int push(void *page);  // insert a page. returns 0 on success, -1 if full.
+    int pop(void *&page);  // retrieve a page. returns 0 on success, -1 if
+                           // empty (page set to nullptr).
+    size_t getNumberOfUsedSlots(); // approximate number of items queued
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      void *page;
+    };
+    std::vector<Cell> cells;  // ring of cells
+    size_t indexMask;         // cells.size() - 1, for index wrapping
+    alignas(64) std::atomic<size_t> pushIndex;  // next slot to fill
+    alignas(64) std::atomic<size_t> popIndex;   // next slot to empty
+  };
+
   std::unique_ptr<AliceO2::Common::Fifo<void *>>
       pagesAvailable; // a buffer to keep track of individual pages
+                      // (default 1+1 threads mode)
+  std::unique_ptr<LockFreePageQueue>
+      pagesAvailableLockFree; // same, when lock-free mode enabled
 
   size_t numberOfPages;                           // number of pages
   size_t pageSize;                                // size of each page, in bytes
   size_t headerReservedSpace = sizeof(DataBlock); // number of bytes reserved at
                                                   // top of each page for header
+                                                  // (set from constructor)
 
   void *baseBlockAddress; // address of block containing all pages
   size_t baseBlockSize;   // size of block containing all pages
@@ -112,8 +250,48 @@ private:
     int nTimeUsed;
   };
 
-  using DataPageMap = std::map<void *, DataPageDescriptor>;
-  DataPageMap pagesMap; // reference of all registered pages
+  // flat array of descriptors of all registered pages, indexed by page id.
+  // pages are contiguous from firstPageAddress, so the descriptor of a page
+  // is found by pure pointer arithmetic, see getPageIndex().
+  std::vector<DataPageDescriptor> pageDescriptors;
+
+  // get index of a page in pageDescriptors array
+  // returns -1 if address is not a valid page
+  int getPageIndex(void *page);
+
+  // elastic mode state
+  struct BorrowedRange {
+    void *address;        // base address of borrowed range
+    size_t numberOfPages; // number of pages in range
+  };
+  bool elasticEnabled = false;          // flag set when elastic mode on
+  BorrowRangeCallback borrowRangeCallback; // get a range from shared reserve
+  ReturnRangeCallback returnRangeCallback; // give back a range to reserve
+  size_t elasticRangePages = 0;         // pages per borrowed range
+  size_t elasticLowWatermark = 0;       // borrow when free pages below this
+  size_t elasticHighWatermark = 0;      // return when free pages above this
+  size_t elasticMaxExtraPages = 0;      // max pages borrowed at any time
+  std::vector<BorrowedRange> borrowedRanges; // ranges currently borrowed
+  std::mutex elasticMutex; // serialize borrow/return operations
+  AliceO2::Common::Timer
+      elasticReturnTimer; // rate-limit attempts to return ranges
+
+  // check if given address belongs to one of the borrowed ranges
+  bool isPageInBorrowedRanges(void *page);
+
+  // try to borrow a new range of pages from the shared reserve
+  // (called when pool runs low)
+  void tryBorrowRange();
+
+  // try to return the last borrowed range to the shared reserve, if all its
+  // pages are currently free (called when pool free pages high)
+  void tryReturnRange();
+
+  // returns the descriptor of given page, for timing statistics accounting.
+  // returns nullptr when stats are disabled, page invalid, or page not in the
+  // sampled subset (when stats sampling configured, only one page out of N is
+  // accounted, to keep the hot path light).
+  DataPageDescriptor *getPageStatsDescriptor(void *page);
 
   CounterStats t1, t2, t3, t4; // statistics on time for superpage
   // t1: getpage->getdatablock
@@ -0,0 +1,156 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef _PROCESSTHREAD_H
+#define _PROCESSTHREAD_H
+
+// A data page processing thread, with input/output FIFOs.
+// Used by ConsumerDataProcessor (pool of threads running a processBlock()
+// function from a dynamic library) and by ConsumerFileRecorder (inline
+// compression workers).
+
+#include "ReadoutUtils.h"
+
+#include <Common/DataBlockContainer.h>
+#include <Common/Fifo.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// declaration of function type to process data
+// input: input block
+// output: output block (can be the same as input block)
+// preliminary interface - will likely be replaced by a class
+int processBlock(DataBlockContainerReference &input,
+                 DataBlockContainerReference &output);
+using PtrProcessFunction = decltype(&processBlock);
+
+// A class to implement a processsing thread
+class processThread {
+
+public:
+  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
+      inputFifo; // fifo for input data. This should be filled externally to
+                 // provide data blocks.
+  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
+      outputFifo; // fifo for output data. This should be emptied externally, to
+                  // dispose of processed data blocks.
+
+  // constructor
+  // parameters:
+  // - f: process function, called for each block coming in inputFifo. Result is
+  // put in outputFifo.
+  // - id: a number to identify this processing thread
+  // - fifoSize: size of input and output FIFOs for incoming/output data blocks
+  // - idleSleepTime: idle sleep time (in microseconds), when input fifo empty
+  // or output fifo full, before retrying.
+  // - cpuSet: when set, CPU affinity of the processing thread (list of CPU
+  // ids, e.g. "0-3,8")
+  // - sharedInput / sharedInputMutex: when set, the thread takes its input
+  // from this queue (shared between the threads of a pool, access protected
+  // by given mutex) instead of its own inputFifo. Threads pull work as they
+  // become free, so a block with a long processing time does not delay the
+  // blocks queued behind it on a given thread.
+  //
+  // The constructor initialize the member variables and create the processing
+  // thread.
+  processThread(PtrProcessFunction f, int id, unsigned int fifoSize = 10,
+                unsigned int idleSleepTime = 100, std::string cpuSet = "",
+                AliceO2::Common::Fifo<DataBlockContainerReference>
+                    *sharedInput = nullptr,
+                std::mutex *sharedInputMutex = nullptr) {
+    shutdown = 0;
+    fProcess = f;
+    cfgIdleSleepTime = idleSleepTime;
+    threadId = id;
+    cfgCpuSet = cpuSet;
+    this->sharedInput = sharedInput;
+    this->sharedInputMutex = sharedInputMutex;
+    inputFifo =
+        std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
+            fifoSize);
+    outputFifo =
+        std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
+            fifoSize);
+    std::function<void(void)> l = std::bind(&processThread::loop, this);
+    th = std::make_unique<std::thread>(l);
+  }
+
+  // stop the thread
+  void stop() {
+    if (th == nullptr) {
+      return;
+    }
+    shutdown = 1;
+    th->join();
+    th = nullptr;
+  }
+
+  // destructor
+  ~processThread() {
+    stop(); // stop thread
+  }
+
+  // the loop which runs in a separate thread and calls fProcess() for each
+  // block in input fifo, until stop() is called
+  void loop() {
+    if (cfgCpuSet.length()) {
+      setThreadCpuSet(cfgCpuSet);
+    }
+    for (; !shutdown;) {
+      bool isActive = 0;
+      // wait there is a slot in output fifo before processing a new block, so
+      // that we are sure we can push the result
+      if (!outputFifo->isFull()) {
+        DataBlockContainerReference bc = nullptr;
+        if (sharedInput != nullptr) {
+          std::unique_lock<std::mutex> lock(*sharedInputMutex);
+          sharedInput->pop(bc);
+        } else {
+          inputFifo->pop(bc);
+        }
+        if (bc != nullptr) {
+          isActive = 1;
+          DataBlockContainerReference result = nullptr;
+          int err = fProcess(bc, result);
+          if (err) {
+            printf("processBlock() failed: error %d\n", err);
+          }
+          if (result) {
+            outputFifo->push(result);
+          }
+        }
+      }
+      if (!isActive) {
+        usleep(cfgIdleSleepTime);
+      }
+    }
+  }
+
+private:
+  std::atomic<int> shutdown; // flag set to 1 to request thread termination
+  std::unique_ptr<std::thread> th;   // the thread
+  unsigned int cfgIdleSleepTime = 0; // idle sleep time (in microseconds), when
+                                     // fifos empty or full, before retrying
+  PtrProcessFunction fProcess = nullptr; // the process function to be used
+  int threadId = 0;                      // id of the thread
+  std::string cfgCpuSet = ""; // when set, CPU affinity of the thread
+  AliceO2::Common::Fifo<DataBlockContainerReference> *sharedInput =
+      nullptr; // when set, input queue shared with the other threads of the
+               // pool, used instead of inputFifo
+  std::mutex *sharedInputMutex = nullptr; // protects access to sharedInput
+};
+
+#endif // #ifndef _PROCESSTHREAD_H
@@ -29,6 +29,33 @@
 #define ERR_OUTPUT_BUFFER_TOO_SMALL -4
 #define ERR_LZ4_FAILED -5
 
+// reusable per-thread compression output buffer, to avoid a malloc/free per
+// data block. Grown as needed, kept for the lifetime of the processing
+// thread.
+namespace {
+struct CompressBuffer {
+  char *ptr = nullptr;
+  int size = 0;
+  ~CompressBuffer() {
+    if (ptr != nullptr) {
+      free(ptr);
+    }
+  }
+  char *get(int sizeNeeded) {
+    if (sizeNeeded > size) {
+      char *newPtr = (char *)realloc(ptr, sizeNeeded);
+      if (newPtr == nullptr) {
+        return nullptr;
+      }
+      ptr = newPtr;
+      size = sizeNeeded;
+    }
+    return ptr;
+  }
+};
+thread_local CompressBuffer compressBuffer;
+} // namespace
+
 extern "C" {
 
 int processBlock(DataBlockContainerReference &input,
@@ -82,12 +109,9 @@ int processBlock(DataBlockContainerReference &input,
   // for LZ4 file formatting
   int outBufferSize = LZ4_compressBound(sizeIn) + lz4FrameFormatBytes;
 
-  char *ptrOut = nullptr; // output buffer
+  char *ptrOut = compressBuffer.get(outBufferSize); // output buffer
   if (ptrOut == nullptr) {
-    ptrOut = (char *)malloc(outBufferSize);
-    if (ptrOut == nullptr) {
-      return ERR_MALLOC;
-    }
+    return ERR_MALLOC;
   }
 
   // compress
@@ -136,9 +160,6 @@ int processBlock(DataBlockContainerReference &input,
   } else {
     err = ERR_LZ4_FAILED;
   }
-  if (ptrOut != nullptr) {
-    free(ptrOut);
-  }
   return err;
 }
 
@@ -0,0 +1,167 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+/*
+  This processor compresses data with the Zstandard algorithm
+  https://facebook.github.io/zstd/
+
+  Each data page is compressed in-place into a standalone zstd frame, which
+  can be decoded with the standard zstd command line tool (provided the same
+  dictionary, if one was used).
+
+  The processBlock() entry point loaded by consumer-processor has no access
+  to the readout configuration, so settings are taken from the environment:
+  - O2_READOUT_ZSTD_LEVEL: compression level. Default 1. Negative values
+    (e.g. -1, -5) trade ratio for extra speed.
+  - O2_READOUT_ZSTD_DICTIONARY: path to a pre-trained dictionary file (as
+    produced by 'zstd --train'), improving the ratio on the repetitive
+    RDH-dense layout of detector data pages. Optional.
+*/
+
+#include <Common/DataBlock.h>
+#include <Common/DataBlockContainer.h>
+#include <Common/DataSet.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+
+#define ERR_SUCCESS 0
+#define ERR_ERROR_UNDEFINED -1
+#define ERR_NULL_INPUT -2
+#define ERR_MALLOC -3
+#define ERR_OUTPUT_BUFFER_TOO_SMALL -4
+#define ERR_ZSTD_FAILED -5
+
+namespace {
+
+// compression settings, loaded once for all threads
+struct ZstdSettings {
+  int level = 1;                // compression level
+  ZSTD_CDict *cdict = nullptr;  // pre-digested dictionary, shared (read-only)
+                                // between the compression contexts
+  ZstdSettings() {
+    const char *v = getenv("O2_READOUT_ZSTD_LEVEL");
+    if (v != nullptr) {
+      level = atoi(v);
+    }
+    const char *dictPath = getenv("O2_READOUT_ZSTD_DICTIONARY");
+    if (dictPath != nullptr) {
+      FILE *fp = fopen(dictPath, "rb");
+      if (fp != nullptr) {
+        fseek(fp, 0, SEEK_END);
+        long dictSize = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (dictSize > 0) {
+          void *dictBuf = malloc(dictSize);
+          if (dictBuf != nullptr) {
+            if (fread(dictBuf, 1, dictSize, fp) == (size_t)dictSize) {
+              cdict = ZSTD_createCDict(dictBuf, dictSize, level);
+            }
+            free(dictBuf);
+          }
+        }
+        fclose(fp);
+      }
+      if (cdict == nullptr) {
+        printf("ProcessorZstdCompress: failed to load dictionary %s\n",
+               dictPath);
+      }
+    }
+  }
+};
+
+ZstdSettings &getSettings() {
+  static ZstdSettings settings; // created on first use, thread-safe
+  return settings;
+}
+
+// per-thread compression context and scratch buffer, reused from one block
+// to the next (context reuse saves the per-call setup cost, the buffer
+// avoids a malloc/free per block)
+struct ZstdContext {
+  ZSTD_CCtx *cctx = nullptr;
+  char *buf = nullptr;
+  size_t bufSize = 0;
+  ~ZstdContext() {
+    if (cctx != nullptr) {
+      ZSTD_freeCCtx(cctx);
+    }
+    if (buf != nullptr) {
+      free(buf);
+    }
+  }
+};
+thread_local ZstdContext zstdContext;
+
+} // namespace
+
+extern "C" {
+
+int processBlock(DataBlockContainerReference &input,
+                 DataBlockContainerReference &output) {
+
+  output = nullptr;
+
+  void *ptrIn = input->getData()->data; // data input
+  if (ptrIn == NULL) {
+    return ERR_NULL_INPUT;
+  }
+  size_t sizeIn = input->getData()->header.dataSize; // input size (bytes)
+
+  ZstdSettings &settings = getSettings();
+  ZstdContext &ctx = zstdContext;
+
+  // lazily create the compression context of this thread
+  if (ctx.cctx == nullptr) {
+    ctx.cctx = ZSTD_createCCtx();
+    if (ctx.cctx == nullptr) {
+      return ERR_MALLOC;
+    }
+    ZSTD_CCtx_setParameter(ctx.cctx, ZSTD_c_compressionLevel, settings.level);
+    if (settings.cdict != nullptr) {
+      ZSTD_CCtx_refCDict(ctx.cctx, settings.cdict);
+    }
+  }
+
+  // make sure the scratch buffer is big enough
+  size_t maxSizeOut = ZSTD_compressBound(sizeIn);
+  if (maxSizeOut > ctx.bufSize) {
+    char *newBuf = (char *)realloc(ctx.buf, maxSizeOut);
+    if (newBuf == nullptr) {
+      return ERR_MALLOC;
+    }
+    ctx.buf = newBuf;
+    ctx.bufSize = maxSizeOut;
+  }
+
+  // compress
+  size_t sizeOut =
+      ZSTD_compress2(ctx.cctx, ctx.buf, maxSizeOut, ptrIn, sizeIn);
+  if (ZSTD_isError(sizeOut)) {
+    return ERR_ZSTD_FAILED;
+  }
+
+  // copy result back in provided page buffer, if it fits
+  int64_t sizeAvailable = (char *)input->getData() +
+                          input->getDataBufferSize() - (char *)ptrIn;
+  if ((int64_t)sizeOut > sizeAvailable) {
+    return ERR_OUTPUT_BUFFER_TOO_SMALL;
+  }
+  memcpy(ptrIn, ctx.buf, sizeOut);
+  output = input;
+  output->getData()->header.dataSize = sizeOut;
+
+  return ERR_SUCCESS;
+}
+
+} // extern "C"
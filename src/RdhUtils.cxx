@@ -89,6 +89,51 @@ int RdhHandle::validateRdh(std::string &err) {
   return retCode;
 }
 
+int scanRdhBlock(void *blockPtr, size_t blockSize,
+                 std::vector<RdhPacketDescriptor> &index, std::string &err) {
+  return scanRdhBlockV<0>(blockPtr, blockSize, index, err);
+}
+
+ScanRdhBlockFunction getScanRdhBlockFunction(int rdhVersion) {
+  switch (rdhVersion) {
+  case 3:
+    return &scanRdhBlockV<3>;
+  case 4:
+    return &scanRdhBlockV<4>;
+  default:
+    return &scanRdhBlockV<0>;
+  }
+}
+
+int writePageLinkIndex(void *payloadPtr,
+                       const std::vector<RdhPacketDescriptor> &index) {
+  PageLinkIndexHeader *h =
+      (PageLinkIndexHeader *)((char *)payloadPtr - PageLinkIndexReservedSpace);
+  if (index.size() > PageLinkIndexMaxEntries) {
+    // index does not fit, mark page as unindexed so that consumers fall back
+    // to their own payload scan
+    h->magic = 0;
+    return -1;
+  }
+  PageLinkIndexEntry *e = (PageLinkIndexEntry *)(h + 1);
+  uint64_t linkMask = 0; // bitmap of link ids seen (linkId <= RdhMaxLinkId,
+                         // checked by scanRdhBlock())
+  for (const auto &p : index) {
+    e->offset = p.offset;
+    e->size = p.size;
+    e->hbOrbit = p.hbOrbit;
+    e->linkId = p.linkId;
+    e->stopBit = p.stopBit;
+    e->pad = 0;
+    linkMask |= ((uint64_t)1 << p.linkId);
+    e++;
+  }
+  h->nEntries = (uint16_t)index.size();
+  h->nLinks = (uint16_t)__builtin_popcountll(linkMask);
+  h->magic = PageLinkIndexMagic;
+  return 0;
+}
+
 RdhBlockHandle::RdhBlockHandle(void *ptr, size_t size)
     : blockPtr(ptr), blockSize(size) {}
 
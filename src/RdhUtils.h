@@ -11,7 +11,10 @@
 // Utilities to handle RDH content from CRU data
 
 #include "RAWDataHeader.h"
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 // Some constants
 const unsigned int RdhMaxLinkId = 31; // maximum ID of a linkId in RDH
@@ -61,6 +64,185 @@ private:
   o2::Header::RAWDataHeader *rdhPtr; // pointer to RDH in memory
 };
 
+// One entry of the packet index produced by scanRdhBlock():
+// describes one RDH+payload packet of a memory block
+struct RdhPacketDescriptor {
+  uint32_t offset;  // offset of packet (RDH) from beginning of block, in bytes
+  uint32_t size;    // total size of packet (RDH + payload), in bytes.
+                    // for a last packet with offsetNextPacket zero, this is
+                    // the number of bytes left to end of block.
+  uint32_t hbOrbit; // heartbeat orbit of packet
+  uint8_t linkId;   // id of link
+  uint8_t stopBit;  // RDH stop bit
+};
+
+// Scan and validate in a single pass a memory block (data page) made of
+// consecutive RDH+payload packets, as otherwise done repeatedly downstream
+// (FMQ subtimeframe splitting, RDH checks, readRaw). Each header is validated
+// (version / header size / link id / offset chain) with flag arithmetic, a
+// single conditional branch per packet, while the next RDH is prefetched, and
+// a compact per-packet index is appended to the provided vector. The vector
+// is not cleared first, so the index of several blocks may be accumulated;
+// caller does clear()/reserve() as appropriate to avoid re-allocation when
+// scanning in a loop.
+// Returns the number of packets appended to the index (>= 0) when the whole
+// block was scanned, or -(number of packets appended + 1) when an invalid
+// header or a broken offset chain stopped the scan (err is then appended with
+// a description, as validateRdh() does).
+int scanRdhBlock(void *blockPtr, size_t blockSize,
+                 std::vector<RdhPacketDescriptor> &index, std::string &err);
+
+// Template version of the scan, to be specialized on the RDH version when it
+// is fixed for the whole run (production conditions): the version check then
+// compiles to a comparison against a constant instead of two dynamic values,
+// and no version branch is left in the per-packet path. rdhVersion = 0
+// accepts versions 3 and 4 (identical layout of the scanned fields), as the
+// plain scanRdhBlock() does.
+template <int rdhVersion>
+inline int scanRdhBlockV(void *blockPtr, size_t blockSize,
+                         std::vector<RdhPacketDescriptor> &index,
+                         std::string &err) {
+  uint8_t *base = (uint8_t *)blockPtr;
+  const size_t rdhSize = sizeof(o2::Header::RAWDataHeader);
+  size_t offset = 0;
+  int nPackets = 0;
+
+  while (offset + rdhSize <= blockSize) {
+    o2::Header::RAWDataHeader *rdh =
+        (o2::Header::RAWDataHeader *)(base + offset);
+    uint32_t version = rdh->version;
+    uint32_t headerSize = rdh->headerSize;
+    uint32_t linkId = rdh->linkId;
+    uint32_t next = rdh->offsetNextPacket;
+
+    // prefetch next header while validating the current one
+    __builtin_prefetch(base + offset + next, 0, 0);
+
+    // accumulate error conditions as flags, single test per packet
+    unsigned int bad = 0;
+    if constexpr (rdhVersion == 0) {
+      bad |= (unsigned int)((version != 3) & (version != 4)); // bit 0: version
+    } else {
+      bad |=
+          (unsigned int)(version != (uint32_t)rdhVersion); // bit 0: version
+    }
+    bad |= ((unsigned int)(headerSize != 64)) << 1;      // bit 1: size
+    bad |= ((unsigned int)(linkId > RdhMaxLinkId)) << 2; // bit 2: link id
+    bad |= ((unsigned int)((next != 0) &
+                           ((next < rdhSize) | (offset + next > blockSize)))
+            << 3); // bit 3: broken offset chain
+    if (bad) {
+      if (bad & 0x1) {
+        err += "Wrong header version\n";
+      }
+      if (bad & 0x2) {
+        err += "Wrong header size\n";
+      }
+      if (bad & 0x4) {
+        err += "Wrong link ID\n";
+      }
+      if (bad & 0x8) {
+        err += "Wrong offset to next packet\n";
+      }
+      return -(nPackets + 1);
+    }
+
+    index.push_back({(uint32_t)offset,
+                     (next != 0) ? next : (uint32_t)(blockSize - offset),
+                     (uint32_t)rdh->heartbeatOrbit, (uint8_t)linkId,
+                     (uint8_t)rdh->stopBit});
+    nPackets++;
+
+    if (next == 0) {
+      // by convention, last packet of the block
+      break;
+    }
+    offset += next;
+  }
+
+  return nPackets;
+}
+
+// scan function pointer, selected once at configure time by
+// getScanRdhBlockFunction() from the RDH version expected for the run
+// (0 = accept v3 / v4 dynamically, as scanRdhBlock() does)
+typedef int (*ScanRdhBlockFunction)(void *, size_t,
+                                    std::vector<RdhPacketDescriptor> &,
+                                    std::string &);
+ScanRdhBlockFunction getScanRdhBlockFunction(int rdhVersion);
+
+// Optional per-link packet index stored in the reserved header space of a
+// data page, immediately before the payload. It is written once by the
+// equipment (from the scanRdhBlock() index, see
+// equipment.pageLinkIndexEnabled), so that downstream consumers can iterate
+// the page content by link / HBF without scanning the payload memory again.
+
+// fixed size (in bytes) of the reserved index area. The equipment grows the
+// page header space by this amount when the feature is enabled.
+const size_t PageLinkIndexReservedSpace = 8192;
+
+// value of PageLinkIndexHeader.magic when a valid index is present
+const uint32_t PageLinkIndexMagic = 0x58494C50; // "PLIX"
+
+// header of the index area
+struct PageLinkIndexHeader {
+  uint32_t magic;    // PageLinkIndexMagic when a valid index follows
+  uint16_t nEntries; // number of PageLinkIndexEntry following this header
+  uint16_t nLinks;   // number of distinct link ids found in the page
+};
+
+// one entry of the index, same content as RdhPacketDescriptor but with a
+// fixed serialized layout (16 bytes)
+struct PageLinkIndexEntry {
+  uint32_t offset;  // offset of packet (RDH) from beginning of payload
+  uint32_t size;    // total size of packet (RDH + payload), in bytes
+  uint32_t hbOrbit; // heartbeat orbit of packet
+  uint8_t linkId;   // id of link
+  uint8_t stopBit;  // RDH stop bit
+  uint16_t pad;     // unused, for alignment
+};
+
+// maximum number of entries fitting in the reserved area. Pages with more
+// packets are left unindexed (magic cleared), consumers then fall back to
+// their own payload scan.
+const size_t PageLinkIndexMaxEntries =
+    (PageLinkIndexReservedSpace - sizeof(PageLinkIndexHeader)) /
+    sizeof(PageLinkIndexEntry);
+
+// Write the index of a page in the reserved area preceeding its payload
+// (payloadPtr), from the descriptors collected by scanRdhBlock(). The caller
+// must ensure the area was actually reserved (see
+// equipment.pageLinkIndexEnabled). When the index does not fit, the magic is
+// cleared instead so the page is seen as unindexed.
+// Returns 0 on success, -1 when the index did not fit.
+int writePageLinkIndex(void *payloadPtr,
+                       const std::vector<RdhPacketDescriptor> &index);
+
+// Get the index of a page, given the address of the page header (the
+// DataBlock object at the beginning of the page) and of its payload.
+// Returns nullptr when the page has no (valid) index: gap between header and
+// payload too small for the reserved area, or magic not set.
+inline const PageLinkIndexHeader *getPageLinkIndex(const void *blockPtr,
+                                                   const void *payloadPtr) {
+  if ((const char *)payloadPtr - (const char *)blockPtr <
+      (ptrdiff_t)PageLinkIndexReservedSpace) {
+    return nullptr;
+  }
+  const PageLinkIndexHeader *h =
+      (const PageLinkIndexHeader *)((const char *)payloadPtr -
+                                    PageLinkIndexReservedSpace);
+  if (h->magic != PageLinkIndexMagic) {
+    return nullptr;
+  }
+  return h;
+}
+
+// Get the entries following an index header returned by getPageLinkIndex()
+inline const PageLinkIndexEntry *
+getPageLinkIndexEntries(const PageLinkIndexHeader *h) {
+  return (const PageLinkIndexEntry *)(h + 1);
+}
+
 // Utility class to access/parse/check the content of a contiguous memory block
 // consisting of RDH+data
 class RdhBlockHandle {
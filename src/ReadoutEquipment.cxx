@@ -8,8 +8,14 @@
 // granted to it by virtue of its status as an Intergovernmental Organization
 // or submit itself to any jurisdiction.
 
+#include "RdhUtils.h"
 #include "ReadoutEquipment.h"
 #include "ReadoutStats.h"
+#include "ReadoutUtils.h"
+
+#ifdef WITH_NUMA
+#include <numa.h>
+#endif
 
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
@@ -44,6 +50,41 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   // | -1 | Data rate limit, per equipment, in Hertz. -1 for unlimited. |
   cfg.getOptionalValue<double>("readout.rate", readoutRate, -1.0);
 
+  // closed-loop throttle parameters
+  // configuration parameter: | equipment-* | throttleEnabled | int | 0 | When
+  // set, the block readout budget is modulated by the free buffer occupancy
+  // (memory pool and output FIFO, c.f. throttleLowWatermark /
+  // throttleHighWatermark). A downstream slowdown then progressively slows
+  // the equipment while the buffers absorb the burst, instead of running
+  // full speed until the pool is empty and stalling hard. |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".throttleEnabled",
+                            cfgThrottleEnabled);
+  // configuration parameter: | equipment-* | throttleLowWatermark | double |
+  // 0.05 | Closed-loop throttle: fraction of free buffer (pool pages / FIFO
+  // slots) below which readout is paused. |
+  cfg.getOptionalValue<double>(cfgEntryPoint + ".throttleLowWatermark",
+                               cfgThrottleLowWatermark);
+  // configuration parameter: | equipment-* | throttleHighWatermark | double |
+  // 0.25 | Closed-loop throttle: fraction of free buffer (pool pages / FIFO
+  // slots) above which readout runs at full speed. Readout rate is scaled
+  // linearly between the two watermarks. |
+  cfg.getOptionalValue<double>(cfgEntryPoint + ".throttleHighWatermark",
+                               cfgThrottleHighWatermark);
+  if (cfgThrottleEnabled) {
+    if ((cfgThrottleLowWatermark < 0) ||
+        (cfgThrottleHighWatermark <= cfgThrottleLowWatermark) ||
+        (cfgThrottleHighWatermark > 1.0)) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Wrong throttle watermarks (low=%.2lf high=%.2lf)",
+                 cfgThrottleLowWatermark, cfgThrottleHighWatermark);
+      throw __LINE__;
+    }
+    theLog.log("Equipment %s: closed-loop throttle enabled, watermarks "
+               "low=%.2lf high=%.2lf",
+               name.c_str(), cfgThrottleLowWatermark,
+               cfgThrottleHighWatermark);
+  }
+
   // idle sleep time, in microseconds.
   // configuration parameter: | equipment-* | idleSleepTime | int | 200 | Thread
   // idle sleep time, in microseconds. |
@@ -65,6 +106,31 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   // |
   cfg.getOptionalValue<std::string>(cfgEntryPoint + ".memoryBankName",
                                     memoryBankName);
+  // configuration parameter: | equipment-* | cpuSet | string | | If set, CPU
+  // affinity of the readout thread. List of CPU ids, given as comma-separated
+  // values or ranges, e.g. "0-3,8". |
+  cfg.getOptionalValue<std::string>(cfgEntryPoint + ".cpuSet", cfgCpuSet);
+  // configuration parameter: | equipment-* | numaNode | int | -1 | NUMA node
+  // of the equipment. If set (>=0), memory bank is preferably taken on this
+  // node (when no bank name specified) and readout thread is bound to it. Use
+  // -2 to detect automatically the node of the PCIe device given by cardId
+  // (e.g. for equipment-rorc). -1 means no NUMA preference. |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".numaNode", cfgNumaNode);
+  if (cfgNumaNode == -2) {
+    // detect NUMA node of PCIe device from sysfs, using cardId from same
+    // config section (when it holds a PCI address)
+    std::string cfgCardId = "";
+    cfg.getOptionalValue<std::string>(cfgEntryPoint + ".cardId", cfgCardId);
+    cfgNumaNode = getPciDeviceNumaNode(cfgCardId);
+    if (cfgNumaNode >= 0) {
+      theLog.log("Equipment %s: detected NUMA node %d for PCI device %s",
+                 name.c_str(), cfgNumaNode, cfgCardId.c_str());
+    } else {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Equipment %s: could not detect NUMA node of PCI device '%s'",
+                 name.c_str(), cfgCardId.c_str());
+    }
+  }
   std::string cfgMemoryPoolPageSize = "";
   // configuration parameter: | equipment-* | memoryPoolPageSize | bytes | |
   // Size of each memory page to be created. Some space might be kept in each
@@ -79,8 +145,17 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
       cfgMemoryPoolPageSize.c_str());
   cfg.getOptionalValue<int>(cfgEntryPoint + ".memoryPoolNumberOfPages",
                             memoryPoolNumberOfPages);
+  // configuration parameter: | equipment-* | memoryPoolElasticPages | int | 0 |
+  // If set, elastic pool mode: the pool may borrow at runtime up to this
+  // number of extra pages from the free space of its memory bank when running
+  // low, and returns them when load drops. This lets total bank memory follow
+  // the actual per-equipment load instead of the static split. Needs
+  // readout.memoryPoolLockFreeEnabled=1. |
+  int cfgMemoryPoolElasticPages = 0;
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".memoryPoolElasticPages",
+                            cfgMemoryPoolElasticPages);
   if (cfgOutputFifoSize == -1) {
-    cfgOutputFifoSize = memoryPoolNumberOfPages;
+    cfgOutputFifoSize = memoryPoolNumberOfPages + cfgMemoryPoolElasticPages;
   }
 
   // disable output?
@@ -116,6 +191,16 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   cfg.getOptionalValue<double>(cfgEntryPoint + ".consoleStatsUpdateTime",
                                cfgConsoleStatsUpdateTime);
 
+  // configuration parameter: | equipment-* | statsPublishInterval | double |
+  // 0.05 | Number of seconds between publications of the performance
+  // counters snapshot read by the monitoring threads (c.f.
+  // getStatsSnapshot()): rates are then computed from coherent counter sets,
+  // instead of counters read one by one while the readout thread updates
+  // them. If zero, snapshots are disabled and readers fall back to direct
+  // counter reads. |
+  cfg.getOptionalValue<double>(cfgEntryPoint + ".statsPublishInterval",
+                               cfgStatsPublishInterval);
+
   // configuration parameter: | equipment-* | stopOnError | int | 0 | If 1,
   // readout will stop automatically on equipment error. |
   int cfgStopOnError = 0;
@@ -133,6 +218,32 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
     this->debugFirstPages = cfgDebugFirstPages;
   }
 
+  // configuration parameter: | equipment-* | pageLinkIndexEnabled | int | 0 |
+  // If set, extra space is reserved at the beginning of each data page to
+  // store a per-link packet index (RDH offsets, sizes, HBF orbits, see
+  // PageLinkIndexHeader in RdhUtils.h), so that downstream consumers can
+  // iterate the page content by link / HBF without scanning the payload
+  // again. The index is filled by the equipments doing an RDH scan of the
+  // pages (currently equipmentRORC, rdhCheckEnabled is then forced on). |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".pageLinkIndexEnabled",
+                            cfgPageLinkIndexEnabled);
+
+  // configuration parameter: | equipment-* | pageTimestampEnabled | int | 0 |
+  // If set, the creation time of each data block is stored in the reserved
+  // header space of its page (see PageTimestampHeader in ReadoutUtils.h), so
+  // that downstream consumers can measure the per-block equipment to consumer
+  // latency (see consumerType=latency). |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".pageTimestampEnabled",
+                            cfgPageTimestampEnabled);
+
+  // configuration parameter: | equipment-* | pageChecksumEnabled | int | 0 |
+  // If set, extra space is reserved in the header of each data page to store
+  // a payload checksum (see PageChecksumHeader in ReadoutUtils.h). The
+  // checksum itself is computed and stamped by the consumers configured to do
+  // so (c.f. consumer-FairMQchannel-* checksumEnabled). |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".pageChecksumEnabled",
+                            cfgPageChecksumEnabled);
+
   // log config summary
   theLog.log("Equipment %s: from config [%s], max rate=%lf Hz, "
              "idleSleepTime=%d us, outputFifoSize=%d",
@@ -152,6 +263,8 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   // init stats
   equipmentStats.resize(EquipmentStatsIndexes::maxIndex);
   equipmentStatsLast.resize(EquipmentStatsIndexes::maxIndex);
+  // batched updates of the global byte counter (c.f. ReadoutStatsBatch)
+  statsBatch.init(&gReadoutStats.bytesReadout);
 
   // creation of memory pool for data pages
   // todo: also allocate pool of DataBlockContainers? at the same time? reserve
@@ -163,6 +276,35 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   pageSpaceReserved = sizeof(
       DataBlock); // reserve some data at beginning of each page for header,
                   // keep beginning of payload aligned as requested in config
+  if (cfgPageTimestampEnabled) {
+    // also reserve room for the block creation timestamp, stored right after
+    // the DataBlock object
+    pageSpaceReserved += PageTimestampReservedSpace;
+    theLog.log("Equipment %s: page timestamp enabled, %d extra bytes "
+               "reserved per page",
+               name.c_str(), (int)PageTimestampReservedSpace);
+  }
+  if (cfgPageChecksumEnabled) {
+    // also reserve room for the payload checksum, stored at a fixed offset
+    // after the timestamp slot: that slot is reserved too (possibly unused)
+    // when not already done above, so that the checksum area is always at the
+    // same place
+    if (!cfgPageTimestampEnabled) {
+      pageSpaceReserved += PageTimestampReservedSpace;
+    }
+    pageSpaceReserved += PageChecksumReservedSpace;
+    theLog.log("Equipment %s: page checksum enabled, %d extra bytes "
+               "reserved per page",
+               name.c_str(), (int)PageChecksumReservedSpace);
+  }
+  if (cfgPageLinkIndexEnabled) {
+    // also reserve room for the per-link packet index, stored between the
+    // DataBlock object and the payload
+    pageSpaceReserved += PageLinkIndexReservedSpace;
+    theLog.log("Equipment %s: page link index enabled, %d extra bytes "
+               "reserved per page",
+               name.c_str(), (int)PageLinkIndexReservedSpace);
+  }
   size_t firstPageOffset = 0; // alignment of 1st page of memory pool
   if (pageSpaceReserved) {
     // auto-align
@@ -177,7 +319,8 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
   try {
     mp = theMemoryBankManager.getPagedPool(
         memoryPoolPageSize, memoryPoolNumberOfPages, memoryBankName,
-        firstPageOffset, cfgBlockAlign);
+        firstPageOffset, cfgBlockAlign, cfgNumaNode,
+        (size_t)cfgMemoryPoolElasticPages, pageSpaceReserved);
   } catch (...) {
   }
   if (mp == nullptr) {
@@ -185,13 +328,47 @@ ReadoutEquipment::ReadoutEquipment(ConfigFile &cfg, std::string cfgEntryPoint) {
                "Failed to create pool of memory pages");
     throw __LINE__;
   }
+
+  // setup elastic pool mode, if configured
+  if (cfgMemoryPoolElasticPages > 0) {
+    // elastic mode pushes borrowed pages from the getPage() side and
+    // collects pages from the releasePage() side, which breaks the
+    // 1 producer + 1 consumer contract of the default pool queue: the
+    // lock-free (MPMC) queue is required
+    extern int MemoryPagesPoolLockFreeEnabled;
+    if (!MemoryPagesPoolLockFreeEnabled) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Equipment %s: memoryPoolElasticPages needs "
+                 "readout.memoryPoolLockFreeEnabled=1",
+                 name.c_str());
+      throw __LINE__;
+    }
+    size_t rangePages = cfgMemoryPoolElasticPages / 4;
+    if (rangePages == 0) {
+      rangePages = 1;
+    }
+    std::string bankName = memoryBankName;
+    mp->setElasticReserve(
+        [bankName](size_t vPageSize, size_t vNumberOfPages) -> void * {
+          return theMemoryBankManager.getPageRange(vPageSize, vNumberOfPages,
+                                                   bankName);
+        },
+        [](void *rangeAddress, size_t vPageSize, size_t vNumberOfPages) {
+          theMemoryBankManager.releasePageRange(rangeAddress, vPageSize,
+                                                vNumberOfPages);
+        },
+        rangePages, memoryPoolNumberOfPages / 4,
+        (memoryPoolNumberOfPages * 3) / 4, cfgMemoryPoolElasticPages);
+    theLog.log("Equipment %s: elastic pool enabled, up to %d extra pages "
+               "borrowed by ranges of %d",
+               name.c_str(), cfgMemoryPoolElasticPages, (int)rangePages);
+  }
   // todo: move page align to MemoryPool class
   assert(pageSpaceReserved == mp->getPageSize() - mp->getDataBlockMaxSize());
 
   // create output fifo
-  dataOut =
-      std::make_shared<AliceO2::Common::Fifo<DataBlockContainerReference>>(
-          cfgOutputFifoSize);
+  dataOut = std::make_shared<BatchedFifo<DataBlockContainerReference>>(
+      cfgOutputFifoSize);
   if (dataOut == nullptr) {
     throw __LINE__;
   }
@@ -224,10 +401,20 @@ void ReadoutEquipment::start() {
     clk.reset(1000000.0 / readoutRate);
   }
   clk0.reset();
+  rateOffsetTime = 0;
+  rateOffsetBlocks = 0;
 
   // reset stats timer
   consoleStatsTimer.reset(cfgConsoleStatsUpdateTime * 1000000);
 
+  // reset snapshot publication, and publish the freshly reset counters so
+  // that monitoring does not read the values of a previous run
+  statsSnapshotLatest = 0;
+  if (cfgStatsPublishInterval > 0) {
+    statsPublishTimer.reset(cfgStatsPublishInterval * 1000000);
+    publishStatsSnapshot();
+  }
+
   readoutThread->start();
 }
 
@@ -242,6 +429,14 @@ void ReadoutEquipment::stop() {
   // block/s\n",nBlocksOut,clk0.getTimer(),nBlocksOut/clk0.getTime());
   readoutThread->join();
 
+  // readout thread stopped: push pending delta to global counter
+  statsBatch.flush();
+
+  // publish a last snapshot, so monitoring reads the final totals
+  if (cfgStatsPublishInterval > 0) {
+    publishStatsSnapshot();
+  }
+
   finalCounters();
 
   for (int i = 0; i < (int)EquipmentStatsIndexes::maxIndex; i++) {
@@ -294,6 +489,36 @@ DataBlockContainerReference ReadoutEquipment::getBlock() {
 Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
   ReadoutEquipment *ptr = static_cast<ReadoutEquipment *>(arg);
 
+  // on first iteration, apply configured placement to readout thread:
+  // CPU set and/or NUMA node binding, so that it runs local to the memory
+  // pool pages and the device doing DMA
+  if (!ptr->numaThreadBindDone) {
+    ptr->numaThreadBindDone = true;
+    if (ptr->cfgCpuSet.length()) {
+      if (setThreadCpuSet(ptr->cfgCpuSet) == 0) {
+        theLog.log("Equipment %s: readout thread bound to CPUs %s",
+                   ptr->name.c_str(), ptr->cfgCpuSet.c_str());
+      } else {
+        theLog.log(InfoLogger::Severity::Warning,
+                   "Equipment %s: failed to set readout thread affinity to %s",
+                   ptr->name.c_str(), ptr->cfgCpuSet.c_str());
+      }
+    }
+    if (ptr->cfgNumaNode >= 0) {
+#ifdef WITH_NUMA
+      if (numa_run_on_node(ptr->cfgNumaNode) == 0) {
+        theLog.log("Equipment %s: readout thread bound to NUMA node %d",
+                   ptr->name.c_str(), ptr->cfgNumaNode);
+      } else {
+        theLog.log(
+            InfoLogger::Severity::Warning,
+            "Equipment %s: failed to bind readout thread to NUMA node %d",
+            ptr->name.c_str(), ptr->cfgNumaNode);
+      }
+#endif
+    }
+  }
+
   // flag to identify if something was done in this iteration
   bool isActive = false;
 
@@ -309,7 +534,9 @@ Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
       uint64_t nBlocksOut =
           ptr->equipmentStats[(int)EquipmentStatsIndexes::nBlocksOut]
               .get(); // number of blocks we have already readout until now
-      maxBlocksToRead = ptr->readoutRate * ptr->clk0.getTime() - nBlocksOut;
+      maxBlocksToRead = ptr->readoutRate *
+                            (ptr->clk0.getTime() - ptr->rateOffsetTime) +
+                        ptr->rateOffsetBlocks - nBlocksOut;
       if ((!ptr->clk.isTimeout()) && (nBlocksOut != 0) &&
           (maxBlocksToRead <= 0)) {
         // target block rate exceeded, wait a bit
@@ -323,22 +550,62 @@ Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
         ptr->dataOut->getNumberOfUsedSlots());
 
     // check status of memory pool
-    {
-      size_t nPagesTotal = 0, nPagesFree = 0, nPagesUsed = 0;
-      if (ptr->getMemoryUsage(nPagesFree, nPagesTotal) == 0) {
-        nPagesUsed = nPagesTotal - nPagesFree;
+    size_t nPagesTotal = 0, nPagesFree = 0, nPagesUsed = 0;
+    if (ptr->getMemoryUsage(nPagesFree, nPagesTotal) == 0) {
+      nPagesUsed = nPagesTotal - nPagesFree;
+    }
+    ptr->equipmentStats[EquipmentStatsIndexes::nPagesUsed].set(nPagesUsed);
+    ptr->equipmentStats[EquipmentStatsIndexes::nPagesFree].set(nPagesFree);
+
+    // closed-loop throttle: scale the block budget of this iteration with
+    // the free buffer ratio, so that a downstream slowdown progressively
+    // slows the equipment while the buffers absorb the burst, instead of
+    // running full speed until the pool is empty and stalling hard
+    if (ptr->cfgThrottleEnabled) {
+      auto occupancyScale = [&](double freeRatio) {
+        if (freeRatio >= ptr->cfgThrottleHighWatermark) {
+          return 1.0;
+        }
+        if (freeRatio <= ptr->cfgThrottleLowWatermark) {
+          return 0.0;
+        }
+        return (freeRatio - ptr->cfgThrottleLowWatermark) /
+               (ptr->cfgThrottleHighWatermark - ptr->cfgThrottleLowWatermark);
+      };
+      double scale = 1.0;
+      if (nPagesTotal) {
+        scale = occupancyScale(nPagesFree * 1.0 / nPagesTotal);
+      }
+      int outFree = ptr->dataOut->getNumberOfFreeSlots();
+      int outUsed = ptr->dataOut->getNumberOfUsedSlots();
+      if (outFree + outUsed) {
+        double outScale = occupancyScale(outFree * 1.0 / (outFree + outUsed));
+        if (outScale < scale) {
+          scale = outScale;
+        }
+      }
+      if (scale < 1.0) {
+        ptr->equipmentStats[EquipmentStatsIndexes::nThrottle].increment();
+        maxBlocksToRead = (int)(maxBlocksToRead * scale);
+        if (maxBlocksToRead <= 0) {
+          // buffers low, pause readout for this iteration
+          break;
+        }
       }
-      ptr->equipmentStats[EquipmentStatsIndexes::nPagesUsed].set(nPagesUsed);
-      ptr->equipmentStats[EquipmentStatsIndexes::nPagesFree].set(nPagesFree);
     }
 
     // try to get new blocks
+    // ready blocks are collected in a batch, pushed to output FIFO with a
+    // single multi-push at the end of the loop
     int nPushedOut = 0;
+    int outputFreeSlots = ptr->dataOut->getNumberOfFreeSlots();
+    ptr->batchOut.clear();
     for (int i = 0; i < maxBlocksToRead; i++) {
 
       // check output FIFO status so that we are sure we can push next block, if
       // any
-      if (ptr->dataOut->isFull()) {
+      if ((!ptr->disableOutput) &&
+          ((int)ptr->batchOut.size() >= outputFreeSlots)) {
         ptr->equipmentStats[EquipmentStatsIndexes::nOutputFull].increment();
         break;
       }
@@ -381,11 +648,38 @@ Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
         ptr->clk.increment();
       }
 
+      // stamp block creation time in the page reserved header space
+      // (c.f. pageTimestampEnabled). The gap check skips blocks not backed
+      // by a page with the extra reserved area.
+      if (ptr->cfgPageTimestampEnabled) {
+        DataBlock *b = nextBlock->getData();
+        if ((char *)b->data - (char *)b >=
+            (ptrdiff_t)(sizeof(DataBlock) + sizeof(PageTimestampHeader))) {
+          PageTimestampHeader *ts =
+              (PageTimestampHeader *)((char *)b + sizeof(DataBlock));
+          ts->pad = 0;
+          ts->timeCreated = PageEventTrace::getTimestamp();
+          ts->magic = PageTimestampMagic;
+        }
+      }
+
+      // clear any stale checksum stamp left by a previous use of this page
+      // (c.f. pageChecksumEnabled): the area is (re)written downstream by the
+      // consumers computing a checksum
+      if (ptr->cfgPageChecksumEnabled) {
+        DataBlock *b = nextBlock->getData();
+        PageChecksumHeader *ck =
+            getPageChecksumArea((char *)b + sizeof(DataBlock), b->data);
+        if (ck != nullptr) {
+          ck->magic = 0;
+        }
+      }
+
       // update stats
       nPushedOut++;
       ptr->equipmentStats[EquipmentStatsIndexes::nBytesOut].increment(
           nextBlock->getData()->header.dataSize);
-      gReadoutStats.bytesReadout += nextBlock->getData()->header.dataSize;
+      ptr->statsBatch.add(nextBlock->getData()->header.dataSize);
       isActive = true;
 
       // print block debug info
@@ -398,10 +692,16 @@ Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
       }
 
       if (!ptr->disableOutput) {
-        // push new page to output fifo
-        ptr->dataOut->push(nextBlock);
+        // add new page to output batch
+        ptr->batchOut.push_back(nextBlock);
       }
     }
+
+    // push batch of new pages to output fifo, with a single synchronization
+    if (ptr->batchOut.size()) {
+      ptr->dataOut->push(ptr->batchOut);
+      ptr->batchOut.clear();
+    }
     ptr->equipmentStats[EquipmentStatsIndexes::nBlocksOut].increment(
         nPushedOut);
 
@@ -446,6 +746,15 @@ Thread::CallbackResult ReadoutEquipment::threadCallback(void *arg) {
       }
     }
 
+    // publish a consistent snapshot of the counters for the monitoring
+    // threads (c.f. getStatsSnapshot())
+    if (ptr->cfgStatsPublishInterval > 0) {
+      if (ptr->statsPublishTimer.isTimeout()) {
+        ptr->publishStatsSnapshot();
+        ptr->statsPublishTimer.increment();
+      }
+    }
+
     break;
   }
 
@@ -472,6 +781,97 @@ int ReadoutEquipment::getMemoryUsage(size_t &numberOfPagesAvailable,
   return 0;
 }
 
+void ReadoutEquipment::publishStatsSnapshot() {
+  // fill the back buffer, then flip the publication counter: the readout
+  // thread never waits for the readers
+  uint64_t next = statsSnapshotLatest.load() + 1;
+  StatsSnapshot &s = statsSnapshots[next & 1];
+  for (int i = 0; i < (int)EquipmentStatsIndexes::maxIndex; i++) {
+    s.values[i] = equipmentStats[i].get();
+    s.counts[i] = equipmentStats[i].getCount();
+  }
+  s.timePublished = PageEventTrace::getTimestamp();
+  statsSnapshotLatest.store(next);
+}
+
+int ReadoutEquipment::readStatsSnapshot(StatsSnapshot &out) {
+  // copy the latest published buffer, retrying when a publication happened
+  // meanwhile (the copy might then mix the two buffers). The writer touches
+  // a given buffer again only two publications later, so a successful
+  // re-check guarantees a coherent copy.
+  for (;;) {
+    uint64_t seq = statsSnapshotLatest.load();
+    if (seq == 0) {
+      return -1;
+    }
+    out = statsSnapshots[seq & 1];
+    if (statsSnapshotLatest.load() == seq) {
+      return 0;
+    }
+  }
+}
+
+int ReadoutEquipment::getStatsSnapshot(std::vector<CounterValue> &values,
+                                       std::vector<CounterValue> &counts,
+                                       uint64_t &timePublished) {
+  StatsSnapshot s;
+  if (readStatsSnapshot(s) != 0) {
+    return -1;
+  }
+  values.assign(s.values, s.values + EquipmentStatsIndexes::maxIndex);
+  counts.assign(s.counts, s.counts + EquipmentStatsIndexes::maxIndex);
+  timePublished = s.timePublished;
+  return 0;
+}
+
+void ReadoutEquipment::getOutputStats(CounterValue &bytesOut,
+                                      CounterValue &blocksOut) {
+  // use the published snapshot when available, so that the two counters are
+  // coherent (taken at the same instant)
+  StatsSnapshot s;
+  if (readStatsSnapshot(s) == 0) {
+    bytesOut = s.values[EquipmentStatsIndexes::nBytesOut];
+    blocksOut = s.values[EquipmentStatsIndexes::nBlocksOut];
+    return;
+  }
+  bytesOut = equipmentStats[EquipmentStatsIndexes::nBytesOut].get();
+  blocksOut = equipmentStats[EquipmentStatsIndexes::nBlocksOut].get();
+}
+
+void ReadoutEquipment::setReadoutRate(double hz) {
+  // rebase the rate budget on current counters, so the equipment does not
+  // burst to compensate the difference accumulated at the previous rate
+  rateOffsetBlocks =
+      equipmentStats[(int)EquipmentStatsIndexes::nBlocksOut].get();
+  rateOffsetTime = clk0.getTime();
+  readoutRate = hz;
+  if (hz > 0) {
+    clk.reset(1000000.0 / hz);
+  }
+}
+
+int ReadoutEquipment::getStatsValue(const std::string &counterName,
+                                    CounterValue &value) {
+  for (int i = 0; i < (int)EquipmentStatsIndexes::maxIndex; i++) {
+    if (counterName == EquipmentStatsNames[i]) {
+      value = equipmentStats[i].get();
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int ReadoutEquipment::getPageTimingPercentiles(double &p50, double &p90,
+                                               double &p99) {
+  p50 = 0;
+  p90 = 0;
+  p99 = 0;
+  if (mp == nullptr) {
+    return -1;
+  }
+  return mp->getPageTimingPercentiles(p50, p90, p99);
+}
+
 void ReadoutEquipment::initCounters(){};
 
 void ReadoutEquipment::finalCounters(){};
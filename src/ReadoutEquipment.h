@@ -17,10 +17,13 @@
 #include <Common/DataBlockContainer.h>
 #include <Common/DataSet.h>
 
+#include <atomic>
 #include <memory>
 
+#include "BatchedFifo.h"
 #include "CounterStats.h"
 #include "MemoryHandler.h"
+#include "ReadoutStats.h"
 
 #include "MemoryBankManager.h"
 
@@ -52,12 +55,62 @@ public:
 
   // protected:
   // todo: give direct access to output FIFO?
-  std::shared_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>> dataOut;
+  // blocks are pushed to / popped from the FIFO in batches, to pay FIFO
+  // synchronization once per iteration instead of once per block
+  std::shared_ptr<BatchedFifo<DataBlockContainerReference>> dataOut;
 
   // get current memory pool usage (available and total)
   int getMemoryUsage(size_t &numberOfPagesAvailable,
                      size_t &numberOfPagesInPool);
 
+  // get cumulated output counters of this equipment (bytes / blocks pushed
+  // out), used e.g. for the exported runtime statistics. Values are taken
+  // from the latest published counters snapshot when available, so that the
+  // two counters are coherent (read at the same instant).
+  void getOutputStats(CounterValue &bytesOut, CounterValue &blocksOut);
+
+  // bulk read of the performance counters, from the latest consistent
+  // snapshot published by the readout thread (c.f.
+  // equipment.statsPublishInterval): current values (c.f.
+  // CounterStats::get()) and update counts (c.f. CounterStats::getCount())
+  // of all counters, in EquipmentStatsIndexes order, all taken at the same
+  // instant. Wait-free for the readout thread: readers retry the copy when a
+  // publication happened meanwhile. Returns 0 on success, with timePublished
+  // set to the snapshot publication time (CLOCK_MONOTONIC, nanoseconds,
+  // c.f. PageEventTrace::getTimestamp()), or -1 when no snapshot was
+  // published yet (snapshots disabled, or equipment not started).
+  int getStatsSnapshot(std::vector<CounterValue> &values,
+                       std::vector<CounterValue> &counts,
+                       uint64_t &timePublished);
+
+  // per-link counters of this equipment, for the equipments maintaining them
+  // (c.f. equipment-rorc-*.linkStatsSampling): estimated cumulated totals,
+  // already scaled for sampling. One entry per link with data is appended to
+  // the provided vector. Default: none.
+  struct LinkStats {
+    int linkId = 0;           // link id
+    CounterValue bytes = 0;   // estimated number of bytes readout
+    CounterValue packets = 0; // estimated number of packets readout
+  };
+  virtual void getLinkStats(std::vector<LinkStats> &) {}
+
+  // change the readout rate limit (in Hz, -1 for unlimited) while running,
+  // e.g. for the benchmark mode rate ramp. The new budget is computed from
+  // current time, so the equipment does not burst to catch up with the
+  // difference accumulated at the previous rate.
+  void setReadoutRate(double hz);
+
+  // get current value of one of the performance counters, by display name
+  // (c.f. EquipmentStatsNames). Returns 0 on success, -1 if no counter with
+  // such name.
+  int getStatsValue(const std::string &counterName, CounterValue &value);
+
+  // get percentiles of the data page lifecycle time (getPage to releasePage,
+  // in microseconds), from the memory pool timing histogram. Returns 0 on
+  // success, -1 when statistics are not available (needs
+  // readout.memoryPoolStatsEnabled).
+  int getPageTimingPercentiles(double &p50, double &p90, double &p99);
+
 private:
   std::unique_ptr<Thread> readoutThread;
   static Thread::CallbackResult threadCallback(void *arg);
@@ -74,6 +127,11 @@ private:
 
   DataBlockId currentBlockId; // current block id
 
+  std::vector<DataBlockContainerReference>
+      batchOut; // blocks ready in current iteration, pushed to dataOut with a
+                // single multi-push operation (vector reused across
+                // iterations to avoid re-allocation)
+
 protected:
   // data enabled ? controlled by setDataOn/setDataOff
   bool isDataOn = false;
@@ -133,6 +191,45 @@ protected:
   std::vector<CounterStats> equipmentStats;
   std::vector<CounterValue> equipmentStatsLast;
 
+  // double-buffered snapshot of the counters above, published periodically
+  // by the readout thread and read by the monitoring threads (c.f.
+  // getStatsSnapshot()). The writer never waits: it fills the back buffer
+  // and flips the publication counter. Readers copy the front buffer and
+  // retry when the counter changed meanwhile.
+  struct StatsSnapshot {
+    CounterValue
+        values[EquipmentStatsIndexes::maxIndex]; // CounterStats::get()
+    CounterValue
+        counts[EquipmentStatsIndexes::maxIndex]; // CounterStats::getCount()
+    uint64_t timePublished = 0; // publication time (CLOCK_MONOTONIC, ns)
+  };
+  StatsSnapshot statsSnapshots[2]; // the two buffers, used alternately
+  std::atomic<uint64_t> statsSnapshotLatest = {
+      0}; // publication counter: zero when no snapshot was published yet,
+          // otherwise the latest one is statsSnapshots[statsSnapshotLatest
+          // & 1]
+
+  // publish a new snapshot of the counters. Single writer: the readout
+  // thread, or the control thread while the readout thread is not running
+  // (start / stop).
+  void publishStatsSnapshot();
+
+  // copy the latest published snapshot. Returns 0 on success, -1 when none
+  // was published yet.
+  int readStatsSnapshot(StatsSnapshot &out);
+
+  double cfgStatsPublishInterval =
+      0.05; // number of seconds between publications of the counters
+            // snapshot (if zero, snapshots are disabled and readers fall
+            // back to direct counter reads)
+  AliceO2::Common::Timer
+      statsPublishTimer; // timer to keep track of elapsed time between
+                         // counter snapshot publications
+
+  ReadoutStatsBatch
+      statsBatch; // local accumulator for the global bytesReadout counter,
+                  // updated from the readout thread and flushed on stop()
+
   double cfgConsoleStatsUpdateTime =
       0; // number of seconds between regular printing of statistics on console
          // (if zero, only on stop)
@@ -144,6 +241,17 @@ protected:
   AliceO2::Common::Timer clk0;
 
   double readoutRate;
+  // baseline for the rate limit budget, reset by setReadoutRate() so that
+  // rate changes take effect from current time
+  double rateOffsetTime = 0;
+  CounterValue rateOffsetBlocks = 0;
+
+  // closed-loop throttle: when enabled, the per-iteration block budget is
+  // scaled with the free buffer ratio (memory pool pages and output FIFO
+  // slots), linearly between the two watermarks
+  int cfgThrottleEnabled = 0;
+  double cfgThrottleLowWatermark = 0.05;  // free ratio: pause readout below
+  double cfgThrottleHighWatermark = 0.25; // free ratio: full speed above
   std::string name; // name of the equipment
 
   uint16_t id = undefinedEquipmentId; // id of equipment (optional, used to tag
@@ -156,6 +264,17 @@ protected:
   std::string memoryBankName = ""; // memory bank to be used. by default, this
                                    // uses the first memory bank available
 
+  std::string cfgCpuSet = ""; // when set, CPU affinity of the readout thread
+                              // (list of CPU ids, e.g. "0-3,8"), so the
+                              // pipeline can be pinned to an isolated core set
+
+  int cfgNumaNode = -1; // NUMA node of this equipment. When set, memory bank
+                        // is preferably taken on this node (if no bank name
+                        // specified) and the readout thread is bound to it,
+                        // so that data pages, DMA and readout stay node-local.
+  bool numaThreadBindDone = false; // flag set once readout thread bound to
+                                   // configured NUMA node
+
   int disableOutput =
       0; // when set true, data are dropped before pushing to output queue
 
@@ -163,6 +282,22 @@ protected:
       0; // amount of space reserved (in bytes) at beginning of each data page,
          // possibly to store header
 
+  int cfgPageLinkIndexEnabled =
+      0; // when set, extra page header space is reserved to store a per-link
+         // packet index (c.f. PageLinkIndexHeader in RdhUtils.h), filled by
+         // the equipments doing an RDH scan of the pages
+
+  int cfgPageTimestampEnabled =
+      0; // when set, extra page header space is reserved to store the block
+         // creation time (c.f. PageTimestampHeader in ReadoutUtils.h), for
+         // downstream latency measurements (consumerType=latency)
+
+  int cfgPageChecksumEnabled =
+      0; // when set, extra page header space is reserved to store a payload
+         // checksum (c.f. PageChecksumHeader in ReadoutUtils.h), stamped by
+         // the consumers computing one (c.f. consumer-FairMQchannel-*
+         // checksumEnabled)
+
   int debugFirstPages = 0; // print debug info on first number of pages read
 };
 
@@ -176,3 +311,5 @@ std::unique_ptr<ReadoutEquipment>
 getReadoutEquipmentPlayer(ConfigFile &cfg, std::string cfgEntryPoint);
 std::unique_ptr<ReadoutEquipment>
 getReadoutEquipmentZmq(ConfigFile &cfg, std::string cfgEntryPoint);
+std::unique_ptr<ReadoutEquipment>
+getReadoutEquipmentShmRing(ConfigFile &cfg, std::string cfgEntryPoint);
@@ -18,7 +18,10 @@ extern InfoLogger theLog;
 #include "RAWDataHeader.h"
 #include <Common/Fifo.h>
 #include <Common/Timer.h>
+#include <atomic>
+#include <mutex>
 #include <stdlib.h>
+#include <thread>
 
 class ReadoutEquipmentCruEmulator : public ReadoutEquipment {
 
@@ -35,8 +38,6 @@ private:
 
   Thread::CallbackResult populateFifoOut(); // iterative callback
 
-  uint64_t currentTimeframeId; // current timeframe id
-
   int cfgNumberOfLinks; // number of links to simulate. Will create data blocks
                         // round-robin.
   int cfgFeeId;         // FEE id to be used
@@ -72,16 +73,44 @@ private:
     int isEmpty = 0;
     int payloadBytesLeft = -1;
   };
-  std::map<int, linkState> perLinkState;
-
-  uint32_t LHCorbit = 0; // current LHC orbit
-  uint32_t LHCbc = 0;    // current LHC bunch crossing
+  std::map<int, linkState> perLinkState; // pre-populated for all links in
+                                         // constructor (no insertion on data
+                                         // path, safe for concurrent access
+                                         // to disjoint links)
 
   Timer elapsedTime; // elapsed time since equipment started
-  double t0 = 0;     // time of first block generated
+
+  // orbit/BC sequencer state, servicing a subset of the links.
+  // there is one instance per generator thread (disjoint link subsets), or a
+  // single instance for all links when the thread pool is disabled.
+  struct GeneratorState {
+    uint32_t orbit = 0; // current LHC orbit
+    uint32_t bc = 0;    // current LHC bunch crossing
+    uint64_t tfId = 1;  // current timeframe id
+    double t0 = 0;      // time of first block generated
+    std::vector<int> linkIndexes; // indexes of links serviced
+  };
+  GeneratorState mainGenerator; // sequencer used when thread pool disabled
+  std::vector<std::unique_ptr<GeneratorState>>
+      generators;                          // per-thread sequencers
+  std::vector<std::thread> generatorThreads; // the generator thread pool
+  std::atomic<int> generatorThreadsShutdown{
+      0}; // flag set to 1 to request generator threads termination
+  int cfgGeneratorThreads = 0; // number of generator threads (0 = disabled,
+                               // pages generated by the readout thread)
+
+  // create a set of data pages (one per link serviced by given sequencer)
+  // and push them to the ready queue
+  Thread::CallbackResult generateSet(GeneratorState &gs);
+
+  void generatorLoop(GeneratorState *gs); // generator thread loop
 
   std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>>
       readyBlocks; // pages ready to be retrieved by getNextBlock()
+  std::mutex generatorMutex; // serializes the generator threads on the shared
+                             // structures supporting a single thread per
+                             // side: memory pool page allocation, and the
+                             // producer side of readyBlocks
   std::vector<DataBlockContainerReference>
       pendingBlocks; // pages being filled (1 per link)
 };
@@ -124,22 +153,41 @@ ReadoutEquipmentCruEmulator::ReadoutEquipmentCruEmulator(
   cfg.getOptionalValue<double>(cfgEntryPoint + ".EmptyHbRatio",
                                cfgEmptyHbRatio);
   cfg.getOptionalValue<int>(cfgEntryPoint + ".PayloadSize", cfgPayloadSize);
+  // configuration parameter: | equipment-cruemulator-* | generatorThreads |
+  // int | 0 | If set, number of threads generating data pages in parallel
+  // (links are partitioned round-robin between threads, each thread keeping
+  // its own orbit/BC sequencer). If 0, pages are generated by the readout
+  // thread. |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".generatorThreads",
+                            cfgGeneratorThreads);
 
   // log config summary
   theLog.log("Equipment %s: maxBlocksPerPage=%d cruBlockSize=%d "
              "numberOfLinks=%d feeId=%d linkId=%d TFperiod=%d HBperiod=%d "
-             "EmptyHbRatio=%f PayloadSize=%d",
+             "EmptyHbRatio=%f PayloadSize=%d generatorThreads=%d",
              name.c_str(), cfgMaxBlocksPerPage, cruBlockSize, cfgNumberOfLinks,
              cfgFeeId, cfgLinkId, cfgTFperiod, cfgHBperiod, cfgEmptyHbRatio,
-             cfgPayloadSize);
+             cfgPayloadSize, cfgGeneratorThreads);
 
   // initialize array of pending blocks (to be filled with data)
   pendingBlocks.resize(cfgNumberOfLinks);
 
+  // pre-populate per-link states, so that no map insertion occurs on the
+  // data path
+  for (int i = 0; i < cfgNumberOfLinks; i++) {
+    perLinkState[cfgLinkId + i];
+  }
+
   // output queue: 1 block per link
+  // (some more room in threaded mode, to decouple generators from the
+  // readout thread)
+  int readyBlocksSize = cfgNumberOfLinks;
+  if (cfgGeneratorThreads > 0) {
+    readyBlocksSize = cfgNumberOfLinks * 2;
+  }
   readyBlocks =
       std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
-          cfgNumberOfLinks);
+          readyBlocksSize);
   if (readyBlocks == nullptr) {
     throw __LINE__;
   }
@@ -149,39 +197,95 @@ ReadoutEquipmentCruEmulator::ReadoutEquipmentCruEmulator(
                  ((cruBlockSize - sizeof(o2::Header::RAWDataHeader)) * 1.0 /
                   (cfgGbtLinkThroughput * 1024 * 1024 * 1024 / 8)));
   theLog.log("Equipment %s: using block rate = %d BC", name.c_str(), bcStep);
+
+  // distribute links between sequencers and start generator thread pool
+  if (cfgGeneratorThreads > 0) {
+    if (cfgGeneratorThreads > cfgNumberOfLinks) {
+      cfgGeneratorThreads = cfgNumberOfLinks;
+    }
+    for (int t = 0; t < cfgGeneratorThreads; t++) {
+      generators.push_back(std::make_unique<GeneratorState>());
+    }
+    for (int i = 0; i < cfgNumberOfLinks; i++) {
+      generators[i % cfgGeneratorThreads]->linkIndexes.push_back(i);
+    }
+    generatorThreadsShutdown = 0;
+    for (int t = 0; t < cfgGeneratorThreads; t++) {
+      generatorThreads.push_back(
+          std::thread(&ReadoutEquipmentCruEmulator::generatorLoop, this,
+                      generators[t].get()));
+    }
+  } else {
+    for (int i = 0; i < cfgNumberOfLinks; i++) {
+      mainGenerator.linkIndexes.push_back(i);
+    }
+  }
 }
 
-ReadoutEquipmentCruEmulator::~ReadoutEquipmentCruEmulator() {}
+ReadoutEquipmentCruEmulator::~ReadoutEquipmentCruEmulator() {
+  // stop generator threads
+  generatorThreadsShutdown = 1;
+  for (auto &t : generatorThreads) {
+    t.join();
+  }
+}
 
 Thread::CallbackResult ReadoutEquipmentCruEmulator::prepareBlocks() {
+  if (cfgGeneratorThreads > 0) {
+    // data pages are generated by the generator thread pool
+    return Thread::CallbackResult::Idle;
+  }
+  return generateSet(mainGenerator);
+}
+
+void ReadoutEquipmentCruEmulator::generatorLoop(GeneratorState *gs) {
+  for (; !generatorThreadsShutdown.load();) {
+    Thread::CallbackResult r = Thread::CallbackResult::Idle;
+    if (isDataOn) {
+      r = generateSet(*gs);
+    }
+    if (r != Thread::CallbackResult::Ok) {
+      // idle sleep, kept short to sustain high page rates
+      usleep(100);
+    }
+  }
+}
 
-  // cru emulator creates a set of data pages for each link and put them in the
-  // fifo to be retrieve by getNextBlock
+Thread::CallbackResult
+ReadoutEquipmentCruEmulator::generateSet(GeneratorState &gs) {
+
+  // cru emulator creates a set of data pages for each link serviced by this
+  // sequencer and put them in the fifo to be retrieve by getNextBlock
 
   // check that we don't go faster than LHC...
   double t = elapsedTime.getTime();
-  if (t0 == 0) {
-    t0 = t;
+  if (gs.t0 == 0) {
+    gs.t0 = t;
   }
-  if (LHCorbit > (uint32_t)((t - t0) * LHCOrbitRate)) {
+  if (gs.orbit > (uint32_t)((t - gs.t0) * LHCOrbitRate)) {
     return Thread::CallbackResult::Idle;
   }
 
   // todo: check that we don't go tooooo slow !!!
 
   // wait enough space available in output fifo to to prepare a new set
-  if (readyBlocks->getNumberOfFreeSlots() < cfgNumberOfLinks) {
+  // (approximate when several generator threads run: overflows are handled
+  // at push time)
+  if (readyBlocks->getNumberOfFreeSlots() < (int)gs.linkIndexes.size()) {
     return Thread::CallbackResult::Idle;
   }
 
   // get a set of new blocks from memory pool (1 per link)
-  for (int i = 0; i < cfgNumberOfLinks; i++) {
+  for (int i : gs.linkIndexes) {
     if (pendingBlocks[i] != nullptr) {
       continue;
     }
     // query memory pool for a free block
+    // (pool page allocation supports a single thread: generator threads
+    // serialize on a mutex)
     DataBlockContainerReference nextBlock = nullptr;
     try {
+      std::unique_lock<std::mutex> lock(generatorMutex);
       nextBlock = mp->getNewDataBlockContainer();
     } catch (...) {
     }
@@ -199,10 +303,10 @@ Thread::CallbackResult ReadoutEquipmentCruEmulator::prepareBlocks() {
 
   o2::Header::RAWDataHeader defaultRDH; // a default RDH
 
-  unsigned int nowOrbit = LHCorbit;
-  unsigned int nowBc = LHCbc;
+  unsigned int nowOrbit = gs.orbit;
+  unsigned int nowBc = gs.bc;
 
-  for (int currentLink = 0; currentLink < cfgNumberOfLinks; currentLink++) {
+  for (int currentLink : gs.linkIndexes) {
 
     // fill the new data page for this link
     DataBlock *b = pendingBlocks[currentLink]->getData();
@@ -212,9 +316,9 @@ Thread::CallbackResult ReadoutEquipmentCruEmulator::prepareBlocks() {
     int offset; // number of bytes used in page
     int nBlocksInPage = 0;
 
-    nowOrbit = LHCorbit;
-    nowBc = LHCbc;
-    uint64_t nowId = currentTimeframeId;
+    nowOrbit = gs.orbit;
+    nowBc = gs.bc;
+    uint64_t nowId = gs.tfId;
 
     int linkId = cfgLinkId + currentLink;
     int bytesAvailableInPage =
@@ -325,12 +429,29 @@ Thread::CallbackResult ReadoutEquipmentCruEmulator::prepareBlocks() {
     b->header.timeframeId = nowId;
     b->header.linkId = linkId;
 
-    readyBlocks->push(pendingBlocks[currentLink]);
+    // push the filled page (single-producer FIFO: generator threads
+    // serialize on the mutex). The free-slot check done before filling is
+    // approximate with several generator threads, so a transiently full
+    // queue is waited out instead of dropping the page.
+    for (;;) {
+      int pushError;
+      {
+        std::unique_lock<std::mutex> lock(generatorMutex);
+        pushError = readyBlocks->push(pendingBlocks[currentLink]);
+      }
+      if (!pushError) {
+        break;
+      }
+      if (generatorThreadsShutdown.load()) {
+        break;
+      }
+      usleep(100);
+    }
     pendingBlocks[currentLink] = nullptr;
   }
-  LHCorbit = nowOrbit;
-  LHCbc = nowBc;
-  currentTimeframeId = 1 + LHCorbit / cfgTFperiod; // timeframe ID
+  gs.orbit = nowOrbit;
+  gs.bc = nowBc;
+  gs.tfId = 1 + gs.orbit / cfgTFperiod; // timeframe ID
 
   return Thread::CallbackResult::Ok;
 }
@@ -344,8 +465,6 @@ DataBlockContainerReference ReadoutEquipmentCruEmulator::getNextBlock() {
 
 void ReadoutEquipmentCruEmulator::initCounters() {
   // init variables
-  currentTimeframeId = 1; // TFid starts on 1
-
   for (auto &b : pendingBlocks) {
     b = nullptr;
   }
@@ -353,10 +472,18 @@ void ReadoutEquipmentCruEmulator::initCounters() {
   readyBlocks->clear();
 
   elapsedTime.reset();
-  t0 = 0;
 
-  LHCorbit = 0;
-  LHCbc = 0;
+  // reset sequencers (TFid starts on 1)
+  auto resetGenerator = [](GeneratorState &gs) {
+    gs.orbit = 0;
+    gs.bc = 0;
+    gs.tfId = 1;
+    gs.t0 = 0;
+  };
+  resetGenerator(mainGenerator);
+  for (auto &gs : generators) {
+    resetGenerator(*gs);
+  }
 
   for (auto &ls : perLinkState) {
     ls.second.HBpagecount = 0;
@@ -13,6 +13,8 @@
 #include "ReadoutEquipment.h"
 #include "ReadoutUtils.h"
 #include <string>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
@@ -33,11 +35,34 @@ private:
 
   std::string filePath = "";        // path to data file
   size_t fileSize = 0;              // data file size
-  std::unique_ptr<char[]> fileData; // copy of file content
+  std::unique_ptr<char[]> fileData; // copy of file content (useMmap=0)
+  void *fileMapping =
+      nullptr; // read-only memory mapping of file (useMmap mode)
+  char *fileDataPtr = nullptr; // pointer to file content (buffer or mapping)
 
   int preLoad;   // if set, data preloaded in the memory pool
   int fillPage;  // if set, page is filled multiple time
   int autoChunk; // if set, page boundary extracted from RDH info
+  int useMmap;   // if set, file is mmap'd read-only instead of being loaded
+                 // in a private buffer. 2 = also pre-fault (MAP_POPULATE).
+  int chunkIndexEnabled; // if set (with autoChunk), page boundaries are
+                         // precomputed once at startup, replay is driven by
+                         // indexed copies without run-time RDH parsing
+
+  // a precomputed data page boundary, as stored in the chunk index
+  struct ChunkIndexEntry {
+    uint64_t fileOffset;  // chunk position in file
+    uint32_t dataSize;    // chunk size (bytes)
+    uint64_t timeframeId; // timeframe id of chunk
+    int linkId;           // link id of chunk
+    int equipmentId;      // CRU id of chunk
+    uint32_t hbOrbit;     // HB orbit of first packet of chunk
+  };
+  std::vector<ChunkIndexEntry> chunkIndex; // page boundaries (autoChunk mode
+                                           // with chunkIndexEnabled)
+  size_t chunkIndexNext = 0; // index of next chunk to be replayed
+
+  void buildChunkIndex(); // scan file once and populate chunkIndex
 
   size_t bytesPerPage = 0;      // number of bytes per data page
   FILE *fp = nullptr;           // file handle
@@ -48,9 +73,25 @@ private:
     uint64_t timeframeId = 0;
     int linkId = undefinedLinkId;
     int equipmentId = undefinedEquipmentId; // used to store CRU id
+    uint32_t hbOrbit = 0;                   // HB orbit of packet
   };
   PacketHeader lastPacketHeader; // keep track of last packet header
 
+  // paced replay (c.f. pacedReplayEnabled): pages are released following the
+  // original orbit timing found in the RDHs, scaled by pacedReplaySpeed
+  int pacedReplayEnabled = 0;    // if set, replay paced on RDH orbit timing
+  double pacedReplaySpeed = 1.0; // speed factor (1 = original beam timing)
+  const double pacedReplaySpinTime =
+      0.0001; // busy-wait window (seconds) before each page deadline
+  const unsigned int LHCOrbitRate =
+      11246;                        // LHC orbit rate, in Hz. 299792458 / 26659
+  bool pacedReplayStarted = false;  // set when first page released
+  uint32_t pacedReplayFirstOrbit = 0; // orbit of first page released
+  AliceO2::Common::Timer replayClock; // time elapsed since first page released
+
+  // wait until the page starting at given orbit is due
+  void paceReplay(uint32_t hbOrbit);
+
   uint32_t timeframePeriodOrbits =
       256; // timeframe interval duration in number of LHC orbits
   uint32_t firstTimeframeHbOrbitBegin =
@@ -63,7 +104,7 @@ private:
 void ReadoutEquipmentPlayer::copyFileDataToPage(void *page) {
   if (page == nullptr)
     return;
-  if (fileData == nullptr)
+  if (fileDataPtr == nullptr)
     return;
   if (fileSize == 0)
     return;
@@ -73,7 +114,7 @@ void ReadoutEquipmentPlayer::copyFileDataToPage(void *page) {
   }
   char *ptr = (char *)page;
   for (int i = 0; i < nCopy; i++) {
-    memcpy(ptr, fileData.get(), fileSize);
+    memcpy(ptr, fileDataPtr, fileSize);
     ptr += fileSize;
   }
 }
@@ -108,17 +149,56 @@ ReadoutEquipmentPlayer::ReadoutEquipmentPlayer(ConfigFile &cfg,
   // compatible with memory bank settings and RDH information.
   // In this mode the preLoad and fillPage options have no effect. |
   cfg.getOptionalValue<int>(cfgEntryPoint + ".autoChunk", autoChunk, 0);
+  // configuration parameter: | equipment-player-* | useMmap | int | 0 | If 1,
+  // the file is memory-mapped read-only instead of being loaded in a private
+  // buffer, and data pages are filled directly from the mapping. This allows
+  // near-instant startup and replay of files larger than RAM. If 2, the
+  // mapping is also pre-faulted at startup (MAP_POPULATE). |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".useMmap", useMmap, 0);
+  // configuration parameter: | equipment-player-* | chunkIndexEnabled | int |
+  // 0 | If set (with autoChunk), the file is scanned once at startup to build
+  // an index of data page boundaries (file offset, length, ids). Replay is
+  // then driven by indexed copies, without run-time RDH parsing, to reach
+  // higher page rates. |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".chunkIndexEnabled",
+                            chunkIndexEnabled, 0);
   // configuration parameter: | equipment-player-* | TFperiod | int | 256 |
   // Duration of a timeframe, in number of LHC orbits. |
   int cfgTFperiod = 256;
   cfg.getOptionalValue<int>(name + ".TFperiod", cfgTFperiod);
   timeframePeriodOrbits = cfgTFperiod;
 
+  // configuration parameter: | equipment-player-* | pacedReplayEnabled | int
+  // | 0 | If set (requires autoChunk), pages are released following the
+  // original orbit timing found in the RDHs instead of as fast as possible:
+  // each page is due at the time of its first HB orbit relative to the first
+  // page, scaled by pacedReplaySpeed. Reproduces the bursty timing of real
+  // beam data (buffer occupancy dynamics included), e.g. to validate pool
+  // sizing and aggregator timeouts. Timing accuracy by coarse sleep plus
+  // short busy-wait before each page deadline. |
+  cfg.getOptionalValue<int>(name + ".pacedReplayEnabled", pacedReplayEnabled);
+  // configuration parameter: | equipment-player-* | pacedReplaySpeed | double
+  // | 1.0 | With pacedReplayEnabled, replay speed factor: 1 = original beam
+  // timing, 2 = twice as fast, 0.5 = half speed. |
+  cfg.getOptionalValue<double>(name + ".pacedReplaySpeed", pacedReplaySpeed);
+  if (pacedReplayEnabled) {
+    if (!autoChunk) {
+      errorHandler(
+          std::string("pacedReplayEnabled requires autoChunk=1 (replay "
+                      "timing is taken from the RDHs)"));
+    }
+    if (pacedReplaySpeed <= 0) {
+      errorHandler(std::string("wrong value for pacedReplaySpeed"));
+    }
+    theLog.log("Equipment %s: paced replay enabled, speed factor %.2f",
+               name.c_str(), pacedReplaySpeed);
+  }
+
   // log config summary
   theLog.log("Equipment %s: using data source file=%s preLoad=%d fillPage=%d "
-             "autoChunk=%d TFperiod=%d",
+             "autoChunk=%d useMmap=%d TFperiod=%d",
              name.c_str(), filePath.c_str(), preLoad, fillPage, autoChunk,
-             timeframePeriodOrbits);
+             useMmap, timeframePeriodOrbits);
 
   // open data file
   fp = fopen(filePath.c_str(), "rb");
@@ -140,6 +220,27 @@ ReadoutEquipmentPlayer::ReadoutEquipmentPlayer(ConfigFile &cfg,
   }
   fileSize = (size_t)fs;
 
+  // map the file in memory, if configured to do so
+  if (useMmap) {
+    int mmapFlags = MAP_PRIVATE;
+    if (useMmap == 2) {
+      mmapFlags |= MAP_POPULATE; // pre-fault whole mapping now
+    }
+    fileMapping = mmap(nullptr, fileSize, PROT_READ, mmapFlags, fileno(fp), 0);
+    if (fileMapping == MAP_FAILED) {
+      fileMapping = nullptr;
+      errorHandler(std::string("mmap failed: ") + strerror(errno));
+    }
+    // file will be read from beginning to end, possibly several times
+    if (madvise(fileMapping, fileSize, MADV_SEQUENTIAL)) {
+      theLog.log(InfoLogger::Severity::Warning, "madvise failed: %s",
+                 strerror(errno));
+    }
+    fileDataPtr = (char *)fileMapping;
+    theLog.log("File mapped read-only @ %p (%lu bytes)", fileMapping,
+               (unsigned long)fileSize);
+  }
+
   // reset counters
   initCounters();
 
@@ -147,6 +248,9 @@ ReadoutEquipmentPlayer::ReadoutEquipmentPlayer(ConfigFile &cfg,
     bytesPerPage = mp->getDataBlockMaxSize();
     theLog.log("Will load file = %lu bytes in chunks of maximum %lu bytes",
                (unsigned long)fileSize, (unsigned long)bytesPerPage);
+    if (chunkIndexEnabled) {
+      buildChunkIndex();
+    }
     return;
   }
 
@@ -160,16 +264,20 @@ ReadoutEquipmentPlayer::ReadoutEquipmentPlayer(ConfigFile &cfg,
                  std::string(" bytes"));
   }
 
-  // allocate a buffer
-  fileData = std::make_unique<char[]>(fileSize);
-  if (fileData == nullptr) {
-    errorHandler(std::string("memory allocation failure"));
-  }
+  if (!useMmap) {
+    // allocate a buffer
+    fileData = std::make_unique<char[]>(fileSize);
+    if (fileData == nullptr) {
+      errorHandler(std::string("memory allocation failure"));
+    }
 
-  // load file
-  if (fread(fileData.get(), fileSize, 1, fp) != 1) {
-    errorHandler(std::string("Failed to load file"));
-  };
+    // load file
+    if (fread(fileData.get(), fileSize, 1, fp) != 1) {
+      errorHandler(std::string("Failed to load file"));
+    };
+    fileDataPtr = fileData.get();
+  }
+  // mapping (if any) survives closing the file
   fclose(fp);
   fp = nullptr;
   fpOk = false;
@@ -200,10 +308,160 @@ ReadoutEquipmentPlayer::ReadoutEquipmentPlayer(ConfigFile &cfg,
   }
 }
 
+void ReadoutEquipmentPlayer::buildChunkIndex() {
+  // scan the file once, applying the same page boundary rules as the
+  // run-time autoChunk parsing (link/CRU/TF change, or page full), and
+  // record the resulting chunks. On scan error, the index is dropped and
+  // replay falls back to run-time parsing.
+
+  chunkIndex.clear();
+
+  // get access to file content: use permanent mapping when available,
+  // otherwise map the file temporarily for the scan
+  char *data = fileDataPtr;
+  void *scanMapping = nullptr;
+  if (data == nullptr) {
+    scanMapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (scanMapping == MAP_FAILED) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Can not map file for scan (%s), chunk index disabled",
+                 strerror(errno));
+      return;
+    }
+    madvise(scanMapping, fileSize, MADV_SEQUENTIAL);
+    data = (char *)scanMapping;
+  }
+
+  bool scanOk = true;
+  bool isFirst = true;
+  size_t chunkStart = 0; // offset of beginning of current chunk
+  PacketHeader chunkHeader; // header of first packet in current chunk
+  size_t offset = 0;
+
+  for (; offset < fileSize;) {
+    if (offset + sizeof(o2::Header::RAWDataHeader) > fileSize) {
+      theLog.log(InfoLogger::Severity::Warning,
+                 "Chunk index: truncated RDH @ 0x%lX, ignoring end of file",
+                 (unsigned long)offset);
+      break;
+    }
+    RdhHandle h(((uint8_t *)data) + offset);
+    std::string errorDescription;
+    if (h.validateRdh(errorDescription)) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Chunk index: RDH error @ 0x%lX: %s", (unsigned long)offset,
+                 errorDescription.c_str());
+      scanOk = false;
+      break;
+    }
+
+    PacketHeader currentPacketHeader;
+    currentPacketHeader.linkId = (int)h.getLinkId();
+    currentPacketHeader.equipmentId = (int)h.getCruId();
+    int hbOrbit = h.getHbOrbit();
+    currentPacketHeader.hbOrbit = (uint32_t)hbOrbit;
+    if (isFirst) {
+      firstTimeframeHbOrbitBegin = hbOrbit;
+    }
+    currentPacketHeader.timeframeId =
+        1 + (hbOrbit - firstTimeframeHbOrbitBegin) / timeframePeriodOrbits;
+
+    uint16_t offsetNextPacket = h.getOffsetNextPacket();
+    if (offsetNextPacket == 0) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Chunk index: invalid packet size @ 0x%lX",
+                 (unsigned long)offset);
+      scanOk = false;
+      break;
+    }
+    if (offsetNextPacket > bytesPerPage) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Chunk index: packet @ 0x%lX does not fit in a data page",
+                 (unsigned long)offset);
+      scanOk = false;
+      break;
+    }
+
+    // changing link/cruid or TF, or page full -> change page
+    bool changePage = 0;
+    if (!isFirst) {
+      if ((currentPacketHeader.linkId != chunkHeader.linkId) ||
+          (currentPacketHeader.equipmentId != chunkHeader.equipmentId) ||
+          (currentPacketHeader.timeframeId != chunkHeader.timeframeId)) {
+        changePage = 1;
+      } else if (offset + offsetNextPacket - chunkStart > bytesPerPage) {
+        changePage = 1;
+      }
+    }
+    if (changePage) {
+      chunkIndex.push_back({(uint64_t)chunkStart,
+                            (uint32_t)(offset - chunkStart),
+                            chunkHeader.timeframeId, chunkHeader.linkId,
+                            chunkHeader.equipmentId, chunkHeader.hbOrbit});
+      chunkStart = offset;
+      chunkHeader = currentPacketHeader;
+    }
+    if (isFirst) {
+      chunkHeader = currentPacketHeader;
+      isFirst = false;
+    }
+    offset += offsetNextPacket;
+  }
+
+  // last (possibly partial) chunk
+  if (offset > chunkStart) {
+    chunkIndex.push_back({(uint64_t)chunkStart, (uint32_t)(offset - chunkStart),
+                          chunkHeader.timeframeId, chunkHeader.linkId,
+                          chunkHeader.equipmentId, chunkHeader.hbOrbit});
+  }
+
+  if (scanMapping != nullptr) {
+    munmap(scanMapping, fileSize);
+  }
+
+  if (!scanOk) {
+    chunkIndex.clear();
+    theLog.log(InfoLogger::Severity::Warning,
+               "Chunk index disabled, falling back to run-time RDH parsing");
+    return;
+  }
+  theLog.log("Chunk index built: %lu data pages",
+             (unsigned long)chunkIndex.size());
+}
+
 ReadoutEquipmentPlayer::~ReadoutEquipmentPlayer() {
   if (fp != nullptr) {
     fclose(fp);
   }
+  if (fileMapping != nullptr) {
+    munmap(fileMapping, fileSize);
+  }
+}
+
+// wait until the page starting at given HB orbit is due, reproducing the
+// original beam timing scaled by pacedReplaySpeed: coarse sleep down to a
+// small window before the deadline, then busy-wait for accuracy
+void ReadoutEquipmentPlayer::paceReplay(uint32_t hbOrbit) {
+  if (!pacedReplayEnabled) {
+    return;
+  }
+  if (!pacedReplayStarted) {
+    // first page released: origin of the replay clock
+    replayClock.reset(0);
+    pacedReplayFirstOrbit = hbOrbit;
+    pacedReplayStarted = true;
+    return;
+  }
+  double target = ((double)(uint32_t)(hbOrbit - pacedReplayFirstOrbit)) /
+                  (LHCOrbitRate * pacedReplaySpeed);
+  double remaining = target - replayClock.getTime();
+  while (remaining > pacedReplaySpinTime) {
+    usleep((useconds_t)((remaining - pacedReplaySpinTime) * 1000000.0));
+    remaining = target - replayClock.getTime();
+  }
+  while (replayClock.getTime() < target) {
+    // busy-wait the last fraction before the deadline
+  }
 }
 
 DataBlockContainerReference ReadoutEquipmentPlayer::getNextBlock() {
@@ -223,16 +481,62 @@ DataBlockContainerReference ReadoutEquipmentPlayer::getNextBlock() {
     b->header.dataSize = 0;
 
     if (autoChunk) {
+      if (chunkIndex.size()) {
+        // replay driven by precomputed chunk index
+        if ((fp == nullptr) || (!fpOk)) {
+          return nullptr;
+        }
+        if (chunkIndexNext >= chunkIndex.size()) {
+          theLog.log("File %s replay completed", name.c_str());
+          fpOk = false;
+          return nullptr;
+        }
+        const ChunkIndexEntry &c = chunkIndex[chunkIndexNext];
+        if (fileMapping != nullptr) {
+          memcpy(b->data, fileDataPtr + c.fileOffset, c.dataSize);
+        } else {
+          if (fseek(fp, c.fileOffset, SEEK_SET) ||
+              (fread(b->data, 1, c.dataSize, fp) != c.dataSize)) {
+            theLog.log(InfoLogger::Severity::Error,
+                       "File %s read error, aborting replay", name.c_str());
+            fpOk = false;
+            return nullptr;
+          }
+        }
+        b->header.dataSize = c.dataSize;
+        b->header.linkId = c.linkId;
+        b->header.equipmentId = c.equipmentId;
+        b->header.timeframeId = c.timeframeId;
+        chunkIndexNext++;
+        fileOffset = c.fileOffset + c.dataSize;
+        // pace the replay on the original orbit timing of the page
+        paceReplay(c.hbOrbit);
+        return nextBlock;
+      }
+
       bool isOk = 1;
+      uint32_t pageFirstHbOrbit = 0; // HB orbit of first packet of this page
       // read from file
       if ((fp != nullptr) && (fpOk)) {
-        size_t nBytes = fread(b->data, 1, bytesPerPage, fp);
+        size_t nBytes = 0;
+        if (fileMapping != nullptr) {
+          // fill page directly from file mapping
+          nBytes = fileSize - fileOffset;
+          if (nBytes > bytesPerPage) {
+            nBytes = bytesPerPage;
+          }
+          if (nBytes) {
+            memcpy(b->data, fileDataPtr + fileOffset, nBytes);
+          }
+        } else {
+          nBytes = fread(b->data, 1, bytesPerPage, fp);
+        }
         if (nBytes == 0) {
-          if (ferror(fp)) {
+          if ((fileMapping == nullptr) && (ferror(fp))) {
             theLog.log(InfoLogger::Severity::Error,
                        "File %s read error, aborting replay", name.c_str());
           }
-          if (feof(fp)) {
+          if ((fileMapping != nullptr) || (feof(fp))) {
             theLog.log("File %s replay completed", name.c_str());
           }
           isOk = 0;
@@ -278,6 +582,7 @@ DataBlockContainerReference ReadoutEquipmentPlayer::getNextBlock() {
               b->header.linkId = currentPacketHeader.linkId;
               b->header.equipmentId = currentPacketHeader.equipmentId;
               b->header.timeframeId = currentPacketHeader.timeframeId;
+              pageFirstHbOrbit = (uint32_t)hbOrbit;
             }
 
             // changing link/cruid or TF -> change page
@@ -321,8 +626,9 @@ DataBlockContainerReference ReadoutEquipmentPlayer::getNextBlock() {
           fileOffset += nBytes;
           // printf ("bytes = %d    delta = %d    new file Offset = %lu\n",
           // nBytes, delta, fileOffset);
-          if (delta > 0) {
+          if ((delta > 0) && (fileMapping == nullptr)) {
             // rewind if necessary
+            // (with a file mapping, next copy simply starts at fileOffset)
             if (fseek(fp, fileOffset, SEEK_SET)) {
               theLog.log(InfoLogger::Severity::Error,
                          "Failed to seek in file, aborting replay");
@@ -337,6 +643,8 @@ DataBlockContainerReference ReadoutEquipmentPlayer::getNextBlock() {
         fpOk = false;
         return nullptr;
       }
+      // pace the replay on the original orbit timing of the page
+      paceReplay(pageFirstHbOrbit);
     } else {
       // copy file data to page, if not done already
       if (!preLoad) {
@@ -361,9 +669,12 @@ void ReadoutEquipmentPlayer::initCounters() {
     }
   }
   fileOffset = 0;
+  chunkIndexNext = 0;
   lastPacketHeader.timeframeId = 0;
   lastPacketHeader.linkId = undefinedLinkId;
   firstTimeframeHbOrbitBegin = 0;
+  pacedReplayStarted = false;
+  pacedReplayFirstOrbit = 0;
 }
 
 std::unique_ptr<ReadoutEquipment>
@@ -16,10 +16,15 @@
 #include <ReadoutCard/MemoryMappedFile.h>
 #include <ReadoutCard/Parameters.h>
 
+#include <atomic>
 #include <cstring>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <Common/Fifo.h>
 #include <Common/Timer.h>
 
 #include "RdhUtils.h"
@@ -42,11 +47,47 @@ private:
   void setDataOff();
   void initCounters();
   void finalCounters();
+  void getLinkStats(std::vector<LinkStats> &stats);
 
   Thread::CallbackResult populateFifoOut(); // the data readout loop function
 
+  // check CRU packet dropped counters (all channels), on timer
+  void checkPacketsDropped();
+
+  // create a DataBlockContainer from a completed superpage and populate
+  // its metadata (RDH parsing, timeframe id, checks).
+  // returns nullptr when the page is not usable (caller releases it).
+  DataBlockContainerReference processSuperpage(void *pageAddress,
+                                               size_t dataBytes,
+                                               bool isPageReady);
+
+  // per-channel feeder thread loop, used in multi-channel mode:
+  // gives free pages to the DMA channel and moves completed superpages
+  // to the shared ready FIFO.
+  void channelLoop(int channelIndex);
+
   AliceO2::roc::ChannelFactory::DmaChannelSharedPtr
-      channel; // channel to ROC device
+      channel; // primary channel to ROC device (channels[0])
+  std::vector<AliceO2::roc::ChannelFactory::DmaChannelSharedPtr>
+      channels; // all DMA channels serviced by this equipment
+
+  // completed superpage, as queued from the per-channel feeder threads
+  // to the readout thread (multi-channel mode)
+  struct ReadyPage {
+    void *pageAddress = nullptr; // base address of corresponding pool page
+    size_t dataBytes = 0;        // number of bytes received in superpage
+    bool isPageReady = false;    // superpage isReady() flag
+  };
+  std::unique_ptr<AliceO2::Common::Fifo<ReadyPage>>
+      readyFifo; // FIFO of completed superpages, shared by all channels
+                 // (multi-channel mode only)
+  std::mutex readyFifoMutex; // serializes the feeder threads pushing to
+                             // readyFifo (the FIFO supports a single producer)
+  std::vector<std::thread> channelThreads; // per-channel feeder threads
+  std::atomic<int> channelThreadsShutdown{
+      0}; // flag set to 1 to request feeder threads termination
+  int cfgChannelIdleSleepTime =
+      200; // idle sleep time of feeder threads, in microseconds
 
   bool isInitialized =
       false; // flag set to 1 when class has been successfully initialized
@@ -60,6 +101,19 @@ private:
   int cfgRdhDumpErrorEnabled = 1; // flag to enable RDH error log at runtime
   int cfgRdhUseFirstInPageEnabled = 0; // flag to enable reading of first RDH in
                                        // page to populate readout headers
+  int cfgRdhVersion = 0; // RDH version expected for the run (0 = accept v3/v4)
+  int cfgLinkStatsSampling = 0; // if N>0, 1 data page out of N is scanned to
+                                // update the per-link counters
+  CounterStats linkStats[RdhMaxLinkId + 1]; // per-link sampled counters: one
+                                            // increment per packet, value =
+                                            // packet size in bytes
+  std::vector<RdhPacketDescriptor>
+      linkStatsIndex; // scratch packet index for the sampled scans (when the
+                      // check scan index is not available)
+  unsigned long long linkStatsSampledPages = 0; // number of pages sampled
+  ScanRdhBlockFunction scanRdhBlockFunction =
+      &scanRdhBlock; // page scan, specialized at configure time when
+                     // rdhVersion is fixed
   int cfgRdhCheckPacketCounterContiguous =
       1; // flag to enable checking if RDH packetCounter value contiguous (done
          // link-by-link)
@@ -106,9 +160,15 @@ private:
   uint8_t RdhLastPacketCounter[RdhMaxLinkId + 1]; // last value of packetCounter
                                                   // RDH field for each link id
 
+  std::vector<RdhPacketDescriptor>
+      rdhPacketIndex; // per-page RDH index filled by scanRdhBlock(), vector
+                      // reused across pages to avoid re-allocation
+
   size_t superPageSize = 0; // usable size of a superpage
 
-  int32_t lastPacketDropped = 0; // latest value of CRU packet dropped counter
+  std::vector<int32_t>
+      lastPacketDropped; // latest value of CRU packet dropped counter, per
+                         // channel
   AliceO2::Common::Timer
       packetDroppedTimer; // a timer to set period of packet dropped checks
 };
@@ -137,6 +197,31 @@ ReadoutEquipmentRORC::ReadoutEquipmentRORC(ConfigFile &cfg, std::string name)
     int cfgChannelNumber = 0;
     cfg.getOptionalValue<int>(name + ".channelNumber", cfgChannelNumber);
 
+    // configuration parameter: | equipment-rorc-* | channelNumbers | string | |
+    // Comma-separated list of DMA channel numbers, to service several endpoints
+    // of the same board from a single equipment instance (sharing one memory
+    // pool and one output stream). When set, it overrides channelNumber. One
+    // feeder thread is created per channel. Needs
+    // readout.memoryPoolLockFreeEnabled=1. |
+    std::string cfgChannelNumbers = "";
+    cfg.getOptionalValue<std::string>(name + ".channelNumbers",
+                                      cfgChannelNumbers);
+    std::vector<int> channelNumbers;
+    if (cfgChannelNumbers.length()) {
+      std::stringstream ss(cfgChannelNumbers);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        channelNumbers.push_back(std::stoi(item));
+      }
+    }
+    if (channelNumbers.size() == 0) {
+      channelNumbers.push_back(cfgChannelNumber);
+    }
+
+    // feeder threads reuse the equipment idle sleep time
+    cfg.getOptionalValue<int>(name + ".idleSleepTime",
+                              cfgChannelIdleSleepTime);
+
     // configuration parameter: | equipment-rorc-* | dataSource | string |
     //  Internal | This parameter selects the data source used by ReadoutCard,
     // c.f. AliceO2::roc::Parameters. It can be for CRU one of Fee, Ddg,
@@ -171,6 +256,51 @@ ReadoutEquipmentRORC::ReadoutEquipmentRORC(ConfigFile &cfg, std::string name)
     // readout headers (e.g. linkId).|
     cfg.getOptionalValue<int>(name + ".rdhUseFirstInPageEnabled",
                               cfgRdhUseFirstInPageEnabled);
+    // configuration parameter: | equipment-rorc-* | rdhVersion | int | 0 |
+    // RDH version expected for the whole run (3 or 4). When set, the page
+    // scan is specialized at configure time for this version, removing the
+    // dynamic version checks from the per-packet path, and packets with
+    // another version are reported as errors. If 0 (default), versions 3 and
+    // 4 are both accepted. |
+    cfg.getOptionalValue<int>(name + ".rdhVersion", cfgRdhVersion);
+    if (cfgRdhVersion) {
+      if ((cfgRdhVersion != 3) && (cfgRdhVersion != 4)) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Wrong value for parameter rdhVersion: %d", cfgRdhVersion);
+        throw __LINE__;
+      }
+      scanRdhBlockFunction = getScanRdhBlockFunction(cfgRdhVersion);
+      theLog.log("Equipment %s: RDH scan specialized for version %d",
+                 name.c_str(), cfgRdhVersion);
+    }
+    // configuration parameter: | equipment-rorc-* | linkStatsSampling | int |
+    // 0 | If N>0, per-link bandwidth accounting: one data page out of N is
+    // scanned with the RDH block scan and per-link packet / byte counters are
+    // updated. The counters, scaled by N to estimate the totals, are exported
+    // to the stats shared memory segment (one eq-name-l-id source per active
+    // link, c.f. readout.statsShmPath) and a per-link summary is logged at
+    // stop. N sets the CPU budget: the scan cost is paid on 1-in-N pages only
+    // (and is free when rdhCheckEnabled already scans every page). |
+    cfg.getOptionalValue<int>(name + ".linkStatsSampling",
+                              cfgLinkStatsSampling);
+    if (cfgLinkStatsSampling) {
+      // counters updated by the equipment thread, read by the stats export
+      for (unsigned int i = 0; i <= RdhMaxLinkId; i++) {
+        linkStats[i].enableThreadSafe();
+      }
+      theLog.log("Equipment %s: per-link stats enabled, sampling 1 page out "
+                 "of %d",
+                 name.c_str(), cfgLinkStatsSampling);
+    }
+
+    // the per-link page index (c.f. equipment.pageLinkIndexEnabled) is filled
+    // from the RDH scan, so the scan must be on
+    if ((cfgPageLinkIndexEnabled) && (!cfgRdhCheckEnabled)) {
+      theLog.log("Equipment %s: pageLinkIndexEnabled needs the RDH scan, "
+                 "enabling rdhCheckEnabled",
+                 name.c_str());
+      cfgRdhCheckEnabled = 1;
+    }
 
     // configuration parameter: | equipment-rorc-* | cleanPageBeforeUse | int |
     // 0 | If set, data pages are filled with zero before being given for
@@ -237,55 +367,89 @@ ReadoutEquipmentRORC::ReadoutEquipmentRORC(ConfigFile &cfg, std::string name)
           << ErrorInfo::Message("Superpage must be at least 32kB"));
     }
 
-    // open and configure ROC
-    theLog.log("Opening ROC %s:%d", cardId.c_str(), cfgChannelNumber);
-    AliceO2::roc::Parameters params;
-    params.setCardId(AliceO2::roc::Parameters::cardIdFromString(cardId));
-    params.setChannelNumber(cfgChannelNumber);
-    params.setFirmwareCheckEnabled(cfgFirmwareCheckEnabled);
+    // open and configure ROC channels
+    for (auto vChannelNumber : channelNumbers) {
+      theLog.log("Opening ROC %s:%d", cardId.c_str(), vChannelNumber);
+      AliceO2::roc::Parameters params;
+      params.setCardId(AliceO2::roc::Parameters::cardIdFromString(cardId));
+      params.setChannelNumber(vChannelNumber);
+      params.setFirmwareCheckEnabled(cfgFirmwareCheckEnabled);
 
-    // setDmaPageSize() : seems deprecated, let's not configure it
+      // setDmaPageSize() : seems deprecated, let's not configure it
 
-    // card data source
-    params.setDataSource(AliceO2::roc::DataSource::fromString(cfgDataSource));
+      // card data source
+      params.setDataSource(AliceO2::roc::DataSource::fromString(cfgDataSource));
 
-    // card readout mode : experimental, not needed
-    // params.setReadoutMode(AliceO2::roc::ReadoutMode::fromString(cfgReadoutMode));
+      // card readout mode : experimental, not needed
+      // params.setReadoutMode(AliceO2::roc::ReadoutMode::fromString(cfgReadoutMode));
 
-    /*
-    theLog.log("Loop DMA block %p:%lu", mp->getBaseBlockAddress(),
-    mp->getBaseBlockSize()); char *ptr=(char *)mp->getBaseBlockAddress(); for
-    (size_t i=0;i<mp->getBaseBlockSize();i++) { ptr[i]=0;
+      /*
+      theLog.log("Loop DMA block %p:%lu", mp->getBaseBlockAddress(),
+      mp->getBaseBlockSize()); char *ptr=(char *)mp->getBaseBlockAddress(); for
+      (size_t i=0;i<mp->getBaseBlockSize();i++) { ptr[i]=0;
+      }
+      */
+
+      // register the memory block for DMA
+      // all channels share the same memory pool
+      void *baseAddress = (void *)mp->getBaseBlockAddress();
+      size_t blockSize = mp->getBaseBlockSize();
+      theLog.log("Register DMA block %p:%lu", baseAddress, blockSize);
+      params.setBufferParameters(
+          AliceO2::roc::buffer_parameters::Memory{baseAddress, blockSize});
+
+      // open channel with above parameters
+      AliceO2::roc::ChannelFactory::DmaChannelSharedPtr newChannel =
+          AliceO2::roc::ChannelFactory().getDmaChannel(params);
+      newChannel->resetChannel(
+          AliceO2::roc::ResetLevel::fromString(cfgResetLevel));
+
+      // retrieve card information
+      std::string infoPciAddress = newChannel->getPciAddress().toString();
+      int infoNumaNode = newChannel->getNumaNode();
+      std::string infoSerialNumber = "unknown";
+      auto v_infoSerialNumber = newChannel->getSerial();
+      if (v_infoSerialNumber) {
+        infoSerialNumber = std::to_string(v_infoSerialNumber.get());
+      }
+      std::string infoFirmwareVersion =
+          newChannel->getFirmwareInfo().value_or("unknown");
+      std::string infoCardId = newChannel->getCardId().value_or("unknown");
+      theLog.log("Equipment %s : PCI %s @ NUMA node %d, serial number %s, "
+                 "firmware version %s, card id %s",
+                 name.c_str(), infoPciAddress.c_str(), infoNumaNode,
+                 infoSerialNumber.c_str(), infoFirmwareVersion.c_str(),
+                 infoCardId.c_str());
+
+      channels.push_back(newChannel);
     }
-    */
-
-    // register the memory block for DMA
-    void *baseAddress = (void *)mp->getBaseBlockAddress();
-    size_t blockSize = mp->getBaseBlockSize();
-    theLog.log("Register DMA block %p:%lu", baseAddress, blockSize);
-    params.setBufferParameters(
-        AliceO2::roc::buffer_parameters::Memory{baseAddress, blockSize});
-
-    // open channel with above parameters
-    channel = AliceO2::roc::ChannelFactory().getDmaChannel(params);
-    channel->resetChannel(AliceO2::roc::ResetLevel::fromString(cfgResetLevel));
-
-    // retrieve card information
-    std::string infoPciAddress = channel->getPciAddress().toString();
-    int infoNumaNode = channel->getNumaNode();
-    std::string infoSerialNumber = "unknown";
-    auto v_infoSerialNumber = channel->getSerial();
-    if (v_infoSerialNumber) {
-      infoSerialNumber = std::to_string(v_infoSerialNumber.get());
+    channel = channels[0]; // keep first channel as primary
+    lastPacketDropped.resize(channels.size(), 0);
+
+    // in multi-channel mode, completed superpages are moved by one feeder
+    // thread per channel to a shared ready FIFO, consumed by the readout
+    // thread. FIFO sized to the pool: it can never block the feeders while
+    // there are free pages.
+    if (channels.size() > 1) {
+      // the feeder threads get/release pool pages concurrently with the
+      // readout thread: this needs the lock-free memory pool mode
+      extern int MemoryPagesPoolLockFreeEnabled;
+      if (!MemoryPagesPoolLockFreeEnabled) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Equipment %s : channelNumbers needs "
+                   "readout.memoryPoolLockFreeEnabled=1 (several threads "
+                   "get/release memory pool pages)",
+                   name.c_str());
+        throw __LINE__;
+      }
+      readyFifo = std::make_unique<AliceO2::Common::Fifo<ReadyPage>>(
+          (int)mp->getTotalNumberOfPages());
+      // this counter is also updated from the feeder threads
+      equipmentStats[EquipmentStatsIndexes::nMemoryLow].enableThreadSafe();
+      theLog.log("Equipment %s : %d DMA channels sharing one memory pool, "
+                 "one feeder thread per channel",
+                 name.c_str(), (int)channels.size());
     }
-    std::string infoFirmwareVersion =
-        channel->getFirmwareInfo().value_or("unknown");
-    std::string infoCardId = channel->getCardId().value_or("unknown");
-    theLog.log("Equipment %s : PCI %s @ NUMA node %d, serial number %s, "
-               "firmware version %s, card id %s",
-               name.c_str(), infoPciAddress.c_str(), infoNumaNode,
-               infoSerialNumber.c_str(), infoFirmwareVersion.c_str(),
-               infoCardId.c_str());
 
     // todo: log parameters ?
 
@@ -310,42 +474,141 @@ ReadoutEquipmentRORC::ReadoutEquipmentRORC(ConfigFile &cfg, std::string name)
     return;
   }
   isInitialized = true;
-}
-
-ReadoutEquipmentRORC::~ReadoutEquipmentRORC() {}
 
-Thread::CallbackResult ReadoutEquipmentRORC::prepareBlocks() {
-  if (!isInitialized)
-    return Thread::CallbackResult::Error;
-  if (!isDataOn)
-    return Thread::CallbackResult::Idle;
+  // start feeder threads (multi-channel mode)
+  if (channels.size() > 1) {
+    channelThreadsShutdown = 0;
+    for (unsigned int i = 0; i < channels.size(); i++) {
+      channelThreads.push_back(
+          std::thread(&ReadoutEquipmentRORC::channelLoop, this, (int)i));
+    }
+  }
+}
 
-  int isActive = 0;
+ReadoutEquipmentRORC::~ReadoutEquipmentRORC() {
+  // stop feeder threads
+  channelThreadsShutdown = 1;
+  for (auto &t : channelThreads) {
+    t.join();
+  }
+  // release leftover pages from shared ready FIFO
+  if (readyFifo != nullptr) {
+    ReadyPage p;
+    while (!readyFifo->pop(p)) {
+      mp->releasePage(p.pageAddress);
+    }
+  }
+}
 
+void ReadoutEquipmentRORC::checkPacketsDropped() {
   // check status of packets dropped
   // Returns the number of dropped packets, as reported by the BAR
   if ((isWaitingFirstLoop) || (packetDroppedTimer.isTimeout())) {
-    int32_t currentPacketDropped = channel->getDroppedPackets();
-    if ((currentPacketDropped != lastPacketDropped) && (!isWaitingFirstLoop)) {
-      int32_t newPacketDropped = (currentPacketDropped - lastPacketDropped);
-      if (newPacketDropped > 0) {
-        theLog.log(InfoLogger::Severity::Warning,
-                   "Equipment %s: CRU has dropped packets (new=%d total=%d)",
-                   name.c_str(), newPacketDropped, currentPacketDropped);
-        if (stopOnError) {
-          theLog.log(InfoLogger::Severity::Error,
-                     "Equipment %s: some data has been lost)", name.c_str());
+    for (unsigned int i = 0; i < channels.size(); i++) {
+      int32_t currentPacketDropped = channels[i]->getDroppedPackets();
+      if ((currentPacketDropped != lastPacketDropped[i]) &&
+          (!isWaitingFirstLoop)) {
+        int32_t newPacketDropped = (currentPacketDropped - lastPacketDropped[i]);
+        if (newPacketDropped > 0) {
+          theLog.log(InfoLogger::Severity::Warning,
+                     "Equipment %s: CRU has dropped packets (new=%d total=%d)",
+                     name.c_str(), newPacketDropped, currentPacketDropped);
+          if (stopOnError) {
+            theLog.log(InfoLogger::Severity::Error,
+                       "Equipment %s: some data has been lost)", name.c_str());
+          }
+          isError++;
         }
-        isError++;
       }
+      lastPacketDropped[i] = currentPacketDropped;
     }
-    lastPacketDropped = currentPacketDropped;
     if (isWaitingFirstLoop) {
       packetDroppedTimer.reset(1000000); // 1 sec interval
     } else {
       packetDroppedTimer.increment();
     }
   }
+}
+
+void ReadoutEquipmentRORC::channelLoop(int channelIndex) {
+  AliceO2::roc::ChannelFactory::DmaChannelSharedPtr ch = channels[channelIndex];
+  for (; !channelThreadsShutdown.load();) {
+    bool isActive = false;
+    if (isDataOn) {
+      // give free pages to the driver
+      while (ch->getTransferQueueAvailable() != 0) {
+        void *newPage = mp->getPage();
+        if (newPage == nullptr) {
+          equipmentStats[EquipmentStatsIndexes::nMemoryLow].increment();
+          break;
+        }
+        // optionnaly, cleanup page before use
+        if (cfgCleanPageBeforeUse) {
+          std::memset(newPage, 0, mp->getPageSize());
+        }
+        AliceO2::roc::Superpage superpage;
+        superpage.setOffset((char *)newPage -
+                            (char *)mp->getBaseBlockAddress() +
+                            pageSpaceReserved);
+        superpage.setSize(superPageSize);
+        superpage.setUserData(newPage);
+        if (ch->pushSuperpage(superpage)) {
+          isActive = true;
+        } else {
+          // push failed (typically, stopDma() has been called in the mean
+          // time) release allocated page to memory pool
+          mp->releasePage(newPage);
+          break;
+        }
+      }
+
+      // this is to be called periodically for driver internal business
+      ch->fillSuperpages();
+
+      // move completed superpages to the shared ready FIFO
+      // (single-producer FIFO: the feeder threads serialize on a mutex)
+      while ((ch->getReadyQueueSize() > 0) && (!readyFifo->isFull())) {
+        auto superpage = ch->popSuperpage();
+        ReadyPage p;
+        p.pageAddress = (void *)superpage.getUserData();
+        p.dataBytes = superpage.getReceived();
+        p.isPageReady = superpage.isReady();
+        int pushError;
+        {
+          std::unique_lock<std::mutex> lock(readyFifoMutex);
+          pushError = readyFifo->push(p);
+        }
+        if (pushError) {
+          // should not happen, FIFO is sized to hold all pool pages
+          mp->releasePage(p.pageAddress);
+        }
+        isActive = true;
+      }
+    }
+    if (!isActive) {
+      usleep(cfgChannelIdleSleepTime);
+    }
+  }
+}
+
+Thread::CallbackResult ReadoutEquipmentRORC::prepareBlocks() {
+  if (!isInitialized)
+    return Thread::CallbackResult::Error;
+  if (!isDataOn)
+    return Thread::CallbackResult::Idle;
+
+  int isActive = 0;
+
+  checkPacketsDropped();
+
+  // in multi-channel mode, pages are given to the channels by the feeder
+  // threads, nothing else to do here
+  if (channels.size() > 1) {
+    if (isWaitingFirstLoop) {
+      isWaitingFirstLoop = false;
+    }
+    return Thread::CallbackResult::Idle;
+  }
 
   // keep track of situations where the queue is completely empty
   // this means we have not filled it fast enough (except in first loop, where
@@ -427,20 +690,51 @@ Thread::CallbackResult ReadoutEquipmentRORC::prepareBlocks() {
 
 DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
 
-  DataBlockContainerReference nextBlock = nullptr;
-
   // ensure the initialization was fine in the main thread
   if (!isInitialized) {
     return nullptr;
   }
-  // channel->fillSuperpages();
 
-  // check for completed page
-  if ((channel->getReadyQueueSize() > 0)) {
+  DataBlockContainerReference nextBlock = nullptr;
+  void *mpPageAddress = nullptr;
+
+  if (channels.size() > 1) {
+    // multi-channel mode: get next completed superpage from shared ready FIFO
+    ReadyPage p;
+    if (readyFifo->pop(p)) {
+      return nullptr;
+    }
+    mpPageAddress = p.pageAddress;
+    nextBlock = processSuperpage(p.pageAddress, p.dataBytes, p.isPageReady);
+  } else {
+    // channel->fillSuperpages();
+
+    // check for completed page
+    if (channel->getReadyQueueSize() <= 0) {
+      return nullptr;
+    }
     // get next page from FIFO
     auto superpage = channel->popSuperpage();
-    void *mpPageAddress = (void *)(superpage.getUserData());
-    if (superpage.isReady()) {
+    mpPageAddress = (void *)(superpage.getUserData());
+    nextBlock = processSuperpage(mpPageAddress, superpage.getReceived(),
+                                 superpage.isReady());
+  }
+
+  if (nextBlock == nullptr) {
+    // the superpage is not used, release it
+    mp->releasePage(mpPageAddress);
+  }
+  return nextBlock;
+}
+
+DataBlockContainerReference
+ReadoutEquipmentRORC::processSuperpage(void *mpPageAddress, size_t dataBytes,
+                                       bool isPageReady) {
+
+  DataBlockContainerReference nextBlock = nullptr;
+
+  {
+    if (isPageReady) {
       std::shared_ptr<DataBlockContainer> d = nullptr;
       // printf ("received a page with %d bytes - isFilled=%d isREady=%d\n",
       //(int)superpage.getReceived(),(int)superpage.isFilled(),(int)superpage.isReady());
@@ -533,7 +827,7 @@ DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
         }
 
         // fill page metadata
-        d->getData()->header.dataSize = superpage.getReceived();
+        d->getData()->header.dataSize = dataBytes;
         d->getData()->header.equipmentId = equipmentId;
         d->getData()->header.linkId = linkId;
         d->getData()->header.timeframeId = currentTimeframe;
@@ -556,68 +850,83 @@ DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
           std::string errorDescription;
           size_t blockSize = d->getData()->header.dataSize;
           uint8_t *baseAddress = (uint8_t *)(d->getData()->data);
-          int rdhIndexInPage = 0;
 
-          for (size_t pageOffset = 0; pageOffset < blockSize;) {
-            RdhHandle h(baseAddress + pageOffset);
-            rdhIndexInPage++;
-
-            // printf("RDH #%d @ 0x%X : next block @ +%d
-            // bytes\n",rdhIndexInPage,(unsigned
-            // int)pageOffset,h.getOffsetNextPacket());
-
-            // data format:
-            // RDH v3 =
-            // https://docs.google.com/document/d/1otkSDYasqpVBDnxplBI7dWNxaZohctA-bvhyrzvtLoQ/edit?usp=sharing
-            if (h.validateRdh(errorDescription)) {
-              if ((cfgRdhDumpEnabled) || (cfgRdhDumpErrorEnabled)) {
-                for (int i = 0; i < 16; i++) {
-                  printf("%08X ", (int)(((uint32_t *)baseAddress)[i]));
-                }
-                printf("\n");
-                printf("Page 0x%p + %ld\n%s", (void *)baseAddress, pageOffset,
-                       errorDescription.c_str());
-                h.dumpRdh(pageOffset, 1);
-                errorDescription.clear();
+          // data format:
+          // RDH v3 =
+          // https://docs.google.com/document/d/1otkSDYasqpVBDnxplBI7dWNxaZohctA-bvhyrzvtLoQ/edit?usp=sharing
+
+          // single scan-and-validate pass over the page, producing a compact
+          // index of the packets it contains. Stream consistency is then
+          // checked from the index.
+          rdhPacketIndex.clear();
+          if (scanRdhBlockFunction(baseAddress, blockSize, rdhPacketIndex,
+                                   errorDescription) < 0) {
+            // an invalid header stopped the scan. it is located right after
+            // the last packet indexed.
+            size_t pageOffset = 0;
+            if (rdhPacketIndex.size()) {
+              pageOffset =
+                  rdhPacketIndex.back().offset + rdhPacketIndex.back().size;
+            }
+            if ((cfgRdhDumpEnabled) || (cfgRdhDumpErrorEnabled)) {
+              for (int i = 0; i < 16; i++) {
+                printf("%08X ",
+                       (int)(((uint32_t *)(baseAddress + pageOffset))[i]));
               }
-              statsRdhCheckErr++;
-              // stop on first RDH error (should distinguich valid/invalid block
-              // length)
-              break;
-            } else {
-              statsRdhCheckOk++;
+              printf("\n");
+              printf("Page 0x%p + %ld\n%s", (void *)baseAddress, pageOffset,
+                     errorDescription.c_str());
+              RdhHandle h(baseAddress + pageOffset);
+              h.dumpRdh(pageOffset, 1);
+              errorDescription.clear();
+            }
+            statsRdhCheckErr++;
+            // valid packets before the error are still accounted below
+          }
+          statsRdhCheckOk += rdhPacketIndex.size();
 
-              if (cfgRdhDumpEnabled) {
-                h.dumpRdh(pageOffset, 1);
-                for (int i = 0; i < 16; i++) {
-                  printf("%08X ",
-                         (int)(((uint32_t *)baseAddress + pageOffset)[i]));
-                }
-                printf("\n");
+          // store the packet index in the page reserved header space, for
+          // reuse downstream (c.f. pageLinkIndexEnabled). On partial scan,
+          // the packets validated before the error are still indexed.
+          if (cfgPageLinkIndexEnabled) {
+            writePageLinkIndex(d->getData()->data, rdhPacketIndex);
+          }
+
+          int rdhIndexInPage = 0;
+          for (auto &p : rdhPacketIndex) {
+            rdhIndexInPage++;
+
+            if (cfgRdhDumpEnabled) {
+              RdhHandle h(baseAddress + p.offset);
+              h.dumpRdh(p.offset, 1);
+              for (int i = 0; i < 16; i++) {
+                printf("%08X ",
+                       (int)(((uint32_t *)baseAddress + p.offset)[i]));
               }
+              printf("\n");
             }
 
             // linkId should be same everywhere in page
-            if (linkId != h.getLinkId()) {
+            if (linkId != p.linkId) {
               if (cfgRdhDumpErrorEnabled) {
                 theLog.log(InfoLogger::Severity::Warning,
                            "RDH #%d @ 0x%X : inconsistent link ids: %d != %d",
-                           rdhIndexInPage, (unsigned int)pageOffset, linkId,
-                           h.getLinkId());
+                           rdhIndexInPage, (unsigned int)p.offset, linkId,
+                           (int)p.linkId);
               }
               statsRdhCheckStreamErr++;
               break; // stop checking this page
             }
 
             // check no timeframe overlap in page
-            if ((uint32_t)hbOrbit >=
+            if (p.hbOrbit >=
                 currentTimeframeHbOrbitBegin + timeframePeriodOrbits) {
               if (cfgRdhDumpErrorEnabled) {
                 theLog.log(InfoLogger::Severity::Warning,
                            "RDH #%d @ 0x%X : TimeFrame ID change in page not "
                            "allowed : hbOrbit %u > %u + %u",
-                           rdhIndexInPage, (unsigned int)pageOffset,
-                           (uint32_t)hbOrbit, currentTimeframeHbOrbitBegin,
+                           rdhIndexInPage, (unsigned int)p.offset,
+                           p.hbOrbit, currentTimeframeHbOrbitBegin,
                            timeframePeriodOrbits);
               }
               statsRdhCheckStreamErr++;
@@ -626,16 +935,17 @@ DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
 
             // check packetCounter is contiguous
             if (cfgRdhCheckPacketCounterContiguous) {
+              RdhHandle h(baseAddress + p.offset);
               uint8_t newCount = h.getPacketCounter();
               // no boundary check necessary to verify linkId<=RdhMaxLinkId,
-              // this was done in validateRDH()
+              // this was done by scanRdhBlock()
               if (newCount != RdhLastPacketCounter[linkId]) {
                 if (newCount !=
                     (uint8_t)(RdhLastPacketCounter[linkId] + (uint8_t)1)) {
                   theLog.log(InfoLogger::Severity::Warning,
                              "RDH #%d @ 0x%X : possible packets dropped for "
                              "link %d, packetCounter jump from %d to %d",
-                             rdhIndexInPage, (unsigned int)pageOffset,
+                             rdhIndexInPage, (unsigned int)p.offset,
                              (int)linkId, (int)RdhLastPacketCounter[linkId],
                              (int)newCount);
                 }
@@ -646,13 +956,28 @@ DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
             // TODO
             // check counter increasing
             // all have same TF id
+          }
+        }
 
-            uint16_t offsetNextPacket = h.getOffsetNextPacket();
-            if (offsetNextPacket == 0) {
-              break;
-            }
-            pageOffset += offsetNextPacket;
+        // sampled per-link accounting (c.f. linkStatsSampling): scan 1 data
+        // page out of N and update the per-link counters from its index
+        if ((cfgLinkStatsSampling) &&
+            ((statsNumberOfPages %
+              (unsigned long long)cfgLinkStatsSampling) == 0)) {
+          const std::vector<RdhPacketDescriptor> *index = &rdhPacketIndex;
+          if (!cfgRdhCheckEnabled) {
+            // no check scan done for this page, scan it now
+            std::string errorDescription;
+            linkStatsIndex.clear();
+            scanRdhBlockFunction(d->getData()->data,
+                                 d->getData()->header.dataSize, linkStatsIndex,
+                                 errorDescription);
+            index = &linkStatsIndex;
           }
+          for (auto &p : *index) {
+            linkStats[p.linkId].increment(p.size);
+          }
+          linkStatsSampledPages++;
         }
       } else {
         // there is a ready superpage, but we are not able to keep it
@@ -662,11 +987,6 @@ DataBlockContainerReference ReadoutEquipmentRORC::getNextBlock() {
       // these are leftover pages not ready, simply discard them
       statsNumberOfPagesEmpty++;
     }
-
-    if (nextBlock == nullptr) {
-      // the superpage is not used, release it
-      mp->releasePage(mpPageAddress);
-    }
   }
   return nextBlock;
 }
@@ -680,7 +1000,9 @@ void ReadoutEquipmentRORC::setDataOn() {
   if (isInitialized) {
     // start DMA
     theLog.log("Starting DMA for ROC %s", getName().c_str());
-    channel->startDma();
+    for (auto &ch : channels) {
+      ch->startDma();
+    }
 
     // get FIFO depth (it should be fully empty when starting)
     RocFifoSize = channel->getTransferQueueAvailable();
@@ -706,11 +1028,13 @@ void ReadoutEquipmentRORC::setDataOff() {
 
   if (isInitialized) {
     theLog.log("Stopping DMA for ROC %s", getName().c_str());
-    try {
-      channel->stopDma();
-    } catch (const std::exception &e) {
-      theLog.log(InfoLogger::Severity::Error, "Exception : %s", e.what());
-      theLog.log("%s", boost::diagnostic_information(e).c_str());
+    for (auto &ch : channels) {
+      try {
+        ch->stopDma();
+      } catch (const std::exception &e) {
+        theLog.log(InfoLogger::Severity::Error, "Exception : %s", e.what());
+        theLog.log("%s", boost::diagnostic_information(e).c_str());
+      }
     }
   }
 }
@@ -740,22 +1064,76 @@ void ReadoutEquipmentRORC::initCounters() {
   for (unsigned int i = 0; i <= RdhMaxLinkId; i++) {
     RdhLastPacketCounter[i] = 0;
   }
+
+  // reset per-link counters
+  if (cfgLinkStatsSampling) {
+    for (unsigned int i = 0; i <= RdhMaxLinkId; i++) {
+      linkStats[i].reset();
+    }
+    linkStatsSampledPages = 0;
+  }
+}
+
+void ReadoutEquipmentRORC::getLinkStats(std::vector<LinkStats> &stats) {
+  if (!cfgLinkStatsSampling) {
+    return;
+  }
+  for (unsigned int i = 0; i <= RdhMaxLinkId; i++) {
+    CounterValue packets = linkStats[i].getCount();
+    if (packets == 0) {
+      continue;
+    }
+    LinkStats s;
+    s.linkId = (int)i;
+    s.bytes = linkStats[i].get() * (CounterValue)cfgLinkStatsSampling;
+    s.packets = packets * (CounterValue)cfgLinkStatsSampling;
+    stats.push_back(s);
+  }
 }
 
 void ReadoutEquipmentRORC::finalCounters() {
+  int32_t totalPacketDropped = 0;
+  for (auto v : lastPacketDropped) {
+    totalPacketDropped += v;
+  }
   if (cfgRdhCheckEnabled) {
     theLog.log("Equipment %s : %llu timeframes, %llu pages (+ %llu lost + %llu "
                "empty), RDH checks %llu ok, %llu "
                "errors, %llu stream inconsistencies %d packets dropped by CRU",
                name.c_str(), statsNumberOfTimeframes, statsNumberOfPages,
                statsNumberOfPagesLost, statsNumberOfPagesEmpty, statsRdhCheckOk,
-               statsRdhCheckErr, statsRdhCheckStreamErr, lastPacketDropped);
+               statsRdhCheckErr, statsRdhCheckStreamErr, totalPacketDropped);
   } else {
     theLog.log("Equipment %s : %llu pages (+ %llu lost + %llu empty)",
                name.c_str(), statsNumberOfPages, statsNumberOfPagesLost,
                statsNumberOfPagesEmpty);
   }
 
+  // per-link summary from the sampled accounting
+  // (estimates scaled by the sampling factor)
+  if (cfgLinkStatsSampling) {
+    theLog.log("Equipment %s : per-link stats (%llu pages sampled, 1 out "
+               "of %d)",
+               name.c_str(), linkStatsSampledPages, cfgLinkStatsSampling);
+    for (unsigned int i = 0; i <= RdhMaxLinkId; i++) {
+      CounterValue packets = linkStats[i].getCount();
+      if (packets == 0) {
+        continue;
+      }
+      theLog.log("Equipment %s link %2u : ~%llu packets ~%s (avg packet %llu "
+                 "bytes)",
+                 name.c_str(), i,
+                 (unsigned long long)(packets *
+                                      (CounterValue)cfgLinkStatsSampling),
+                 ReadoutUtils::NumberOfBytesToString(
+                     (double)(linkStats[i].get() *
+                              (CounterValue)cfgLinkStatsSampling),
+                     "B")
+                     .c_str(),
+                 (unsigned long long)linkStats[i].getAverage());
+    }
+  }
+
   if (cfgDebugStatsEnabled) {
 
     printf("\n*** begin debug stats ***\n");
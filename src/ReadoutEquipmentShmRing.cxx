@@ -0,0 +1,240 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#include "MemoryBankManager.h"
+#include "ReadoutEquipment.h"
+#include "ReadoutUtils.h"
+#include "ShmRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <InfoLogger/InfoLogger.hxx>
+using namespace AliceO2::InfoLogger;
+extern InfoLogger theLog;
+
+// Equipment exposing a shared-memory ring over the memory pool, for local
+// producer processes. The producer maps the pool data region (e.g. the
+// hugepage-backed file of the memory bank) and the control region created
+// here, gets free pages from the "free" ring, writes DataBlock payloads
+// directly into the pages, and publishes them through the "ready" ring.
+// Readout just turns ready pages into data blocks: a zero-copy local
+// ingestion path with no socket syscalls on the hot path.
+// See ShmRing.h for the control region layout.
+
+class ReadoutEquipmentShmRing : public ReadoutEquipment {
+
+public:
+  ReadoutEquipmentShmRing(ConfigFile &cfg, std::string name = "shmRingReadout");
+  ~ReadoutEquipmentShmRing();
+  DataBlockContainerReference getNextBlock();
+  Thread::CallbackResult prepareBlocks();
+
+private:
+  void initCounters();
+  void finalCounters();
+
+  std::string cfgShmName = ""; // name of POSIX shared memory control region
+
+  int shmFd = -1;           // file descriptor of control region
+  void *shmBase = nullptr;  // mapped control region
+  size_t shmSize = 0;       // size of control region
+  uint64_t ringCapacity = 0; // number of record slots in each ring
+
+  ShmRingQueue *freeQueue = nullptr;    // free pages, readout -> producer
+  ShmRingQueue *readyQueue = nullptr;   // filled pages, producer -> readout
+  ShmRingRecord *freeRecords = nullptr; // records of free ring
+  ShmRingRecord *readyRecords = nullptr; // records of ready ring
+
+  unsigned long long statsPagesProvided = 0; // pages published in free ring
+  unsigned long long statsPagesReceived = 0; // pages received from ready ring
+  unsigned long long statsPagesInvalid =
+      0; // ready records with invalid page offset
+};
+
+ReadoutEquipmentShmRing::ReadoutEquipmentShmRing(ConfigFile &cfg,
+                                                 std::string cfgEntryPoint)
+    : ReadoutEquipment(cfg, cfgEntryPoint) {
+
+  // get configuration values
+  // configuration parameter: | equipment-shmring-* | shmName | string |
+  // /readout-shmring | Name of the POSIX shared memory object created for the
+  // control region (the two page rings), as given to shm_open(). The producer
+  // process shall map it, together with the data region (the memory-mapped
+  // file of the memory bank used by this equipment). |
+  cfgShmName = "/readout-shmring";
+  cfg.getOptionalValue<std::string>(cfgEntryPoint + ".shmName", cfgShmName);
+
+  // log config summary
+  theLog.log("Equipment %s: shmName=%s", name.c_str(), cfgShmName.c_str());
+
+  // create and initialize control region
+  ringCapacity = mp->getTotalNumberOfPages();
+  shmSize = shmRingGetSize(ringCapacity);
+  shmFd = shm_open(cfgShmName.c_str(), O_CREAT | O_RDWR, 0666);
+  if (shmFd < 0) {
+    theLog.log(InfoLogger::Severity::Error, "shm_open(%s) failed: %s",
+               cfgShmName.c_str(), strerror(errno));
+    throw __LINE__;
+  }
+  if (ftruncate(shmFd, shmSize)) {
+    theLog.log(InfoLogger::Severity::Error, "ftruncate failed: %s",
+               strerror(errno));
+    throw __LINE__;
+  }
+  shmBase =
+      mmap(nullptr, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+  if (shmBase == MAP_FAILED) {
+    shmBase = nullptr;
+    theLog.log(InfoLogger::Severity::Error, "mmap failed: %s",
+               strerror(errno));
+    throw __LINE__;
+  }
+  memset(shmBase, 0, shmSize);
+
+  ShmRingHeader *h = shmRingGetHeader(shmBase);
+  h->pageSize = mp->getPageSize();
+  h->numberOfPages = ringCapacity;
+  h->capacity = ringCapacity;
+  h->payloadOffset = pageSpaceReserved;
+  h->payloadMaxSize = mp->getDataBlockMaxSize();
+  h->version = ShmRingVersion;
+  h->magic = ShmRingMagic; // set last: marks the control region valid
+
+  freeQueue = shmRingGetFreeQueue(shmBase);
+  readyQueue = shmRingGetReadyQueue(shmBase);
+  freeRecords = shmRingGetFreeRecords(shmBase);
+  readyRecords = shmRingGetReadyRecords(shmBase);
+
+  theLog.log("Equipment %s: control region %s created, %lu bytes, %lu pages "
+             "of %lu bytes (payload @ +%lu, max %lu bytes)",
+             name.c_str(), cfgShmName.c_str(), (unsigned long)shmSize,
+             (unsigned long)ringCapacity, (unsigned long)h->pageSize,
+             (unsigned long)h->payloadOffset, (unsigned long)h->payloadMaxSize);
+}
+
+ReadoutEquipmentShmRing::~ReadoutEquipmentShmRing() {
+  if (shmBase != nullptr) {
+    // invalidate control region before releasing it
+    shmRingGetHeader(shmBase)->magic = 0;
+    munmap(shmBase, shmSize);
+  }
+  if (shmFd >= 0) {
+    close(shmFd);
+    shm_unlink(cfgShmName.c_str());
+  }
+}
+
+Thread::CallbackResult ReadoutEquipmentShmRing::prepareBlocks() {
+  if (!isDataOn) {
+    return Thread::CallbackResult::Idle;
+  }
+
+  // publish free pages to the producer
+  int nPushed = 0;
+  for (;;) {
+    void *newPage = mp->getPage();
+    if (newPage == nullptr) {
+      equipmentStats[EquipmentStatsIndexes::nMemoryLow].increment();
+      break;
+    }
+    ShmRingRecord r;
+    r.pageOffset = (char *)newPage - (char *)mp->getBaseBlockAddress();
+    r.dataSize = 0;
+    r.timeframeId = undefinedTimeframeId;
+    r.linkId = undefinedLinkId;
+    r.equipmentId = undefinedEquipmentId;
+    if (shmRingPush(freeQueue, freeRecords, ringCapacity, r)) {
+      // ring full, give page back
+      mp->releasePage(newPage);
+      break;
+    }
+    nPushed++;
+    statsPagesProvided++;
+  }
+  equipmentStats[EquipmentStatsIndexes::nPushedUp].increment(nPushed);
+
+  if (nPushed == 0) {
+    return Thread::CallbackResult::Idle;
+  }
+  return Thread::CallbackResult::Ok;
+}
+
+DataBlockContainerReference ReadoutEquipmentShmRing::getNextBlock() {
+
+  // get next filled page published by the producer
+  ShmRingRecord r;
+  if (shmRingPop(readyQueue, readyRecords, ringCapacity, r)) {
+    return nullptr;
+  }
+
+  void *pageAddress = (char *)mp->getBaseBlockAddress() + r.pageOffset;
+  if (!mp->isPageValid(pageAddress)) {
+    theLog.log(InfoLogger::Severity::Warning,
+               "Got an invalid page from ready ring : offset 0x%lX",
+               (unsigned long)r.pageOffset);
+    statsPagesInvalid++;
+    return nullptr;
+  }
+
+  DataBlockContainerReference nextBlock = nullptr;
+  try {
+    // there is some space reserved at beginning of page for a DataBlock
+    nextBlock = mp->getNewDataBlockContainer(pageAddress);
+  } catch (...) {
+  }
+  if (nextBlock == nullptr) {
+    mp->releasePage(pageAddress);
+    return nullptr;
+  }
+
+  // fill page metadata from ready record
+  DataBlock *b = nextBlock->getData();
+  uint64_t maxSize = mp->getDataBlockMaxSize();
+  if (r.dataSize > maxSize) {
+    r.dataSize = maxSize;
+  }
+  b->header.dataSize = r.dataSize;
+  b->header.linkId = r.linkId;
+  b->header.equipmentId = r.equipmentId;
+  b->header.timeframeId = r.timeframeId;
+
+  statsPagesReceived++;
+  return nextBlock;
+}
+
+void ReadoutEquipmentShmRing::initCounters() {
+  statsPagesProvided = 0;
+  statsPagesReceived = 0;
+  statsPagesInvalid = 0;
+}
+
+void ReadoutEquipmentShmRing::finalCounters() {
+  // reclaim pages still published in the free ring.
+  // the producer shall be stopped at this point.
+  int nReclaimed = 0;
+  ShmRingRecord r;
+  while (!shmRingPop(freeQueue, freeRecords, ringCapacity, r)) {
+    mp->releasePage((char *)mp->getBaseBlockAddress() + r.pageOffset);
+    nReclaimed++;
+  }
+  theLog.log("Equipment %s : %llu pages provided, %llu received, %llu "
+             "invalid, %d free pages reclaimed",
+             name.c_str(), statsPagesProvided, statsPagesReceived,
+             statsPagesInvalid, nReclaimed);
+}
+
+std::unique_ptr<ReadoutEquipment>
+getReadoutEquipmentShmRing(ConfigFile &cfg, std::string cfgEntryPoint) {
+  return std::make_unique<ReadoutEquipmentShmRing>(cfg, cfgEntryPoint);
+}
@@ -20,86 +20,93 @@ extern InfoLogger theLog;
 class ReadoutEquipmentZmq : public ReadoutEquipment {
 
 public:
-  ReadoutEquipmentZmq(ConfigFile &cfg, std::string name = "dummyReadout");
+  ReadoutEquipmentZmq(ConfigFile &cfg, std::string name = "zmqReadout");
   ~ReadoutEquipmentZmq();
   DataBlockContainerReference getNextBlock();
 
 private:
+  void initCounters();
+  void finalCounters();
+
   Thread::CallbackResult populateFifoOut(); // iterative callback
 
-  void *context=nullptr;
-  void *zh=nullptr;
+  std::string cfgAddress = ""; // address of remote data source
+  int cfgMaxMessageSize =
+      0; // expected maximum size of one message, in bytes. Batching of
+         // several messages in a page stops when remaining space is below
+         // this value.
+  int cfgMaxMessagesPerPage = 0; // if set, maximum number of messages
+                                 // aggregated in each data page
+
+  void *context = nullptr; // ZMQ context
+  void *zh = nullptr;      // ZMQ socket handle
+
+  DataBlockContainerReference
+      pendingBlock; // empty page kept between calls until some data received
+
+  unsigned long long statsNumberOfMessages = 0; // number of messages received
+  unsigned long long statsNumberOfTruncated =
+      0; // number of messages dropped because not fitting in page
 };
 
 ReadoutEquipmentZmq::ReadoutEquipmentZmq(ConfigFile &cfg,
-                                             std::string cfgEntryPoint)
+                                         std::string cfgEntryPoint)
     : ReadoutEquipment(cfg, cfgEntryPoint) {
 
- printf ("Connecting to DCS ADAPOS server\n");
-int err=0;
-
-context = zmq_ctx_new ();
-if (context!=nullptr) {
- zh = zmq_socket (context, ZMQ_PULL);
- if (zh!=nullptr) {
-   
-   err=zmq_connect (zh,"tcp://localhost:5555");
-   if (err) { throw __LINE__; } // zmq_errno()
-
-     int timeout = 10000;
-     err=zmq_setsockopt(zh, ZMQ_RCVTIMEO, (void*) &timeout, sizeof(int));
-     printf("err=%d, zmq_errno returned %d.\n", err, zmq_errno());
-     timeout=0;
-     size_t argsz=sizeof(timeout);
-     err=zmq_getsockopt(zh, ZMQ_RCVTIMEO, (void*) &timeout, &argsz);
-     printf("err=%d, timeout=%d argsz=%d\n", err, timeout,(int)argsz);
-     
-     zmq_msg_t msg;
-     err=zmq_msg_init(&msg);
-     if (err) { throw __LINE__;}
-   
-     int nbytes=zmq_recvmsg(zh, &msg,0);
-     if (nbytes) {
-       err=zmq_errno();
-       printf("zmq_errno returned %d = %s\n", err,zmq_strerror(err));
-       printf("received %d\n",nbytes);
-       zmq_msg_close (&msg);
-     }
-   }
- }
-/*
-int i;
-for (i=0;i<50;i++) {
-  zmq_msg_t msg;
-  err=zmq_msg_init(&msg);
-  if (err) {
-    return __LINE__;
+  // get configuration values
+  // configuration parameter: | equipment-zmq-* | address | string |
+  // tcp://localhost:5555 | Address of remote data source, eg
+  // tcp://remoteHost:12345. |
+  cfgAddress = "tcp://localhost:5555";
+  cfg.getOptionalValue<std::string>(cfgEntryPoint + ".address", cfgAddress);
+  // configuration parameter: | equipment-zmq-* | maxMessageSize | bytes | 128k
+  // | Expected maximum size of one message. Several messages are aggregated
+  // in each data page; batching stops when remaining page space is below this
+  // value. Messages bigger than the remaining space are dropped. |
+  std::string cfgStringMaxMessageSize = "128k";
+  cfg.getOptionalValue<std::string>(cfgEntryPoint + ".maxMessageSize",
+                                    cfgStringMaxMessageSize);
+  cfgMaxMessageSize = (int)ReadoutUtils::getNumberOfBytesFromString(
+      cfgStringMaxMessageSize.c_str());
+  // configuration parameter: | equipment-zmq-* | maxMessagesPerPage | int | 0
+  // | If set, maximum number of messages aggregated in each data page. If 0,
+  // messages are aggregated until page is full. |
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".maxMessagesPerPage",
+                            cfgMaxMessagesPerPage);
+
+  // log config summary
+  theLog.log("Equipment %s: address=%s maxMessageSize=%d maxMessagesPerPage=%d",
+             name.c_str(), cfgAddress.c_str(), cfgMaxMessageSize,
+             cfgMaxMessagesPerPage);
+
+  // create ZMQ context and socket, connect to remote data source
+  int err = 0;
+  context = zmq_ctx_new();
+  if (context == nullptr) {
+    theLog.logError("Failed to create ZMQ context");
+    throw __LINE__;
   }
-
-  int nbytes=zmq_recvmsg(zh, &msg,0);
-  if (nbytes) {
-    err=zmq_errno();
-    printf("zmq_errno returned %d = %s\n", err,zmq_strerror(err));
-    printf("received %d\n",nbytes);
-    zmq_msg_close (&msg);
-  } else {
-    fflush(stdout);  
-    usleep(100000);
+  zh = zmq_socket(context, ZMQ_PULL);
+  if (zh == nullptr) {
+    theLog.logError("Failed to create ZMQ socket");
+    throw __LINE__;
+  }
+  err = zmq_connect(zh, cfgAddress.c_str());
+  if (err) {
+    theLog.log(InfoLogger::Severity::Error,
+               "Failed to connect ZMQ socket to %s : %s", cfgAddress.c_str(),
+               zmq_strerror(zmq_errno()));
+    throw __LINE__;
   }
 }
-*/
-
- }
 
 ReadoutEquipmentZmq::~ReadoutEquipmentZmq() {
-
-  if (zh!=nullptr) {
-    zmq_close (zh);
+  if (zh != nullptr) {
+    zmq_close(zh);
   }
-  if (context!=nullptr) {
-    zmq_ctx_destroy (context);
+  if (context != nullptr) {
+    zmq_ctx_destroy(context);
   }
-
 }
 
 DataBlockContainerReference ReadoutEquipmentZmq::getNextBlock() {
@@ -108,29 +115,73 @@ DataBlockContainerReference ReadoutEquipmentZmq::getNextBlock() {
     return nullptr;
   }
 
-  // query memory pool for a free block
-  DataBlockContainerReference nextBlock = nullptr;
-  try {
-    nextBlock = mp->getNewDataBlockContainer();
-  } catch (...) {
+  // get a free page from memory pool, and keep it accross calls until some
+  // data is received: messages are read directly into page memory, no
+  // intermediate buffer / copy.
+  if (pendingBlock == nullptr) {
+    try {
+      pendingBlock = mp->getNewDataBlockContainer();
+    } catch (...) {
+    }
+    if (pendingBlock == nullptr) {
+      return nullptr;
+    }
+  }
+  DataBlock *b = pendingBlock->getData();
+  size_t pageSize = mp->getDataBlockMaxSize();
+
+  // receive a batch of messages, each appended in page at current offset
+  size_t dSize = 0;
+  int nMessages = 0;
+  for (;;) {
+    size_t bytesLeft = pageSize - dSize;
+    if ((int)bytesLeft < cfgMaxMessageSize) {
+      // page considered full: next message might not fit
+      break;
+    }
+    int nBytes = zmq_recv(zh, &b->data[dSize], bytesLeft, ZMQ_DONTWAIT);
+    if (nBytes < 0) {
+      // no more messages pending (or error)
+      break;
+    }
+    if ((size_t)nBytes > bytesLeft) {
+      // message was truncated, drop it
+      statsNumberOfTruncated++;
+      continue;
+    }
+    dSize += nBytes;
+    nMessages++;
+    statsNumberOfMessages++;
+    if ((cfgMaxMessagesPerPage) && (nMessages >= cfgMaxMessagesPerPage)) {
+      break;
+    }
   }
 
-  // format data block
-  if (nextBlock != nullptr) {
-    DataBlock *b = nextBlock->getData();
-
-    // set size
-    int dSize = 0;
-    
-    // no need to fill header defaults, this is done by getNewDataBlockContainer()
-    // only adjust payload size
-    b->header.dataSize = dSize;
-    //b->data[k] = (char)k;
+  if (dSize == 0) {
+    // nothing received, keep page for next call
+    return nullptr;
   }
 
+  // no need to fill header defaults, this is done by getNewDataBlockContainer()
+  // only adjust payload size
+  b->header.dataSize = dSize;
+
+  DataBlockContainerReference nextBlock = pendingBlock;
+  pendingBlock = nullptr;
   return nextBlock;
 }
 
+void ReadoutEquipmentZmq::initCounters() {
+  pendingBlock = nullptr;
+  statsNumberOfMessages = 0;
+  statsNumberOfTruncated = 0;
+}
+
+void ReadoutEquipmentZmq::finalCounters() {
+  theLog.log("Equipment %s : %llu messages received, %llu truncated",
+             name.c_str(), statsNumberOfMessages, statsNumberOfTruncated);
+}
+
 std::unique_ptr<ReadoutEquipment>
 getReadoutEquipmentZmq(ConfigFile &cfg, std::string cfgEntryPoint) {
   return std::make_unique<ReadoutEquipmentZmq>(cfg, cfgEntryPoint);
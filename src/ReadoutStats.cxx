@@ -18,6 +18,15 @@
 
 #include "ReadoutStats.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 // get global log handle
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
@@ -28,7 +37,7 @@ ReadoutStats gReadoutStats;
 
 ReadoutStats::ReadoutStats() { reset(); }
 
-ReadoutStats::~ReadoutStats() {}
+ReadoutStats::~ReadoutStats() { stopShmExport(); }
 
 void ReadoutStats::reset() {
   numberOfSubtimeframes = 0;
@@ -45,3 +54,117 @@ void ReadoutStats::print() {
              (unsigned long long)bytesRecorded.load(),
              (unsigned long long)bytesFairMQ.load());
 }
+
+int ReadoutStats::startShmExport(const std::string &path) {
+  stopShmExport();
+  shmFd = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (shmFd < 0) {
+    theLog.log(InfoLogger::Severity::Error,
+               "Failed to create stats segment %s : %s", path.c_str(),
+               strerror(errno));
+    return -1;
+  }
+  if (ftruncate(shmFd, sizeof(ReadoutStatsShm))) {
+    close(shmFd);
+    shmFd = -1;
+    return -1;
+  }
+  void *ptr = mmap(nullptr, sizeof(ReadoutStatsShm), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, shmFd, 0);
+  if (ptr == MAP_FAILED) {
+    close(shmFd);
+    shmFd = -1;
+    return -1;
+  }
+  shmPath = path;
+  shm = new (ptr) ReadoutStatsShm;
+  memset((void *)shm->sources, 0, sizeof(shm->sources));
+  shm->version.store(ReadoutStatsShmVersion);
+  shm->pid.store((uint32_t)getpid());
+  shm->startTime.store((uint64_t)time(nullptr));
+  shm->updateTime.store((uint64_t)time(nullptr));
+  // magic written last: readers consider the segment valid only when set
+  shm->magic.store(ReadoutStatsShmMagic);
+  theLog.log("Readout stats exported to %s (%d bytes)", path.c_str(),
+             (int)sizeof(ReadoutStatsShm));
+  return 0;
+}
+
+void ReadoutStats::stopShmExport() {
+  if (shm != nullptr) {
+    shm->magic.store(0); // flag segment invalid
+    munmap((void *)shm, sizeof(ReadoutStatsShm));
+    shm = nullptr;
+  }
+  if (shmFd >= 0) {
+    close(shmFd);
+    shmFd = -1;
+  }
+  if (shmPath.length()) {
+    unlink(shmPath.c_str());
+    shmPath.clear();
+  }
+}
+
+void ReadoutStats::updateShmExport(double elapsedTime) {
+  if (shm == nullptr) {
+    return;
+  }
+  uint64_t vReadout = bytesReadout.load();
+  uint64_t vRecorded = bytesRecorded.load();
+  uint64_t vFairMQ = bytesFairMQ.load();
+  if (elapsedTime > 0) {
+    // the segment still holds the values of the previous update: derive
+    // rates from the difference before overwriting them
+    shm->bytesReadoutRate.store(
+        (uint64_t)((vReadout - shm->bytesReadout.load()) / elapsedTime));
+    shm->bytesRecordedRate.store(
+        (uint64_t)((vRecorded - shm->bytesRecorded.load()) / elapsedTime));
+    shm->bytesFairMQRate.store(
+        (uint64_t)((vFairMQ - shm->bytesFairMQ.load()) / elapsedTime));
+  }
+  shm->numberOfSubtimeframes.store(numberOfSubtimeframes.load());
+  shm->bytesReadout.store(vReadout);
+  shm->bytesRecorded.store(vRecorded);
+  shm->bytesFairMQ.store(vFairMQ);
+  shm->updateTime.store((uint64_t)time(nullptr));
+}
+
+void ReadoutStats::updateShmSource(const std::string &sourceName,
+                                   uint64_t bytes, uint64_t blocks,
+                                   double elapsedTime) {
+  if (shm == nullptr) {
+    return;
+  }
+  // lookup slot by name, or take first free one
+  ReadoutStatsSourceShm *slot = nullptr;
+  for (unsigned int i = 0; i < ReadoutStatsMaxSources; i++) {
+    if (strncmp(shm->sources[i].name, sourceName.c_str(),
+                ReadoutStatsSourceNameLength) == 0) {
+      slot = &shm->sources[i];
+      break;
+    }
+    if (shm->sources[i].name[0] == 0) {
+      slot = &shm->sources[i];
+      // name written after counters zeroed, so readers never see a named
+      // slot with stale values
+      slot->bytes.store(0);
+      slot->blocks.store(0);
+      slot->bytesPerSecond.store(0);
+      strncpy(slot->name, sourceName.c_str(),
+              ReadoutStatsSourceNameLength - 1);
+      slot->name[ReadoutStatsSourceNameLength - 1] = 0;
+      break;
+    }
+  }
+  if (slot == nullptr) {
+    // table full
+    return;
+  }
+  if (elapsedTime > 0) {
+    slot->bytesPerSecond.store(
+        (uint64_t)((bytes - slot->bytes.load()) / elapsedTime));
+  }
+  slot->bytes.store(bytes);
+  slot->blocks.store(blocks);
+}
@@ -15,7 +15,61 @@
 
 // This defines a class to keep trakc of some readout counters,
 
+#ifndef _READOUTSTATS_H
+#define _READOUTSTATS_H
+
+#include <Common/Timer.h>
 #include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Layout of the shared memory segment optionally exported by readout for
+// external monitoring (see readout.statsShmPath). Scrapers mmap the file
+// read-only and read the counters directly: no syscall, no lock, no
+// interaction with the readout process. All fields are lock-free atomics,
+// updated in place. The magic/version pair at the beginning allows readers
+// to check they understand the layout.
+
+constexpr uint64_t ReadoutStatsShmMagic =
+    0x5354415453523245ULL; // "E2RSTATS", flags a valid segment
+constexpr uint32_t ReadoutStatsShmVersion = 1;
+constexpr unsigned int ReadoutStatsMaxSources =
+    64; // maximum number of per-equipment / per-consumer slots
+constexpr unsigned int ReadoutStatsSourceNameLength =
+    32; // maximum source name length (including terminating zero)
+
+// one per-source (equipment or consumer) counter slot
+struct ReadoutStatsSourceShm {
+  char name[ReadoutStatsSourceNameLength]; // source name, zero-terminated.
+                                           // Empty = slot unused.
+  std::atomic<uint64_t> bytes;             // total bytes handled
+  std::atomic<uint64_t> blocks;            // total blocks handled
+  std::atomic<uint64_t> bytesPerSecond;    // rate over last update period
+};
+
+// the segment
+struct ReadoutStatsShm {
+  std::atomic<uint64_t> magic;      // ReadoutStatsShmMagic, written last at
+                                    // init: readers should wait for it
+  std::atomic<uint32_t> version;    // ReadoutStatsShmVersion
+  std::atomic<uint32_t> pid;        // pid of readout process
+  std::atomic<uint64_t> startTime;  // unix time when segment created
+  std::atomic<uint64_t> updateTime; // unix time of last rate update
+
+  // global counters (same as ReadoutStats)
+  std::atomic<uint64_t> numberOfSubtimeframes;
+  std::atomic<uint64_t> bytesReadout;
+  std::atomic<uint64_t> bytesRecorded;
+  std::atomic<uint64_t> bytesFairMQ;
+
+  // rates derived in-process over the last update period (bytes/s)
+  std::atomic<uint64_t> bytesReadoutRate;
+  std::atomic<uint64_t> bytesRecordedRate;
+  std::atomic<uint64_t> bytesFairMQRate;
+
+  // per-equipment / per-consumer slots
+  ReadoutStatsSourceShm sources[ReadoutStatsMaxSources];
+};
 
 class ReadoutStats {
 public:
@@ -24,10 +78,85 @@ public:
   void reset();
   void print();
 
-  std::atomic<uint64_t> numberOfSubtimeframes;
-  std::atomic<uint64_t> bytesReadout;
-  std::atomic<uint64_t> bytesRecorded;
-  std::atomic<uint64_t> bytesFairMQ;
+  // shared memory export of the counters, for external scrapers.
+  // startShmExport creates (overwrites) the file at given path and maps it.
+  // Returns 0 on success.
+  int startShmExport(const std::string &path);
+  void stopShmExport(); // unmap and remove the file
+
+  // refresh the exported segment: copy the global counters and derive the
+  // rates from the values stored at previous call. elapsedTime: time (in
+  // seconds) since previous call. To be called periodically (no effect if
+  // export not started).
+  void updateShmExport(double elapsedTime);
+
+  // update (or create on first use) the slot of the named source with given
+  // cumulated counters, deriving its rate from the previous slot content.
+  // To be called with same period as updateShmExport().
+  void updateShmSource(const std::string &sourceName, uint64_t bytes,
+                       uint64_t blocks, double elapsedTime);
+
+  // each counter on its own cache line: they are updated from different
+  // threads (equipments, consumers), a shared line would bounce between cores
+  alignas(64) std::atomic<uint64_t> numberOfSubtimeframes;
+  alignas(64) std::atomic<uint64_t> bytesReadout;
+  alignas(64) std::atomic<uint64_t> bytesRecorded;
+  alignas(64) std::atomic<uint64_t> bytesFairMQ;
+
+private:
+  ReadoutStatsShm *shm = nullptr; // mapped segment, when export enabled
+  int shmFd = -1;                 // file descriptor of segment
+  std::string shmPath;            // path of segment file
 };
 
 extern ReadoutStats gReadoutStats;
+
+// Local accumulator for one of the gReadoutStats counters above. On the hot
+// paths (consumer pushData, equipment readout loop), incrementing the shared
+// atomic per block makes its cache line bounce between threads at high block
+// rates. The accumulator keeps a local sum instead, flushed to the global
+// counter when a count or time threshold is reached, and on destruction.
+// One instance per updating thread: add() is not thread-safe.
+class ReadoutStatsBatch {
+public:
+  ~ReadoutStatsBatch() { flush(); }
+
+  // associate with one of the global counters. Any pending value for a
+  // previous association is flushed first.
+  void init(std::atomic<uint64_t> *vCounter) {
+    flush();
+    counter = vCounter;
+    flushTimer.reset(flushIntervalUs);
+  }
+
+  // account a value
+  inline void add(uint64_t value) {
+    localSum += value;
+    if ((++localSteps >= flushSteps) || (flushTimer.isTimeout())) {
+      flush();
+    }
+  }
+
+  // push the pending local sum to the global counter. To be called when the
+  // data flow stops, so that no delta stays behind in final statistics.
+  void flush() {
+    if ((counter != nullptr) && (localSum)) {
+      *counter += localSum;
+    }
+    localSum = 0;
+    localSteps = 0;
+    flushTimer.reset(flushIntervalUs);
+  }
+
+private:
+  static const int flushSteps = 100; // maximum number of add() between flushes
+  static const int flushIntervalUs =
+      100000; // maximum time between flushes (microseconds), so that exported
+              // counters stay fresh at low rate
+  std::atomic<uint64_t> *counter = nullptr; // associated global counter
+  uint64_t localSum = 0;                    // value accumulated locally
+  int localSteps = 0;                       // number of add() since last flush
+  AliceO2::Common::Timer flushTimer;        // time since last flush
+};
+
+#endif // #ifndef _READOUTSTATS_H
@@ -10,8 +10,10 @@
 
 #include "ReadoutUtils.h"
 #include <math.h>
+#include <sched.h>
 #include <sstream>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "RAWDataHeader.h"
@@ -80,6 +82,67 @@ std::string ReadoutUtils::NumberOfBytesToString(double value,
   return std::string(bufStr);
 }
 
+#ifdef __SSE4_2__
+
+// hardware implementation, using the SSE4.2 crc32 instructions
+// (8 bytes per instruction on the bulk of the data)
+
+#include <nmmintrin.h>
+
+const bool ReadoutUtils::crc32cHardware = true;
+
+uint32_t ReadoutUtils::crc32c(const void *data, size_t size) {
+  const uint8_t *ptr = (const uint8_t *)data;
+  uint64_t crc = 0xFFFFFFFF;
+  while (size >= sizeof(uint64_t)) {
+    uint64_t v;
+    memcpy(&v, ptr, sizeof(v));
+    crc = _mm_crc32_u64(crc, v);
+    ptr += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  uint32_t crc32 = (uint32_t)crc;
+  while (size > 0) {
+    crc32 = _mm_crc32_u8(crc32, *ptr);
+    ptr++;
+    size--;
+  }
+  return crc32 ^ 0xFFFFFFFF;
+}
+
+#else
+
+// software fallback, bytewise with a lookup table built on first use
+
+const bool ReadoutUtils::crc32cHardware = false;
+
+static uint32_t crc32cTable[256];
+static int crc32cTableInit = []() {
+  const uint32_t polynomial = 0x82F63B78; // CRC32C (Castagnoli), reflected
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+    }
+    crc32cTable[i] = crc;
+  }
+  return 0;
+}();
+
+uint32_t ReadoutUtils::crc32c(const void *data, size_t size) {
+  (void)crc32cTableInit;
+  const uint8_t *ptr = (const uint8_t *)data;
+  uint32_t crc = 0xFFFFFFFF;
+  while (size > 0) {
+    crc = (crc >> 8) ^ crc32cTable[(crc ^ *ptr) & 0xFF];
+    ptr++;
+    size--;
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+#endif
+
 void dumpRDH(o2::Header::RAWDataHeader *rdh) {
   printf("RDH:\tversion=%d\theader size=%d\tblock length=%d\n",
          (int)rdh->version, (int)rdh->headerSize, (int)rdh->blockLength);
@@ -134,6 +197,69 @@ std::string NumberOfBytesToString(double value, const char *suffix, int base) {
   return std::string(bufStr);
 }
 
+int setThreadCpuSet(const std::string &cpuSet) {
+  if (cpuSet.length() == 0) {
+    return -1;
+  }
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  int nCpusSet = 0;
+  // parse comma-separated list of CPU ids or ranges, e.g. "0-3,8,12"
+  std::size_t ix0 = 0;
+  for (;;) {
+    std::size_t ix1 = cpuSet.find(",", ix0);
+    std::string item = cpuSet.substr(
+        ix0, (ix1 == std::string::npos) ? std::string::npos : ix1 - ix0);
+    int cpuFirst = -1, cpuLast = -1;
+    if (sscanf(item.c_str(), "%d-%d", &cpuFirst, &cpuLast) == 2) {
+    } else if (sscanf(item.c_str(), "%d", &cpuFirst) == 1) {
+      cpuLast = cpuFirst;
+    } else {
+      return -1;
+    }
+    if ((cpuFirst < 0) || (cpuLast < cpuFirst) || (cpuLast >= CPU_SETSIZE)) {
+      return -1;
+    }
+    for (int cpu = cpuFirst; cpu <= cpuLast; cpu++) {
+      CPU_SET(cpu, &mask);
+      nCpusSet++;
+    }
+    if (ix1 == std::string::npos) {
+      break;
+    }
+    ix0 = ix1 + 1;
+  }
+  if (nCpusSet == 0) {
+    return -1;
+  }
+  // apply mask to calling thread
+  if (sched_setaffinity(0, sizeof(mask), &mask)) {
+    return -1;
+  }
+  return 0;
+}
+
+int getPciDeviceNumaNode(const std::string &pciAddress) {
+  int numaNode = -1;
+  if (pciAddress.length() == 0) {
+    return -1;
+  }
+  // sysfs uses full addresses with domain, e.g. 0000:3b:00.0
+  std::string fullAddress = pciAddress;
+  if (fullAddress.find(':') == fullAddress.rfind(':')) {
+    fullAddress = "0000:" + fullAddress;
+  }
+  std::string path = "/sys/bus/pci/devices/" + fullAddress + "/numa_node";
+  FILE *fp = fopen(path.c_str(), "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%d", &numaNode) != 1) {
+      numaNode = -1;
+    }
+    fclose(fp);
+  }
+  return numaNode;
+}
+
 int getProcessStats(double &uTime, double &sTime) {
   int err = -1;
   FILE *fp;
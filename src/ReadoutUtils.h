@@ -12,6 +12,8 @@
 #define _READOUTUTILS_H
 
 #include <map>
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
 
 #include <Common/Configuration.h>
@@ -29,6 +31,15 @@ long long getNumberOfBytesFromString(const char *inputString);
 // suffix is the "base unit" to add after calculated prefix, e.g. Byte-> kBytes
 std::string NumberOfBytesToString(double value, const char *suffix);
 
+// compute the CRC32C checksum (Castagnoli polynomial, as implemented by the
+// SSE4.2 crc32 instructions) of a memory area. The hardware instructions are
+// used when available at compile time, with a software fallback otherwise
+// (c.f. crc32cHardware).
+uint32_t crc32c(const void *data, size_t size);
+
+// true when crc32c() uses the SSE4.2 hardware instructions
+extern const bool crc32cHardware;
+
 } // namespace ReadoutUtils
 
 // print RDH struct content to stdout
@@ -50,5 +61,87 @@ std::string NumberOfBytesToString(double value, const char *suffix,
 // returns 0 on success, -1 on error
 int getProcessStats(double &uTime, double &sTime);
 
+// function to set the CPU affinity of the calling thread
+// input is a list of CPU ids, given as comma-separated values or ranges,
+// e.g. "0-3,8,12"
+// returns 0 on success, -1 on error
+int setThreadCpuSet(const std::string &cpuSet);
+
+// function to get the NUMA node of a PCI device, from sysfs
+// input is the PCI address, e.g. "3b:00.0" or "0000:3b:00.0"
+// returns the node number, or -1 if it can not be retrieved
+int getPciDeviceNumaNode(const std::string &pciAddress);
+
+// Optional creation timestamp stored in the reserved header space of a data
+// page, immediately after the DataBlock object (c.f.
+// equipment.pageTimestampEnabled). Consumers use it to measure the equipment
+// to consumer latency per block (see consumerType=latency).
+
+// value of PageTimestampHeader.magic when a valid timestamp is present
+const uint32_t PageTimestampMagic = 0x53544750; // "PGTS"
+
+struct PageTimestampHeader {
+  uint32_t magic;       // PageTimestampMagic when valid
+  uint32_t pad;         // unused, for alignment
+  uint64_t timeCreated; // CLOCK_MONOTONIC time when the block was pushed out
+                        // by the equipment, in nanoseconds (c.f.
+                        // PageEventTrace::getTimestamp())
+};
+
+// fixed size (in bytes) of the reserved timestamp area, padded so that the
+// payload alignment is shifted by a full cache line when enabled
+const size_t PageTimestampReservedSpace = 64;
+
+// Get the timestamp of a page, given the address of the end of its DataBlock
+// object (where the timestamp area starts) and of its payload. Returns
+// nullptr when the page has no (valid) timestamp: gap too small for the
+// area, or magic not set.
+inline const PageTimestampHeader *getPageTimestamp(const void *headerEndPtr,
+                                                   const void *payloadPtr) {
+  if ((const char *)payloadPtr - (const char *)headerEndPtr <
+      (ptrdiff_t)sizeof(PageTimestampHeader)) {
+    return nullptr;
+  }
+  const PageTimestampHeader *h = (const PageTimestampHeader *)headerEndPtr;
+  if (h->magic != PageTimestampMagic) {
+    return nullptr;
+  }
+  return h;
+}
+
+// Optional payload checksum stored in the reserved header space of a data
+// page, at a fixed offset after the timestamp slot (c.f.
+// equipment.pageChecksumEnabled for the space reservation). It is stamped by
+// the consumers computing a payload CRC (c.f. consumer-FairMQchannel-*
+// checksumEnabled), so that the page integrity can be verified later.
+
+// value of PageChecksumHeader.magic when a valid checksum is present
+const uint32_t PageChecksumMagic = 0x4b434750; // "PGCK"
+
+struct PageChecksumHeader {
+  uint32_t magic;  // PageChecksumMagic when valid
+  uint32_t crc32c; // CRC32C of the page payload (c.f. ReadoutUtils::crc32c)
+};
+
+// fixed size (in bytes) of the reserved checksum area
+const size_t PageChecksumReservedSpace = 64;
+
+// Get the (writable) checksum area of a page, given the address of the end of
+// its DataBlock object and of its payload. The area starts after the
+// timestamp slot, which is always reserved when the checksum one is. Returns
+// nullptr when the gap between header and payload is too small for the area,
+// i.e. the page does not have the space reserved. The magic is NOT checked:
+// use this to stamp a checksum, or check magic == PageChecksumMagic before
+// reading one.
+inline PageChecksumHeader *getPageChecksumArea(void *headerEndPtr,
+                                               const void *payloadPtr) {
+  char *areaPtr = (char *)headerEndPtr + PageTimestampReservedSpace;
+  if ((const char *)payloadPtr - areaPtr <
+      (ptrdiff_t)sizeof(PageChecksumHeader)) {
+    return nullptr;
+  }
+  return (PageChecksumHeader *)areaPtr;
+}
+
 // end of _READOUTUTILS_H
 #endif
@@ -0,0 +1,118 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef _SHMRING_H
+#define _SHMRING_H
+
+// definition of the shared-memory control region used by equipment-shmring
+// to exchange data pages with a local external producer process.
+//
+// The control region (a POSIX shared memory object) holds two
+// single-producer single-consumer rings of page records:
+// - the "free" ring: written by readout, read by the producer. It publishes
+//   data pages available for writing.
+// - the "ready" ring: written by the producer, read by readout. It publishes
+//   pages filled with data, with their metadata.
+// Page records give offsets relative to the beginning of the data region:
+// the big memory block of the readout memory pool, which the producer maps
+// separately (e.g. the hugepage-backed file of the corresponding memory
+// bank). The producer must write payload data at pageOffset + payloadOffset,
+// up to payloadMaxSize bytes, and report the size written in the ready
+// record. No socket or syscall is involved on the data path.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+const uint32_t ShmRingMagic = 0x52494E47; // to identify control region
+const uint32_t ShmRingVersion = 1;        // layout version
+
+// fixed-size description of the ring layout, at beginning of control region
+struct ShmRingHeader {
+  uint32_t magic;         // ShmRingMagic
+  uint32_t version;       // ShmRingVersion
+  uint64_t pageSize;      // size of one data page, in bytes
+  uint64_t numberOfPages; // number of pages in data region
+  uint64_t capacity;      // number of record slots in each ring
+  uint64_t payloadOffset; // where producer shall write data in page
+  uint64_t payloadMaxSize; // maximum number of payload bytes per page
+};
+
+// description of one data page exchanged through a ring
+struct ShmRingRecord {
+  uint64_t pageOffset;  // offset of page from beginning of data region
+  uint64_t dataSize;    // number of payload bytes written (ready ring)
+  uint64_t timeframeId; // timeframe id of data in page (ready ring)
+  uint32_t linkId;      // link id of data in page (ready ring)
+  uint32_t equipmentId; // equipment (CRU) id of data in page (ready ring)
+};
+
+// indexes of one single-producer single-consumer ring
+// (records stored separately, see layout below)
+struct ShmRingQueue {
+  std::atomic<uint64_t> writeIndex; // index of next record to be written
+  std::atomic<uint64_t> readIndex;  // index of next record to be read
+};
+
+// layout of control region:
+// [ShmRingHeader][free ShmRingQueue][ready ShmRingQueue]
+// [capacity x ShmRingRecord (free)][capacity x ShmRingRecord (ready)]
+
+inline size_t shmRingGetSize(uint64_t capacity) {
+  return sizeof(ShmRingHeader) + 2 * sizeof(ShmRingQueue) +
+         2 * capacity * sizeof(ShmRingRecord);
+}
+inline ShmRingHeader *shmRingGetHeader(void *base) {
+  return (ShmRingHeader *)base;
+}
+inline ShmRingQueue *shmRingGetFreeQueue(void *base) {
+  return (ShmRingQueue *)((char *)base + sizeof(ShmRingHeader));
+}
+inline ShmRingQueue *shmRingGetReadyQueue(void *base) {
+  return (ShmRingQueue *)((char *)base + sizeof(ShmRingHeader) +
+                          sizeof(ShmRingQueue));
+}
+inline ShmRingRecord *shmRingGetFreeRecords(void *base) {
+  return (ShmRingRecord *)((char *)base + sizeof(ShmRingHeader) +
+                           2 * sizeof(ShmRingQueue));
+}
+inline ShmRingRecord *shmRingGetReadyRecords(void *base) {
+  ShmRingHeader *h = shmRingGetHeader(base);
+  return shmRingGetFreeRecords(base) + h->capacity;
+}
+
+// append a record to given ring
+// returns 0 on success, -1 when ring full
+inline int shmRingPush(ShmRingQueue *q, ShmRingRecord *records,
+                       uint64_t capacity, const ShmRingRecord &r) {
+  uint64_t w = q->writeIndex.load(std::memory_order_relaxed);
+  uint64_t rd = q->readIndex.load(std::memory_order_acquire);
+  if (w - rd >= capacity) {
+    return -1;
+  }
+  records[w % capacity] = r;
+  q->writeIndex.store(w + 1, std::memory_order_release);
+  return 0;
+}
+
+// retrieve next record from given ring
+// returns 0 on success, -1 when ring empty
+inline int shmRingPop(ShmRingQueue *q, ShmRingRecord *records,
+                      uint64_t capacity, ShmRingRecord &r) {
+  uint64_t rd = q->readIndex.load(std::memory_order_relaxed);
+  uint64_t w = q->writeIndex.load(std::memory_order_acquire);
+  if (rd == w) {
+    return -1;
+  }
+  r = records[rd % capacity];
+  q->readIndex.store(rd + 1, std::memory_order_release);
+  return 0;
+}
+#endif // #ifndef _SHMRING_H
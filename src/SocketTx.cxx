@@ -25,20 +25,42 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
 #include "ReadoutUtils.h"
 #include <InfoLogger/InfoLogger.hxx>
 using namespace AliceO2::InfoLogger;
 extern InfoLogger theLog; // hook to global infologger handle
 
-SocketTx::SocketTx(std::string name, std::string host, int port) {
+// depth of the input queue of blocks to be sent
+const unsigned int socketTxQueueSize = 100;
+
+SocketTx::SocketTx(std::string name, std::string host, int port, int zeroCopy,
+                   int batchSize) {
   shutdownRequest = 0;
   clientName = name;
   serverHost = host;
   serverPort = port;
+  cfgZeroCopy = zeroCopy;
+  cfgBatchSize = batchSize;
+  if (cfgBatchSize < 1) {
+    cfgBatchSize = 1;
+  }
+
+#ifndef MSG_ZEROCOPY
+  if (cfgZeroCopy) {
+    theLog.log("%s: MSG_ZEROCOPY not available on this platform, using "
+               "standard writes",
+               clientName.c_str());
+    cfgZeroCopy = 0;
+  }
+#endif
 
-  isSending = 0;
-  currentBlock = nullptr;
-  // blocks=std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(100);
+  blocks =
+      std::make_unique<AliceO2::Common::Fifo<DataBlockContainerReference>>(
+          socketTxQueueSize);
 
   std::function<void(void)> f = std::bind(&SocketTx::run, this);
   th = std::make_unique<std::thread>(f);
@@ -49,11 +71,63 @@ SocketTx::~SocketTx() {
   if (th != nullptr) {
     th->join();
   }
-  if (currentBlock != nullptr) {
-    theLog.log("%s: block sent incomplete : %lu/%u", clientName.c_str(),
-               currentBlockIndex, currentBlock->getData()->header.dataSize);
-    currentBlock = nullptr;
+  if (!blocks->isEmpty()) {
+    theLog.log("%s: some blocks not sent", clientName.c_str());
+    blocks->clear();
   }
+  zcPending.clear();
+}
+
+void SocketTx::zcCollectCompletions(int sockfd) {
+#ifdef MSG_ZEROCOPY
+  // transmission completions are reported on the socket error queue, as
+  // ranges of sendmsg() sequence numbers
+  for (;;) {
+    struct msghdr msg;
+    char control[100];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int n = recvmsg(sockfd, &msg, MSG_ERRQUEUE);
+    if (n < 0) {
+      // nothing pending (or error): done
+      break;
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (((cm->cmsg_level != SOL_IP) || (cm->cmsg_type != IP_RECVERR)) &&
+          ((cm->cmsg_level != SOL_IPV6) || (cm->cmsg_type != IPV6_RECVERR))) {
+        continue;
+      }
+      struct sock_extended_err *serr =
+          (struct sock_extended_err *)CMSG_DATA(cm);
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      if ((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) &&
+          (!zcCopiedReported)) {
+        theLog.log("%s: kernel copied zerocopy send (data not pinnable), "
+                   "performance may degrade",
+                   clientName.c_str());
+        zcCopiedReported = true;
+      }
+      // completed range is [ee_info, ee_data]
+      uint32_t hi = serr->ee_data;
+      if ((int32_t)(hi + 1 - zcSeqAcked) > 0) {
+        zcSeqAcked = hi + 1;
+      }
+    }
+    // release references of fully completed batches
+    while (!zcPending.empty()) {
+      if ((int32_t)(zcSeqAcked - (zcPending.front().zcSeq + 1)) < 0) {
+        break;
+      }
+      zcPending.pop_front();
+    }
+  }
+#else
+  (void)sockfd;
+#endif
 }
 
 void SocketTx::run() {
@@ -89,38 +163,153 @@ void SocketTx::run() {
     return;
   }
 
+#ifdef MSG_ZEROCOPY
+  if (cfgZeroCopy) {
+    int one = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one))) {
+      theLog.log("%s: failed to set SO_ZEROCOPY (%s), using standard writes",
+                 clientName.c_str(), strerror(errno));
+      cfgZeroCopy = 0;
+    }
+  }
+#endif
+
   char h[100];
   gethostname(h, 100);
   clientName += std::string(" @ ") + h + " -> " + serverHost + ":" +
                 std::to_string(serverPort);
-  theLog.log("%s connected", clientName.c_str());
+  theLog.log("%s connected (zeroCopy=%d batchSize=%d)", clientName.c_str(),
+             cfgZeroCopy, cfgBatchSize);
+
+  // loop: batch queued blocks and send them
+  std::vector<DataBlockContainerReference> batch;
+  std::vector<struct iovec> iov;
+  batch.reserve(cfgBatchSize);
+  iov.reserve(cfgBatchSize);
 
-  // loop: send current block, if any
   for (;;) {
-    if (isSending) {
-      size_t cs = currentBlock->getData()->header.dataSize - currentBlockIndex;
-      int n =
-          write(sockfd, &currentBlock->getData()->data[currentBlockIndex], cs);
-      if (n == 0) {
+
+    if (cfgZeroCopy) {
+      zcCollectCompletions(sockfd);
+      if (zcPending.size() >= zcMaxPending) {
+        // too many sends pending completion, wait
+        usleep(10);
+        if (shutdownRequest) {
+          break;
+        }
+        continue;
+      }
+    }
+
+    // collect up to cfgBatchSize blocks from input queue
+    batch.clear();
+    iov.clear();
+    size_t batchBytes = 0;
+    while ((int)batch.size() < cfgBatchSize) {
+      DataBlockContainerReference b = nullptr;
+      if (blocks->pop(b)) {
         break;
       }
-      if (n > 0) {
-        bytesTx += n;
-        currentBlockIndex += n;
-        if (currentBlockIndex == currentBlock->getData()->header.dataSize) {
-          currentBlock = nullptr;
-          isSending = 0;
-        }
+      struct iovec v;
+      v.iov_base = (void *)b->getData()->data;
+      v.iov_len = (size_t)b->getData()->header.dataSize;
+      iov.push_back(v);
+      batchBytes += v.iov_len;
+      batch.push_back(b);
+    }
+
+    if (batch.empty()) {
+      if (shutdownRequest) {
+        break;
+      }
+      usleep(10);
+      continue;
+    }
+
+    // send the whole batch in as few syscalls as possible, handling partial
+    // sends
+    size_t sent = 0;
+    unsigned int iovIx = 0;
+    bool txError = false;
+    while (sent < batchBytes) {
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov[iovIx];
+      msg.msg_iovlen = iov.size() - iovIx;
+      int flags = 0;
+#ifdef MSG_ZEROCOPY
+      if (cfgZeroCopy) {
+        flags |= MSG_ZEROCOPY;
       }
+#endif
+      ssize_t n = sendmsg(sockfd, &msg, flags);
       if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+#ifdef MSG_ZEROCOPY
+        if ((cfgZeroCopy) && (errno == ENOBUFS)) {
+          // optmem limit reached, wait for completions
+          zcCollectCompletions(sockfd);
+          usleep(10);
+          continue;
+        }
+#endif
+        txError = true;
         break;
       }
-    } else {
-      usleep(10);
+      if (n == 0) {
+        txError = true;
+        break;
+      }
+      if (cfgZeroCopy) {
+        zcSeqNext++; // each successful MSG_ZEROCOPY sendmsg() gets a sequence
+      }
+      sent += n;
+      bytesTx += n;
+      // advance iovec past what was sent
+      size_t left = n;
+      while ((left) && (iovIx < iov.size())) {
+        if (left >= iov[iovIx].iov_len) {
+          left -= iov[iovIx].iov_len;
+          iovIx++;
+        } else {
+          iov[iovIx].iov_base = (char *)iov[iovIx].iov_base + left;
+          iov[iovIx].iov_len -= left;
+          left = 0;
+        }
+      }
     }
+    if (txError) {
+      break;
+    }
+
+    if (cfgZeroCopy) {
+      // keep references until the last sendmsg() of this batch completes
+      PendingZcBatch p;
+      p.zcSeq = zcSeqNext - 1;
+      p.refs = std::move(batch);
+      zcPending.push_back(std::move(p));
+    }
+    // (otherwise references released here with batch)
 
     if (shutdownRequest) {
-      break;
+      // flush queue on shutdown only if empty batches remain, exit loop
+      if (blocks->isEmpty()) {
+        break;
+      }
+    }
+  }
+
+  // wait for pending zerocopy completions
+  if (cfgZeroCopy) {
+    for (int i = 0; (i < 1000) && (!zcPending.empty()); i++) {
+      zcCollectCompletions(sockfd);
+      usleep(1000);
+    }
+    if (!zcPending.empty()) {
+      theLog.log("%s: %d zerocopy sends still pending on close",
+                 clientName.c_str(), (int)zcPending.size());
     }
   }
 
@@ -139,15 +328,10 @@ void SocketTx::run() {
 }
 
 int SocketTx::pushData(DataBlockContainerReference &b) {
-  if (isSending) {
-    // there's already a block queued
+  // queue block
+  if (blocks->push(b)) {
+    // queue full
     return -1;
   }
-
-  // queue block
-  currentBlockIndex = 0;
-  currentBlock = b;
-  isSending = 1;
-
   return 0;
 }
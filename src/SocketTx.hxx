@@ -10,9 +10,11 @@
 
 #include <Common/Timer.h>
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <Common/DataBlock.h>
 #include <Common/DataBlockContainer.h>
@@ -26,22 +28,27 @@ public:
   // name: name given to this client, for logging purpose
   // serverHost: IP of remote server to connect to
   // serverPort: port number of remote server to connect to
-  SocketTx(std::string name, std::string serverHost, int serverPort);
+  // zeroCopy: when set, pages are sent with MSG_ZEROCOPY (kernel does not
+  // copy payload to socket buffers; page references are kept until the
+  // kernel reports transmission completed on the socket error queue)
+  // batchSize: maximum number of queued pages grouped in a single sendmsg()
+  // call (scatter-gather), to reduce per-page syscall overhead
+  SocketTx(std::string name, std::string serverHost, int serverPort,
+           int zeroCopy = 0, int batchSize = 1);
 
   // destructor
   ~SocketTx();
 
   // push a new piece of data to output socket
-  // returns 0 on success, or -1 on error (e.g. when already busy sending
-  // something)
+  // returns 0 on success, or -1 on error (e.g. when send queue full)
   int pushData(DataBlockContainerReference &b);
 
 private:
   std::unique_ptr<std::thread> th;  // thread pushing data to socket
   std::atomic<int> shutdownRequest; // flag to be set to 1 to stop thread
 
-  // todo: create an input queue, instead of single block
-  // std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>> blocks;
+  // input queue of blocks to be sent
+  std::unique_ptr<AliceO2::Common::Fifo<DataBlockContainerReference>> blocks;
 
   unsigned long long bytesTx = 0; // number of bytes sent
   AliceO2::Common::Timer t;       // timer, to count active time
@@ -50,12 +57,26 @@ private:
   std::string serverHost; // remote server IP
   int serverPort;         // remote server port
 
-private:
-  std::atomic<int> isSending; // if set, thread busy sending. if not set, new
-                              // block can be pushed
-  DataBlockContainerReference currentBlock =
-      nullptr;                  // current data chunk being sent
-  size_t currentBlockIndex = 0; // number of bytes of chunk already sent
+  int cfgZeroCopy = 0;  // when set, send with MSG_ZEROCOPY
+  int cfgBatchSize = 1; // maximum number of pages per sendmsg() call
+
+  // blocks sent with MSG_ZEROCOPY, kept referenced until the kernel reports
+  // the corresponding send completed (socket error queue). zcSeq is the
+  // sequence number of the last sendmsg() call having touched these blocks.
+  struct PendingZcBatch {
+    uint32_t zcSeq;
+    std::vector<DataBlockContainerReference> refs;
+  };
+  std::deque<PendingZcBatch> zcPending;
+  uint32_t zcSeqNext = 0; // sequence number of next MSG_ZEROCOPY sendmsg()
+  uint32_t zcSeqAcked = 0; // highest sequence number completed (+1)
+  bool zcCopiedReported = false; // flag to report kernel copy fallback once
+
+  // maximum number of batches pending zerocopy completion before send pauses
+  static const unsigned int zcMaxPending = 256;
+
+  // collect zerocopy completions from socket error queue, release references
+  void zcCollectCompletions(int sockfd);
 
   void run(); // code executed in separate thread
 };
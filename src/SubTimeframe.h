@@ -19,3 +19,46 @@ struct SubTimeframe {
   uint32_t numberOfHBF; // number of HB frames (i.e. following messages)
   uint8_t linkId;       // common link id of all data in this HBframe
 };
+
+// extended header message for the batched format
+// (consumer-FairMQChannel enableRawFormat=3)
+// subtimeframe made of 1 message with this header followed by 1 message per
+// data page: instead of one message per heartbeat-frame, the HBF boundaries
+// in the concatenated payload of the following messages are given by an index
+// table appended to this header. The header message size is
+// sizeof(SubTimeframeIndexed) + numberOfOffsets * sizeof(uint32_t).
+struct SubTimeframeIndexed {
+  SubTimeframe stf;         // common subtimeframe header
+  uint32_t numberOfOffsets; // number of entries in the index table. Normally
+                            // equal to stf.numberOfHBF, may be less if the
+                            // table was truncated (header page full).
+  // followed by numberOfOffsets uint32_t: offset of the first packet of each
+  // HB frame, counted from the beginning of the concatenated payload of the
+  // following messages
+};
+
+// description of one payload message part, as found in the table following
+// struct SubTimeframeV2
+struct SubTimeframePartDescriptor {
+  uint32_t offset;     // offset of this part in the concatenated payload
+  uint32_t size;       // size of this part (bytes)
+  uint32_t firstOrbit; // heartbeat orbit of the first RDH in this part
+  uint32_t linkId;     // link id of the data in this part
+  uint32_t crc32c;     // CRC32C of the part payload (c.f. ReadoutUtils::crc32c
+                       // and consumer-FairMQchannel-* checksumEnabled), zero
+                       // when not computed
+  uint32_t pad;        // unused, keeps the table entries 8-byte aligned
+};
+
+// v2 header message (consumer-FairMQChannel enableRawFormat=4)
+// subtimeframe made of 1 message with this header followed by 1 message per
+// data page. A table of part descriptors follows the fixed header, so that
+// receivers can route or discard parts without reading payload memory.
+// The header message size is
+// sizeof(SubTimeframeV2) + numberOfParts * sizeof(SubTimeframePartDescriptor).
+struct SubTimeframeV2 {
+  uint32_t version;       // format version of this header, set to 2
+  uint32_t timeframeId;   // id of timeframe
+  uint32_t numberOfParts; // number of following messages / table entries
+  // followed by numberOfParts struct SubTimeframePartDescriptor
+};
@@ -35,6 +35,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <signal.h>
@@ -139,6 +140,13 @@ static void signalHandler(int signalId) {
   ShutdownRequest = 1;
 }
 
+// global signal handler to request an on-demand dump of the page lifecycle
+// trace (see PageEventTrace). Only a flag is set here, the dump itself is
+// done from the main supervision loop.
+static int PageTraceDumpRequest =
+    0; // set to 1 to request a trace dump, e.g. on SIGUSR1 signal
+static void signalHandlerPageTraceDump(int) { PageTraceDumpRequest = 1; }
+
 class Readout {
 
 public:
@@ -170,6 +178,13 @@ private:
   std::string cfgLogbookUrl;
   std::string cfgLogbookApiToken;
   int cfgLogbookUpdateInterval;
+  int cfgConfigureThreads;
+  int cfgBenchmarkMode;
+  double cfgBenchmarkStartRate;
+  double cfgBenchmarkStepTime;
+  std::string cfgBenchmarkOutput;
+  int cfgConsumerThreadsEnabled;
+  int cfgConsumerThreadsFifoSize;
 
   // runtime entities
   std::vector<std::unique_ptr<Consumer>> dataConsumers;
@@ -181,10 +196,38 @@ private:
   std::unique_ptr<DataBlockAggregator> agg;
   std::unique_ptr<AliceO2::Common::Fifo<DataSetReference>> agg_output;
 
+  // optional consumer dispatch stage (see consumerThreadsEnabled): datasets
+  // popped from the aggregator output are fanned out to one queue and one
+  // thread per consumer, instead of sequential pushData() calls from the main
+  // loop
+  struct ConsumerDispatcher {
+    Consumer *consumer = nullptr; // the consumer served by this thread
+    std::unique_ptr<AliceO2::Common::Fifo<DataSetReference>>
+        queue;                            // datasets pending pushData()
+    std::unique_ptr<std::thread> thread;  // thread calling pushData()
+    std::atomic<int> shutdown = {0};      // to stop thread (after drain)
+    unsigned long long pushed = 0;        // datasets queued (main loop side)
+    std::atomic<unsigned long long> popped = {
+        0};                // datasets consumed (thread side)
+    int peakOccupancy = 0; // maximum queue occupancy seen
+  };
+  std::vector<std::unique_ptr<ConsumerDispatcher>> consumerDispatchers;
+  void loopConsumerDispatch(ConsumerDispatcher *d); // dispatch thread loop
+
   int isRunning =
       0; // set to 1 when running, 0 when not running (or should stop running)
   AliceO2::Common::Timer startTimer; // time counter from start()
   AliceO2::Common::Timer stopTimer;  // time counter from stop()
+
+  // benchmark mode runtime state
+  AliceO2::Common::Timer benchmarkTimer; // time counter of current rate step
+  double benchmarkTargetRate = 0; // current per-equipment target rate (Hz)
+  double benchmarkBestRate = 0;   // last sustained per-equipment rate (Hz)
+  double benchmarkBestMBs = 0;    // aggregate throughput at that rate (MB/s)
+  CounterValue benchmarkLastBlocks = 0; // output counters at last step
+  CounterValue benchmarkLastBytes = 0;
+  bool benchmarkDone = false; // set once saturation reached, report printed
+  void printBenchmarkReport(double saturatedRate, double saturatedMBs);
   std::unique_ptr<std::thread>
       runningThread; // the thread active in "running" state
 
@@ -202,6 +245,14 @@ private:
   AliceO2::Common::Timer
       logbookTimer; // timer to handle readout logbook publish interval
   uint64_t maxTimeframeId;
+
+  std::string cfgStatsShmPath;       // path of exported stats segment
+  double cfgStatsShmUpdateInterval;  // update period of exported stats
+  AliceO2::Common::Timer statsShmTimer; // timer for exported stats updates
+  AliceO2::Common::Timer
+      statsShmElapsed; // time elapsed since last exported stats update, for
+                       // rate computation
+  void updateStatsShm(); // refresh the exported stats segment
 };
 
 void Readout::publishLogbookStats() {
@@ -258,6 +309,12 @@ int Readout::init(int argc, char *argv[]) {
   sigaction(SIGQUIT, &signalSettings, NULL);
   sigaction(SIGINT, &signalSettings, NULL);
 
+  // configure signal handler for on-demand page trace dump
+  struct sigaction signalSettingsDump;
+  bzero(&signalSettingsDump, sizeof(signalSettingsDump));
+  signalSettingsDump.sa_handler = signalHandlerPageTraceDump;
+  sigaction(SIGUSR1, &signalSettingsDump, NULL);
+
   // log startup and options
   theLog.log("Readout " READOUT_VERSION " - process starting, pid %d", getpid());
   theLog.log("Optional built features enabled:");
@@ -400,6 +457,65 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
   };
   mergeConfig(cfg.get(), properties);
 
+  // configuration parameter: | readout | benchmarkMode | int | 0 | When set
+  // (N>0), a self-contained benchmark pipeline is instantiated: N emulated CRU
+  // equipments -> aggregator -> stats consumer (plus optional output, c.f.
+  // benchmarkOutput). The data rate is ramped up step by step until the
+  // saturation point, and a report is printed (max sustainable rate,
+  // bottleneck stage, page latency percentiles). One-command hardware
+  // acceptance test, no hand-crafted config needed. |
+  cfgBenchmarkMode = 0;
+  cfg.getOptionalValue<int>("readout.benchmarkMode", cfgBenchmarkMode);
+  if (cfgBenchmarkMode > 0) {
+    // configuration parameter: | readout | benchmarkStartRate | double | 100 |
+    // Benchmark mode: initial page rate of each equipment, in Hz. Doubled at
+    // each step while sustained. |
+    cfgBenchmarkStartRate = 100;
+    cfg.getOptionalValue<double>("readout.benchmarkStartRate",
+                                 cfgBenchmarkStartRate);
+    // configuration parameter: | readout | benchmarkStepTime | double | 10 |
+    // Benchmark mode: duration of each rate step, in seconds. |
+    cfgBenchmarkStepTime = 10;
+    cfg.getOptionalValue<double>("readout.benchmarkStepTime",
+                                 cfgBenchmarkStepTime);
+    // configuration parameter: | readout | benchmarkOutput | string |  |
+    // Benchmark mode: optional extra consumer. Possible values: record
+    // (fileRecorder to /tmp/readout-benchmark.raw), fmq (FairMQChannel with
+    // default settings). |
+    cfgBenchmarkOutput = "";
+    cfg.getOptionalValue<std::string>("readout.benchmarkOutput",
+                                      cfgBenchmarkOutput);
+
+    theLog.log("Benchmark mode enabled : %d emulated equipments, starting at "
+               "%.0lf Hz each (%.0lfs steps)",
+               cfgBenchmarkMode, cfgBenchmarkStartRate, cfgBenchmarkStepTime);
+
+    // inject the canonical benchmark pipeline in the configuration tree,
+    // using the same mechanism as the OCC properties overlay
+    boost::property_tree::ptree &t = cfg.get();
+    for (int i = 1; i <= cfgBenchmarkMode; i++) {
+      std::string section = "equipment-benchmark-" + std::to_string(i);
+      t.put(section + ".equipmentType", "cruEmulator");
+      t.put(section + ".enabled", 1);
+      t.put(section + ".id", 1000 + i);
+    }
+    t.put("consumer-benchmark-stats.consumerType", "stats");
+    if (cfgBenchmarkOutput == "record") {
+      t.put("consumer-benchmark-rec.consumerType", "fileRecorder");
+      t.put("consumer-benchmark-rec.fileName", "/tmp/readout-benchmark.raw");
+    } else if (cfgBenchmarkOutput == "fmq") {
+      t.put("consumer-benchmark-fmq.consumerType", "FairMQChannel");
+    } else if (cfgBenchmarkOutput.length()) {
+      theLog.log(InfoLogger::Severity::Error, "Wrong benchmarkOutput %s",
+                 cfgBenchmarkOutput.c_str());
+      return -1;
+    }
+    // start throttled at the initial rate, ramped up while running
+    t.put("readout.rate", cfgBenchmarkStartRate);
+    // enable memory pool timing statistics, for the page latency report
+    t.put("readout.memoryPoolStatsEnabled", 1);
+  }
+
   // try to prevent deep sleeps
   bool deepsleepDisabled = false;
   int maxLatency = 2;
@@ -431,14 +547,67 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
   cfgFlushEquipmentTimeout = 1;
   cfg.getOptionalValue<double>("readout.flushEquipmentTimeout",
                                cfgFlushEquipmentTimeout);
+  // configuration parameter: | readout | consumerThreadsEnabled | int | 0 |
+  // If set, each consumer gets a dispatch thread and a queue of datasets: the
+  // main loop fans out the datasets popped from the aggregator instead of
+  // calling each consumer sequentially, so the consumers walk the dataset
+  // metadata concurrently (while still cache-warm) and a busy consumer delays
+  // the others only once its queue is full. Queue peak occupancy per consumer
+  // reported at stop. |
+  cfgConsumerThreadsEnabled = 0;
+  cfg.getOptionalValue<int>("readout.consumerThreadsEnabled",
+                            cfgConsumerThreadsEnabled);
+  // configuration parameter: | readout | consumerThreadsFifoSize | int | 100 |
+  // With consumerThreadsEnabled, depth of each consumer dispatch queue.
+  // Queued datasets keep their data pages referenced: a deeper queue absorbs
+  // longer consumer stalls but may retain more pages. |
+  cfgConsumerThreadsFifoSize = 100;
+  cfg.getOptionalValue<int>("readout.consumerThreadsFifoSize",
+                            cfgConsumerThreadsFifoSize);
+  // configuration parameter: | readout | configureThreads | int | 1 | Number
+  // of threads used to instantiate the equipments and the consumers during
+  // configure. When bigger than one, independent components are configured
+  // concurrently (memory banks are still created first, sequentially), so
+  // that configure latency is bounded by the slowest component instead of the
+  // sum. |
+  cfgConfigureThreads = 1;
+  cfg.getOptionalValue<int>("readout.configureThreads", cfgConfigureThreads);
   // configuration parameter: | readout | memoryPoolStatsEnabled | int | 0 |
   // Global debugging flag to enable statistics on memory pool usage (printed
-  // to stdout when pool released). |
+  // to stdout when pool released). A value N bigger than 1 enables sampling:
+  // only one page out of N is accounted, to reduce overhead on the data path. |
   int cfgMemoryPoolStatsEnabled = 0;
   cfg.getOptionalValue<int>("readout.memoryPoolStatsEnabled",
                             cfgMemoryPoolStatsEnabled);
   extern int MemoryPagesPoolStatsEnabled;
   MemoryPagesPoolStatsEnabled = cfgMemoryPoolStatsEnabled;
+  // configuration parameter: | readout | memoryPoolLockFreeEnabled | int | 0 |
+  // Global flag to use a lock-free (multiple producers / multiple consumers)
+  // queue of available pages in the memory pools, allowing concurrent page
+  // release from several consumer threads without external locks. |
+  int cfgMemoryPoolLockFreeEnabled = 0;
+  cfg.getOptionalValue<int>("readout.memoryPoolLockFreeEnabled",
+                            cfgMemoryPoolLockFreeEnabled);
+  extern int MemoryPagesPoolLockFreeEnabled;
+  MemoryPagesPoolLockFreeEnabled = cfgMemoryPoolLockFreeEnabled;
+  if (MemoryPagesPoolLockFreeEnabled) {
+    theLog.log("Memory pools: lock-free page queue enabled");
+  }
+  // configuration parameter: | readout | pageTraceSize | int | 0 | When set,
+  // enables tracing of data page lifecycle events (getPage,
+  // getNewDataBlockContainer, releasePage, consumer push) in a shared
+  // in-memory ring of given size (number of events, rounded up to next power
+  // of two, oldest events overwritten). Recording an event is a single relaxed
+  // atomic operation, cheap enough to stay enabled in production. The ring is
+  // dumped to stdout on SIGUSR1 and on stop, to investigate latency outliers
+  // of individual pages. |
+  int cfgPageTraceSize = 0;
+  cfg.getOptionalValue<int>("readout.pageTraceSize", cfgPageTraceSize);
+  if (cfgPageTraceSize > 0) {
+    gPageEventTrace.init(cfgPageTraceSize);
+    theLog.log("Page lifecycle trace enabled, ring of %d events",
+               cfgPageTraceSize);
+  }
   // configuration parameter: | readout | disableAggregatorSlicing | int | 0 |
   // When set, the aggregator slicing is disabled, data pages are passed through
   // without grouping/slicing. |
@@ -491,7 +660,33 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
 #endif
   }
 
+  // configuration parameter: | readout | statsShmPath | string | | When set,
+  // readout exports its runtime counters (global, per-equipment and
+  // per-consumer, with rates derived in-process) to a shared memory segment
+  // created at this path (e.g. /dev/shm/readout-stats.shm), which external
+  // scrapers can mmap read-only. See ReadoutStats.h for the segment layout. |
+  cfgStatsShmPath = "";
+  cfg.getOptionalValue<std::string>("readout.statsShmPath", cfgStatsShmPath);
+  // configuration parameter: | readout | statsShmUpdateInterval | double | 1 |
+  // Amount of time (in seconds) between updates of the exported stats
+  // segment. |
+  cfgStatsShmUpdateInterval = 1;
+  cfg.getOptionalValue<double>("readout.statsShmUpdateInterval",
+                               cfgStatsShmUpdateInterval);
+  if (cfgStatsShmPath.length()) {
+    gReadoutStats.startShmExport(cfgStatsShmPath);
+  }
+
   // configuration of memory banks
+  // configuration parameter: | readout | bankInitThreads | int | 1 | Number of
+  // threads used to initialize (pre-fault and zero) each memory bank at start.
+  // Using several threads can significantly reduce start-of-run latency for
+  // large hugepage banks. |
+  int cfgBankInitThreads = 1;
+  cfg.getOptionalValue<int>("readout.bankInitThreads", cfgBankInitThreads);
+  if (cfgBankInitThreads < 1) {
+    cfgBankInitThreads = 1;
+  }
   int numaNodeChanged = 0;
   for (auto kName : ConfigFileBrowser(&cfg, "bank-")) {
     // skip disabled
@@ -556,6 +751,8 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
     }
     theLog.log("Creating memory bank %s: type %s size %lld", kName.c_str(),
                cfgType.c_str(), mSize);
+    AliceO2::Common::Timer bankInitTimer;
+    bankInitTimer.reset();
     std::shared_ptr<MemoryBank> b = nullptr;
     try {
       b = getMemoryBank(mSize, cfgType, kName);
@@ -566,11 +763,17 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
                  kName.c_str());
       continue;
     }
-    // cleanup the memory range
-    b->clear();
+    // tag bank with NUMA node where it was allocated, when enforced, so that
+    // equipments can later request a pool local to their device
+    if ((cfgNumaNode >= 0) && (numaNodeChanged)) {
+      b->setNumaNode(cfgNumaNode);
+    }
+    // cleanup the memory range (this also pre-faults the pages)
+    b->clear(cfgBankInitThreads);
     // add bank to list centrally managed
     theMemoryBankManager.addBank(b, kName);
-    theLog.log("Bank %s added", kName.c_str());
+    theLog.log("Bank %s added (initialized in %.2lfs using %d threads)",
+               kName.c_str(), bankInitTimer.getTime(), cfgBankInitThreads);
   }
 
   // releasing memory bind policy
@@ -585,110 +788,177 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
 #endif
   }
 
-  // configuration of data consumers
-  for (auto kName : ConfigFileBrowser(&cfg, "consumer-")) {
-
-    // skip disabled
-    int enabled = 1;
-    try {
-      // configuration parameter: | consumer-* | enabled | int | 1 | Enable
-      // (value=1) or disable (value=0) the consumer. |
-      enabled = cfg.getValue<int>(kName + ".enabled");
-    } catch (...) {
+  // helper to run a set of independent configure tasks, sequentially or on a
+  // pool of threads (c.f. readout.configureThreads)
+  auto runConfigureTasks = [&](size_t nTasks,
+                               std::function<void(size_t)> task) {
+    int nThreads = cfgConfigureThreads;
+    if (nThreads > (int)nTasks) {
+      nThreads = (int)nTasks;
     }
-    if (!enabled) {
-      continue;
+    if (nThreads <= 1) {
+      for (size_t ix = 0; ix < nTasks; ix++) {
+        task(ix);
+      }
+      return;
+    }
+    std::atomic<size_t> nextTask(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < nThreads; i++) {
+      workers.push_back(std::thread([&]() {
+        for (;;) {
+          size_t ix = nextTask.fetch_add(1);
+          if (ix >= nTasks) {
+            break;
+          }
+          task(ix);
+        }
+      }));
+    }
+    for (auto &w : workers) {
+      w.join();
     }
+  };
+  if (cfgConfigureThreads > 1) {
+    theLog.log("Using %d threads to configure equipments and consumers",
+               cfgConfigureThreads);
+  }
 
-    // configuration parameter: | consumer-* | consumerOutput | string |  | Name
-    // of the consumer where the output of this consumer (if any) should be
-    // pushed. |
-    std::string cfgOutput = "";
-    cfg.getOptionalValue<std::string>(kName + ".consumerOutput", cfgOutput);
+  // configuration of data consumers
+  // each consumer is configured in its own task, results are collected in
+  // configuration order once all tasks completed
+  {
+    std::vector<std::string> consumerSections;
+    for (auto kName : ConfigFileBrowser(&cfg, "consumer-")) {
+      consumerSections.push_back(kName);
+    }
+    struct ConsumerSlot {
+      std::unique_ptr<Consumer> consumer;
+      std::string output; // consumerOutput parameter, linked later
+    };
+    std::vector<ConsumerSlot> consumerSlots(consumerSections.size());
 
-    // configuration parameter: | consumer-* | stopOnError | int | 0 | If 1,
-    // readout will stop automatically on consumer error. |
-    int cfgStopOnError = 0;
-    cfg.getOptionalValue<int>(kName + ".stopOnError", cfgStopOnError);
+    auto configureConsumer = [&](size_t slotIx) {
+      const std::string &kName = consumerSections[slotIx];
 
-    // instanciate consumer of appropriate type
-    std::unique_ptr<Consumer> newConsumer = nullptr;
-    try {
-      // configuration parameter: | consumer-* | consumerType | string |  | The
-      // type of consumer to be instanciated. One of:stats, FairMQDevice,
-      // DataSampling, FairMQChannel, fileRecorder, checker, processor, tcp. |
-      std::string cfgType = "";
-      cfgType = cfg.getValue<std::string>(kName + ".consumerType");
-      theLog.log("Configuring consumer %s: %s", kName.c_str(), cfgType.c_str());
-
-      if (!cfgType.compare("stats")) {
-        newConsumer = getUniqueConsumerStats(cfg, kName);
-      } else if (!cfgType.compare("FairMQDevice")) {
+      // skip disabled
+      int enabled = 1;
+      try {
+        // configuration parameter: | consumer-* | enabled | int | 1 | Enable
+        // (value=1) or disable (value=0) the consumer. |
+        enabled = cfg.getValue<int>(kName + ".enabled");
+      } catch (...) {
+      }
+      if (!enabled) {
+        return;
+      }
+
+      // configuration parameter: | consumer-* | consumerOutput | string |  | Name
+      // of the consumer where the output of this consumer (if any) should be
+      // pushed. |
+      std::string cfgOutput = "";
+      cfg.getOptionalValue<std::string>(kName + ".consumerOutput", cfgOutput);
+
+      // configuration parameter: | consumer-* | stopOnError | int | 0 | If 1,
+      // readout will stop automatically on consumer error. |
+      int cfgStopOnError = 0;
+      cfg.getOptionalValue<int>(kName + ".stopOnError", cfgStopOnError);
+
+      // instanciate consumer of appropriate type
+      std::unique_ptr<Consumer> newConsumer = nullptr;
+      AliceO2::Common::Timer configureTime;
+      configureTime.reset();
+      try {
+        // configuration parameter: | consumer-* | consumerType | string |  | The
+        // type of consumer to be instanciated. One of:stats, latency,
+        // FairMQDevice, DataSampling, FairMQChannel, fileRecorder, checker,
+        // processor, tcp. |
+        std::string cfgType = "";
+        cfgType = cfg.getValue<std::string>(kName + ".consumerType");
+        theLog.log("Configuring consumer %s: %s", kName.c_str(), cfgType.c_str());
+
+        if (!cfgType.compare("stats")) {
+          newConsumer = getUniqueConsumerStats(cfg, kName);
+        } else if (!cfgType.compare("latency")) {
+          newConsumer = getUniqueConsumerLatency(cfg, kName);
+        } else if (!cfgType.compare("FairMQDevice")) {
 #ifdef WITH_FAIRMQ
-        newConsumer = getUniqueConsumerFMQ(cfg, kName);
+          newConsumer = getUniqueConsumerFMQ(cfg, kName);
 #else
-        theLog.log("Skipping %s: %s - not supported by this build",
-                   kName.c_str(), cfgType.c_str());
+          theLog.log("Skipping %s: %s - not supported by this build",
+                     kName.c_str(), cfgType.c_str());
 #endif
-      } else if (!cfgType.compare("DataSampling")) {
+        } else if (!cfgType.compare("DataSampling")) {
 #ifdef WITH_FAIRMQ
-        newConsumer = getUniqueConsumerDataSampling(cfg, kName);
+          newConsumer = getUniqueConsumerDataSampling(cfg, kName);
 #else
-        theLog.log("Skipping %s: %s - not supported by this build",
-                   kName.c_str(), cfgType.c_str());
+          theLog.log("Skipping %s: %s - not supported by this build",
+                     kName.c_str(), cfgType.c_str());
 #endif
-      } else if (!cfgType.compare("FairMQChannel")) {
+        } else if (!cfgType.compare("FairMQChannel")) {
 #ifdef WITH_FAIRMQ
-        newConsumer = getUniqueConsumerFMQchannel(cfg, kName);
+          newConsumer = getUniqueConsumerFMQchannel(cfg, kName);
 #else
-        theLog.log("Skipping %s: %s - not supported by this build",
-                   kName.c_str(), cfgType.c_str());
+          theLog.log("Skipping %s: %s - not supported by this build",
+                     kName.c_str(), cfgType.c_str());
 #endif
-      } else if (!cfgType.compare("fileRecorder")) {
-        newConsumer = getUniqueConsumerFileRecorder(cfg, kName);
-      } else if (!cfgType.compare("checker")) {
-        newConsumer = getUniqueConsumerDataChecker(cfg, kName);
-      } else if (!cfgType.compare("processor")) {
-        newConsumer = getUniqueConsumerDataProcessor(cfg, kName);
-      } else if (!cfgType.compare("tcp")) {
-        newConsumer = getUniqueConsumerTCP(cfg, kName);
-      } else if (!cfgType.compare("rdma")) {
+        } else if (!cfgType.compare("fileRecorder")) {
+          newConsumer = getUniqueConsumerFileRecorder(cfg, kName);
+        } else if (!cfgType.compare("checker")) {
+          newConsumer = getUniqueConsumerDataChecker(cfg, kName);
+        } else if (!cfgType.compare("processor")) {
+          newConsumer = getUniqueConsumerDataProcessor(cfg, kName);
+        } else if (!cfgType.compare("tcp")) {
+          newConsumer = getUniqueConsumerTCP(cfg, kName);
+        } else if (!cfgType.compare("rdma")) {
 #ifdef WITH_RDMA
-        newConsumer = getUniqueConsumerRDMA(cfg, kName);
+          newConsumer = getUniqueConsumerRDMA(cfg, kName);
 #else
-        theLog.log("Skipping %s: %s - not supported by this build",
-                   kName.c_str(), cfgType.c_str());
+          theLog.log("Skipping %s: %s - not supported by this build",
+                     kName.c_str(), cfgType.c_str());
 #endif
-      } else {
-        theLog.log("Unknown consumer type '%s' for [%s]", cfgType.c_str(),
+        } else {
+          theLog.log("Unknown consumer type '%s' for [%s]", cfgType.c_str(),
+                     kName.c_str());
+        }
+      } catch (const std::exception &ex) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Failed to configure consumer %s : %s", kName.c_str(),
+                   ex.what());
+        return;
+      } catch (const std::string &ex) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Failed to configure consumer %s : %s", kName.c_str(),
+                   ex.c_str());
+        return;
+      } catch (...) {
+        theLog.log(InfoLogger::Severity::Error, "Failed to configure consumer %s",
                    kName.c_str());
+        return;
       }
-    } catch (const std::exception &ex) {
-      theLog.log(InfoLogger::Severity::Error,
-                 "Failed to configure consumer %s : %s", kName.c_str(),
-                 ex.what());
-      continue;
-    } catch (const std::string &ex) {
-      theLog.log(InfoLogger::Severity::Error,
-                 "Failed to configure consumer %s : %s", kName.c_str(),
-                 ex.c_str());
-      continue;
-    } catch (...) {
-      theLog.log(InfoLogger::Severity::Error, "Failed to configure consumer %s",
-                 kName.c_str());
-      continue;
-    }
 
-    if (newConsumer != nullptr) {
-      if (cfgOutput.length() > 0) {
-        consumersOutput.insert(
-            std::pair<Consumer *, std::string>(newConsumer.get(), cfgOutput));
+      if (newConsumer != nullptr) {
+        theLog.log("Consumer %s configured in %.2lfs", kName.c_str(),
+                   configureTime.getTime());
+        newConsumer->name = kName;
+        if (cfgStopOnError) {
+          newConsumer->stopOnError = 1;
+        }
+        consumerSlots[slotIx].output = cfgOutput;
+        consumerSlots[slotIx].consumer = std::move(newConsumer);
       }
-      newConsumer->name = kName;
-      if (cfgStopOnError) {
-        newConsumer->stopOnError = 1;
+    };
+    runConfigureTasks(consumerSections.size(), configureConsumer);
+
+    // collect results, in configuration order
+    for (auto &slot : consumerSlots) {
+      if (slot.consumer != nullptr) {
+        if (slot.output.length() > 0) {
+          consumersOutput.insert(std::pair<Consumer *, std::string>(
+              slot.consumer.get(), slot.output));
+        }
+        dataConsumers.push_back(std::move(slot.consumer));
       }
-      dataConsumers.push_back(std::move(newConsumer));
     }
   }
 
@@ -719,73 +989,93 @@ int Readout::configure(const boost::property_tree::ptree &properties) {
   }
 
   // configure readout equipments
-  int nEquipmentFailures = 0; // number of failed equipment instanciation
-  for (auto kName : ConfigFileBrowser(&cfg, "equipment-")) {
-
-    // example iteration on each sub-key
-    // for (auto kk : ConfigFileBrowser (&cfg,"",kName)) {
-    //  printf("%s -> %s\n",kName.c_str(),kk.c_str());
-    //}
-
-    // skip disabled equipments
-    // configuration parameter: | equipment-* | enabled | int | 1 | Enable
-    // (value=1) or disable (value=0) the equipment. |
-    int enabled = 1;
-    cfg.getOptionalValue<int>(kName + ".enabled", enabled);
-    if (!enabled) {
-      continue;
+  // as for the consumers, one configure task per equipment
+  std::atomic<int> nEquipmentFailures(0); // number of failed equipment instanciation
+  {
+    std::vector<std::string> equipmentSections;
+    for (auto kName : ConfigFileBrowser(&cfg, "equipment-")) {
+      equipmentSections.push_back(kName);
     }
+    std::vector<std::unique_ptr<ReadoutEquipment>> equipmentSlots(
+        equipmentSections.size());
+
+    auto configureEquipment = [&](size_t slotIx) {
+      const std::string &kName = equipmentSections[slotIx];
+
+      // skip disabled equipments
+      // configuration parameter: | equipment-* | enabled | int | 1 | Enable
+      // (value=1) or disable (value=0) the equipment. |
+      int enabled = 1;
+      cfg.getOptionalValue<int>(kName + ".enabled", enabled);
+      if (!enabled) {
+        return;
+      }
 
-    // configuration parameter: | equipment-* | equipmentType | string |  | The
-    // type of equipment to be instanciated. One of: dummy, rorc, cruEmulator |
-    std::string cfgEquipmentType = "";
-    cfgEquipmentType = cfg.getValue<std::string>(kName + ".equipmentType");
-    theLog.log("Configuring equipment %s: %s", kName.c_str(),
-               cfgEquipmentType.c_str());
-
-    std::unique_ptr<ReadoutEquipment> newDevice = nullptr;
-    try {
-      if (!cfgEquipmentType.compare("dummy")) {
-        newDevice = getReadoutEquipmentDummy(cfg, kName);
-      } else if (!cfgEquipmentType.compare("rorc")) {
-        newDevice = getReadoutEquipmentRORC(cfg, kName);
-      } else if (!cfgEquipmentType.compare("cruEmulator")) {
-        newDevice = getReadoutEquipmentCruEmulator(cfg, kName);
-      } else if (!cfgEquipmentType.compare("player")) {
-        newDevice = getReadoutEquipmentPlayer(cfg, kName);
-      } else if (!cfgEquipmentType.compare("zmq")) {
+      // configuration parameter: | equipment-* | equipmentType | string |  | The
+      // type of equipment to be instanciated. One of: dummy, rorc, cruEmulator,
+      // player, zmq, shmRing |
+      std::string cfgEquipmentType = "";
+      cfgEquipmentType = cfg.getValue<std::string>(kName + ".equipmentType");
+      theLog.log("Configuring equipment %s: %s", kName.c_str(),
+                 cfgEquipmentType.c_str());
+
+      std::unique_ptr<ReadoutEquipment> newDevice = nullptr;
+      AliceO2::Common::Timer configureTime;
+      configureTime.reset();
+      try {
+        if (!cfgEquipmentType.compare("dummy")) {
+          newDevice = getReadoutEquipmentDummy(cfg, kName);
+        } else if (!cfgEquipmentType.compare("rorc")) {
+          newDevice = getReadoutEquipmentRORC(cfg, kName);
+        } else if (!cfgEquipmentType.compare("cruEmulator")) {
+          newDevice = getReadoutEquipmentCruEmulator(cfg, kName);
+        } else if (!cfgEquipmentType.compare("player")) {
+          newDevice = getReadoutEquipmentPlayer(cfg, kName);
+        } else if (!cfgEquipmentType.compare("zmq")) {
 #ifdef WITH_ZMQ
-        newDevice = getReadoutEquipmentZmq(cfg, kName);
+          newDevice = getReadoutEquipmentZmq(cfg, kName);
 #else
-        theLog.log("Skipping %s: %s - not supported by this build",
-                   kName.c_str(), cfgEquipmentType.c_str());
+          theLog.log("Skipping %s: %s - not supported by this build",
+                     kName.c_str(), cfgEquipmentType.c_str());
 #endif
-      } else {
-        theLog.log("Unknown equipment type '%s' for [%s]",
-                   cfgEquipmentType.c_str(), kName.c_str());
+        } else if (!cfgEquipmentType.compare("shmRing")) {
+          newDevice = getReadoutEquipmentShmRing(cfg, kName);
+        } else {
+          theLog.log("Unknown equipment type '%s' for [%s]",
+                     cfgEquipmentType.c_str(), kName.c_str());
+        }
+      } catch (std::string errMsg) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Failed to configure equipment %s : %s", kName.c_str(),
+                   errMsg.c_str());
+        nEquipmentFailures++;
+        return;
+      } catch (int errNo) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Failed to configure equipment %s : error #%d", kName.c_str(),
+                   errNo);
+        nEquipmentFailures++;
+        return;
+      } catch (...) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Failed to configure equipment %s", kName.c_str());
+        nEquipmentFailures++;
+        return;
       }
-    } catch (std::string errMsg) {
-      theLog.log(InfoLogger::Severity::Error,
-                 "Failed to configure equipment %s : %s", kName.c_str(),
-                 errMsg.c_str());
-      nEquipmentFailures++;
-      continue;
-    } catch (int errNo) {
-      theLog.log(InfoLogger::Severity::Error,
-                 "Failed to configure equipment %s : error #%d", kName.c_str(),
-                 errNo);
-      nEquipmentFailures++;
-      continue;
-    } catch (...) {
-      theLog.log(InfoLogger::Severity::Error,
-                 "Failed to configure equipment %s", kName.c_str());
-      nEquipmentFailures++;
-      continue;
-    }
 
-    // add to list of equipments
-    if (newDevice != nullptr) {
-      readoutDevices.push_back(std::move(newDevice));
+      if (newDevice != nullptr) {
+        theLog.log("Equipment %s configured in %.2lfs", kName.c_str(),
+                   configureTime.getTime());
+        equipmentSlots[slotIx] = std::move(newDevice);
+      }
+    };
+    runConfigureTasks(equipmentSections.size(), configureEquipment);
+
+    // add to list of equipments, in configuration order
+    for (auto &slot : equipmentSlots) {
+      if (slot != nullptr) {
+        readoutDevices.push_back(std::move(slot));
+      }
     }
   }
 
@@ -820,10 +1110,23 @@ int Readout::start() {
   publishLogbookStats();
   logbookTimer.reset(cfgLogbookUpdateInterval * 1000000);
   maxTimeframeId = 0;
+  statsShmTimer.reset(cfgStatsShmUpdateInterval * 1000000);
+  statsShmElapsed.reset(1000000);
 
   // cleanup exit conditions
   ShutdownRequest = 0;
 
+  // reset benchmark mode state
+  if (cfgBenchmarkMode > 0) {
+    benchmarkTargetRate = cfgBenchmarkStartRate;
+    benchmarkBestRate = 0;
+    benchmarkBestMBs = 0;
+    benchmarkLastBlocks = 0;
+    benchmarkLastBytes = 0;
+    benchmarkDone = false;
+    benchmarkTimer.reset(cfgBenchmarkStepTime * 1000000);
+  }
+
   theLog.log("Starting aggregator");
   if (cfgDisableAggregatorSlicing) {
     theLog.log("Aggregator slicing disabled");
@@ -840,6 +1143,38 @@ int Readout::start() {
     agg->cfgStfTimeout=cfgAggregatorStfTimeout;
     agg->enableStfBuilding=1;
   }
+  // configuration parameter: | readout | aggregatorCpuSet | string | | If set,
+  // CPU affinity of the aggregator thread. List of CPU ids, given as
+  // comma-separated values or ranges, e.g. "0-3,8". |
+  std::string cfgAggregatorCpuSet = "";
+  cfg.getOptionalValue<std::string>("readout.aggregatorCpuSet",
+                                    cfgAggregatorCpuSet);
+  agg->cfgCpuSet = cfgAggregatorCpuSet;
+
+  // configuration parameter: | readout | aggregatorThreads | int | 0 | If set,
+  // number of aggregator worker threads. Equipment inputs are partitioned
+  // between workers running the slicers in parallel, and the aggregator thread
+  // only merges completed slices to the output. If 0, single-threaded. |
+  int cfgAggregatorThreads = 0;
+  cfg.getOptionalValue<int>("readout.aggregatorThreads", cfgAggregatorThreads);
+  agg->cfgThreads = cfgAggregatorThreads;
+
+  // configuration parameter: | readout | aggregatorWakeupEnabled | int | 0 |
+  // If set, the aggregator threads are notified when data is pushed to their
+  // input FIFOs and wake up immediately, instead of polling with fixed
+  // sleeps. Reduces per-stage latency. |
+  int cfgAggregatorWakeupEnabled = 0;
+  cfg.getOptionalValue<int>("readout.aggregatorWakeupEnabled",
+                            cfgAggregatorWakeupEnabled);
+  agg->cfgWakeupEnabled = cfgAggregatorWakeupEnabled;
+  // configuration parameter: | readout | aggregatorSpinTime | int | 0 | With
+  // aggregatorWakeupEnabled, time (microseconds) an idle aggregator thread
+  // busy-waits for new data before blocking on its wakeup event. Lowest
+  // wakeup latency for the highest-rate links, at the price of CPU usage. |
+  int cfgAggregatorSpinTime = 0;
+  cfg.getOptionalValue<int>("readout.aggregatorSpinTime",
+                            cfgAggregatorSpinTime);
+  agg->cfgWakeupSpinTime = cfgAggregatorSpinTime;
 
   agg->start();
 
@@ -848,6 +1183,25 @@ int Readout::start() {
     c->start();
   }
 
+  // start the consumer dispatch stage, if enabled
+  if (cfgConsumerThreadsEnabled) {
+    for (auto &c : dataConsumers) {
+      // forward consumers get data from another consumer, not from here
+      if (c->isForwardConsumer) {
+        continue;
+      }
+      auto d = std::make_unique<ConsumerDispatcher>();
+      d->consumer = c.get();
+      d->queue = std::make_unique<AliceO2::Common::Fifo<DataSetReference>>(
+          cfgConsumerThreadsFifoSize);
+      d->thread = std::make_unique<std::thread>(
+          &Readout::loopConsumerDispatch, this, d.get());
+      consumerDispatchers.push_back(std::move(d));
+    }
+    theLog.log("Consumer dispatch threads started (%d threads, fifo size %d)",
+               (int)consumerDispatchers.size(), cfgConsumerThreadsFifoSize);
+  }
+
   theLog.log("Starting readout equipments");
   for (auto &&readoutDevice : readoutDevices) {
     readoutDevice->start();
@@ -903,10 +1257,26 @@ void Readout::loopRunning() {
         }
       }
 
+      if (consumerDispatchers.size()) {
+        // fan out to the per-consumer queues, each walked by its own thread:
+        // a busy consumer delays the others only once its queue is full
+        for (auto &d : consumerDispatchers) {
+          while (d->queue->push(bc)) {
+            usleep(1000);
+          }
+          d->pushed++;
+          int occupancy = (int)(d->pushed - d->popped.load());
+          if (occupancy > d->peakOccupancy) {
+            d->peakOccupancy = occupancy;
+          }
+        }
+      }
+
       for (auto &c : dataConsumers) {
         // push only to "prime" consumers, not to those getting data directly
         // forwarded from another consumer
-        if (c->isForwardConsumer == false) {
+        // (skipped when the dispatch stage queues the datasets instead)
+        if ((c->isForwardConsumer == false) && (!consumerDispatchers.size())) {
           if (c->pushData(bc) < 0) {
             c->isError++;
           }
@@ -927,6 +1297,21 @@ void Readout::loopRunning() {
     }
   }
 
+  // drain and stop the consumer dispatch threads: the queues are emptied
+  // before the consumers are notified of stop
+  for (auto &d : consumerDispatchers) {
+    d->shutdown = 1;
+  }
+  for (auto &d : consumerDispatchers) {
+    d->thread->join();
+    d->thread = nullptr;
+    theLog.log("Consumer %s : %llu datasets dispatched, queue peak "
+               "occupancy %d/%d",
+               d->consumer->name.c_str(), d->pushed, d->peakOccupancy,
+               cfgConsumerThreadsFifoSize);
+  }
+  consumerDispatchers.clear();
+
 #ifdef CALLGRIND
   CALLGRIND_STOP_INSTRUMENTATION;
   CALLGRIND_DUMP_STATS;
@@ -935,6 +1320,25 @@ void Readout::loopRunning() {
   theLog.log("Exiting main loop");
 }
 
+// consumer dispatch thread loop: deliver the queued datasets to one consumer
+void Readout::loopConsumerDispatch(ConsumerDispatcher *d) {
+  Consumer *c = d->consumer;
+  for (;;) {
+    DataSetReference bc = nullptr;
+    if (d->queue->pop(bc)) {
+      if (d->shutdown) {
+        break;
+      }
+      usleep(1000);
+      continue;
+    }
+    if (c->pushData(bc) < 0) {
+      c->isError++;
+    }
+    d->popped++;
+  }
+}
+
 int Readout::iterateCheck() {
   usleep(100000);
   for (auto &&readoutDevice : readoutDevices) {
@@ -967,9 +1371,128 @@ int Readout::iterateRunning() {
     publishLogbookStats();
     logbookTimer.increment();
   }
+  // regular refresh of the exported stats segment
+  if (statsShmTimer.isTimeout()) {
+    updateStatsShm();
+    statsShmTimer.increment();
+  }
+  // on-demand dump of the page lifecycle trace
+  if (PageTraceDumpRequest) {
+    PageTraceDumpRequest = 0;
+    gPageEventTrace.dump();
+  }
+  // benchmark mode: rate ramp supervision
+  if ((cfgBenchmarkMode > 0) && (!benchmarkDone) &&
+      (benchmarkTimer.isTimeout())) {
+    double t = benchmarkTimer.getTime();
+    CounterValue blocks = 0;
+    CounterValue bytes = 0;
+    for (auto &&readoutDevice : readoutDevices) {
+      CounterValue bytesOut = 0;
+      CounterValue blocksOut = 0;
+      readoutDevice->getOutputStats(bytesOut, blocksOut);
+      bytes += bytesOut;
+      blocks += blocksOut;
+    }
+    double blockRate =
+        (blocks - benchmarkLastBlocks) / (t * readoutDevices.size());
+    double mbRate = (bytes - benchmarkLastBytes) / (t * 1024.0 * 1024.0);
+    benchmarkLastBlocks = blocks;
+    benchmarkLastBytes = bytes;
+    theLog.log("Benchmark step done : target = %.0lf Hz/equipment, achieved = "
+               "%.1lf Hz/equipment (%.1lf MB/s total)",
+               benchmarkTargetRate, blockRate, mbRate);
+    if (blockRate >= benchmarkTargetRate * 0.95) {
+      // rate sustained, try higher
+      benchmarkBestRate = blockRate;
+      benchmarkBestMBs = mbRate;
+      benchmarkTargetRate = benchmarkTargetRate * 2;
+      theLog.log("Benchmark : rate sustained, stepping up to %.0lf "
+                 "Hz/equipment",
+                 benchmarkTargetRate);
+      for (auto &&readoutDevice : readoutDevices) {
+        readoutDevice->setReadoutRate(benchmarkTargetRate);
+      }
+      benchmarkTimer.reset(cfgBenchmarkStepTime * 1000000);
+    } else {
+      // saturation point found
+      benchmarkDone = true;
+      printBenchmarkReport(blockRate, mbRate);
+      theLog.log("Benchmark completed");
+      return 1;
+    }
+  }
   return 0;
 }
 
+void Readout::printBenchmarkReport(double saturatedRate, double saturatedMBs) {
+  theLog.log("Benchmark report:");
+  theLog.log("  equipments : %d x cruEmulator", (int)readoutDevices.size());
+  theLog.log("  max sustainable rate : %.1lf Hz/equipment (%.1lf MB/s total)",
+             benchmarkBestRate, benchmarkBestMBs);
+  theLog.log("  saturated at target %.0lf Hz/equipment : achieved %.1lf "
+             "Hz/equipment (%.1lf MB/s total)",
+             benchmarkTargetRate, saturatedRate, saturatedMBs);
+  for (auto &&readoutDevice : readoutDevices) {
+    // guess the limiting stage from the equipment counters
+    CounterValue nOutputFull = 0;
+    CounterValue nMemoryLow = 0;
+    CounterValue nThrottle = 0;
+    readoutDevice->getStatsValue("nOutputFull", nOutputFull);
+    readoutDevice->getStatsValue("nMemoryLow", nMemoryLow);
+    readoutDevice->getStatsValue("nThrottle", nThrottle);
+    const char *bottleneck = "data source";
+    if ((nOutputFull >= nMemoryLow) && (nOutputFull > 0)) {
+      bottleneck = "output FIFO full (aggregator / consumers)";
+    } else if (nMemoryLow > 0) {
+      bottleneck = "memory pool low (pages not released fast enough)";
+    }
+    double p50 = 0, p90 = 0, p99 = 0;
+    if (readoutDevice->getPageTimingPercentiles(p50, p90, p99) == 0) {
+      theLog.log("  %s : bottleneck = %s (nOutputFull=%llu nMemoryLow=%llu "
+                 "nThrottle=%llu), page latency p50/p90/p99 = "
+                 "%.0lf/%.0lf/%.0lf us",
+                 readoutDevice->getName().c_str(), bottleneck,
+                 (unsigned long long)nOutputFull,
+                 (unsigned long long)nMemoryLow, (unsigned long long)nThrottle,
+                 p50, p90, p99);
+    } else {
+      theLog.log("  %s : bottleneck = %s (nOutputFull=%llu nMemoryLow=%llu "
+                 "nThrottle=%llu)",
+                 readoutDevice->getName().c_str(), bottleneck,
+                 (unsigned long long)nOutputFull,
+                 (unsigned long long)nMemoryLow,
+                 (unsigned long long)nThrottle);
+    }
+  }
+}
+
+void Readout::updateStatsShm() {
+  double elapsedTime = statsShmElapsed.getTime();
+  statsShmElapsed.reset(1000000);
+  gReadoutStats.updateShmExport(elapsedTime);
+  for (auto &&readoutDevice : readoutDevices) {
+    CounterValue bytesOut = 0;
+    CounterValue blocksOut = 0;
+    readoutDevice->getOutputStats(bytesOut, blocksOut);
+    gReadoutStats.updateShmSource("eq-" + readoutDevice->getName(), bytesOut,
+                                  blocksOut, elapsedTime);
+    // per-link counters, for the equipments maintaining them
+    // (c.f. equipment-rorc-*.linkStatsSampling)
+    std::vector<ReadoutEquipment::LinkStats> linkStats;
+    readoutDevice->getLinkStats(linkStats);
+    for (auto &ls : linkStats) {
+      gReadoutStats.updateShmSource("eq-" + readoutDevice->getName() + "-l" +
+                                        std::to_string(ls.linkId),
+                                    ls.bytes, ls.packets, elapsedTime);
+    }
+  }
+  for (auto &c : dataConsumers) {
+    gReadoutStats.updateShmSource("co-" + c->name, c->totalBytesIn,
+                                  c->totalBlocksIn, elapsedTime);
+  }
+}
+
 int Readout::stop() {
 
   theLog.log("Readout executing STOP");
@@ -1024,6 +1547,9 @@ int Readout::stop() {
     }
   }
 
+  // dump page lifecycle trace, if enabled
+  gPageEventTrace.dump();
+
   // publish final logbook statistics
   publishLogbookStats();
   gReadoutStats.reset();
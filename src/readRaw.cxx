@@ -14,20 +14,218 @@
 
 #include "RdhUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
 
 #include <lz4.h>
 
 //#define ERRLOG(args...) fprintf(stderr,args)
 #define ERRLOG(args...) fprintf(stdout, args)
 
-int main(int argc, const char *argv[]) {
+// sidecar index file (<rawFilePath>.idx): file offset of each data page,
+// with its timeframe/link ids, so that large recordings can be navigated
+// without re-parsing them from the start (see options writeIndex / tf)
+struct RawFileIndexHeader {
+  char magic[8];      // RawFileIndexMagic
+  uint64_t pageCount; // number of entries following the header
+};
+struct RawFileIndexEntry {
+  uint64_t fileOffset;  // offset of page in raw file (including block header
+                        // or LZ4 frame header, when applicable)
+  uint64_t dataSize;    // size of page payload, in bytes (after LZ4 decoding,
+                        // when applicable)
+  uint64_t timeframeId; // id of timeframe (from data block header, 0 if
+                        // unknown)
+  uint32_t linkId;      // id of link (from data block header or first RDH)
+  uint32_t firstOrbit;  // heartbeat orbit of first RDH in page (0 if unknown)
+};
+const char RawFileIndexMagic[8] = {'O', '2', 'R', 'R', 'I', 'D', 'X', '1'};
 
-  // parameters
-  std::string filePath;
-  typedef enum { plain, lz4, undefined } FileType;
-  FileType fileType = FileType::plain;
+typedef enum { plain, lz4, undefined } FileType;
+
+// page scan used by the validation passes, specialized once at option parsing
+// time when a fixed RDH version is given (rdhVersion option)
+static ScanRdhBlockFunction gScanRdhBlock = &scanRdhBlock;
+
+// statistics accumulated when validating one file
+// (worker output of the parallel multi-file check mode)
+struct FileCheckStats {
+  unsigned long pages = 0;           // number of data pages parsed
+  unsigned long long bytes = 0;      // number of payload bytes parsed
+  unsigned long long rdhPackets = 0; // number of RDH packets validated
+  unsigned long errors = 0;          // number of errors found
+  unsigned long long linkPackets[RdhMaxLinkId + 1] = {
+      0}; // number of packets per link id
+  unsigned long long linkBytes[RdhMaxLinkId + 1] = {
+      0};                   // number of bytes per link id
+  std::string firstError;   // description of first error found, if any
+};
+
+// validate the RDH content of one recorded file, accumulating statistics.
+// this is the per-file worker of the parallel multi-file check mode, reusing
+// the single scan-and-validate pass of scanRdhBlock().
+// returns 0 on success (file fully parsed, data errors counted in stats),
+// -1 when the file could not be read.
+static int validateFile(const std::string &path, FileType fileType,
+                        bool dataBlockHeaderEnabled, FileCheckStats &stats) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  long fileSize = 0;
+  if (fseek(fp, 0, SEEK_END) || ((fileSize = ftell(fp)) < 0) ||
+      fseek(fp, 0, SEEK_SET)) {
+    fclose(fp);
+    return -1;
+  }
+
+  const long maxBlockSize = 128 * 1024L * 1024L;
+  bool isAutoPageSize = (!dataBlockHeaderEnabled) && (fileType != FileType::lz4);
+  std::vector<uint8_t> data;          // chunk read buffer
+  std::vector<uint8_t> dataDecoded;   // LZ4 decode buffer
+  std::vector<RdhPacketDescriptor> index; // per-page RDH index, reused
+  std::string err;
+
+  for (unsigned long fileOffset = 0; fileOffset < (unsigned long)fileSize;) {
+    long dataSize = 0;
+
+    if (dataBlockHeaderEnabled) {
+      DataBlockHeaderBase hb;
+      if (fread(&hb, sizeof(hb), 1, fp) != 1) {
+        break;
+      }
+      fileOffset += sizeof(hb);
+      if ((hb.blockType != DataBlockType::H_BASE) ||
+          (hb.headerSize != sizeof(hb))) {
+        stats.errors++;
+        if (stats.firstError.empty()) {
+          stats.firstError = "Bad data block header";
+        }
+        break;
+      }
+      dataSize = hb.dataSize;
+    } else if (fileType == FileType::lz4) {
+      const char header[] = {0x04, 0x22, 0x4D, 0x18, 0x60, 0x70, 0x73};
+      uint32_t blockSize = 0;
+      char buffer[sizeof(header) + sizeof(blockSize)];
+      if (fread(&buffer, sizeof(buffer), 1, fp) != 1) {
+        break;
+      }
+      fileOffset += sizeof(buffer);
+      if (memcmp(buffer, header, sizeof(header)) != 0) {
+        stats.errors++;
+        if (stats.firstError.empty()) {
+          stats.firstError = "Bad LZ4 frame header";
+        }
+        break;
+      }
+      blockSize = *((uint32_t *)&buffer[sizeof(header)]);
+      dataSize = blockSize;
+    } else {
+      dataSize = fileSize - fileOffset;
+      if (dataSize > maxBlockSize) {
+        dataSize = maxBlockSize;
+      }
+    }
+
+    if ((dataSize <= 0) || (dataSize > maxBlockSize)) {
+      stats.errors++;
+      if (stats.firstError.empty()) {
+        stats.firstError = "Bad page size";
+      }
+      break;
+    }
+    data.resize(dataSize);
+    if (fread(data.data(), dataSize, 1, fp) != 1) {
+      break;
+    }
+    fileOffset += dataSize;
+
+    uint8_t *pagePtr = data.data();
+    if (fileType == FileType::lz4) {
+      // check frame trailer and decode
+      const char trailer[] = {0x00, 0x00, 0x00, 0x00};
+      char buffer[sizeof(trailer)];
+      if (fread(&buffer, sizeof(buffer), 1, fp) != 1) {
+        break;
+      }
+      fileOffset += sizeof(buffer);
+      if (memcmp(buffer, trailer, sizeof(trailer)) != 0) {
+        stats.errors++;
+        if (stats.firstError.empty()) {
+          stats.firstError = "Bad LZ4 frame trailer";
+        }
+        break;
+      }
+      dataDecoded.resize(maxBlockSize);
+      int res = LZ4_decompress_safe((char *)data.data(),
+                                    (char *)dataDecoded.data(), dataSize,
+                                    maxBlockSize);
+      if ((res <= 0) || (res >= maxBlockSize)) {
+        stats.errors++;
+        if (stats.firstError.empty()) {
+          stats.firstError = "LZ4 decode failed";
+        }
+        break;
+      }
+      pagePtr = dataDecoded.data();
+      dataSize = res;
+    }
+
+    stats.pages++;
+    stats.bytes += dataSize;
+
+    // scan-and-validate the page, collect per-link statistics from the index
+    index.clear();
+    err.clear();
+    int scanResult = gScanRdhBlock(pagePtr, dataSize, index, err);
+    for (auto &p : index) {
+      stats.rdhPackets++;
+      stats.linkPackets[p.linkId]++;
+      stats.linkBytes[p.linkId] += p.size;
+    }
+    size_t consumed = 0;
+    if (index.size()) {
+      consumed = index.back().offset + index.back().size;
+    }
+    if (scanResult < 0) {
+      if ((isAutoPageSize) && (consumed > 0) &&
+          (fileOffset < (unsigned long)fileSize)) {
+        // the (virtual) chunk boundary may fall in the middle of a packet:
+        // realign to the offending packet and retry from there
+        fileOffset -= (dataSize - consumed);
+        if (fseek(fp, fileOffset, SEEK_SET)) {
+          break;
+        }
+        continue;
+      }
+      stats.errors++;
+      if (stats.firstError.empty()) {
+        stats.firstError = err;
+      }
+      break;
+    }
+    if ((isAutoPageSize) && (consumed < (size_t)dataSize) &&
+        (fileOffset < (unsigned long)fileSize)) {
+      // partial header left at end of chunk: realign
+      fileOffset -= (dataSize - consumed);
+      if (fseek(fp, fileOffset, SEEK_SET)) {
+        break;
+      }
+    }
+  }
+
+  fclose(fp);
+  return 0;
+}
 
   bool dumpRDH = false;
   bool validateRDH = true;
@@ -40,6 +238,19 @@ int main(int argc, const char *argv[]) {
   bool dataBlockHeaderEnabled = false;
   bool checkContinuousTriggerOrder = false;
   bool isAutoPageSize = false; // flag set when no known page size in file
+  bool useMmap = false; // if set, file accessed by read-only memory mapping
+                        // instead of buffered reads
+  bool writeIndex = false; // if set, a sidecar index file (<filePath>.idx) is
+                           // generated during the pass
+  long selectTf = -1; // if >= 0, only pages of given timeframe id are
+                      // processed, located by direct seek using the sidecar
+                      // index file
+  std::string directory; // if set, all files of given directory are checked
+                         // concurrently by a pool of worker threads
+  int numberOfThreads =
+      (int)std::thread::hardware_concurrency(); // number of worker threads
+                                                // for multi-file check
+  int rdhVersion = 0; // RDH version expected in file (0 = accept v3/v4)
 
   // parse input arguments
   // format is a list of key=value pairs
@@ -55,6 +266,12 @@ int main(int argc, const char *argv[]) {
     dumpData=(int) : dump the data pages. If -1, all bytes. Otherwise, the first bytes only, as specified.\n \
     dumpDataInline=(int) : if set, each packet raw content is printed (hex dump style). \
     fileReadVerbose=(int) : if set, more information is printed when reading/decoding file. \
+    useMmap=0|1 : access file by read-only memory mapping instead of buffered reads.\n \
+    writeIndex=0|1 : generate a sidecar index file (filePath.idx) with the offset of each data page.\n \
+    tf=(int) : process only the pages of given timeframe id, seeking directly to them with the sidecar index file (generate it first with writeIndex=1).\n \
+    directory=(string) : check all files of given directory concurrently (validation only), merging statistics in one report. filePath also accepts a comma-separated list of files.\n \
+    numberOfThreads=(int) : number of worker threads for multi-file check (default: number of cores).\n \
+    rdhVersion=(int) : RDH version expected in the file (3 or 4): the scan is specialized for it, other versions reported as errors. 0 (default) accepts v3 and v4.\n \
     \n",
            argv[0]);
     return -1;
@@ -104,25 +321,172 @@ int main(int argc, const char *argv[]) {
       fileReadVerbose = std::stoi(value);
     } else if (key == "checkContinuousTriggerOrder") {
       checkContinuousTriggerOrder = std::stoi(value);
+    } else if (key == "useMmap") {
+      useMmap = std::stoi(value);
+    } else if (key == "writeIndex") {
+      writeIndex = std::stoi(value);
+    } else if (key == "tf") {
+      selectTf = std::stol(value);
+    } else if (key == "directory") {
+      directory = value;
+    } else if (key == "numberOfThreads") {
+      numberOfThreads = std::stoi(value);
+    } else if (key == "rdhVersion") {
+      rdhVersion = std::stoi(value);
     } else {
       ERRLOG("unknown option %s\n", key.c_str());
     }
   }
 
-  if (filePath == "") {
+  if (rdhVersion) {
+    if ((rdhVersion != 3) && (rdhVersion != 4)) {
+      ERRLOG("wrong rdhVersion %d (3 or 4 expected)\n", rdhVersion);
+      return -1;
+    }
+    gScanRdhBlock = getScanRdhBlockFunction(rdhVersion);
+  }
+
+  if ((filePath == "") && (directory == "")) {
     ERRLOG("Please provide a file name\n");
     return -1;
   }
 
+  // parallel multi-file validation mode: a set of files (all files of a
+  // directory, or a comma-separated filePath list) is checked concurrently by
+  // a pool of worker threads, merging statistics in one report
+  std::vector<std::string> filePathList;
+  if (directory.length()) {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL) {
+      ERRLOG("Failed to open directory %s\n", directory.c_str());
+      return -1;
+    }
+    struct dirent *dirEntry;
+    while ((dirEntry = readdir(dir)) != NULL) {
+      std::string name = dirEntry->d_name;
+      if ((name == ".") || (name == "..")) {
+        continue;
+      }
+      if ((name.size() >= 4) &&
+          (name.compare(name.size() - 4, 4, ".idx") == 0)) {
+        // skip sidecar index files
+        continue;
+      }
+      std::string fullPath = directory + "/" + name;
+      struct stat st;
+      if ((stat(fullPath.c_str(), &st) == 0) && (S_ISREG(st.st_mode))) {
+        filePathList.push_back(fullPath);
+      }
+    }
+    closedir(dir);
+    std::sort(filePathList.begin(), filePathList.end());
+  } else if (filePath.find(',') != std::string::npos) {
+    size_t begin = 0;
+    for (;;) {
+      size_t end = filePath.find(',', begin);
+      std::string item = filePath.substr(
+          begin, (end == std::string::npos) ? end : end - begin);
+      if (item.length()) {
+        filePathList.push_back(item);
+      }
+      if (end == std::string::npos) {
+        break;
+      }
+      begin = end + 1;
+    }
+  }
+  if (filePathList.size()) {
+    if (numberOfThreads < 1) {
+      numberOfThreads = 1;
+    }
+    if ((size_t)numberOfThreads > filePathList.size()) {
+      numberOfThreads = (int)filePathList.size();
+    }
+    ERRLOG("Checking %lu files with %d threads\n",
+           (unsigned long)filePathList.size(), numberOfThreads);
+
+    std::vector<FileCheckStats> fileStats(filePathList.size());
+    std::vector<int> fileResult(filePathList.size(), 0);
+    std::atomic<size_t> nextFileIx{0};
+    auto worker = [&]() {
+      // each thread takes the next unchecked file until the list is done
+      for (;;) {
+        size_t ix = nextFileIx.fetch_add(1);
+        if (ix >= filePathList.size()) {
+          return;
+        }
+        fileResult[ix] = validateFile(filePathList[ix], fileType,
+                                      dataBlockHeaderEnabled, fileStats[ix]);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numberOfThreads; i++) {
+      workers.push_back(std::thread(worker));
+    }
+    for (auto &t : workers) {
+      t.join();
+    }
+
+    // merge per-file statistics in one report
+    FileCheckStats total;
+    unsigned long nFiles = 0, nFilesFailed = 0;
+    printf("%-50s %10s %14s %12s %8s\n", "file", "pages", "bytes", "packets",
+           "errors");
+    for (size_t i = 0; i < filePathList.size(); i++) {
+      FileCheckStats &s = fileStats[i];
+      if (fileResult[i] != 0) {
+        printf("%-50s read failed\n", filePathList[i].c_str());
+        nFilesFailed++;
+        continue;
+      }
+      nFiles++;
+      printf("%-50s %10lu %14llu %12llu %8lu\n", filePathList[i].c_str(),
+             s.pages, s.bytes, s.rdhPackets, s.errors);
+      if (s.firstError.length()) {
+        // strip trailing newline of stored error description
+        while (s.firstError.length() && (s.firstError.back() == '\n')) {
+          s.firstError.pop_back();
+        }
+        printf("%-50s first error: %s\n", "", s.firstError.c_str());
+      }
+      total.pages += s.pages;
+      total.bytes += s.bytes;
+      total.rdhPackets += s.rdhPackets;
+      total.errors += s.errors;
+      for (unsigned int l = 0; l <= RdhMaxLinkId; l++) {
+        total.linkPackets[l] += s.linkPackets[l];
+        total.linkBytes[l] += s.linkBytes[l];
+      }
+    }
+    printf("Per-link statistics:\n");
+    printf("%6s %14s %16s\n", "link", "packets", "bytes");
+    for (unsigned int l = 0; l <= RdhMaxLinkId; l++) {
+      if (total.linkPackets[l]) {
+        printf("%6u %14llu %16llu\n", l, total.linkPackets[l],
+               total.linkBytes[l]);
+      }
+    }
+    printf("Total: %lu files checked (%lu unreadable), %lu pages, %llu bytes, "
+           "%llu RDH packets, %lu errors\n",
+           nFiles, nFilesFailed, total.pages, total.bytes, total.rdhPackets,
+           total.errors);
+    if ((total.errors) || (nFilesFailed)) {
+      return -1;
+    }
+    return 0;
+  }
+
   ERRLOG("Using data file %s\n", filePath.c_str());
   ERRLOG("dataBlockHeaderEnabled=%d dumpRDH=%d validateRDH=%d "
          "checkContinuousTriggerOrder=%d "
          "dumpDataBlockHeader=%d dumpData=%d "
 	 "dumpDataInline=%d fileReadVerbose=%d "
+	 "useMmap=%d writeIndex=%d tf=%ld "
 	 "\n",
          (int)dataBlockHeaderEnabled, (int)dumpRDH, (int)validateRDH,
          (int)checkContinuousTriggerOrder, (int)dumpDataBlockHeader, dumpData,
-	 (int)dumpDataInline,(int)fileReadVerbose
+	 (int)dumpDataInline,(int)fileReadVerbose,
+	 (int)useMmap,(int)writeIndex,selectTf
 	 );
 
   // open raw data file
@@ -152,6 +516,98 @@ int main(int argc, const char *argv[]) {
     printf("File size: %ld bytes\n", fileSize);
   }
 
+  // optional read-only memory mapping of the file:
+  // page data is then parsed in place (no read/copy into a private buffer),
+  // with sequential read-ahead hint
+  uint8_t *mapAddress = nullptr;
+  unsigned long readOffset = 0; // current read position, when mapped
+  if (useMmap) {
+    mapAddress =
+        (uint8_t *)mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fileno(fp), 0);
+    if (mapAddress == MAP_FAILED) {
+      ERRLOG("Failed to mmap file\n");
+      return -1;
+    }
+    madvise(mapAddress, fileSize, MADV_SEQUENTIAL);
+    if (fileReadVerbose) {
+      printf("File mapped @ %p\n", (void *)mapAddress);
+    }
+  }
+
+  // helpers to read / seek, from mapping or with buffered file access
+  auto fileRead = [&](void *dst, size_t size) -> bool {
+    if (mapAddress != nullptr) {
+      if (readOffset + size > (unsigned long)fileSize) {
+        return false;
+      }
+      memcpy(dst, mapAddress + readOffset, size);
+      readOffset += size;
+      return true;
+    }
+    return fread(dst, size, 1, fp) == 1;
+  };
+  auto fileSeek = [&](unsigned long offset) -> bool {
+    if (mapAddress != nullptr) {
+      readOffset = offset;
+      return true;
+    }
+    return fseek(fp, offset, SEEK_SET) == 0;
+  };
+
+  std::string indexPath = filePath + ".idx";
+
+  // optional generation of the sidecar index file
+  FILE *fpIndex = nullptr;
+  if (writeIndex) {
+    fpIndex = fopen(indexPath.c_str(), "wb");
+    if (fpIndex == NULL) {
+      ERRLOG("Failed to create index file %s\n", indexPath.c_str());
+      return -1;
+    }
+    // header written now to reserve space, pageCount patched at the end
+    RawFileIndexHeader indexHeader;
+    memcpy(indexHeader.magic, RawFileIndexMagic, sizeof(indexHeader.magic));
+    indexHeader.pageCount = 0;
+    if (fwrite(&indexHeader, sizeof(indexHeader), 1, fpIndex) != 1) {
+      ERRLOG("Failed to write index file %s\n", indexPath.c_str());
+      return -1;
+    }
+    ERRLOG("Writing index file %s\n", indexPath.c_str());
+  }
+
+  // optional selection of a single timeframe: load the sidecar index and
+  // collect the file offsets of its pages, for direct seek
+  std::vector<unsigned long> selectedPageOffsets;
+  size_t selectedPageIx = 0;
+  if (selectTf >= 0) {
+    FILE *fpi = fopen(indexPath.c_str(), "rb");
+    if (fpi == NULL) {
+      ERRLOG("Index file %s not found, generate it first with writeIndex=1\n",
+             indexPath.c_str());
+      return -1;
+    }
+    RawFileIndexHeader indexHeader;
+    if ((fread(&indexHeader, sizeof(indexHeader), 1, fpi) != 1) ||
+        (memcmp(indexHeader.magic, RawFileIndexMagic,
+                sizeof(indexHeader.magic)) != 0)) {
+      ERRLOG("Bad index file %s\n", indexPath.c_str());
+      return -1;
+    }
+    for (uint64_t i = 0; i < indexHeader.pageCount; i++) {
+      RawFileIndexEntry e;
+      if (fread(&e, sizeof(e), 1, fpi) != 1) {
+        ERRLOG("Bad index file %s\n", indexPath.c_str());
+        return -1;
+      }
+      if (e.timeframeId == (uint64_t)selectTf) {
+        selectedPageOffsets.push_back((unsigned long)e.fileOffset);
+      }
+    }
+    fclose(fpi);
+    ERRLOG("%lu pages indexed for timeframe %ld\n",
+           (unsigned long)selectedPageOffsets.size(), selectTf);
+  }
+
   // read file
   unsigned long pageCount = 0;
   unsigned long RDHBlockCount = 0;
@@ -166,6 +622,10 @@ int main(int argc, const char *argv[]) {
   uint32_t latestTriggerOrbit = 0;
   uint32_t latestTriggerBC = 0;
 
+  std::vector<RdhPacketDescriptor>
+      rdhPacketIndex; // per-page RDH index filled by scanRdhBlock(), vector
+                      // reused across pages to avoid re-allocation
+
   const int maxBlockSize =
       128 * 1024L *
       1024L; // maximum memory allocated for page reading (or decompressing)
@@ -180,12 +640,30 @@ int main(int argc, const char *argv[]) {
     break;                                                                     \
   }
 
+    // timeframe selection: jump directly to the next page of selected
+    // timeframe, as located by the sidecar index
+    if (selectTf >= 0) {
+      if (selectedPageIx >= selectedPageOffsets.size()) {
+        break;
+      }
+      fileOffset = selectedPageOffsets[selectedPageIx++];
+      if (!fileSeek(fileOffset)) {
+        ERRLOG("Failed to seek in file");
+        return -1;
+      }
+    }
+
     unsigned long blockOffset = dataOffset;
     long dataSize;
 
+    // metadata of current page, collected for the index
+    unsigned long entryFileOffset = fileOffset;
+    uint64_t entryTimeframeId = 0;
+    uint32_t entryLinkId = undefinedLinkId;
+
     if (dataBlockHeaderEnabled) {
       DataBlockHeaderBase hb;
-      if (fread(&hb, sizeof(hb), 1, fp) != 1) {
+      if (!fileRead(&hb, sizeof(hb))) {
         break;
       }
       fileOffset += sizeof(hb);
@@ -210,6 +688,8 @@ int main(int argc, const char *argv[]) {
         printf("\tdata @ %lu\n", fileOffset);
       }
       dataSize = hb.dataSize;
+      entryTimeframeId = hb.timeframeId;
+      entryLinkId = hb.linkId;
     } else {
       dataSize = fileSize - fileOffset;
 
@@ -222,7 +702,7 @@ int main(int argc, const char *argv[]) {
         const char header[] = {0x04, 0x22, 0x4D, 0x18, 0x60, 0x70, 0x73};
         uint32_t blockSize = 0;
         char buffer[sizeof(header) + sizeof(blockSize)];
-        if (fread(&buffer, sizeof(buffer), 1, fp) != 1) {
+        if (!fileRead(&buffer, sizeof(buffer))) {
           ERR_LOOP;
         }
 
@@ -255,12 +735,24 @@ int main(int argc, const char *argv[]) {
     if (dataSize == 0) {
       ERR_LOOP;
     }
-    void *data = malloc(dataSize);
-    if (data == NULL) {
-      ERR_LOOP;
-    }
-    if (fread(data, dataSize, 1, fp) != 1) {
-      ERR_LOOP;
+    void *data = nullptr;
+    bool dataIsOwned = false; // set when data in a private buffer to free
+    if (mapAddress != nullptr) {
+      // zero-copy: parse page in place from the mapping
+      if (readOffset + dataSize > (unsigned long)fileSize) {
+        ERR_LOOP;
+      }
+      data = mapAddress + readOffset;
+      readOffset += dataSize;
+    } else {
+      data = malloc(dataSize);
+      if (data == NULL) {
+        ERR_LOOP;
+      }
+      dataIsOwned = true;
+      if (fread(data, dataSize, 1, fp) != 1) {
+        ERR_LOOP;
+      }
     }
     fileOffset += dataSize;
     pageCount++;
@@ -269,7 +761,7 @@ int main(int argc, const char *argv[]) {
       // read trailer
       const char trailer[] = {0x00, 0x00, 0x00, 0x00};
       char buffer[sizeof(trailer)];
-      if (fread(&buffer, sizeof(buffer), 1, fp) != 1) {
+      if (!fileRead(&buffer, sizeof(buffer))) {
         ERR_LOOP;
       }
 
@@ -295,14 +787,38 @@ int main(int argc, const char *argv[]) {
       if ((res <= 0) || (res >= maxBlockSize)) {
         ERR_LOOP;
       }
-      free(data);
+      if (dataIsOwned) {
+        free(data);
+      }
       data = dataUncompressed;
+      dataIsOwned = true;
       dataSize = res;
       if (fileReadVerbose) {
         printf("uncompressed = %ld bytes\n", dataSize);
       }
     }
 
+    // append an entry for this page to the sidecar index
+    if (fpIndex != nullptr) {
+      RawFileIndexEntry e;
+      e.fileOffset = entryFileOffset;
+      e.dataSize = (uint64_t)dataSize;
+      e.timeframeId = entryTimeframeId;
+      e.linkId = entryLinkId;
+      e.firstOrbit = 0;
+      if ((unsigned long)dataSize >= sizeof(o2::Header::RAWDataHeader)) {
+        RdhHandle h(data);
+        e.firstOrbit = h.getHbOrbit();
+        if (e.linkId == undefinedLinkId) {
+          e.linkId = h.getLinkId();
+        }
+      }
+      if (fwrite(&e, sizeof(e), 1, fpIndex) != 1) {
+        ERRLOG("Failed to write index file %s\n", indexPath.c_str());
+        return -1;
+      }
+    }
+
     if (dumpData) {
       long max = dataSize;
       if ((dumpData < max) && (dumpData > 0)) {
@@ -319,7 +835,30 @@ int main(int argc, const char *argv[]) {
       printf("\n\t...\n");
     }
 
-    if ((validateRDH) || (dumpRDH)) {
+    if ((validateRDH) && (!dumpRDH) && (!dumpDataInline) &&
+        (!checkContinuousTriggerOrder) && (!isAutoPageSize)) {
+      // fast path for plain validation: a single scan-and-validate pass over
+      // the page (see scanRdhBlock()), no per-RDH options to honor
+      std::string errorDescription;
+      rdhPacketIndex.clear();
+      int scanResult =
+          gScanRdhBlock(data, dataSize, rdhPacketIndex, errorDescription);
+      RDHBlockCount += rdhPacketIndex.size();
+      if (scanResult < 0) {
+        // an invalid header stopped the scan, located right after the last
+        // packet indexed
+        size_t pageOffset = 0;
+        if (rdhPacketIndex.size()) {
+          pageOffset =
+              rdhPacketIndex.back().offset + rdhPacketIndex.back().size;
+        }
+        RDHBlockCount++;
+        RdhHandle h(((uint8_t *)data) + pageOffset);
+        h.dumpRdh(pageOffset, 1);
+        ERRLOG("File offset 0x%08lX + %ld\n%s", blockOffset, pageOffset,
+               errorDescription.c_str());
+      }
+    } else if ((validateRDH) || (dumpRDH)) {
       std::string errorDescription;
       for (size_t pageOffset = 0; pageOffset < (unsigned long)dataSize;) {
 
@@ -332,7 +871,7 @@ int main(int argc, const char *argv[]) {
             int delta = dataSize - pageOffset;
             fileOffset -= delta;
             dataSize -= delta;
-            if (fseek(fp, fileOffset, SEEK_SET)) {
+            if (!fileSeek(fileOffset)) {
               ERRLOG("Failed to seek in file");
               return -1;
             }
@@ -431,7 +970,7 @@ int main(int argc, const char *argv[]) {
             int delta = pageOffset + offsetNextPacket - dataSize;
             fileOffset += delta;
             dataSize += delta;
-            if (fseek(fp, fileOffset, SEEK_SET)) {
+            if (!fileSeek(fileOffset)) {
               ERRLOG("Failed to seek in file");
               return -1;
             }
@@ -447,7 +986,9 @@ int main(int argc, const char *argv[]) {
       }
     }
 
-    free(data);
+    if (dataIsOwned) {
+      free(data);
+    }
     dataOffset += dataSize;
     if (dataOffsetProgressStep) {
       if (dataOffset > dataOffsetLast + dataOffsetProgressStep) {
@@ -462,11 +1003,31 @@ int main(int argc, const char *argv[]) {
   }
   ERRLOG("%lu bytes\n", fileOffset);
 
+  // finalize sidecar index: patch page count in header
+  if (fpIndex != nullptr) {
+    RawFileIndexHeader indexHeader;
+    memcpy(indexHeader.magic, RawFileIndexMagic, sizeof(indexHeader.magic));
+    indexHeader.pageCount = pageCount;
+    if ((fseek(fpIndex, 0, SEEK_SET)) ||
+        (fwrite(&indexHeader, sizeof(indexHeader), 1, fpIndex) != 1)) {
+      ERRLOG("Failed to write index file %s\n", indexPath.c_str());
+    } else {
+      ERRLOG("Index file %s completed, %lu pages\n", indexPath.c_str(),
+             pageCount);
+    }
+    fclose(fpIndex);
+  }
+
   // check file status
-  if (feof(fp)) {
+  if ((mapAddress == nullptr) && (feof(fp))) {
     ERRLOG("End of file\n");
   }
 
+  // release mapping
+  if (mapAddress != nullptr) {
+    munmap(mapAddress, fileSize);
+  }
+
   // close file
   fclose(fp);
 }
@@ -0,0 +1,475 @@
+// Copyright CERN and copyright holders of ALICE O2. This software is
+// distributed under the terms of the GNU General Public License v3 (GPL
+// Version 3), copied verbatim in the file "COPYING".
+//
+// See http://alice-o2.web.cern.ch/license for full licensing information.
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+// FMQ transport benchmark harness
+// Sweeps message size, parts per message, transport type and channel count in
+// one invocation (sender and receiver threads in the same process), and
+// reports throughput and latency percentiles for each point, in text, CSV or
+// JSON format. A previous CSV report can be given as baseline, results are
+// then compared point by point to detect performance regressions.
+
+#ifdef WITH_FAIRMQ
+
+#include <fairmq/FairMQDevice.h>
+#include <fairmq/FairMQMessage.h>
+#include <fairmq/FairMQTransportFactory.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// one point of the benchmark sweep
+struct BenchmarkPoint {
+  std::string transport; // FMQ transport type (shmem, zeromq)
+  int nChannels;         // number of independent channel pairs
+  size_t msgSize;        // size of each message part, bytes
+  int nParts;            // number of parts per (multipart) message
+};
+
+// measured results for one point
+struct BenchmarkResult {
+  BenchmarkPoint point;
+  double duration = 0;      // effective measurement time, seconds
+  double msgRate = 0;       // messages per second (all channels)
+  double throughputMBs = 0; // payload throughput, MB/s (all channels)
+  double latencyAvg = 0;    // send-to-receive latency, average, microseconds
+  double latencyP50 = 0;    // latency percentiles, microseconds
+  double latencyP90 = 0;
+  double latencyP99 = 0;
+  double latencyMax = 0;
+};
+
+// per-channel counters, written by the receiver thread
+struct ChannelStats {
+  unsigned long long nMsg = 0;
+  unsigned long long nBytes = 0;
+  std::vector<double> latencies; // microseconds
+};
+
+// current time, monotonic, in nanoseconds
+static uint64_t getTimeNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// maximum number of latency samples kept per channel
+const size_t maxLatencySamples = 1000000;
+
+// run one benchmark point and fill result. returns 0 on success.
+static int runBenchmarkPoint(const BenchmarkPoint &point, int durationSeconds,
+                             BenchmarkResult &result) {
+
+  result.point = point;
+
+  std::atomic<int> stopSenders(0);
+  std::atomic<int> stopReceivers(0);
+  std::vector<std::thread> senderThreads;
+  std::vector<std::thread> receiverThreads;
+  std::vector<ChannelStats> channelStats(point.nChannels);
+
+  // each channel pair gets a unique address, to allow successive points
+  // without rebinding conflicts
+  static int addressSequence = 0;
+  int addressBase = addressSequence;
+  addressSequence += point.nChannels;
+
+  for (int ch = 0; ch < point.nChannels; ch++) {
+    char address[128];
+    snprintf(address, sizeof(address), "ipc:///tmp/readout-benchmark-%d-%d",
+             (int)getpid(), addressBase + ch);
+    std::string channelAddress = address;
+
+    // sender thread: binds, sends multipart messages with a timestamp in the
+    // first part payload
+    senderThreads.push_back(std::thread([&, channelAddress]() {
+      auto factory =
+          FairMQTransportFactory::CreateTransportFactory(point.transport);
+      auto push = FairMQChannel{"benchmark", "pair", factory};
+      push.Bind(channelAddress);
+      if (!push.Validate()) {
+        return;
+      }
+      std::vector<FairMQMessagePtr> msgs;
+      msgs.reserve(point.nParts);
+      while (!stopSenders.load()) {
+        msgs.clear();
+        for (int p = 0; p < point.nParts; p++) {
+          msgs.emplace_back(push.NewMessage(point.msgSize));
+        }
+        if (point.msgSize >= sizeof(uint64_t)) {
+          // timestamp in first part, to measure send-to-receive latency
+          *((uint64_t *)msgs[0]->GetData()) = getTimeNs();
+        }
+        if (push.Send(msgs, 1000) < 0) {
+          continue;
+        }
+      }
+    }));
+
+    // receiver thread: connects, receives and accounts messages
+    receiverThreads.push_back(std::thread([&, channelAddress, ch]() {
+      auto factory =
+          FairMQTransportFactory::CreateTransportFactory(point.transport);
+      auto pull = FairMQChannel{"benchmark", "pair", factory};
+      pull.Connect(channelAddress);
+      ChannelStats &stats = channelStats[ch];
+      stats.latencies.reserve(10000);
+      while (!stopReceivers.load()) {
+        std::vector<FairMQMessagePtr> msgParts;
+        int64_t bytesReceived = pull.Receive(msgParts, 100);
+        if (bytesReceived <= 0) {
+          continue;
+        }
+        if ((msgParts.size()) && (msgParts[0]->GetSize() >= sizeof(uint64_t))) {
+          uint64_t sendTime = *((uint64_t *)msgParts[0]->GetData());
+          if (stats.latencies.size() < maxLatencySamples) {
+            stats.latencies.push_back((getTimeNs() - sendTime) / 1000.0);
+          }
+        }
+        stats.nMsg++;
+        stats.nBytes += bytesReceived;
+      }
+    }));
+  }
+
+  // measurement window
+  uint64_t t0 = getTimeNs();
+  sleep(durationSeconds);
+  stopSenders = 1;
+  for (auto &t : senderThreads) {
+    t.join();
+  }
+  // let receivers drain in-flight messages
+  usleep(200000);
+  stopReceivers = 1;
+  for (auto &t : receiverThreads) {
+    t.join();
+  }
+  double t = (getTimeNs() - t0) / 1000000000.0;
+
+  // aggregate channels
+  unsigned long long nMsg = 0;
+  unsigned long long nBytes = 0;
+  std::vector<double> latencies;
+  for (auto &stats : channelStats) {
+    nMsg += stats.nMsg;
+    nBytes += stats.nBytes;
+    latencies.insert(latencies.end(), stats.latencies.begin(),
+                     stats.latencies.end());
+  }
+  result.duration = t;
+  result.msgRate = nMsg / t;
+  result.throughputMBs = nBytes / (1024.0 * 1024.0 * t);
+  if (latencies.size()) {
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (auto l : latencies) {
+      sum += l;
+    }
+    result.latencyAvg = sum / latencies.size();
+    auto percentile = [&](double p) {
+      return latencies[(size_t)((latencies.size() - 1) * p)];
+    };
+    result.latencyP50 = percentile(0.50);
+    result.latencyP90 = percentile(0.90);
+    result.latencyP99 = percentile(0.99);
+    result.latencyMax = latencies.back();
+  }
+  return 0;
+}
+
+// CSV format of a result, matching loadBaseline() below
+static const char *csvHeader = "transport,channels,msgSize,msgParts,duration,"
+                               "msgRate,throughputMBs,latencyAvgUs,"
+                               "latencyP50Us,latencyP90Us,latencyP99Us,"
+                               "latencyMaxUs";
+static void printCsvResult(FILE *fp, const BenchmarkResult &r) {
+  fprintf(fp, "%s,%d,%lu,%d,%.3lf,%.1lf,%.3lf,%.2lf,%.2lf,%.2lf,%.2lf,%.2lf\n",
+          r.point.transport.c_str(), r.point.nChannels, r.point.msgSize,
+          r.point.nParts, r.duration, r.msgRate, r.throughputMBs, r.latencyAvg,
+          r.latencyP50, r.latencyP90, r.latencyP99, r.latencyMax);
+}
+
+// load results from a previous CSV report, for baseline comparison
+static int loadBaseline(const std::string &path,
+                        std::vector<BenchmarkResult> &baseline) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char transport[64];
+    BenchmarkResult r;
+    unsigned long msgSize = 0;
+    if (sscanf(line,
+               "%63[^,],%d,%lu,%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+               transport, &r.point.nChannels, &msgSize, &r.point.nParts,
+               &r.duration, &r.msgRate, &r.throughputMBs, &r.latencyAvg,
+               &r.latencyP50, &r.latencyP90, &r.latencyP99,
+               &r.latencyMax) == 12) {
+      r.point.transport = transport;
+      r.point.msgSize = msgSize;
+      baseline.push_back(r);
+    }
+  }
+  fclose(fp);
+  return 0;
+}
+
+// parse a comma-separated list of (unsigned) numbers
+static std::vector<size_t> parseNumberList(const std::string &value) {
+  std::vector<size_t> result;
+  size_t ix = 0;
+  while (ix < value.length()) {
+    size_t next = value.find(',', ix);
+    if (next == std::string::npos) {
+      next = value.length();
+    }
+    result.push_back((size_t)atoll(value.substr(ix, next - ix).c_str()));
+    ix = next + 1;
+  }
+  return result;
+}
+
+// parse a comma-separated list of strings
+static std::vector<std::string> parseStringList(const std::string &value) {
+  std::vector<std::string> result;
+  size_t ix = 0;
+  while (ix < value.length()) {
+    size_t next = value.find(',', ix);
+    if (next == std::string::npos) {
+      next = value.length();
+    }
+    result.push_back(value.substr(ix, next - ix));
+    ix = next + 1;
+  }
+  return result;
+}
+
+int main(int argc, const char **argv) {
+
+  // parameters of the sweep, with defaults
+  std::vector<std::string> transports = {"shmem"};
+  std::vector<size_t> channelCounts = {1};
+  std::vector<size_t> msgSizes = {1024, 65536, 1048576};
+  std::vector<size_t> msgParts = {1, 64};
+  int duration = 5;          // seconds per benchmark point
+  std::string outputFormat = "text"; // text, csv or json
+  std::string outputFile;    // when set, report written there instead of stdout
+  std::string baselinePath;  // when set, CSV report to compare against
+  double tolerance = 10.0;   // regression threshold, percent of baseline
+
+  // parse input arguments
+  // format is a list of key=value pairs
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    std::string key(option);
+    size_t separatorPosition = key.find('=');
+    if (separatorPosition == std::string::npos) {
+      printf("Usage: %s [options]\nList of options:\n \
+    transports=(string,...) : list of FMQ transports to test (default: shmem). e.g. shmem,zeromq.\n \
+    channels=(int,...) : list of channel counts to test (default: 1).\n \
+    msgSizes=(int,...) : list of message part sizes to test, bytes (default: 1024,65536,1048576).\n \
+    msgParts=(int,...) : list of parts-per-message counts to test (default: 1,64).\n \
+    duration=(int) : measurement time per benchmark point, seconds (default: 5).\n \
+    outputFormat=text|csv|json : report format (default: text).\n \
+    outputFile=(string) : write report to given file instead of stdout.\n \
+    baseline=(string) : path to a previous CSV report. Results are compared point by point, and exit code is non-zero if throughput drops by more than the tolerance.\n \
+    tolerance=(float) : throughput regression threshold for baseline comparison, in percent (default: 10).\n \
+    \n",
+             argv[0]);
+      return -1;
+    }
+    key.resize(separatorPosition);
+    std::string value = &(option[separatorPosition + 1]);
+
+    if (key == "transports") {
+      transports = parseStringList(value);
+    } else if (key == "channels") {
+      channelCounts = parseNumberList(value);
+    } else if (key == "msgSizes") {
+      msgSizes = parseNumberList(value);
+    } else if (key == "msgParts") {
+      msgParts = parseNumberList(value);
+    } else if (key == "duration") {
+      duration = atoi(value.c_str());
+    } else if (key == "outputFormat") {
+      outputFormat = value;
+    } else if (key == "outputFile") {
+      outputFile = value;
+    } else if (key == "baseline") {
+      baselinePath = value;
+    } else if (key == "tolerance") {
+      tolerance = atof(value.c_str());
+    } else {
+      printf("Failed to parse option '%s'\n", option);
+      return -1;
+    }
+  }
+  if ((outputFormat != "text") && (outputFormat != "csv") &&
+      (outputFormat != "json")) {
+    printf("Wrong output format %s\n", outputFormat.c_str());
+    return -1;
+  }
+
+  // load baseline, if any
+  std::vector<BenchmarkResult> baseline;
+  if (baselinePath.length()) {
+    if (loadBaseline(baselinePath, baseline) || (baseline.size() == 0)) {
+      printf("Failed to load baseline from %s\n", baselinePath.c_str());
+      return -1;
+    }
+    printf("Baseline loaded from %s : %lu points\n", baselinePath.c_str(),
+           baseline.size());
+  }
+
+  // run the sweep
+  std::vector<BenchmarkResult> results;
+  int nPoints = (int)(transports.size() * channelCounts.size() *
+                      msgSizes.size() * msgParts.size());
+  printf("Running %d benchmark points, %ds each\n", nPoints, duration);
+  for (auto const &transport : transports) {
+    for (auto nChannels : channelCounts) {
+      for (auto msgSize : msgSizes) {
+        for (auto nParts : msgParts) {
+          BenchmarkPoint point;
+          point.transport = transport;
+          point.nChannels = (int)nChannels;
+          point.msgSize = msgSize;
+          point.nParts = (int)nParts;
+          printf("%s channels=%d msgSize=%lu msgParts=%d ... ",
+                 point.transport.c_str(), point.nChannels, point.msgSize,
+                 point.nParts);
+          fflush(stdout);
+          BenchmarkResult result;
+          if (runBenchmarkPoint(point, duration, result)) {
+            printf("failed\n");
+            continue;
+          }
+          printf("%.1lf msg/s %.3lf MB/s lat p99 = %.2lf us\n", result.msgRate,
+                 result.throughputMBs, result.latencyP99);
+          results.push_back(result);
+        }
+      }
+    }
+  }
+
+  // write report
+  FILE *fpOut = stdout;
+  if (outputFile.length()) {
+    fpOut = fopen(outputFile.c_str(), "w");
+    if (fpOut == NULL) {
+      printf("Failed to create %s\n", outputFile.c_str());
+      return -1;
+    }
+  }
+  if (outputFormat == "csv") {
+    fprintf(fpOut, "%s\n", csvHeader);
+    for (auto const &r : results) {
+      printCsvResult(fpOut, r);
+    }
+  } else if (outputFormat == "json") {
+    fprintf(fpOut, "[\n");
+    int ix = 0;
+    for (auto const &r : results) {
+      fprintf(fpOut,
+              "  {\"transport\": \"%s\", \"channels\": %d, \"msgSize\": %lu, "
+              "\"msgParts\": %d, \"duration\": %.3lf, \"msgRate\": %.1lf, "
+              "\"throughputMBs\": %.3lf, \"latencyAvgUs\": %.2lf, "
+              "\"latencyP50Us\": %.2lf, \"latencyP90Us\": %.2lf, "
+              "\"latencyP99Us\": %.2lf, \"latencyMaxUs\": %.2lf}%s\n",
+              r.point.transport.c_str(), r.point.nChannels, r.point.msgSize,
+              r.point.nParts, r.duration, r.msgRate, r.throughputMBs,
+              r.latencyAvg, r.latencyP50, r.latencyP90, r.latencyP99,
+              r.latencyMax, (++ix < (int)results.size()) ? "," : "");
+    }
+    fprintf(fpOut, "]\n");
+  } else {
+    fprintf(fpOut, "%-8s %8s %10s %8s %12s %12s %10s %10s %10s %10s\n",
+            "transport", "channels", "msgSize", "msgParts", "msg/s", "MB/s",
+            "lat avg", "lat p50", "lat p90", "lat p99");
+    for (auto const &r : results) {
+      fprintf(fpOut,
+              "%-8s %8d %10lu %8d %12.1lf %12.3lf %10.2lf %10.2lf %10.2lf "
+              "%10.2lf\n",
+              r.point.transport.c_str(), r.point.nChannels, r.point.msgSize,
+              r.point.nParts, r.msgRate, r.throughputMBs, r.latencyAvg,
+              r.latencyP50, r.latencyP90, r.latencyP99);
+    }
+  }
+  if (fpOut != stdout) {
+    fclose(fpOut);
+    printf("Report written to %s\n", outputFile.c_str());
+  }
+
+  // baseline comparison
+  int nRegressions = 0;
+  if (baseline.size()) {
+    printf("\nComparison with baseline (tolerance %.1lf %%):\n", tolerance);
+    for (auto const &r : results) {
+      const BenchmarkResult *b = nullptr;
+      for (auto const &candidate : baseline) {
+        if ((candidate.point.transport == r.point.transport) &&
+            (candidate.point.nChannels == r.point.nChannels) &&
+            (candidate.point.msgSize == r.point.msgSize) &&
+            (candidate.point.nParts == r.point.nParts)) {
+          b = &candidate;
+          break;
+        }
+      }
+      if (b == nullptr) {
+        printf("%s channels=%d msgSize=%lu msgParts=%d : not in baseline\n",
+               r.point.transport.c_str(), r.point.nChannels, r.point.msgSize,
+               r.point.nParts);
+        continue;
+      }
+      double delta = 0;
+      if (b->throughputMBs > 0) {
+        delta = (r.throughputMBs - b->throughputMBs) * 100.0 / b->throughputMBs;
+      }
+      bool isRegression = (delta < -tolerance);
+      if (isRegression) {
+        nRegressions++;
+      }
+      printf("%s channels=%d msgSize=%lu msgParts=%d : %.3lf MB/s vs %.3lf "
+             "MB/s (%+.1lf %%)%s\n",
+             r.point.transport.c_str(), r.point.nChannels, r.point.msgSize,
+             r.point.nParts, r.throughputMBs, b->throughputMBs, delta,
+             isRegression ? " REGRESSION" : "");
+    }
+    if (nRegressions) {
+      printf("%d benchmark points below baseline\n", nRegressions);
+      return 1;
+    }
+    printf("No regression detected\n");
+  }
+
+  return 0;
+}
+
+#else
+
+// replacement implementation when FMQ not available
+#include <stdio.h>
+int main() {
+  printf("Not compiled with FMQ, exiting\n");
+  return 0;
+}
+
+#endif
@@ -27,12 +27,19 @@
 #include <InfoLogger/InfoLogger.hxx>
 
 #include "CounterStats.h"
+#include <Common/Fifo.h>
 #include <Common/Timer.h>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "RAWDataHeader.h"
 #include "SubTimeframe.h"
 
 #include "RdhUtils.h"
+#include "ReadoutUtils.h"
 
 // definition of a global for logging
 using namespace AliceO2::InfoLogger;
@@ -203,6 +210,232 @@ ReadoutStfDecoder::~ReadoutStfDecoder() {
   }
 }
 
+enum decodingMode { none = 0, stfHbf = 1, stfSuperpage = 2, stfV2 = 3 };
+
+// counters of the decoding/checking stage.
+// one instance per decoding thread, aggregated for the final report.
+struct DecodeStats {
+  unsigned long long nMsgDecoded = 0; // number of messages decoded
+  unsigned long long nParts = 0;      // number of message parts decoded
+  unsigned long long nErrors = 0;     // number of decoding/checking errors
+  double copyRatio = 0;               // cumulated HBF copy ratio (stfSuperpage)
+  unsigned long long copyRatioCount = 0; // number of copy ratio samples
+  unsigned long long nChecksum = 0; // number of part checksums verified (stfV2)
+};
+
+// decode / check one multi-part message, according to given mode.
+// counters updated accordingly. may be called concurrently from several
+// threads (each with its own stats instance).
+static void decodeMessage(std::vector<FairMQMessagePtr> &msgParts,
+                          decodingMode mode, int cfgDumpRDH, int cfgDumpTF,
+                          int cfgCheckChecksum, DecodeStats &stats) {
+  stats.nMsgDecoded++;
+
+  if (mode == decodingMode::stfHbf) {
+
+    // expected format of received messages : (header + HB + HB ...)
+
+    int nPart = msgParts.size();
+    stats.nParts += nPart;
+    if (nPart < 2) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Only %d parts in message, need at least 2", nPart);
+      stats.nErrors++;
+      return;
+    }
+
+    int i = 0;
+    bool dumpNext = false;
+    SubTimeframe *stf = nullptr;
+    for (auto const &mm : msgParts) {
+
+      if (i == 0) {
+        // first part is STF header
+        if (mm->GetSize() != sizeof(SubTimeframe)) {
+          theLog.log(InfoLogger::Severity::Error,
+                     "Header wrong size %d != %d\n", (int)mm->GetSize(),
+                     (int)sizeof(SubTimeframe));
+          stats.nErrors++;
+          break;
+        }
+        stf = (SubTimeframe *)mm->GetData();
+        if ((int)stf->numberOfHBF != nPart - 1) {
+          theLog.log(InfoLogger::Severity::Error,
+                     "Mismatch stf->numberOfHBF %d != %d message parts - 1\n",
+                     stf->numberOfHBF, nPart - 1);
+          stats.nErrors++;
+          break;
+        }
+        // number of message parts matches number of HBFs in header ?
+        if (cfgDumpTF) {
+          if ((stf->timeframeId == 1) || (stf->timeframeId % cfgDumpTF == 0)) {
+            dumpNext = true;
+          }
+        }
+      } else {
+        // then we have 1 part per HBF
+        size_t dataSize = mm->GetSize();
+        void *data = mm->GetData();
+        std::string errorDescription;
+        for (size_t pageOffset = 0; pageOffset < dataSize;) {
+          if (pageOffset + sizeof(o2::Header::RAWDataHeader) > dataSize) {
+            theLog.log("part %d offset 0x%08lX: not enough space for RDH", i,
+                       pageOffset);
+            stats.nErrors++;
+            break;
+          }
+          RdhHandle h(((uint8_t *)data) + pageOffset);
+
+          if (dumpNext) {
+            printf("Receiving TF %d CRU %d link %d : %d HBf\n",
+                   (int)stf->timeframeId, (int)h.getCruId(), (int)stf->linkId,
+                   (int)stf->numberOfHBF);
+            dumpNext = false;
+          }
+
+          if (cfgDumpRDH) {
+            h.dumpRdh(pageOffset, 1);
+          }
+
+          int nErr = h.validateRdh(errorDescription);
+          if (nErr) {
+            if (!cfgDumpRDH) {
+              // dump RDH if not done already
+              h.dumpRdh(pageOffset, 1);
+            }
+            theLog.log(InfoLogger::Severity::Error,
+                       "part %d offset 0x%08lX : %s", i, pageOffset,
+                       errorDescription.c_str());
+            errorDescription.clear();
+            stats.nErrors++;
+            break;
+          }
+
+          // go to next RDH
+          uint16_t offsetNextPacket = h.getOffsetNextPacket();
+          if (offsetNextPacket == 0) {
+            break;
+          }
+          pageOffset += offsetNextPacket;
+        }
+      }
+      i++;
+    }
+
+  } else if (mode == decodingMode::stfSuperpage) {
+
+    stats.nParts += msgParts.size();
+    ReadoutStfDecoder decoder(std::move(msgParts));
+    stats.copyRatio += decoder.getCopyRatio();
+    stats.copyRatioCount++;
+
+    if (cfgDumpRDH) {
+      int i = 0;
+      for (auto const &p : decoder.getHbf()) {
+        printf("HBF %d\n", i);
+        for (size_t offset = 0; offset < p.size;) {
+          RdhHandle h(((uint8_t *)p.data) + offset);
+          if (cfgDumpRDH) {
+            h.dumpRdh(offset, 1);
+          }
+          // go to next RDH
+          uint16_t offsetNextPacket = h.getOffsetNextPacket();
+          if (offsetNextPacket == 0) {
+            break;
+          }
+          offset += offsetNextPacket;
+        }
+        i++;
+      }
+    }
+  } else if (mode == decodingMode::stfV2) {
+
+    // expected format of received messages : (v2 header + part + part
+    // ...) all routing information comes from the part descriptor table
+    // in the header: payload memory is not read
+
+    int nPart = msgParts.size();
+    stats.nParts += nPart;
+    if (nPart < 2) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Only %d parts in message, need at least 2", nPart);
+      stats.nErrors++;
+      return;
+    }
+    auto const &mm = msgParts[0];
+    if (mm->GetSize() < sizeof(SubTimeframeV2)) {
+      theLog.log(InfoLogger::Severity::Error, "Header wrong size %d < %d\n",
+                 (int)mm->GetSize(), (int)sizeof(SubTimeframeV2));
+      stats.nErrors++;
+      return;
+    }
+    SubTimeframeV2 *stf = (SubTimeframeV2 *)mm->GetData();
+    if (stf->version != 2) {
+      theLog.log(InfoLogger::Severity::Error, "Header wrong version %d != 2",
+                 (int)stf->version);
+      stats.nErrors++;
+      return;
+    }
+    if ((int)stf->numberOfParts != nPart - 1) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Mismatch stf->numberOfParts %d != %d message parts - "
+                 "1\n",
+                 stf->numberOfParts, nPart - 1);
+      stats.nErrors++;
+      return;
+    }
+    if (mm->GetSize() !=
+        sizeof(SubTimeframeV2) +
+            stf->numberOfParts * sizeof(SubTimeframePartDescriptor)) {
+      theLog.log(InfoLogger::Severity::Error,
+                 "Header wrong size %d for %d parts\n", (int)mm->GetSize(),
+                 (int)stf->numberOfParts);
+      stats.nErrors++;
+      return;
+    }
+    SubTimeframePartDescriptor *partTable =
+        (SubTimeframePartDescriptor *)((char *)mm->GetData() +
+                                       sizeof(SubTimeframeV2));
+    bool dumpNext = false;
+    if (cfgDumpTF) {
+      if ((stf->timeframeId == 1) || (stf->timeframeId % cfgDumpTF == 0)) {
+        dumpNext = true;
+      }
+    }
+    for (uint32_t p = 0; p < stf->numberOfParts; p++) {
+      // check table against message sizes (metadata only)
+      if (partTable[p].size != msgParts[p + 1]->GetSize()) {
+        theLog.log(InfoLogger::Severity::Error,
+                   "Mismatch part %d size %d != %d message size\n", (int)p,
+                   (int)partTable[p].size, (int)msgParts[p + 1]->GetSize());
+        stats.nErrors++;
+        break;
+      }
+      // verify the payload checksum, when present in the table
+      // (c.f. consumer-FairMQchannel-* checksumEnabled)
+      if ((cfgCheckChecksum) && (partTable[p].crc32c != 0)) {
+        uint32_t crc = ReadoutUtils::crc32c(msgParts[p + 1]->GetData(),
+                                            msgParts[p + 1]->GetSize());
+        if (crc != partTable[p].crc32c) {
+          theLog.log(InfoLogger::Severity::Error,
+                     "Mismatch part %d checksum: computed 0x%08X != 0x%08X "
+                     "in header\n",
+                     (int)p, crc, partTable[p].crc32c);
+          stats.nErrors++;
+          break;
+        }
+        stats.nChecksum++;
+      }
+      if (dumpNext) {
+        printf("Receiving TF %d part %d : link %d orbit %u offset 0x%08X "
+               "size %d\n",
+               (int)stf->timeframeId, (int)p, (int)partTable[p].linkId,
+               partTable[p].firstOrbit, partTable[p].offset,
+               (int)partTable[p].size);
+      }
+    }
+  }
+}
 
 // program main
 int main(int argc, const char **argv) {
@@ -254,11 +487,10 @@ int main(int argc, const char **argv) {
 
   // configuration parameter: | receiverFMQ | decodingMode | string | none |
   // Decoding mode of the readout FMQ output stream. Possible values: none (no
-  // decoding), stfHbf, stfSuperpage |
+  // decoding), stfHbf, stfSuperpage, stfV2 |
   std::string cfgDecodingMode = "none";
   cfg.getOptionalValue<std::string>(cfgEntryPoint + ".decodingMode",
                                     cfgDecodingMode);
-  enum decodingMode { none = 0, stfHbf = 1, stfSuperpage = 2 };
   decodingMode mode = decodingMode::none;
   if (cfgDecodingMode == "none") {
     mode = decodingMode::none;
@@ -266,6 +498,8 @@ int main(int argc, const char **argv) {
     mode = decodingMode::stfHbf;
   } else if (cfgDecodingMode == "stfSuperpage") {
     mode = decodingMode::stfSuperpage;
+  } else if (cfgDecodingMode == "stfV2") {
+    mode = decodingMode::stfV2;
   } else {
     theLog.log(InfoLogger::Severity::Error, "Wrong decoding mode set : %s",
                cfgDecodingMode.c_str());
@@ -284,6 +518,50 @@ int main(int argc, const char **argv) {
   cfg.getOptionalValue<int>(cfgEntryPoint + ".dumpTF", cfgDumpTF, 0);
   theLog.log("dumpRDH = %d dumpTF = %d", cfgDumpRDH, cfgDumpTF);
 
+  // configuration parameter: | receiverFMQ | decodingThreads | int | 0 | Number
+  // of threads for the decoding/checking of incoming messages. When zero,
+  // messages are decoded in the receiving loop (single-threaded behavior). When
+  // set, the receiving loop hands messages over to a pool of decoding threads,
+  // so that checking can keep up with high input rates. |
+  int cfgDecodingThreads = 0;
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".decodingThreads",
+                            cfgDecodingThreads, 0);
+
+  // configuration parameter: | receiverFMQ | decodingFifoSize | int | 32 | Size
+  // of the FIFO between the receiving loop and the decoding threads (number of
+  // message batches). Used when decodingThreads is set. |
+  int cfgDecodingFifoSize = 32;
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".decodingFifoSize",
+                            cfgDecodingFifoSize, 32);
+
+  // configuration parameter: | receiverFMQ | decodingBatchSize | int | 4 |
+  // Number of messages handed over at once to the decoding threads, to reduce
+  // synchronization overhead. Used when decodingThreads is set. |
+  int cfgDecodingBatchSize = 4;
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".decodingBatchSize",
+                            cfgDecodingBatchSize, 4);
+  if (cfgDecodingBatchSize < 1) {
+    cfgDecodingBatchSize = 1;
+  }
+  if (cfgDecodingThreads) {
+    theLog.log("decodingThreads = %d decodingFifoSize = %d decodingBatchSize = "
+               "%d",
+               cfgDecodingThreads, cfgDecodingFifoSize, cfgDecodingBatchSize);
+  }
+
+  // configuration parameter: | receiverFMQ | checkChecksum | int | 0 | If
+  // set, the CRC32C of the payload of each message part received in stfV2
+  // decoding mode is recomputed and verified against the value found in the
+  // part descriptor table of the STF header (c.f. consumer-FairMQchannel-*
+  // checksumEnabled). Parts with no checksum in the table (zero) are skipped. |
+  int cfgCheckChecksum = 0;
+  cfg.getOptionalValue<int>(cfgEntryPoint + ".checkChecksum", cfgCheckChecksum,
+                            0);
+  if (cfgCheckChecksum) {
+    theLog.log("checkChecksum enabled, %s CRC32C implementation",
+               ReadoutUtils::crc32cHardware ? "hardware (SSE4.2)" : "software");
+  }
+
   // create FMQ receiving channel
   theLog.log("Creating FMQ RX channel %s type %s @ %s", cfgChannelName.c_str(),
              cfgChannelType.c_str(), cfgChannelAddress.c_str());
@@ -311,13 +589,71 @@ int main(int argc, const char **argv) {
   unsigned long long nBytes = 0;
   bool isMultiPart = false;
 
-  double copyRatio=0;
-  unsigned long long copyRatioCount=0;
-
-  if ( (mode == decodingMode::stfHbf) || (mode == decodingMode::stfSuperpage)){
+  if ( (mode == decodingMode::stfHbf) || (mode == decodingMode::stfSuperpage)
+    || (mode == decodingMode::stfV2)){
     isMultiPart = true;
   }
 
+  // decoding counters (inline mode, single-threaded)
+  DecodeStats decodeStats;
+
+  // decoding thread pool, when configured.
+  // received messages are handed over by batches, to limit synchronization
+  // overhead, and each thread keeps its own counters, aggregated for reports.
+  typedef std::vector<std::vector<FairMQMessagePtr>> DecodeBatch;
+  std::unique_ptr<AliceO2::Common::Fifo<DecodeBatch *>> decodeFifo;
+  std::mutex decodeFifoMutex; // serializes the consumer side of decodeFifo, shared by all decoding threads (the FIFO itself is 1 producer + 1 consumer only)
+  std::vector<std::thread> decodeThreads;
+  std::vector<DecodeStats> decodeThreadStats;
+  std::atomic<int> decodeShutdown(0);
+  std::unique_ptr<DecodeBatch> pendingBatch;
+  if ((cfgDecodingThreads > 0) && (isMultiPart)) {
+    decodeFifo = std::make_unique<AliceO2::Common::Fifo<DecodeBatch *>>(
+        cfgDecodingFifoSize);
+    decodeThreadStats.resize(cfgDecodingThreads);
+    for (int ix = 0; ix < cfgDecodingThreads; ix++) {
+      decodeThreads.push_back(std::thread([&, ix]() {
+        DecodeStats &stats = decodeThreadStats[ix];
+        for (;;) {
+          DecodeBatch *batch = nullptr;
+          int popError;
+          {
+            std::unique_lock<std::mutex> lock(decodeFifoMutex);
+            popError = decodeFifo->pop(batch);
+          }
+          if (popError == 0) {
+            for (auto &parts : *batch) {
+              decodeMessage(parts, mode, cfgDumpRDH, cfgDumpTF,
+                            cfgCheckChecksum, stats);
+            }
+            delete batch;
+          } else {
+            // exit only when FIFO drained after shutdown request
+            if (decodeShutdown.load()) {
+              break;
+            }
+            usleep(1000);
+          }
+        }
+      }));
+    }
+    theLog.log("Started %d decoding threads", cfgDecodingThreads);
+  }
+
+  // aggregate decoding counters over all threads (and the inline instance)
+  auto getDecodeStatsTotal = [&]() {
+    DecodeStats total = decodeStats;
+    for (auto const &stats : decodeThreadStats) {
+      total.nMsgDecoded += stats.nMsgDecoded;
+      total.nParts += stats.nParts;
+      total.nErrors += stats.nErrors;
+      total.copyRatio += stats.copyRatio;
+      total.copyRatioCount += stats.copyRatioCount;
+      total.nChecksum += stats.nChecksum;
+    }
+    return total;
+  };
+
   theLog.log("Entering receiving loop");
 
   for (; !ShutdownRequest;) {
@@ -331,123 +667,38 @@ int main(int argc, const char **argv) {
       if (bytesReceived > 0) {
         nBytes += bytesReceived;
         nMsg++;
+        nMsgParts += msgParts.size();
         msgStats.increment(bytesReceived);
 
-        if (mode == decodingMode::stfHbf) {
-	
-          // expected format of received messages : (header + HB + HB ...)
-
-          int nPart = msgParts.size();
-	  nMsgParts += nPart;
-          if (nPart < 2) {
-            theLog.log(InfoLogger::Severity::Error,
-                       "Only %d parts in message, need at least 2", nPart);
-            continue;
+        if (decodeFifo != nullptr) {
+          // hand over message to decoding threads, by batches
+          if (pendingBatch == nullptr) {
+            pendingBatch = std::make_unique<DecodeBatch>();
+            pendingBatch->reserve(cfgDecodingBatchSize);
           }
-
-          int i = 0;
-          bool dumpNext = false;
-          SubTimeframe *stf = nullptr;
-          for (auto const &mm : msgParts) {
-            
-            if (i == 0) {
-              // first part is STF header
-              if (mm->GetSize() != sizeof(SubTimeframe)) {
-                theLog.log(InfoLogger::Severity::Error,
-                           "Header wrong size %d != %d\n", (int)mm->GetSize(),
-                           (int)sizeof(SubTimeframe));
+          pendingBatch->push_back(std::move(msgParts));
+          if ((int)pendingBatch->size() >= cfgDecodingBatchSize) {
+            for (; !ShutdownRequest;) {
+              if (decodeFifo->push(pendingBatch.get()) == 0) {
+                (void)pendingBatch.release();
                 break;
               }
-              stf = (SubTimeframe *)mm->GetData();
-              if ((int)stf->numberOfHBF != nPart - 1) {
-                theLog.log(
-                    InfoLogger::Severity::Error,
-                    "Mismatch stf->numberOfHBF %d != %d message parts - 1\n",
-                    stf->numberOfHBF, nPart - 1);
-                break;
-              }
-              // number of message parts matches number of HBFs in header ?
-              if (cfgDumpTF) {
-                if ((stf->timeframeId == 1) ||
-                    (stf->timeframeId % cfgDumpTF == 0)) {
-                  dumpNext = true;
-                }
-              }
-            } else {	    
-	      // then we have 1 part per HBF
-              size_t dataSize = mm->GetSize();
-              void *data = mm->GetData();
-              std::string errorDescription;
-              for (size_t pageOffset = 0; pageOffset < dataSize;) {
-                if (pageOffset + sizeof(o2::Header::RAWDataHeader) > dataSize) {
-                  theLog.log("part %d offset 0x%08lX: not enough space for RDH",
-                             i, pageOffset);
-                  break;
-                }
-                RdhHandle h(((uint8_t *)data) + pageOffset);
-
-                if (dumpNext) {
-                  printf("Receiving TF %d CRU %d link %d : %d HBf\n",
-                         (int)stf->timeframeId, (int)h.getCruId(),
-                         (int)stf->linkId, (int)stf->numberOfHBF);
-                  dumpNext = false;
-                }
-
-                if (cfgDumpRDH) {
-                  h.dumpRdh(pageOffset, 1);
-                }
-
-                int nErr = h.validateRdh(errorDescription);
-                if (nErr) {
-                  if (!cfgDumpRDH) {
-                    // dump RDH if not done already
-                    h.dumpRdh(pageOffset, 1);
-                  }
-                  theLog.log(InfoLogger::Severity::Error,
-                             "part %d offset 0x%08lX : %s", i, pageOffset,
-                             errorDescription.c_str());
-                  errorDescription.clear();
-                  break;
-                }
-
-                // go to next RDH
-                uint16_t offsetNextPacket = h.getOffsetNextPacket();
-                if (offsetNextPacket == 0) {
-                  break;
-                }
-                pageOffset += offsetNextPacket;
-              }
+              // FIFO full, decoding threads late: wait a bit
+              usleep(1000);
             }
-            i++;
           }
-	  
-        } else if (mode == decodingMode::stfSuperpage) {
-
-	  nMsgParts += msgParts.size();
-          ReadoutStfDecoder decoder(std::move(msgParts));
-	  copyRatio+=decoder.getCopyRatio();
-	  copyRatioCount++;
-	  
-	  if (cfgDumpRDH) {
-	    int i=0;
-	    for (auto const &p : decoder.getHbf()) {
-	      printf("HBF %d\n",i);
-	      for (size_t offset = 0; offset < p.size;) {
-                RdhHandle h(((uint8_t *)p.data) + offset);
-                if (cfgDumpRDH) {
-                  h.dumpRdh(offset, 1);
-        	}
-		// go to next RDH
-                uint16_t offsetNextPacket = h.getOffsetNextPacket();
-                if (offsetNextPacket == 0) {
-                  break;
-                }
-                offset += offsetNextPacket;
-	      }
-	      i++;
-	    }
+        } else {
+          decodeMessage(msgParts, mode, cfgDumpRDH, cfgDumpTF, cfgCheckChecksum,
+                        decodeStats);
+        }
+      } else {
+        // no message received: flush partial batch to decoding threads,
+        // so that checking does not lag behind when input rate is low
+        if ((pendingBatch != nullptr) && (pendingBatch->size())) {
+          if (decodeFifo->push(pendingBatch.get()) == 0) {
+            (void)pendingBatch.release();
           }
-	}
+        }
       }
     } else {
       if (pull.Receive(msg, 0) > 0) {
@@ -470,8 +721,10 @@ int main(int argc, const char **argv) {
       double t = runningTime.getTime();
       theLog.log("%.3lf msg/s %.3lf parts/s %.3lfMB/s", nMsg / t, nMsgParts / t,
                  nBytes / (1024.0 * 1024.0 * t));
-      if (copyRatioCount) {
-        theLog.log("HBF copy ratio = %.3lf %%",copyRatio*100/copyRatioCount);
+      DecodeStats total = getDecodeStatsTotal();
+      if (total.copyRatioCount) {
+        theLog.log("HBF copy ratio = %.3lf %%",
+                   total.copyRatio * 100 / total.copyRatioCount);
       }
       runningTime.reset(statsTimeout);
       nMsg = 0;
@@ -481,6 +734,23 @@ int main(int argc, const char **argv) {
   }
 
   theLog.log("Receiving loop completed");
+
+  // stop decoding threads: decode leftover batch here, then let the threads
+  // drain the FIFO before exiting
+  if (decodeFifo != nullptr) {
+    if (pendingBatch != nullptr) {
+      for (auto &parts : *pendingBatch) {
+        decodeMessage(parts, mode, cfgDumpRDH, cfgDumpTF, cfgCheckChecksum,
+                      decodeStats);
+      }
+      pendingBatch = nullptr;
+    }
+    decodeShutdown = 1;
+    for (auto &t : decodeThreads) {
+      t.join();
+    }
+  }
+
   theLog.log(
       "bytes received: %llu  (avg=%.2lf  min=%llu  max=%llu  count=%llu)",
       (unsigned long long)msgStats.get(), msgStats.getAverage(),
@@ -488,6 +758,19 @@ int main(int argc, const char **argv) {
       (unsigned long long)msgStats.getMaximum(),
       (unsigned long long)msgStats.getCount());
 
+  if (mode != decodingMode::none) {
+    DecodeStats total = getDecodeStatsTotal();
+    theLog.log("messages decoded: %llu  (parts=%llu  errors=%llu)",
+               total.nMsgDecoded, total.nParts, total.nErrors);
+    if (total.copyRatioCount) {
+      theLog.log("HBF copy ratio = %.3lf %%",
+                 total.copyRatio * 100 / total.copyRatioCount);
+    }
+    if (cfgCheckChecksum) {
+      theLog.log("part checksums verified: %llu", total.nChecksum);
+    }
+  }
+
   return 0;
 
   // other implementation with a full FMQ device